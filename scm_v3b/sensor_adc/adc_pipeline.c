@@ -0,0 +1,214 @@
+/*
+Interrupt driven ADC acquisition
+
+Each conversion used to be a chain of spin loops in main(): sensor settle,
+PGA settle, convert and a busy-wait on the ADC, then the reset strobe. Here
+the same steps are sequenced by an RF timer compare and the ADC interrupt,
+so the CPU sleeps in between:
+
+  SETTLE  -- compare -->  PGA amplify, start the ADC state machine
+  AMPLIFY -- compare -->  convert high
+  CONVERT -- ADC ISR -->  sample into the ring, convert low, PGA off, reset low
+  RESET   -- compare -->  reset high, back to SETTLE
+
+adc_pipeline_process() runs from the main loop and feeds the samples through
+a CIC decimator, ORDER integrators and combs with a rate change of
+DECIMATION, which is the average of DECIMATION samples for order 1.
+*/
+#include "Memory_map.h"
+#include "adc_pipeline.h"
+
+#define GPIO_REG__PGA_AMPLIFY	0x0040
+#define GPIO_REG__ADC_CONVERT	0x0020
+#define GPIO_REG__ADC_RESET	  0x0010
+
+#define ADC_RFTIMER_COMPARE				RFTIMER_REG__COMPARE6
+#define ADC_RFTIMER_COMPARE_CONTROL		RFTIMER_REG__COMPARE6_CONTROL
+
+// Assuming RF timer frequency = 500 kHz
+#define ADC_SENSOR_SETTLE_TICKS		25	// 50us, slowdown for potentiometric sensors
+#define ADC_PGA_SETTLE_TICKS		25	// 50us for the amp to settle
+#define ADC_RESET_TICKS				13	// 26us reset strobe
+
+#define ADC_SAMPLE_BITS				10
+// the decimator's gain has to leave room for the sample in 32 bits
+#define ADC_CIC_MAX_GAIN			(1u << (32 - ADC_SAMPLE_BITS))
+
+#define ADC_IRQ						0x0008
+#define RFTIMER_IRQ					0x0080
+
+#define ADC_RING_MASK				(ADC_RING_SIZE - 1)
+
+enum {
+	ADC_STATE_IDLE = 0,
+	ADC_STATE_SETTLE,
+	ADC_STATE_AMPLIFY,
+	ADC_STATE_CONVERT,
+	ADC_STATE_RESET
+};
+
+volatile unsigned int adc_state = ADC_STATE_IDLE;
+
+// written by the ADC ISR at head, read by adc_pipeline_process() at tail
+unsigned short adc_ring[ADC_RING_SIZE];
+volatile unsigned int adc_ring_head = 0;
+volatile unsigned int adc_ring_tail = 0;
+volatile unsigned int adc_ring_overruns = 0;
+
+// CIC state, wraps modulo 2^32 which the combs undo
+unsigned int cic_order;
+unsigned int cic_decimation;
+unsigned int cic_gain;
+unsigned int cic_phase;
+unsigned int cic_to_skip;
+unsigned int cic_integrators[ADC_CIC_MAX_ORDER];
+unsigned int cic_combs[ADC_CIC_MAX_ORDER];
+
+void adc_schedule(unsigned int ticks) {
+	ADC_RFTIMER_COMPARE = RFTIMER_REG__COUNTER + ticks;
+	ADC_RFTIMER_COMPARE_CONTROL = RFTIMER_COMPARE_ENABLE | RFTIMER_COMPARE_INTERRUPT_ENABLE;
+}
+
+// Starts converting continuously, one output per DECIMATION samples.
+// Returns 0 if the order or the gain (DECIMATION^ORDER) is too large.
+int adc_pipeline_start(unsigned int order, unsigned int decimation) {
+	unsigned int i;
+
+	if (order == 0 || order > ADC_CIC_MAX_ORDER || decimation == 0) {
+		return 0;
+	}
+	cic_gain = 1;
+	for (i=0; i<order; i++) {
+		if (cic_gain > ADC_CIC_MAX_GAIN / decimation) {
+			return 0;
+		}
+		cic_gain *= decimation;
+	}
+
+	adc_pipeline_stop();
+
+	cic_order = order;
+	cic_decimation = decimation;
+	cic_phase = 0;
+	// the first outputs of a higher order filter are still filling up
+	cic_to_skip = order - 1;
+	for (i=0; i<ADC_CIC_MAX_ORDER; i++) {
+		cic_integrators[i] = 0;
+		cic_combs[i] = 0;
+	}
+	adc_ring_head = 0;
+	adc_ring_tail = 0;
+	adc_ring_overruns = 0;
+
+	// RF timer free running
+	RFTIMER_REG__MAX_COUNT = 0xFFFFFFFF;
+	RFTIMER_REG__CONTROL = 0x7;
+
+	adc_state = ADC_STATE_SETTLE;
+	adc_schedule(ADC_SENSOR_SETTLE_TICKS);
+	ISER = ADC_IRQ | RFTIMER_IRQ;
+
+	return 1;
+}
+
+// Stops converting, dropping a conversion in progress
+void adc_pipeline_stop(void) {
+	adc_state = ADC_STATE_IDLE;
+	ADC_RFTIMER_COMPARE_CONTROL = 0x0;
+
+	// PGA and convert off, reset released, as after reset1()
+	GPIO_REG__OUTPUT &= ~GPIO_REG__ADC_CONVERT;
+	GPIO_REG__OUTPUT |= GPIO_REG__PGA_AMPLIFY | GPIO_REG__ADC_RESET;
+}
+
+// Runs the samples received so far through the decimator. Returns 1 with
+// the next output in VALUE, or 0 once the ring is empty.
+int adc_pipeline_process(unsigned int* value) {
+	unsigned int x, y, prev, k;
+
+	while (adc_ring_tail != adc_ring_head) {
+		x = adc_ring[adc_ring_tail];
+		adc_ring_tail = (adc_ring_tail + 1) & ADC_RING_MASK;
+
+		cic_integrators[0] += x;
+		for (k=1; k<cic_order; k++) {
+			cic_integrators[k] += cic_integrators[k-1];
+		}
+
+		cic_phase++;
+		if (cic_phase < cic_decimation) {
+			continue;
+		}
+		cic_phase = 0;
+
+		y = cic_integrators[cic_order-1];
+		for (k=0; k<cic_order; k++) {
+			prev = cic_combs[k];
+			cic_combs[k] = y;
+			y = y - prev;
+		}
+
+		if (cic_to_skip > 0) {
+			cic_to_skip--;
+			continue;
+		}
+		*value = y / cic_gain;
+		return 1;
+	}
+	return 0;
+}
+
+// Samples lost because adc_pipeline_process() didn't keep up
+unsigned int adc_pipeline_overruns(void) {
+	return adc_ring_overruns;
+}
+
+void adc_pipeline_rftimer_isr(void) {
+	switch (adc_state) {
+		case ADC_STATE_SETTLE:
+			// activate state machine so ADC result will be copied into buffer
+			ADC_REG__START = 0x1;
+			// set PGA to amplify mode and wait for amp to settle
+			GPIO_REG__OUTPUT &= ~GPIO_REG__PGA_AMPLIFY;
+			adc_state = ADC_STATE_AMPLIFY;
+			adc_schedule(ADC_PGA_SETTLE_TICKS);
+			break;
+		case ADC_STATE_AMPLIFY:
+			// set convert high, the ADC interrupt signals the result
+			ADC_RFTIMER_COMPARE_CONTROL = 0x0;
+			adc_state = ADC_STATE_CONVERT;
+			GPIO_REG__OUTPUT |= GPIO_REG__ADC_CONVERT;
+			break;
+		case ADC_STATE_RESET:
+			GPIO_REG__OUTPUT |= GPIO_REG__ADC_RESET;
+			adc_state = ADC_STATE_SETTLE;
+			adc_schedule(ADC_SENSOR_SETTLE_TICKS);
+			break;
+		default:
+			ADC_RFTIMER_COMPARE_CONTROL = 0x0;
+			break;
+	}
+}
+
+void adc_pipeline_adc_isr(void) {
+	unsigned int next_head;
+
+	if (adc_state != ADC_STATE_CONVERT) {
+		return;
+	}
+
+	next_head = (adc_ring_head + 1) & ADC_RING_MASK;
+	if (next_head == adc_ring_tail) {
+		adc_ring_overruns++;
+	} else {
+		adc_ring[adc_ring_head] = (unsigned short) ADC_REG__DATA;
+		adc_ring_head = next_head;
+	}
+
+	// PGA back off and strobe reset low, it goes high again on the next compare
+	GPIO_REG__OUTPUT &= ~GPIO_REG__ADC_CONVERT;
+	GPIO_REG__OUTPUT |= GPIO_REG__PGA_AMPLIFY;
+	GPIO_REG__OUTPUT &= ~GPIO_REG__ADC_RESET;
+	adc_state = ADC_STATE_RESET;
+	adc_schedule(ADC_RESET_TICKS);
+}
@@ -0,0 +1,19 @@
+// Interrupt driven ADC acquisition with a CIC decimator, see adc_pipeline.c
+
+// raw samples waiting for adc_pipeline_process(), power of 2
+#define ADC_RING_SIZE				64
+
+// order 1 is a plain boxcar average
+#define ADC_CIC_MAX_ORDER			4
+
+// RF timer compare used to sequence the conversions
+#define ADC_RFTIMER_COMPARE_INT		0x00000040
+
+int adc_pipeline_start(unsigned int order, unsigned int decimation);
+void adc_pipeline_stop(void);
+int adc_pipeline_process(unsigned int* value);
+unsigned int adc_pipeline_overruns(void);
+
+// call from ADC_ISR() and from RFTIMER_ISR() on ADC_RFTIMER_COMPARE_INT
+void adc_pipeline_adc_isr(void);
+void adc_pipeline_rftimer_isr(void);
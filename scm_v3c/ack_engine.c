@@ -0,0 +1,211 @@
+/**
+\brief Sends ACKs a fixed time after the frame they acknowledge, from the radio interrupts.
+
+While enabled, every RX frame with a good CRC gets num_acks ACKs at a known
+good TX code, whatever code it was received at:
+- at SFD, the ACK is built with the RX code, so only the counter of the
+  received frame is left to fill in,
+- at RX done, the ACK is loaded, the LO retuned to the TX code and an RF timer
+  compare set turnaround_ticks after the RX done timestamp,
+- the compare starts the TX, and each TX done schedules the next ACK the same
+  turnaround after it.
+The ACK latency then only depends on the RF timer, not on what the
+application does in between.
+
+The engine borrows compare 0 from radio.c. A compare set at RX done replaces
+the end of the RX window, so receive_packet() returns once the last ACK is out,
+through cb_timer(), as it would have when the window ended.
+*/
+
+#include <stddef.h>
+
+#include "scm3c_hw_interface.h"
+#include "radio.h"
+#include "rftimer.h"
+#include "packet_encoder.h"
+#include "telemetry.h"
+#include "ack_engine.h"
+
+//=========================== defines =========================================
+
+// the RX window timer of radio.c, free once the frame is in
+#define ACK_ENGINE_RFTIMER_COMPAREID    0
+
+//=========================== variables =======================================
+
+typedef struct {
+    bool        enabled;
+    uint32_t    turnaround_ticks;
+    uint8_t     tx_coarse;              // known good code the ACKs go out at
+    uint8_t     tx_mid;
+    uint8_t     tx_fine;
+    uint8_t     num_acks;
+    uint8_t     rx_coarse;              // code of the current RX, goes in the ACK
+    uint8_t     rx_mid;
+    uint8_t     rx_fine;
+    uint8_t     ack[ACK_ENGINE_MAX_LEN];
+    uint8_t     ack_len;
+    bool        prepared;               // ack[] was built at SFD
+    uint8_t     acks_left;              // of the frame being acknowledged
+    uint32_t    frame_end;              // RX done or TX done the next ACK is timed from
+    uint8_t     rx_frame[LEN_RX_PKT];
+    uint32_t    sent;
+    uint32_t    late;                   // ACKs started after the turnaround
+    uint32_t    last_turnaround;
+} ack_engine_vars_t;
+
+ack_engine_vars_t ack_engine_vars;
+
+//=========================== prototypes ======================================
+
+void ack_engine_startFrame_rx(uint32_t timestamp);
+void ack_engine_endFrame_rx(uint32_t timestamp);
+void ack_engine_endFrame_tx(uint32_t timestamp);
+void ack_engine_schedule(uint32_t frame_end);
+void ack_engine_fire(void);
+
+//=========================== public ==========================================
+
+/* Hooks the engine between the radio interrupts and the callbacks of radio.c,
+ * call it after radio_setCallbacks(). Each ACK starts TURNAROUND_TICKS after
+ * the end of the frame before it, or ACK_ENGINE_MIN_WARMUP_TICKS after it was
+ * scheduled if that is later.
+ */
+void ack_engine_init(uint32_t turnaround_ticks) {
+    ack_engine_vars.enabled          = false;
+    ack_engine_vars.turnaround_ticks = turnaround_ticks;
+    ack_engine_vars.prepared         = false;
+    ack_engine_vars.acks_left        = 0;
+    ack_engine_vars.sent             = 0;
+    ack_engine_vars.late             = 0;
+    ack_engine_vars.last_turnaround  = 0;
+
+    radio_setStartFrameRxCb(ack_engine_startFrame_rx);
+    radio_setEndFrameRxCb(ack_engine_endFrame_rx);
+    radio_setEndFrameTxCb(ack_engine_endFrame_tx);
+}
+
+// Acknowledges the frames received from now on with NUM_ACKS ACKs at COARSE/MID/FINE
+void ack_engine_enable(uint8_t coarse, uint8_t mid, uint8_t fine, uint8_t num_acks) {
+    ack_engine_vars.tx_coarse = coarse;
+    ack_engine_vars.tx_mid    = mid;
+    ack_engine_vars.tx_fine   = fine;
+    ack_engine_vars.num_acks  = num_acks;
+    ack_engine_vars.enabled   = num_acks > 0;
+}
+
+void ack_engine_disable(void) {
+    ack_engine_vars.enabled = false;
+}
+
+// The code of the next receive_packet(), reported back in its ACKs
+void ack_engine_listen(uint8_t coarse, uint8_t mid, uint8_t fine) {
+    ack_engine_vars.rx_coarse = coarse;
+    ack_engine_vars.rx_mid    = mid;
+    ack_engine_vars.rx_fine   = fine;
+}
+
+// Builds an ACK frame in BUF, ACK_ENGINE_MAX_LEN long, and returns the length for send_packet_len()
+uint8_t ack_engine_build(uint8_t* buf, uint8_t counter, uint8_t rx_coarse, uint8_t rx_mid, uint8_t rx_fine) {
+    packet_encoder_t enc;
+
+    packet_encoder_begin(&enc, buf, ACK_ENGINE_MAX_LEN, counter);
+    packet_add_lc_config(&enc, rx_coarse, rx_mid, rx_fine);
+    return packet_encoder_end(&enc);
+}
+
+uint32_t ack_engine_sent(void) {
+    return ack_engine_vars.sent;
+}
+
+uint32_t ack_engine_late(void) {
+    return ack_engine_vars.late;
+}
+
+// RF timer ticks from the end of the last frame to the start of the last ACK
+uint32_t ack_engine_last_turnaround(void) {
+    return ack_engine_vars.last_turnaround;
+}
+
+//=========================== private =========================================
+
+// Sets the RF timer to start the ACK a turnaround after FRAME_END
+void ack_engine_schedule(uint32_t frame_end) {
+    uint32_t start;
+    uint32_t earliest;
+
+    ack_engine_vars.frame_end = frame_end;
+
+    radio_loadPacket(ack_engine_vars.ack, ack_engine_vars.ack_len);
+    LC_FREQCHANGE(ack_engine_vars.tx_coarse, ack_engine_vars.tx_mid, ack_engine_vars.tx_fine);
+    radio_txEnable();
+
+    // the TX gets its warm-up from radio_txEnable() even if that is past the
+    // turnaround (which also keeps the compare out of the past, where it
+    // would only match after the counter wraps)
+    start    = frame_end + ack_engine_vars.turnaround_ticks;
+    earliest = rftimer_readCounter() + ACK_ENGINE_MIN_WARMUP_TICKS;
+    if ((int32_t)(earliest - start) > 0) {
+        ack_engine_vars.late++;
+        telemetry_trace(TELEMETRY_TRACE_ACK_LATE, earliest - start);
+        start = earliest;
+    }
+    rftimer_set_callback(ack_engine_fire, ACK_ENGINE_RFTIMER_COMPAREID);
+    rftimer_setCompareIn(start, ACK_ENGINE_RFTIMER_COMPAREID);
+}
+
+//=========================== interrupt =======================================
+
+void ack_engine_startFrame_rx(uint32_t timestamp) {
+    cb_startFrame_rx(timestamp);
+
+    if (!ack_engine_vars.enabled) {
+        return;
+    }
+    ack_engine_vars.ack_len = ack_engine_build(ack_engine_vars.ack, 0,
+        ack_engine_vars.rx_coarse, ack_engine_vars.rx_mid, ack_engine_vars.rx_fine);
+    ack_engine_vars.prepared = true;
+}
+
+void ack_engine_endFrame_rx(uint32_t timestamp) {
+    uint8_t len;
+    int8_t  rssi;
+    uint8_t lqi;
+
+    // before radio.c clears the frame
+    radio_getReceivedFrame(ack_engine_vars.rx_frame, &len, sizeof(ack_engine_vars.rx_frame), &rssi, &lqi);
+
+    cb_endFrame_rx(timestamp);
+
+    if (!ack_engine_vars.enabled || !ack_engine_vars.prepared || !radio_getCrcOk() || len != LEN_RX_PKT) {
+        ack_engine_vars.prepared = false;
+        return;
+    }
+    ack_engine_vars.prepared  = false;
+    ack_engine_vars.ack[0]    = ack_engine_vars.rx_frame[0];
+    ack_engine_vars.acks_left = ack_engine_vars.num_acks;
+    ack_engine_schedule(timestamp);
+}
+
+void ack_engine_endFrame_tx(uint32_t timestamp) {
+    cb_endFrame_tx(timestamp);
+
+    if (ack_engine_vars.acks_left == 0) {
+        return;
+    }
+    ack_engine_vars.sent++;
+    if (--ack_engine_vars.acks_left > 0) {
+        ack_engine_schedule(timestamp);
+        return;
+    }
+
+    // done, end the RX window receive_packet() is waiting for
+    rftimer_set_callback(cb_timer, ACK_ENGINE_RFTIMER_COMPAREID);
+    cb_timer();
+}
+
+void ack_engine_fire(void) {
+    radio_txNow();
+    ack_engine_vars.last_turnaround = rftimer_readCounter() - ack_engine_vars.frame_end;
+    telemetry_trace(TELEMETRY_TRACE_ACK_SENT, ack_engine_vars.last_turnaround);
+}
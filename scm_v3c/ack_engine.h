@@ -0,0 +1,31 @@
+#ifndef __ACK_ENGINE_H
+#define __ACK_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+// [counter of the received frame] [PACKET_LC_CONFIG it was received at], padded
+#define ACK_ENGINE_MAX_LEN      16
+// RF timer ticks the LO and LDOs get between radio_txEnable() and radio_txNow(),
+// the 2ms TX turnaround of pingpong_test. An ACK that would get less, e.g. with
+// a shorter turnaround, goes out this long after it was scheduled and counts as late.
+#define ACK_ENGINE_MIN_WARMUP_TICKS 1000
+
+//=========================== typedef =========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void     ack_engine_init(uint32_t turnaround_ticks);
+void     ack_engine_enable(uint8_t coarse, uint8_t mid, uint8_t fine, uint8_t num_acks);
+void     ack_engine_disable(void);
+void     ack_engine_listen(uint8_t coarse, uint8_t mid, uint8_t fine);
+uint8_t  ack_engine_build(uint8_t* buf, uint8_t counter, uint8_t rx_coarse, uint8_t rx_mid, uint8_t rx_fine);
+uint32_t ack_engine_sent(void);
+uint32_t ack_engine_late(void);
+uint32_t ack_engine_last_turnaround(void);
+
+#endif
@@ -1,3 +1,4 @@
+#include <stdio.h>
 
 void adc_isr() {
     printf("adc interrupt triggered\r\n");
@@ -0,0 +1,221 @@
+/**
+\brief Collects sensor readings into radio payloads instead of one frame each.
+
+Each reading is a packet_encoder record after a PACKET_TIME record with the
+ms since the previous reading of the payload, the first one the ms since boot,
+so a temperature costs 7 bytes or so instead of a whole frame and a radio
+warm-up. Readings taken in the same ms share the time record.
+
+The payload is sent through the callback of the application:
+- when it is full, i.e. the next reading does not fit or no reading would,
+- from aggregator_poll() once its first reading is max_latency_ms old,
+- and only if the budget callback, if any, says there is the energy for it.
+Until then the readings wait in the payload. Readings that do not fit while
+the budget holds the payload back are dropped and counted, the old ones are
+kept since they are due first.
+*/
+
+#include <stddef.h>
+
+#include "rftimer.h"
+#include "imu_sampler.h"
+#include "packet_encoder.h"
+#include "aggregator.h"
+
+//=========================== defines =========================================
+
+// time record with a short delta and the shortest reading, no reading fits below it
+#define AGGREGATOR_MIN_READING_LEN  (2 * PACKET_RECORD_HEADER_LEN + 2)
+
+//=========================== variables =======================================
+
+typedef struct {
+    packet_encoder_t        enc;
+    uint8_t*                buf;
+    uint8_t                 buf_len;
+    uint8_t                 counter;        // first byte of the payloads
+    uint8_t                 readings;       // in the current payload
+    uint32_t                first_tick;     // RF timer time of its first reading
+    uint32_t                last_tick;      // RF timer time of its last time record, on a whole ms
+    uint32_t                max_latency_ticks;
+    aggregator_send_cbt     send;
+    aggregator_budget_cbt   budget;
+    uint32_t                frames;
+    uint32_t                dropped;
+} aggregator_vars_t;
+
+aggregator_vars_t aggregator_vars;
+
+//=========================== prototypes ======================================
+
+bool aggregator_add(uint8_t type, uint32_t a, uint32_t b);
+bool aggregator_put(uint8_t type, uint32_t a, uint32_t b);
+bool aggregator_put_time(uint32_t now);
+bool aggregator_send(void);
+
+//=========================== public ==========================================
+
+/* Payloads are built in BUF, BUF_LEN bytes including the CRC, and handed to
+ * SEND. The readings of a payload wait at most MAX_LATENCY_MS for the next
+ * ones, if aggregator_poll() is called often enough.
+ */
+void aggregator_init(uint8_t* buf, uint8_t buf_len, uint32_t max_latency_ms, aggregator_send_cbt send) {
+    aggregator_vars.buf               = buf;
+    aggregator_vars.buf_len           = buf_len;
+    aggregator_vars.counter           = 0;
+    aggregator_vars.readings          = 0;
+    aggregator_vars.max_latency_ticks = max_latency_ms * RFTIMER_TICKS_PER_MS;
+    aggregator_vars.send              = send;
+    aggregator_vars.budget            = NULL;
+    aggregator_vars.frames            = 0;
+    aggregator_vars.dropped           = 0;
+
+    packet_encoder_begin(&aggregator_vars.enc, buf, buf_len, aggregator_vars.counter);
+}
+
+// BUDGET is asked before each payload is sent, NULL to always send
+void aggregator_set_budget(aggregator_budget_cbt budget) {
+    aggregator_vars.budget = budget;
+}
+
+bool aggregator_add_clock_counts(uint32_t count_2M, uint32_t count_32k) {
+    return aggregator_add(PACKET_CLOCK_COUNTS, count_2M, count_32k);
+}
+
+bool aggregator_add_temperature(int32_t centi_degrees) {
+    return aggregator_add(PACKET_TEMPERATURE, (uint32_t) centi_degrees, 0);
+}
+
+bool aggregator_add_adc(uint16_t value) {
+    return aggregator_add(PACKET_ADC, value, 0);
+}
+
+// The oldest samples of imu_sampler, as many as fit, false if there are none
+bool aggregator_add_imu(void) {
+    if (imu_sampler_count() == 0) {
+        return false;
+    }
+    return aggregator_add(PACKET_IMU, 0, 0);
+}
+
+// Sends the payload if its first reading is due, returns true if it was sent
+bool aggregator_poll(void) {
+    if (aggregator_vars.readings == 0 ||
+        rftimer_readCounter() - aggregator_vars.first_tick < aggregator_vars.max_latency_ticks) {
+        return false;
+    }
+    return aggregator_send();
+}
+
+// Sends the readings there are now, e.g. before sleeping
+bool aggregator_flush(void) {
+    if (aggregator_vars.readings == 0) {
+        return false;
+    }
+    return aggregator_send();
+}
+
+uint8_t aggregator_pending(void) {
+    return aggregator_vars.readings;
+}
+
+uint32_t aggregator_frames(void) {
+    return aggregator_vars.frames;
+}
+
+uint32_t aggregator_dropped(void) {
+    return aggregator_vars.dropped;
+}
+
+//=========================== private =========================================
+
+/* Adds the time and the reading, or nothing. If they do not fit, the payload
+ * is sent and they go in the next one.
+ */
+bool aggregator_add(uint8_t type, uint32_t a, uint32_t b) {
+    uint32_t now;
+    uint32_t last_tick;
+    uint8_t  len;
+
+    now = rftimer_readCounter();
+
+    while (1) {
+        len       = aggregator_vars.enc.len;
+        last_tick = aggregator_vars.last_tick;
+        if (aggregator_put_time(now) && aggregator_put(type, a, b)) {
+            break;
+        }
+
+        // undo the time record, a lone one would shift the next delta
+        aggregator_vars.enc.len      = len;
+        aggregator_vars.enc.overflow = false;
+        aggregator_vars.last_tick    = last_tick;
+        if (aggregator_vars.readings == 0 || !aggregator_send()) {
+            aggregator_vars.dropped++;
+            return false;
+        }
+    }
+
+    if (aggregator_vars.readings == 0) {
+        aggregator_vars.first_tick = now;
+    }
+    aggregator_vars.readings++;
+
+    if (aggregator_vars.enc.max_len - aggregator_vars.enc.len < AGGREGATOR_MIN_READING_LEN) {
+        aggregator_send();
+    }
+    return true;
+}
+
+bool aggregator_put(uint8_t type, uint32_t a, uint32_t b) {
+    switch (type) {
+        case PACKET_CLOCK_COUNTS:
+            return packet_add_clock_counts(&aggregator_vars.enc, a, b);
+        case PACKET_TEMPERATURE:
+            return packet_add_temperature(&aggregator_vars.enc, (int32_t) a);
+        case PACKET_ADC:
+            return packet_add_adc(&aggregator_vars.enc, (uint16_t) a);
+        case PACKET_IMU:
+            return packet_add_imu(&aggregator_vars.enc);
+        default:
+            return false;
+    }
+}
+
+/* The first time record of a payload holds the ms since boot, the next ones
+ * whole ms since the previous, so the rounding does not add up.
+ */
+bool aggregator_put_time(uint32_t now) {
+    uint32_t ms;
+
+    if (aggregator_vars.readings == 0) {
+        if (!packet_add_time(&aggregator_vars.enc, now / RFTIMER_TICKS_PER_MS)) {
+            return false;
+        }
+        aggregator_vars.last_tick = now - now % RFTIMER_TICKS_PER_MS;
+        return true;
+    }
+
+    ms = (now - aggregator_vars.last_tick) / RFTIMER_TICKS_PER_MS;
+    if (ms == 0) {
+        return true;
+    }
+    if (!packet_add_time(&aggregator_vars.enc, ms)) {
+        return false;
+    }
+    aggregator_vars.last_tick += ms * RFTIMER_TICKS_PER_MS;
+    return true;
+}
+
+// Sends the payload and starts the next one, unless the budget says no
+bool aggregator_send(void) {
+    if (aggregator_vars.budget != NULL && !aggregator_vars.budget()) {
+        return false;
+    }
+
+    aggregator_vars.send(aggregator_vars.buf, packet_encoder_end(&aggregator_vars.enc));
+    aggregator_vars.frames++;
+    aggregator_vars.readings = 0;
+    packet_encoder_begin(&aggregator_vars.enc, aggregator_vars.buf, aggregator_vars.buf_len, ++aggregator_vars.counter);
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef __AGGREGATOR_H
+#define __AGGREGATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+//=========================== typedef =========================================
+
+// Sends a finished payload, LEN includes the room for the CRC
+typedef void (*aggregator_send_cbt)(uint8_t* payload, uint8_t len);
+// True if there is the energy to send a frame now
+typedef bool (*aggregator_budget_cbt)(void);
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void     aggregator_init(uint8_t* buf, uint8_t buf_len, uint32_t max_latency_ms, aggregator_send_cbt send);
+void     aggregator_set_budget(aggregator_budget_cbt budget);
+bool     aggregator_add_clock_counts(uint32_t count_2M, uint32_t count_32k);
+bool     aggregator_add_temperature(int32_t centi_degrees);
+bool     aggregator_add_adc(uint16_t value);
+bool     aggregator_add_imu(void);
+bool     aggregator_poll(void);
+bool     aggregator_flush(void);
+uint8_t  aggregator_pending(void);
+uint32_t aggregator_frames(void);
+uint32_t aggregator_dropped(void);
+
+#endif
@@ -7,12 +7,21 @@
 #include "scm3c_hw_interface.h"
 #include "memory_map.h"
 #include "rftimer.h"
+#include "counters.h"
 #include "radio.h"
 #include "optical.h"
 #include "zappy2.h"
 #include "temperature.h"
-#include "fixed-point.h"
 #include "spi.h"
+#include "imu_sampler.h"
+#include "telemetry.h"
+#include "binlog.h"
+#include "command.h"
+#include "packet_encoder.h"
+#include "sweep_results.h"
+#include "solar_duty.h"
+#include "aggregator.h"
+#include "ack_engine.h"
 
 //=========================== defines =========================================
 
@@ -22,21 +31,37 @@
 // after optical calibration has completed for the purpose of measuring temperature
 // the optical programmer (if programmed to do so) will continue to send optical
 // calibration pulses as a reference.
-#define CLOCK_RATIO_VS_TEMP_SLOPE -19.293 //-19.667 //-30.715 // dummy value
-#define CLOCK_RATIO_VS_TEMP_OFFSET 1298.134 // 1317.511 //1915.142 // y intercept // dummy value
-#define CLOCK_RATIO_VS_FINE_CODE_SLOPE -10.567 //-24.33
-#define CLOCK_RATIO_VS_FINE_CODE_OFFEST 710.411 // 1592.204 // y intercept // dummy value
+#define CLOCK_RATIO_VS_TEMP_SLOPE CLOCK_RATIO_COEF(-19.293) //-19.667 //-30.715 // dummy value
+#define CLOCK_RATIO_VS_TEMP_OFFSET CLOCK_RATIO_COEF(1298.134) // 1317.511 //1915.142 // y intercept // dummy value
+#define CLOCK_RATIO_VS_FINE_CODE_SLOPE CLOCK_RATIO_COEF(-10.567) //-24.33
+#define CLOCK_RATIO_VS_FINE_CODE_OFFEST CLOCK_RATIO_COEF(710.411) // 1592.204 // y intercept // dummy value
 #define TEMP_MEASURE_DURATION_MILLISECONDS 100 // duration for which we should measure the 2MHz and 32kHz clocks in order to measure the temperature
 
 // RADIO DEFINES
 // make sure to set LEN_TX_PKT and LEN_RX_PKT in radio.h
+#ifndef OPTICAL_CALIBRATE
 #define OPTICAL_CALIBRATE 1 // 1 if should optical calibrate, 0 if manual
+#endif
 #define INITIALIZE_IMU 1 // 1 if IMU should be configured to make accel and gyro measurements and 0 otherwise
+#define IMU_SAMPLE_RATE_HZ 100 // IMU sampler rate in modes 17 and 20, see imu_sampler_start()
+#define IMU_SAMPLES_PER_TX 16 // samples to wait for before sending an IMU_DATA packet
+#define SARA_TOGGLES 1500 // SARA phase swaps per actuation in modes 6 and 15, see sara_compile()
+#define SARA_STEP_TICKS 625 // RF timer ticks per SARA GPIO edge, the 1.25ms the old 60 count spin loop took in low_power_mode()
+#define SARA_RELEASE_STEP_TICKS 3125 // same for the release, the old 300 counts
+#define AGGREGATE_MAX_LATENCY_MS 5000 // longest a reading waits for others to share its frame, see aggregator.c
+#define ACK_TURNAROUND_TICKS 1100 // RF timer ticks (2.2ms, ACK_ENGINE_MIN_WARMUP_TICKS and 200us for the RX done interrupt) from the end of a received frame to its ACK, and between ACKs, see ack_engine.c
 
-#define MODE 0 // 0 for tx, 1 for rx, 2 for rx then tx, ... and more (see switch statement below)
-#define SOLAR_MODE 0 // 1 if on solar, 0 if on power supply/usb (this enables/disables the SOLAR_DELAY delay)
+// The MODE to SWEEP_* defines below are the defaults of experiment_config_t, see config
+#ifndef MODE
+#define MODE 0 // 0 for tx, 1 for rx, 2 for rx then tx, ... 19 to wait for UART commands, 20 to send IMU samples (see experiment_modes)
+#endif
+#ifndef SOLAR_MODE
+#define SOLAR_MODE 0 // 1 if on solar, 0 if on power supply/usb (this enables/disables the sleep in radio_delay())
+#endif
 //NEED TO UNCOMMENT IN TX? radio_delay
-#define SOLAR_DELAY 25000 // for loop iteration count for delay while on solar between radio periods (5000 = ~3 seconds at 500KHz clock, which is low_power_mode)
+#define SOLAR_MIN_SLEEP_MS 1000 // shortest sleep between radio periods on solar, see solar_duty.c
+#define SOLAR_MAX_SLEEP_MS 15000 // longest, and the only one without a supply monitor (the old 25000 count delay loop)
+#define SOLAR_POWER_GOOD_GPIO 0x0000 // GPIO input of the harvester's power good output, 0 if not wired (enable it with GPI_enables())
 #define SWEEP_TX 0 // 1 if sweep, 0 if fixed
 #define SWEEP_RX 1 // 1 if sweep, 0 if fixed
 #define SEND_ACK 1 // 1 if we should send an ack after packet rx and 0 otherwise
@@ -113,8 +138,6 @@
 #define IF_COARSE 22
 #define IF_FINE 20
 
-#define CRC_VALUE         (*((unsigned int *) 0x0000FFFC))
-#define CODE_LENGTH       (*((unsigned int *) 0x0000FFF8))
 #define NUMPKT_PER_CFG      1
 #define STEPS_PER_CONFIG    32
 
@@ -129,10 +152,44 @@ typedef enum {
 	TEMP					 = 0x04,
 	COUNT_2M_32K	 = 0x05,
 	COMPRESSED_CLOCK = 0x06,
-	IMU_DATA = 0x07,
-	CUSTOM = 0x08
+	IMU_DATA = 0x07
 } tx_packet_content_source_t;
 
+// LC codes swept by repeat_rx_tx(), the stops are exclusive
+typedef struct {
+	uint8_t coarse_start;
+	uint8_t coarse_stop;
+	uint8_t mid_start;
+	uint8_t mid_stop;
+	uint8_t fine_start;
+	uint8_t fine_stop;
+} sweep_range_t;
+
+typedef struct {
+	uint8_t coarse;
+	uint8_t mid;
+	uint8_t fine;
+} lc_code_t;
+
+// Everything an experiment can change without a rebuild. Only bytes, so the
+// layout is the same in tools/experiment_config.py, which writes it into the
+// config block of the image.
+typedef struct {
+	uint8_t mode;               // index in experiment_modes
+	uint8_t optical_calibrate;
+	uint8_t solar_mode;
+	uint8_t sweep_tx;
+	uint8_t sweep_rx;
+	uint8_t send_ack;
+	uint8_t num_ack;
+	lc_code_t fixed_tx;
+	lc_code_t fixed_rx;
+	sweep_range_t sweep_range_tx;
+	sweep_range_t sweep_range_rx;
+} experiment_config_t;
+
+typedef void (*experiment_mode_t)(void);
+
 //=========================== variables =======================================
 
 // RADIO VARIABLES
@@ -143,50 +200,165 @@ tx_packet_content_source_t tx_packet_data_source = LC_CODES;
 
 uint8_t tx_packet[LEN_TX_PKT]; // contains the contents of the packet to be transmitted
 int rx_count = 0; // count of the number of packets actually received
-// need_to_send_ack: set to true if should send ack right after the receive completes.
-// Use SEND_ACK to determine whether to send an acknowledgemnets or not.
-bool need_to_send_ack = false;
+// set by onRx() for a frame with a good CRC, so the LC codes go in sweep_results
+bool rx_crc_ok = false;
 
-uint8_t fixed_lc_coarse_tx = DEFAULT_FIXED_LC_COARSE_TX;
-uint8_t fixed_lc_mid_tx = DEFAULT_FIXED_LC_MID_TX;
-uint8_t fixed_lc_fine_tx = DEFAULT_FIXED_LC_FINE_TX;
+// the defines, replaced by the config block of the image if there is one, then
+// changed by the commands. The fixed LC codes also follow the temperature in mode 7.
+experiment_config_t config = {
+	MODE,
+	OPTICAL_CALIBRATE,
+	SOLAR_MODE,
+	SWEEP_TX,
+	SWEEP_RX,
+	SEND_ACK,
+	NUM_ACK,
+	{DEFAULT_FIXED_LC_COARSE_TX, DEFAULT_FIXED_LC_MID_TX, DEFAULT_FIXED_LC_FINE_TX},
+	{DEFAULT_FIXED_LC_COARSE_RX, DEFAULT_FIXED_LC_MID_RX, DEFAULT_FIXED_LC_FINE_RX},
+	{
+		SWEEP_COARSE_START_TX, SWEEP_COARSE_END_TX,
+		SWEEP_MID_START_TX, SWEEP_MID_END_TX,
+		SWEEP_FINE_START_TX, SWEEP_FINE_END_TX
+	},
+	{
+		SWEEP_COARSE_START_RX, SWEEP_COARSE_END_RX,
+		SWEEP_MID_START_RX, SWEEP_MID_END_RX,
+		SWEEP_FINE_START_RX, SWEEP_FINE_END_RX
+	}
+};
 
-uint8_t fixed_lc_coarse_rx = DEFAULT_FIXED_LC_COARSE_RX;
-uint8_t fixed_lc_mid_rx = DEFAULT_FIXED_LC_MID_RX;
-uint8_t fixed_lc_fine_rx = DEFAULT_FIXED_LC_FINE_RX;
+// COMMAND VARIABLES
+// set by the command handlers, picked up by the command mode loop and repeat_rx_tx()
+bool run_requested = false;
+bool mode_requested = false;
+radio_mode_t run_radio_mode;
+uint8_t run_should_sweep;
+bool stop_requested = false;
 
 // TEMPERATURE VARIABLES
-double temp;
+int32_t temp; // hundredths of a degree
 uint32_t count_2M;
 uint32_t count_32k;
 
-// HACK SOLUTION TO GET ACK TO SEND RX CODES NEED TO FIX LATER
-uint8_t custom_tx_packet[LEN_TX_PKT];
+// binary payloads built by packet_encoder.c
+uint8_t encoded_tx_packet[MAX_LEN_TX_PKT];
+// readings waiting in aggregator.c to fill a frame
+uint8_t aggregate_tx_packet[MAX_LEN_TX_PKT];
+
+// the peer only sends LEN_RX_PKT frames, anything else in the lab is dropped in radio_isr()
+const radio_rx_filter_t rx_filter = {RADIO_FILTER_LENGTH, LEN_RX_PKT, LEN_RX_PKT, 0, 0, 0};
 
 uint8_t temp_adjusted_fine_code; // will be set by adjust_tx_fine_with_temp function
 
 // IMU variables
 imu_data_t imu_measurement;
+uint8_t imu_frame[TELEMETRY_MAX_PAYLOAD_LEN];
 
 //=========================== prototypes ======================================
 
+void		 run_mode(uint8_t mode);
+void		 mode_tx(void);
+void		 mode_rx(void);
+void		 mode_tx_rx_switching(void);
+void		 mode_tx_then_rx(void);
+void		 mode_idle(void);
+void		 mode_idle_low_power(void);
+void		 mode_sara(void);
+void		 mode_temp_compensated_tx(void);
+void		 mode_delay_test(void);
+void		 mode_sprintf_tx(void);
+void		 mode_clock_tx(void);
+void		 mode_log_clocks(void);
+void		 mode_print_temp(void);
+void		 mode_divider_current(void);
+void		 mode_contact_sensor(void);
+void		 mode_sara_on_rx(void);
+void		 mode_rftimer_test(void);
+void		 mode_imu_read(void);
+void		 mode_print_idle(void);
+void		 mode_commands(void);
+void		 mode_imu_tx(void);
 void		 repeat_rx_tx(radio_mode_t radio_mode, uint8_t should_sweep, int total_packets);
 void		 radio_delay(void);
 void		 onRx(uint8_t *packet, uint8_t packet_len);
+void		 send_aggregate(uint8_t* payload, uint8_t len);
+void		 configure_acks(void);
 void		 adjust_tx_fine_with_temp(void);
 void		 delay_milliseconds_test_loop(void);
 void		 test_rf_timer_callback(void);
-void		 imu_read_callback(void);
+void		 drain_imu_samples(void);
 void		 log_imu_data(void);
+bool		 parse_run(const char* text, command_args_t* args);
+bool		 parse_sweep(const char* text, command_args_t* args);
+bool		 parse_flags(const char* text, command_args_t* args);
+bool		 parse_ack(const char* text, command_args_t* args);
+bool		 parse_mode(const char* text, command_args_t* args);
+void		 command_tx(const command_args_t* args);
+void		 command_rx(const command_args_t* args);
+void		 command_stop(const command_args_t* args);
+void		 command_fixtx(const command_args_t* args);
+void		 command_fixrx(const command_args_t* args);
+void		 command_sweeptx(const command_args_t* args);
+void		 command_sweeprx(const command_args_t* args);
+void		 command_results(const command_args_t* args);
+void		 command_clearres(const command_args_t* args);
+void		 command_mode(const command_args_t* args);
+void		 command_sweep(const command_args_t* args);
+void		 command_ack(const command_args_t* args);
+void		 command_solar(const command_args_t* args);
+void		 command_config(const command_args_t* args);
+
+// entry points of the modes, by config.mode. Most never return, those that do
+// go back to the command loop of main() or of mode 19.
+const experiment_mode_t experiment_modes[] = {
+	mode_tx,                    // 0
+	mode_rx,                    // 1
+	mode_tx_rx_switching,       // 2
+	mode_tx_then_rx,            // 3
+	mode_idle,                  // 4
+	mode_idle_low_power,        // 5
+	mode_sara,                  // 6
+	mode_temp_compensated_tx,   // 7
+	mode_delay_test,            // 8
+	mode_sprintf_tx,            // 9
+	mode_clock_tx,              // 10
+	mode_log_clocks,            // 11
+	mode_print_temp,            // 12
+	mode_divider_current,       // 13
+	mode_contact_sensor,        // 14
+	mode_sara_on_rx,            // 15
+	mode_rftimer_test,          // 16
+	mode_imu_read,              // 17
+	mode_print_idle,            // 18
+	mode_commands,              // 19
+	mode_imu_tx,                // 20
+};
+
+#define NUM_EXPERIMENT_MODES	(sizeof(experiment_modes) / sizeof(experiment_modes[0]))
+#define COMMAND_MODE			19
+
+const command_t app_commands[] = {
+	{"tx",       parse_run,          command_tx,       "tx <sweep 0|1>"},
+	{"rx",       parse_run,          command_rx,       "rx <sweep 0|1>"},
+	{"stop",     command_parse_none, command_stop,     "stop"},
+	{"fixtx",    command_parse_lc,   command_fixtx,    "fixtx <coarse> <mid> <fine>"},
+	{"fixrx",    command_parse_lc,   command_fixrx,    "fixrx <coarse> <mid> <fine>"},
+	{"sweeptx",  parse_sweep,        command_sweeptx,  "sweeptx <coarse start> <end> <mid start> <end> <fine start> <end>"},
+	{"sweeprx",  parse_sweep,        command_sweeprx,  "sweeprx <coarse start> <end> <mid start> <end> <fine start> <end>"},
+	{"results",  parse_run,          command_results,  "results <uart 0|radio 1>"},
+	{"clearres", command_parse_none, command_clearres, "clearres"},
+	{"mode",     parse_mode,         command_mode,     "mode <n>"},
+	{"sweep",    parse_flags,        command_sweep,    "sweep <tx 0|1> <rx 0|1>"},
+	{"ack",      parse_ack,          command_ack,      "ack <send 0|1> <count>"},
+	{"solar",    parse_run,          command_solar,    "solar <0|1>"},
+	{"config",   command_parse_none, command_config,   "config"},
+};
 
 //=========================== main ============================================
 	
 int main(void) {
     uint32_t calc_crc;
     uint8_t         offset;
-		int i,j;
-		short counter;
-		int gripper_result;
     
     printf("Initializing...");
 	
@@ -194,22 +366,36 @@ int main(void) {
     printf("\r\n-------------------\r\n");
     printf("Validating program integrity..."); 
     
-    calc_crc = crc32c(0x0000,CODE_LENGTH);
+    calc_crc = crc32c(HAL_IMAGE(0x0000),IMAGE_CODE_LENGTH);
     
-    if(calc_crc == CRC_VALUE){
+    if(calc_crc == IMAGE_CRC_VALUE){
         printf("CRC OK\r\n");
     } else{
         printf("\r\nProgramming Error - CRC DOES NOT MATCH - Halting Execution\r\n");
+        image_report_bad_blocks();
         while(1);
     }
 		
+		if (image_read_config(&config, sizeof(config))) {
+			printf("Using the config block of the image\r\n");
+		}
+		
 		// Set up mote configuration
     // This function handles all the analog scan chain setup
     initialize_mote();
 		
 		radio_setCallbacks(onRx);
+		radio_setRxFilter(&rx_filter);
+		ack_engine_init(ACK_TURNAROUND_TICKS);
+		
+		aggregator_init(aggregate_tx_packet, sizeof(aggregate_tx_packet), AGGREGATE_MAX_LATENCY_MS, send_aggregate);
+		
+		if (config.solar_mode) {
+			solar_duty_init(SOLAR_MIN_SLEEP_MS, SOLAR_MAX_SLEEP_MS, SOLAR_POWER_GOOD_GPIO);
+			aggregator_set_budget(solar_duty_power_good);
+		}
 
-    if (OPTICAL_CALIBRATE) {
+    if (config.optical_calibrate) {
 			optical_calibrate();
 		} else {
 			manual_calibrate(HF_COARSE, HF_FINE, RC2M_COARSE, RC2M_FINE, RC2M_SUPERFINE, IF_COARSE, IF_FINE);
@@ -218,196 +404,287 @@ int main(void) {
 		if (INITIALIZE_IMU) {
 			initialize_imu();
 		}
+		
+		command_init(app_commands, sizeof(app_commands) / sizeof(app_commands[0]));
 
-		switch (MODE) {
-			case 0: // tx indefinite
-				//tx_packet_data_source = LC_CODES;
-				repeat_rx_tx(TX, SWEEP_TX, -1);
-				break;
-			case 1: //rx indefinite
-				repeat_rx_tx(RX, SWEEP_RX, -1);
-				break;
-			case 2: //single tx then single rx then low power
-				tx_packet_data_source = LC_CODES;
-				printf("going into switching mode!\n");
-				
-				for (i = 0; i < 100; i++) {
-					repeat_rx_tx(TX, SWEEP_TX, 1);// number means to send one packet. if you change to negative infinity. usually want to try for two
-					//for (j = 0; j < 1000000; j++) {}
-					repeat_rx_tx(RX, SWEEP_RX, 1);
-				}
-			
-				//printf("entering low power state indefinitely. Power cycle before reprogramming.\n");
-				printf("done!\n");
-				
-				//low_power_mode();
-				while(1);
-				break;
-			case 3: //tx then rx NONSOLAR
-				tx_packet_data_source = LC_CODES;
-				repeat_rx_tx(TX, SWEEP_TX, 1);
-			
-				for (i = 0; i < 100000; i++){}
-			
-				repeat_rx_tx(RX, SWEEP_RX, 1);
-				break;
-			case 4: // idle normal power used for doing nothing while letting optical interrupts happen for tmperature mode
-				while (1) {}
-				break;
-			case 5: // idle low power
-				low_power_mode();
-				while (1) {}
-				break;
-			case 6: //turn on go to low power and after you are done closing send packet
-				low_power_mode();
-				while(1)
-				//for(j=0;j<10;j++)
-				{	
-					sara_start(1500,60);
-					//(200,200); //second argument affects rate of GPIO 4 and 5 and 6. GPIO 6 is clock. Set to (300, 250) for 96 Hz to test motors
-					//GPIO_REG__OUTPUT=0x0000;
-					
-					for(i=0;i<100;i++);
-					sara_release(300);
-					for(i=0;i<100;i++);
-					printf("toggle!\n");
-				}
-				while(1)
-				{}
-				break;
-			case 7: // temperature compensated transmit loop
-				while (1) {
-					temp = get_2MHz_32k_ratio_temp_estimate(TEMP_MEASURE_DURATION_MILLISECONDS, CLOCK_RATIO_VS_TEMP_SLOPE, CLOCK_RATIO_VS_TEMP_OFFSET);
-					adjust_tx_fine_with_temp();
-				
-					tx_packet_data_source = TEMP;
-										
-					// will not sweep since that is exactly what we are trying to get rid of by compensating with temperature
-					repeat_rx_tx(TX, 0, 1); // send 1 packet(s)
-				}
-				break;
-			case 8: // test of RF TIMER delay milliseconds function
-				delay_milliseconds_test_loop();
-				while (1) {} // since this is interrupt based we need some loop to stall in while we wait for interrupts
-				break;
-			case 9: // sprintf transmit test
-				sprintf(tx_packet, "2MHz: %d 32kHz: %d", 280000, 50000);
-							
-				tx_packet_data_source = LC_CODES;
-				repeat_rx_tx(TX, SWEEP_TX, -1);
-			
-				while (1) {}
-				break;
-			case 10: // take one measurement of the clocks for temperature measurement and then continuously transmit the result for a certain period, then repeat
-				// note: since this is a sweep, we need to set the sweep coarse and mid code start and end fixed values to be such that the coarse and mid
-				// are always fixed. The fine code sweep should be 0 to 32
-				while (1) {
-					// Get the counts for 2MHz and 32kHz clocks
-					read_counters_duration(TEMP_MEASURE_DURATION_MILLISECONDS);
-					
-					count_2M = scm3c_hw_interface_get_count_2M();
-					count_32k = scm3c_hw_interface_get_count_32k();
-					
-					// Now continuously transimt the clock counts.
-					printf("2M: %u, 32kHz: %u\n", count_2M, count_32k);
+		run_mode(config.mode);
 		
-					tx_packet_data_source = COMPRESSED_CLOCK;
-					repeat_rx_tx(TX, 1, 32); // in this case we will always sweep since with different temps we don't know which LC codes will work, so set to 1 not 0
-				}
-				
-				break;
-			case 11: // continuously measure and log 2MHz and 32kHz
-				while (1) {
-					// Get the counts for 2MHz and 32kHz clocks
-					read_counters_duration(TEMP_MEASURE_DURATION_MILLISECONDS);
-					
-					count_2M = scm3c_hw_interface_get_count_2M();
-					count_32k = scm3c_hw_interface_get_count_32k();
-					
-					printf("2M: %u, 32kHz: %u\n", count_2M, count_32k);
-				}
-				break;
-			case 12: // continuously measure and print temperature
-				while (1) {
-					// Get the counts for 2MHz and 32kHz clocks
-					temp = get_2MHz_32k_ratio_temp_estimate(TEMP_MEASURE_DURATION_MILLISECONDS, CLOCK_RATIO_VS_TEMP_SLOPE, CLOCK_RATIO_VS_TEMP_OFFSET);
-					
-					printf("2M: %u, 32kHz: %u, Temp: %d\n", count_2M, count_32k, (int) temp);					
-				}
-				break;
-			case 13: // measure divider current draw
-				while (1) {
-					printf("switching\n");
-					ANALOG_CFG_REG__10 = 0x0058;
-					delay_milliseconds_synchronous(2000, DELAY_RFTIMER_COMPAREID);
-					printf("switching\n");
-					ANALOG_CFG_REG__10 = 0x0018;
-					delay_milliseconds_synchronous(2000, DELAY_RFTIMER_COMPAREID);
-				}
-				break;
-			case 14: // contact sensor development// Alex wrote this code 
-				
-				printf("GPIO ON\n");
-				//enable GPIOs
-				GPO_enables(0xFFFF);
-				GPI_enables(0xFFFF);
-				GPI_control(0,0,0,0);//sets GPI to cortex registers
-				GPO_control(6,6,6,6); //GPIO 0 -15 //sets GP0 to cortex registers
-				// Program analog scan chain
-				analog_scan_chain_write();
-				analog_scan_chain_load();
+		while (1) {
+			if (!command_poll()) {
+				HAL_IDLE();
+			}
+		}
+}
+
+//=========================== public ==========================================
+
+//=========================== private =========================================
+
+void run_mode(uint8_t mode) {
+	if (mode < NUM_EXPERIMENT_MODES) {
+		experiment_modes[mode]();
+	} else {
+		printf("Invalid mode\n");
+	}
+}
+
+// 0: tx indefinite
+void mode_tx(void) {
+	//tx_packet_data_source = LC_CODES;
+	repeat_rx_tx(TX, config.sweep_tx, -1);
+}
+
+// 1: rx indefinite
+void mode_rx(void) {
+	repeat_rx_tx(RX, config.sweep_rx, -1);
+}
+
+// 2: single tx then single rx then low power
+void mode_tx_rx_switching(void) {
+	int i;
+	
+	tx_packet_data_source = LC_CODES;
+	printf("going into switching mode!\n");
+	
+	for (i = 0; i < 100; i++) {
+		repeat_rx_tx(TX, config.sweep_tx, 1);// number means to send one packet. if you change to negative infinity. usually want to try for two
+		//for (j = 0; j < 1000000; j++) {}
+		repeat_rx_tx(RX, config.sweep_rx, 1);
+	}
+
+	//printf("entering low power state indefinitely. Power cycle before reprogramming.\n");
+	printf("done!\n");
+	
+	//low_power_mode();
+	while(1) {
+		HAL_IDLE();
+	}
+}
+
+// 3: tx then rx NONSOLAR
+void mode_tx_then_rx(void) {
+	int i;
+	
+	tx_packet_data_source = LC_CODES;
+	repeat_rx_tx(TX, config.sweep_tx, 1);
+
+	for (i = 0; i < 100000; i++){}
+
+	repeat_rx_tx(RX, config.sweep_rx, 1);
+}
+
+// 4: idle normal power used for doing nothing while letting optical interrupts happen for tmperature mode
+void mode_idle(void) {
+	while (1) {
+		if (!command_poll()) {
+			HAL_IDLE();
+		}
+	}
+}
+
+// 5: idle low power
+void mode_idle_low_power(void) {
+	low_power_mode();
+	while (1) {
+		HAL_IDLE();
+	}
+}
+
+// 6: turn on go to low power and after you are done closing send packet
+void mode_sara(void) {
+	int i;
+	
+	low_power_mode();
+	while(1)
+	//for(j=0;j<10;j++)
+	{	
+		sara_start(SARA_TOGGLES, SARA_STEP_TICKS);
+		//(200,2083); //second argument is the RF timer ticks per edge of GPIO 4 and 5 and 6. GPIO 6 is clock. Set to (300, 2604) for 96 Hz to test motors
+		//GPIO_REG__OUTPUT=0x0000;
+		
+		for(i=0;i<100;i++);
+		sara_release(SARA_RELEASE_STEP_TICKS);
+		for(i=0;i<100;i++);
+		printf("toggle!\n");
+	}
+	while(1)
+	{}
+}
+
+// 7: temperature compensated transmit loop
+void mode_temp_compensated_tx(void) {
+	while (1) {
+		temp = get_2MHz_32k_ratio_temp_estimate(TEMP_MEASURE_DURATION_MILLISECONDS, CLOCK_RATIO_VS_TEMP_SLOPE, CLOCK_RATIO_VS_TEMP_OFFSET);
+		count_2M = scm3c_hw_interface_get_count_2M();
+		count_32k = scm3c_hw_interface_get_count_32k();
+		adjust_tx_fine_with_temp();
+		
+		// a frame carries many readings, sent by send_aggregate() when it is full or
+		// AGGREGATE_MAX_LATENCY_MS after its first reading
+		aggregator_add_temperature(temp);
+		aggregator_add_clock_counts(count_2M, count_32k);
+		aggregator_poll();
+		
+		command_poll();
+		radio_delay();
+	}
+}
+
+// 8: test of RF TIMER delay milliseconds function
+void mode_delay_test(void) {
+	delay_milliseconds_test_loop();
+	while (1) { // since this is interrupt based we need some loop to stall in while we wait for interrupts
+		HAL_IDLE();
+	}
+}
+
+// 9: sprintf transmit test
+void mode_sprintf_tx(void) {
+	sprintf(tx_packet, "2MHz: %d 32kHz: %d", 280000, 50000);
 				
-				//set gpio to 3.3V 
-				GPIO_REG__OUTPUT=0xFFFF;
+	tx_packet_data_source = LC_CODES;
+	repeat_rx_tx(TX, config.sweep_tx, -1);
+
+	while (1) {
+		HAL_IDLE();
+	}
+}
+
+// 10: take one measurement of the clocks for temperature measurement and then continuously transmit the result for a certain period, then repeat
+void mode_clock_tx(void) {
+	// note: since this is a sweep, we need to set the sweep coarse and mid code start and end fixed values to be such that the coarse and mid
+	// are always fixed. The fine code sweep should be 0 to 32
+	while (1) {
+		// Get the counts for 2MHz and 32kHz clocks
+		read_counters_duration(TEMP_MEASURE_DURATION_MILLISECONDS);
+		
+		count_2M = scm3c_hw_interface_get_count_2M();
+		count_32k = scm3c_hw_interface_get_count_32k();
+		
+		// Now continuously transimt the clock counts.
+		binlog(BINLOG_CLOCK_COUNTS, count_2M, count_32k);
+		
+		tx_packet_data_source = COMPRESSED_CLOCK;
+		repeat_rx_tx(TX, 1, 32); // in this case we will always sweep since with different temps we don't know which LC codes will work, so set to 1 not 0
+	}
+}
+
+// 11: continuously measure and log 2MHz and 32kHz
+void mode_log_clocks(void) {
+	counters_snapshot_t snapshot;
+	
+	while (1) {
+		// Get the counts for 2MHz and 32kHz clocks
+		counters_measure(TEMP_MEASURE_DURATION_MILLISECONDS * RFTIMER_TICKS_PER_MS, &snapshot);
+		
+		count_2M = snapshot.count_2M;
+		count_32k = snapshot.count_32k;
+		
+#if TELEMETRY_ENABLED
+		// all five counts and the window they ran for
+		counters_send(&snapshot);
+#else
+		binlog(BINLOG_CLOCK_COUNTS, count_2M, count_32k);
+#endif
+	}
+}
+
+// 12: continuously measure and print temperature
+void mode_print_temp(void) {
+	while (1) {
+		// Get the counts for 2MHz and 32kHz clocks
+		temp = get_2MHz_32k_ratio_temp_estimate(TEMP_MEASURE_DURATION_MILLISECONDS, CLOCK_RATIO_VS_TEMP_SLOPE, CLOCK_RATIO_VS_TEMP_OFFSET);
+		
+		printf("2M: %u, 32kHz: %u, Temp: %d\n", count_2M, count_32k, temp / 100);					
+	}
+}
+
+// 13: measure divider current draw
+void mode_divider_current(void) {
+	while (1) {
+		printf("switching\n");
+		ANALOG_CFG_REG__10 = 0x0058;
+		delay_milliseconds_synchronous(2000, DELAY_RFTIMER_COMPAREID);
+		printf("switching\n");
+		ANALOG_CFG_REG__10 = 0x0018;
+		delay_milliseconds_synchronous(2000, DELAY_RFTIMER_COMPAREID);
+	}
+}
+
+// 14: contact sensor development, Alex wrote this code
+void mode_contact_sensor(void) {
+	short counter;
+	int gripper_result;
+	
+	
+	printf("GPIO ON\n");
+	//enable GPIOs
+	GPO_enables(0xFFFF);
+	GPI_enables(0xFFFF);
+	GPI_control(0,0,0,0);//sets GPI to cortex registers
+	GPO_control(6,6,6,6); //GPIO 0 -15 //sets GP0 to cortex registers
+	// Program analog scan chain
+	analog_scan_chain_write();
+	analog_scan_chain_load();
+	
+	//set gpio to 3.3V 
+	GPIO_REG__OUTPUT=0xFFFF;
 //				if((GPIO_REG__INPUT | 0xFDFF) == 0xFFFF)
 //				{
 //					printf("GPIO9 high\n");
 //				}
-				//disable GPIOs
-				GPO_enables(0x0000);
-				
-				// Program analog scan chain
-				analog_scan_chain_write();
-				analog_scan_chain_load();
+	//disable GPIOs
+	GPO_enables(0x0000);
+	
+	// Program analog scan chain
+	analog_scan_chain_write();
+	analog_scan_chain_load();
+	
+	printf("GPIO OFF\n");
+	//check til GPI turns to zero;
+	counter=0; 
+	while(1){
+		  gripper_result = ~(GPIO_REG__INPUT | 0xFDFF)==0xffff0200;
+			printf("%x\n", GPIO_REG__INPUT);
+			if(gripper_result){
+				counter=counter+1;
+			}	
+			else {
+				counter=0;
 				
-				printf("GPIO OFF\n");
-				//check til GPI turns to zero;
-				counter=0; 
-				while(1){
-					  gripper_result = ~(GPIO_REG__INPUT | 0xFDFF)==0xffff0200;
-						printf("%x\n", GPIO_REG__INPUT);
-						if(gripper_result){
-							counter=counter+1;
-						}	
-						else {
-							counter=0;
-							
-						}
-						if(counter>40){
-							printf("Gripper Closed %d %d \n", counter, gripper_result);
-						}
-				}
-				break;
-			case 15: // SARA final code with rx until packet is received, then send acks, then turn off radio, then operate SARA then loop
-				while (1) {
-					printf("Attempting to receive a packet\n");
-					repeat_rx_tx(RX, SWEEP_RX, 1); // keep looping until we receive a single packet. Sends NUM_ACK acks if SEND_ACK set to 1
-					
-					// if we reach this point it means that we have received a packet and have (optionally) sent acks.
-					printf("packet received. starting SARA toggle!\n");
-					// now trigger SARA. ALEX CHECK THE PARAMETERS HERE
-					low_power_mode();
-					sara_start(1500,60);
-					//(200,200); //second argument affects rate of GPIO 4 and 5 and 6. GPIO 6 is clock. Set to (300, 250) for 96 Hz to test motors
-					//GPIO_REG__OUTPUT=0x0000;
-					
-					for(i=0;i<100;i++);
-					sara_release(300);
-					for(i=0;i<100;i++);
-					printf("toggle!\n");
-					normal_power_mode();
-				}
-			case 16: // testing new RF timer code that allows easier use of all 8 COMPARE interrupts
+			}
+			if(counter>40){
+				printf("Gripper Closed %d %d \n", counter, gripper_result);
+			}
+	}
+}
+
+// 15: SARA final code with rx until packet is received, then send acks, then turn off radio, then operate SARA then loop
+void mode_sara_on_rx(void) {
+	int i;
+	
+	while (1) {
+		printf("Attempting to receive a packet\n");
+		repeat_rx_tx(RX, config.sweep_rx, 1); // keep looping until we receive a single packet. Sends config.num_ack acks if config.send_ack is set
+		
+		// if we reach this point it means that we have received a packet and have (optionally) sent acks.
+		printf("packet received. starting SARA toggle!\n");
+		// now trigger SARA. ALEX CHECK THE PARAMETERS HERE
+		low_power_mode();
+		sara_start(SARA_TOGGLES, SARA_STEP_TICKS);
+		//(200,2083); //second argument is the RF timer ticks per edge of GPIO 4 and 5 and 6. GPIO 6 is clock. Set to (300, 2604) for 96 Hz to test motors
+		//GPIO_REG__OUTPUT=0x0000;
+		
+		for(i=0;i<100;i++);
+		sara_release(SARA_RELEASE_STEP_TICKS);
+		for(i=0;i<100;i++);
+		printf("toggle!\n");
+		normal_power_mode();
+	}
+}
+
+// 16: testing new RF timer code that allows easier use of all 8 COMPARE interrupts
+void mode_rftimer_test(void) {
 //				printf("starting COMPARE0\n");
 //				rftimer_set_callback(test_rf_timer_callback, 0);
 //				delay_milliseconds_synchronous(3000, 0);
@@ -416,44 +693,66 @@ int main(void) {
 //				//rftimer_set_callback(test_rf_timer_callback, 1);
 //				delay_milliseconds_synchronous(10000, 1);
 //				printf("ending COMPARE1\n");
-			
+
 //				rftimer_set_callback(test_rf_timer_callback, 7);
-				rftimer_set_repeat(true, 7);
-				delay_milliseconds_asynchronous(1000, 7);
-			
+	rftimer_set_repeat(true, 7);
+	delay_milliseconds_asynchronous(1000, 7);
+
 //				rftimer_set_callback(test_rf_timer_callback, 6);
-				rftimer_set_repeat(true, 6);
-				delay_milliseconds_asynchronous(2000, 6);
-			
-				while (1) {
-					//printf("halted");
-				}
-				break;
-			case 17: // Read IMU loop
-				rftimer_set_callback(imu_read_callback, 1);
-				rftimer_set_repeat(true, 1);
-				delay_milliseconds_asynchronous(100, 1);
-			
-			
-				//while (1) {
-				//	imu_read_callback();
-				//}
-				break;
-			case 18:
-				while (1) {
-					printf("Idle\n");
-				}
-			default:
-				printf("Invalid mode\n");
-				break;
+	rftimer_set_repeat(true, 6);
+	delay_milliseconds_asynchronous(2000, 6);
+
+	while (1) {
+		//printf("halted");
+		HAL_IDLE();
+	}
+}
+
+// 17: Read IMU loop
+void mode_imu_read(void) {
+	imu_sampler_start(IMU_SAMPLE_RATE_HZ);
+	while (1) {
+		drain_imu_samples();
+		if (!command_poll()) {
+			HAL_IDLE();
 		}
-		
-		while (1) {}
+	}
 }
 
-//=========================== public ==========================================
+// 18: print forever
+void mode_print_idle(void) {
+	while (1) {
+		printf("Idle\n");
+	}
+}
 
-//=========================== private =========================================
+// 19: wait for commands on the UART, see app_commands
+void mode_commands(void) {
+	printf("Waiting for commands, try help\n");
+	while (1) {
+		if (run_requested) {
+			run_requested = false;
+			repeat_rx_tx(run_radio_mode, run_should_sweep, -1);
+			printf("Stopped\n");
+		}
+		if (mode_requested) {
+			mode_requested = false;
+			run_mode(config.mode);
+			printf("Stopped\n");
+			config.mode = COMMAND_MODE;
+		}
+		if (!command_poll()) {
+			HAL_IDLE();
+		}
+	}
+}
+
+// 20: send batches of IMU samples at a fixed LC code
+void mode_imu_tx(void) {
+	tx_packet_data_source = IMU_DATA;
+	imu_sampler_start(IMU_SAMPLE_RATE_HZ);
+	repeat_rx_tx(TX, 0, -1);
+}
 
 /* Repeateadly sends or receives packets depending on radio_mode
    Will sweep or be at fixed frequency depending on repeat_mode
@@ -472,18 +771,11 @@ void repeat_rx_tx(radio_mode_t radio_mode, uint8_t should_sweep, int total_packe
 	uint8_t         cfg_mid_stop;
 	uint8_t         cfg_fine_stop;
 	
-	uint8_t HF_CLOCK_fine;
-	uint8_t HF_CLOCK_coarse;
-	uint8_t RC2M_coarse;
-	uint8_t RC2M_fine;
-	uint8_t RC2M_superfine;
-	uint8_t IF_clk_target;
-	uint8_t IF_coarse;
-	uint8_t IF_fine;
-	
 	uint8_t i;
 	
-	tx_packet_content_source_t saved_tx_packet_data_source;
+	uint8_t* tx_buf;
+	uint8_t tx_len;
+	packet_encoder_t encoder;
 	
 	unsigned packet_counter = 0; // number of times we have transmitted or attempted to receive
 	
@@ -497,13 +789,13 @@ void repeat_rx_tx(radio_mode_t radio_mode, uint8_t should_sweep, int total_packe
 
 	if (!should_sweep) { // fixed frequency mode
 		if (radio_mode == TX) {
-			cfg_coarse_start = fixed_lc_coarse_tx;
-			cfg_mid_start = fixed_lc_mid_tx;
-			cfg_fine_start = fixed_lc_fine_tx;
+			cfg_coarse_start = config.fixed_tx.coarse;
+			cfg_mid_start = config.fixed_tx.mid;
+			cfg_fine_start = config.fixed_tx.fine;
 		} else {
-			cfg_coarse_start = fixed_lc_coarse_rx;
-			cfg_mid_start = fixed_lc_mid_rx;
-			cfg_fine_start = fixed_lc_fine_rx;
+			cfg_coarse_start = config.fixed_rx.coarse;
+			cfg_mid_start = config.fixed_rx.mid;
+			cfg_fine_start = config.fixed_rx.fine;
 		}
 				
 		cfg_coarse_stop = cfg_coarse_start + 1;
@@ -512,21 +804,14 @@ void repeat_rx_tx(radio_mode_t radio_mode, uint8_t should_sweep, int total_packe
 		
 		printf("Fixed %s at c:%u m:%u f:%u\n", radio_mode_string, cfg_coarse_start, cfg_mid_start, cfg_fine_start);
 	} else { // sweep mode
-			if (radio_mode == TX) {
-				cfg_coarse_start = SWEEP_COARSE_START_TX;
-				cfg_coarse_stop = SWEEP_COARSE_END_TX;
-				cfg_mid_start = SWEEP_MID_START_TX;
-				cfg_mid_stop = SWEEP_MID_END_TX;
-				cfg_fine_start = SWEEP_FINE_START_TX;
-				cfg_fine_stop = SWEEP_FINE_END_TX;
-			} else {
-				cfg_coarse_start = SWEEP_COARSE_START_RX;
-				cfg_coarse_stop = SWEEP_COARSE_END_RX;
-				cfg_mid_start = SWEEP_MID_START_RX;
-				cfg_mid_stop = SWEEP_MID_END_RX;
-				cfg_fine_start = SWEEP_FINE_START_RX;
-				cfg_fine_stop = SWEEP_FINE_END_RX;
-			}
+			sweep_range_t* range = (radio_mode == TX) ? &config.sweep_range_tx : &config.sweep_range_rx;
+			
+			cfg_coarse_start = range->coarse_start;
+			cfg_coarse_stop = range->coarse_stop;
+			cfg_mid_start = range->mid_start;
+			cfg_mid_stop = range->mid_stop;
+			cfg_fine_start = range->fine_start;
+			cfg_fine_stop = range->fine_stop;
 		
 		printf("Sweeping %s\n", radio_mode_string);
 	}
@@ -543,106 +828,54 @@ void repeat_rx_tx(radio_mode_t radio_mode, uint8_t should_sweep, int total_packe
 					
 					radio_delay();
 					
+					// commands run here, between two LC settings
+					command_poll();
+					if (stop_requested) {
+						stop_requested = false;
+						return;
+					}
+					
 					if (should_sweep) {
-						printf( "coarse=%d, middle=%d, fine=%d\r\n", cfg_coarse, cfg_mid, cfg_fine);
+						binlog(BINLOG_SWEEP_CONFIG, cfg_coarse, cfg_mid, cfg_fine);
 					}
 					
 					for (i=0;i<NUMPKT_PER_CFG;i++) {
 						if (radio_mode == RX) {
+							rx_crc_ok = false;
+							// a frame received here is acknowledged from the radio interrupts,
+							// receive_packet() returns after the last ACK
+							configure_acks();
+							ack_engine_listen(cfg_coarse, cfg_mid, cfg_fine);
 							receive_packet(cfg_coarse, cfg_mid, cfg_fine);
-							
-							if (need_to_send_ack) {
-								radio_delay();
-								
-								printf("START sending acks\n");
-								//send_ack(FIXED_LC_COARSE_TX, FIXED_LC_MID_TX, FIXED_LC_FINE_TX, cfg_coarse, cfg_mid, cfg_fine, j);
-								//send_ack(fixed_lc_coarse_tx, fixed_lc_mid_tx, fixed_lc_fine_tx, cfg_coarse, cfg_mid, cfg_fine, j);
-								
-								// send the acks by sweeping through another call to repeat_rx_tx
-								saved_tx_packet_data_source = tx_packet_data_source;
-								tx_packet_data_source = CUSTOM;
-								
-								sprintf(custom_tx_packet, "%d %d %d", cfg_coarse, cfg_mid, cfg_fine);
-								
-								repeat_rx_tx(TX, SWEEP_TX, NUM_ACK);
-								
-								printf("DONE sending acks\n");
-								
-								tx_packet_data_source = saved_tx_packet_data_source;
-								//tx_packet_data_source = LC_CODES;
-								
-								need_to_send_ack = false;
+							if (rx_crc_ok) {
+								sweep_results_mark(cfg_coarse, cfg_mid, cfg_fine);
 							}
 						}
 						else { // TX mode
 							tx_packet[0] = (uint8_t) packet_counter;
+							tx_buf = tx_packet;
+							tx_len = LEN_TX_PKT;
+							
+							// the binary sources are records after the counter, see packet_encoder.c
+							packet_encoder_begin(&encoder, encoded_tx_packet, sizeof(encoded_tx_packet), (uint8_t) packet_counter);
 							
 							switch (tx_packet_data_source) { // defines how to set packet contents
 								case PREDEFINED: // packet content set prior
 									break;
 								case LC_CODES: // packet content will be LC coarse mid fine 
-//									tx_packet[1] = cfg_coarse;
-//									tx_packet[2] = cfg_mid;
-//									tx_packet[3] = cfg_fine;
-								
-								  sprintf(tx_packet, "%d %d %d test test test test", cfg_coarse, cfg_mid, cfg_fine);
-								
+									packet_add_lc_config(&encoder, cfg_coarse, cfg_mid, cfg_fine);
 									break;
 								case OPTICAL_VALS: // packet content will be optical settings
-									HF_CLOCK_coarse     = scm3c_hw_interface_get_HF_CLOCK_coarse();
-									HF_CLOCK_fine       = scm3c_hw_interface_get_HF_CLOCK_fine();
-									RC2M_coarse         = scm3c_hw_interface_get_RC2M_coarse();
-									RC2M_fine           = scm3c_hw_interface_get_RC2M_fine();
-									RC2M_superfine      = scm3c_hw_interface_get_RC2M_superfine();
-									IF_coarse           = scm3c_hw_interface_get_IF_coarse();
-									IF_fine             = scm3c_hw_interface_get_IF_fine();
-									
-									tx_packet[1] = (uint8_t) 0;
-									tx_packet[2] = (uint8_t)HF_CLOCK_coarse;
-									tx_packet[3] = (uint8_t)HF_CLOCK_fine;
-									tx_packet[4] = (uint8_t)RC2M_coarse;
-									tx_packet[5] = (uint8_t)RC2M_fine;
-									tx_packet[6] = (uint8_t)RC2M_superfine;
-									tx_packet[7] = (uint8_t)IF_coarse;
-									tx_packet[8] = (uint8_t)IF_fine;
-									tx_packet[9] = (uint8_t) 0;
-									tx_packet[10] = cfg_coarse;
-									tx_packet[11] = cfg_mid;
-									tx_packet[12] = cfg_fine;
-								
+									packet_add_optical(&encoder);
+									packet_add_lc_config(&encoder, cfg_coarse, cfg_mid, cfg_fine);
 									break;
 								case TEMP:
-									// format: FF TT.TT
-									//sprintf(tx_packet, "%2d %2.2f", cfg_fine, temp);
-									
-										// had to do it this weird way since the normal double formatting was making the packets stop sending after a while.... I have no clue why
-										sprintf(tx_packet, "%02d %d.%02d", cfg_fine, (uint8_t) temp, (uint8_t) ((temp - (uint8_t) temp) * 100));
-									
-//									tx_packet[1] = (uint8_t) cfg_coarse;
-//									tx_packet[2] = (uint8_t) cfg_mid;
-//									tx_packet[3] = (uint8_t) cfg_fine;
-//									tx_packet[4] = (uint8_t) (int) temp; // two digits left of decimal place
-//									tx_packet[5] = (uint8_t) ((temp - (uint8_t)(temp))*100); // two digits right of decimal place
-//									tx_packet[6] = (uint8_t) 0;
-//									tx_packet[7] = (uint8_t) 0;
-//									tx_packet[8] = (uint8_t) 0;
-//									tx_packet[9] = (uint8_t) 0;
-									
-//									tx_packet[0] = 0;
-//									tx_packet[1] = cfg_fine;
-//									tx_packet[2] = 2;
-//									tx_packet[3] = 3;
-//									tx_packet[4] = 4;
-//									tx_packet[5] = 5;
-//									tx_packet[6] = 6;
-//									tx_packet[7] = 7;
-//									tx_packet[8] = 8;
-//									tx_packet[9] = 9;
-								
+									packet_add_lc_config(&encoder, cfg_coarse, cfg_mid, cfg_fine);
+									packet_add_temperature(&encoder, temp);
 									break;
 								case COUNT_2M_32K:
-									sprintf(tx_packet, "C:%d M:%d F:%d 2MHz:%d 32kHz:%d", cfg_coarse, cfg_mid, cfg_fine, count_2M, count_32k);
-								
+									packet_add_lc_config(&encoder, cfg_coarse, cfg_mid, cfg_fine);
+									packet_add_clock_counts(&encoder, count_2M, count_32k);
 									break;
 								case COMPRESSED_CLOCK: // for when on solar and packet length is compressed
 									// since we are on solar and the sweep of 32 fine codes will take a while (probably 1.5 minutes)
@@ -651,95 +884,33 @@ void repeat_rx_tx(radio_mode_t radio_mode, uint8_t should_sweep, int total_packe
 									read_counters_duration(TEMP_MEASURE_DURATION_MILLISECONDS);
 									count_2M = scm3c_hw_interface_get_count_2M();
 									count_32k = scm3c_hw_interface_get_count_32k();
-									printf("2M: %u, 32kHz: %u\n", count_2M, count_32k);
+									binlog(BINLOG_CLOCK_COUNTS, count_2M, count_32k);
 								
-									// mode for sending the 2MHz clocks and the 32kHz clock as well as fine code
-									// send in a compressed format taking the form of:
-									// 0: packet counter 1: fine 2: 2MHz[5-4] 3: 2MHz[3-2] 4: 2MHz[1-0] 5: 32kHz[3-2] 6: 23kHz[1-0]
-									// where the indices indicate the bits taken from each value (0 is LSB).
-									// example: if 2MHz is 179746, then 2: 17, 3: 97, 4: 46
-									// The point of this is to make the packet as small as possible to send this information so that
-									// we can build a figure that shows the relationship between fine code and clock ratio
-//									tx_packet[1] = (uint8_t) cfg_fine;
-//									tx_packet[2] = (uint8_t) (count_2M / 100000); // highest digit
-//									tx_packet[3] = (uint8_t) ((count_2M / 10000) - (10*tx_packet[2])); // 2nd highest digit
-//									tx_packet[4] = (uint8_t) (((count_2M - ((count_2M / 10000) * 10000))) / 100); // middle 2 digits
-//									tx_packet[5] = (uint8_t) (count_2M % 100); // lower 2 digits
-//									tx_packet[6] = (uint8_t) (count_32k / 100); // upper 2 digits
-//									tx_packet[7] = (uint8_t) (count_32k % 100); // lower 2 digits
-								
-									//FF2222223333; length = 12
-									sprintf(tx_packet, "%2d%d%d", cfg_fine, count_2M, count_32k);
-									
-//									tx_packet[0] = 0;
-//									tx_packet[1] = 1;
-//									tx_packet[2] = 2;
-//									tx_packet[3] = 3;
-//									tx_packet[4] = 4;
-//									tx_packet[5] = 5;
-//									tx_packet[6] = 6;
-//									tx_packet[7] = 7;
-//									tx_packet[8] = 8;
-//									tx_packet[9] = 9;
-									
-
+									// the config and both counts take 12 bytes with the counter, enough to build a figure
+									// that shows the relationship between fine code and clock ratio
+									packet_add_lc_config(&encoder, cfg_coarse, cfg_mid, cfg_fine);
+									packet_add_clock_counts(&encoder, count_2M, count_32k);
 									break;
 								case IMU_DATA:
-									// first take an IMU measurement
-									read_all_imu_data(&imu_measurement);
-									log_imu_data();
-//									
-//									//place imu acc x data into the rest of the packet (lsb first)
-//									tx_packet[1] = imu_measurement.acc_x.bytes[0];
-//									tx_packet[2] = imu_measurement.acc_x.bytes[1];
-//									
-//									//place acceleration y data into packet
-//									tx_packet[3] = imu_measurement.acc_y.bytes[0];
-//									tx_packet[4] = imu_measurement.acc_y.bytes[1];
-//									
-//									//place acceleration z data into packet
-//									tx_packet[5] = imu_measurement.acc_z.bytes[0];
-//									tx_packet[6] = imu_measurement.acc_z.bytes[1];
-//									
-//									//place gyro x data into packet
-//									tx_packet[7] = imu_measurement.gyro_x.bytes[0];
-//									tx_packet[8] = imu_measurement.gyro_x.bytes[1];
-//									
-//									//place gyro y data into packet
-//									tx_packet[9] = imu_measurement.gyro_y.bytes[0];
-//									tx_packet[10] = imu_measurement.gyro_y.bytes[1];
-//									
-//									//place gyro z data into packet
-//									tx_packet[11] = imu_measurement.gyro_z.bytes[0];
-//									tx_packet[12] = imu_measurement.gyro_z.bytes[1];
-	
-									sprintf(tx_packet, "%d %d %d %d %d %d", 
-										imu_measurement.acc_x.bytes[0],
-										imu_measurement.acc_x.bytes[1],
-										imu_measurement.acc_y.bytes[0],
-										imu_measurement.acc_y.bytes[1],
-										imu_measurement.acc_z.bytes[0],
-										imu_measurement.acc_z.bytes[1]);
-
-										//sprintf(tx_packet, "test");
-//										imu_measurement.gyro_x.bytes[0],
-//										imu_measurement.gyro_x.bytes[1],
-//										imu_measurement.gyro_y.bytes[0],
-//										imu_measurement.gyro_y.bytes[1],
-//										imu_measurement.gyro_z.bytes[0],
-//										imu_measurement.gyro_z.bytes[1]
+									// wait for a batch rather than waking the radio for every sample
+									while (imu_sampler_count() < IMU_SAMPLES_PER_TX) {
+										HAL_IDLE();
+									}
+									packet_add_imu(&encoder);
 									break;
 										
-								case CUSTOM:
-									memcpy(&tx_packet[0],custom_tx_packet,LEN_TX_PKT);
-								  break;
 								default:
 									printf("ERROR: unset tx packet content source");
 								
 									break;
 							}
 							
-							send_packet(cfg_coarse, cfg_mid, cfg_fine, tx_packet);
+							if (tx_packet_data_source != PREDEFINED) {
+								tx_len = packet_encoder_end(&encoder);
+								tx_buf = encoded_tx_packet;
+							}
+							
+							send_packet_len(cfg_coarse, cfg_mid, cfg_fine, tx_buf, tx_len);
 						}
 
 						// stop after send or received a certain number of times
@@ -749,7 +920,7 @@ void repeat_rx_tx(radio_mode_t radio_mode, uint8_t should_sweep, int total_packe
 							//printf("packet %d out of %d\n", packet_counter, total_packets);
 						}
 						
-						if (SOLAR_MODE == 1 & should_sweep == 0) {
+						if (config.solar_mode && !should_sweep) {
 //							printf("radio event\n");
 						}
 						
@@ -771,16 +942,11 @@ void repeat_rx_tx(radio_mode_t radio_mode, uint8_t should_sweep, int total_packe
 	}
 }
 
-// TODO: change this function to use delay_milliseconds to use RF TIMER, which is independent of 
-// HCLK so that the timing is more more consistent regardless of clock speed (won't matter whether
-// you are in lower or normal power state).
+// On solar, sleeps between radio periods for as long as the harvested power needs, see solar_duty.c
 void radio_delay(void) {
-	uint16_t j;
-	
-	if (SOLAR_MODE) {
-		low_power_mode();
-		for (j = 0; j < SOLAR_DELAY; j++) {}
-		normal_power_mode();
+	if (config.solar_mode) {
+		solar_duty_sleep();
+		binlog(BINLOG_SOLAR_SLEEP, solar_duty_last_sleep_ms(), solar_duty_interval_ms());
 	}
 }
 
@@ -791,8 +957,9 @@ void onRx(uint8_t *packet, uint8_t packet_len) {
 	rx_count += 1;
 	//printf("received a total of %d packets\n", rx_count);
 	
-	if (SEND_ACK)
-		need_to_send_ack = true;
+	if (radio_getCrcOk()) {
+		rx_crc_ok = true;
+	}
 	
 	//printf("packet first item: %d\n", packet[0]); //there are 20 or 22 packets and they are uint8_t
 //	if (packet[1]==1) // THIS IS OUTDATED CODE
@@ -802,14 +969,32 @@ void onRx(uint8_t *packet, uint8_t packet_len) {
 //	}
 }
 
+/* Sends the readings of aggregator.c at the fixed TX code, which will not sweep
+ * since that is exactly what we are trying to get rid of by compensating with temperature
+ */
+void send_aggregate(uint8_t* payload, uint8_t len) {
+	send_packet_len(config.fixed_tx.coarse, config.fixed_tx.mid, config.fixed_tx.fine, payload, len);
+}
+
+/* ACKs go out at the fixed TX code too, whatever code the frame came in at,
+ * so they follow the ack command and the temperature of mode 7
+ */
+void configure_acks(void) {
+	if (config.send_ack) {
+		ack_engine_enable(config.fixed_tx.coarse, config.fixed_tx.mid, config.fixed_tx.fine, config.num_ack);
+	} else {
+		ack_engine_disable();
+	}
+}
+
 /* This function will update the fixed fine code based on a linear model relating the 2MHz and 32kHz clock ratios
  * and fine codes that properly transmit.
  */
 void adjust_tx_fine_with_temp(void) {
 	// calculate the ratio between the 2M and the 32kHZz clocks
-	double ratio = fix_double(fix_div(fix_init(count_2M), fix_init(count_32k)));
+	uint32_t ratio = clock_ratio(count_2M, count_32k);
 	
-	fixed_lc_fine_tx = CLOCK_RATIO_VS_FINE_CODE_SLOPE * ratio + CLOCK_RATIO_VS_FINE_CODE_OFFEST;
+	config.fixed_tx.fine = clock_ratio_model(ratio, CLOCK_RATIO_VS_FINE_CODE_SLOPE, CLOCK_RATIO_VS_FINE_CODE_OFFEST, 1);
 }
 
 /* A function used for testing the delay milliseconds functionality. */
@@ -823,16 +1008,27 @@ void test_rf_timer_callback(void) {
 	printf("RF timer callback called!\n");
 }
 
-void imu_read_callback(void) {
-	//printf("reading IMU data\n");
-
-	//test_imu_life();
-	read_all_imu_data(&imu_measurement);
-	log_imu_data();
+// Sends the sampled IMU data over the UART, in frames of IMU_SAMPLES_PER_TX or so
+void drain_imu_samples(void) {
+#if TELEMETRY_ENABLED
+	uint8_t len;
+	
+	while (imu_sampler_count() >= IMU_SAMPLES_PER_TX) {
+		len = imu_sampler_pack(imu_frame, sizeof(imu_frame));
+		telemetry_send(TELEMETRY_CHANNEL_IMU, imu_frame, len);
+	}
+#else
+	imu_sample_t sample;
+	
+	while (imu_sampler_pop(&sample)) {
+		imu_measurement = sample.data;
+		log_imu_data();
+	}
+#endif
 }
 
 void log_imu_data(void) {
-	printf("AX: %3d %3d, AY: %3d %3d, AZ: %3d %3d, GX: %3d %3d, GY: %3d %3d, GZ: %3d %3d\n", 
+	binlog(BINLOG_IMU_DATA,
 		imu_measurement.acc_x.bytes[0],
 		imu_measurement.acc_x.bytes[1],
 		imu_measurement.acc_y.bytes[0],
@@ -845,4 +1041,160 @@ void log_imu_data(void) {
 		imu_measurement.gyro_y.bytes[1],
 		imu_measurement.gyro_z.bytes[0],
 		imu_measurement.gyro_z.bytes[1]);
-}
\ No newline at end of file
+}
+
+bool parse_run(const char* text, command_args_t* args) {
+	return command_parse_int(text, args) && (args->values[0] == 0 || args->values[0] == 1);
+}
+
+// Six codes up to 32, each start below its end
+bool parse_sweep(const char* text, command_args_t* args) {
+	uint8_t i;
+	
+	if (!command_parse_ints(text, args) || args->count != 6) {
+		return false;
+	}
+	for (i = 0; i < 6; i += 2) {
+		if (args->values[i] < 0 || args->values[i] >= args->values[i + 1] || args->values[i + 1] > 32) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Two flags
+bool parse_flags(const char* text, command_args_t* args) {
+	return command_parse_ints(text, args) && args->count == 2 &&
+		(args->values[0] == 0 || args->values[0] == 1) &&
+		(args->values[1] == 0 || args->values[1] == 1);
+}
+
+bool parse_ack(const char* text, command_args_t* args) {
+	return command_parse_ints(text, args) && args->count == 2 &&
+		(args->values[0] == 0 || args->values[0] == 1) &&
+		args->values[1] > 0 && args->values[1] <= 255;
+}
+
+// Any mode but the command mode itself, which is where this is typed
+bool parse_mode(const char* text, command_args_t* args) {
+	return command_parse_int(text, args) &&
+		args->values[0] >= 0 && args->values[0] < NUM_EXPERIMENT_MODES &&
+		args->values[0] != COMMAND_MODE;
+}
+
+// Only takes effect in mode 19, the other modes decide what to run themselves
+void command_tx(const command_args_t* args) {
+	run_radio_mode = TX;
+	run_should_sweep = args->values[0];
+	run_requested = true;
+}
+
+void command_rx(const command_args_t* args) {
+	run_radio_mode = RX;
+	run_should_sweep = args->values[0];
+	run_requested = true;
+}
+
+void command_stop(const command_args_t* args) {
+	stop_requested = true;
+}
+
+// Fixed LC codes, taking effect at the next call of repeat_rx_tx()
+void command_fixtx(const command_args_t* args) {
+	config.fixed_tx.coarse = args->values[0];
+	config.fixed_tx.mid = args->values[1];
+	config.fixed_tx.fine = args->values[2];
+}
+
+void command_fixrx(const command_args_t* args) {
+	config.fixed_rx.coarse = args->values[0];
+	config.fixed_rx.mid = args->values[1];
+	config.fixed_rx.fine = args->values[2];
+}
+
+void command_sweeptx(const command_args_t* args) {
+	config.sweep_range_tx.coarse_start = args->values[0];
+	config.sweep_range_tx.coarse_stop = args->values[1];
+	config.sweep_range_tx.mid_start = args->values[2];
+	config.sweep_range_tx.mid_stop = args->values[3];
+	config.sweep_range_tx.fine_start = args->values[4];
+	config.sweep_range_tx.fine_stop = args->values[5];
+}
+
+void command_sweeprx(const command_args_t* args) {
+	config.sweep_range_rx.coarse_start = args->values[0];
+	config.sweep_range_rx.coarse_stop = args->values[1];
+	config.sweep_range_rx.mid_start = args->values[2];
+	config.sweep_range_rx.mid_stop = args->values[3];
+	config.sweep_range_rx.fine_start = args->values[4];
+	config.sweep_range_rx.fine_stop = args->values[5];
+}
+
+// Sends the LC codes that received a frame so far, as binlog records or over the radio at the fixed TX codes
+void command_results(const command_args_t* args) {
+	packet_encoder_t encoder;
+	uint16_t next_row;
+	uint8_t counter;
+	bool done;
+	
+	if (args->values[0] == 0) {
+		sweep_results_dump();
+		return;
+	}
+	
+	next_row = 0;
+	counter = 0;
+	do {
+		packet_encoder_begin(&encoder, encoded_tx_packet, sizeof(encoded_tx_packet), counter++);
+		done = sweep_results_pack(&encoder, &next_row);
+		send_packet_len(config.fixed_tx.coarse, config.fixed_tx.mid, config.fixed_tx.fine, encoded_tx_packet, packet_encoder_end(&encoder));
+	} while (!done);
+	printf("sent %u working LC codes in %u packets\n", sweep_results_count(), counter);
+}
+
+void command_clearres(const command_args_t* args) {
+	sweep_results_clear();
+}
+
+// Only takes effect in mode 19, which runs the mode until it returns
+void command_mode(const command_args_t* args) {
+	config.mode = args->values[0];
+	mode_requested = true;
+}
+
+// Sweep or stay at the fixed codes, from the next call of repeat_rx_tx()
+void command_sweep(const command_args_t* args) {
+	config.sweep_tx = args->values[0];
+	config.sweep_rx = args->values[1];
+}
+
+void command_ack(const command_args_t* args) {
+	config.send_ack = args->values[0];
+	config.num_ack = args->values[1];
+}
+
+void command_solar(const command_args_t* args) {
+	config.solar_mode = args->values[0];
+	if (config.solar_mode) {
+		solar_duty_init(SOLAR_MIN_SLEEP_MS, SOLAR_MAX_SLEEP_MS, SOLAR_POWER_GOOD_GPIO);
+		aggregator_set_budget(solar_duty_power_good);
+	} else {
+		aggregator_set_budget(NULL);
+	}
+}
+
+void command_config(const command_args_t* args) {
+	printf("mode %u optical %u solar %u sweep tx %u rx %u ack %u x%u\n",
+		config.mode, config.optical_calibrate, config.solar_mode,
+		config.sweep_tx, config.sweep_rx, config.send_ack, config.num_ack);
+	printf("fixed tx c:%u m:%u f:%u rx c:%u m:%u f:%u\n",
+		config.fixed_tx.coarse, config.fixed_tx.mid, config.fixed_tx.fine,
+		config.fixed_rx.coarse, config.fixed_rx.mid, config.fixed_rx.fine);
+	printf("sweep tx c:%u-%u m:%u-%u f:%u-%u rx c:%u-%u m:%u-%u f:%u-%u\n",
+		config.sweep_range_tx.coarse_start, config.sweep_range_tx.coarse_stop,
+		config.sweep_range_tx.mid_start, config.sweep_range_tx.mid_stop,
+		config.sweep_range_tx.fine_start, config.sweep_range_tx.fine_stop,
+		config.sweep_range_rx.coarse_start, config.sweep_range_rx.coarse_stop,
+		config.sweep_range_rx.mid_start, config.sweep_range_rx.mid_stop,
+		config.sweep_range_rx.fine_start, config.sweep_range_rx.fine_stop);
+}
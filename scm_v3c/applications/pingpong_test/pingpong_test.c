@@ -6,7 +6,8 @@ one valid frame sent by OpenMote it will lock on the frequency and keep
 listening.
 
 After locked, SCuM will send back a frame every time it receives one frame from
-OpenMote. 
+OpenMote. The receiver is then only on around the expected arrival of each
+frame, the interval between them learned from the first two (see sync_rx.c).
 
 The target image running on OpenMote can be found at: 
 (https://openwsn-builder.paris.inria.fr/job/Firmware/board=openmote-cc2538,
@@ -14,24 +15,27 @@ The target image running on OpenMote can be found at:
 */
 
 #include <string.h>
+#include <stdio.h>
 
 #include "scm3c_hw_interface.h"
 #include "memory_map.h"
 #include "rftimer.h"
 #include "radio.h"
 #include "optical.h"
+#include "sync_rx.h"
 
 //=========================== defines =========================================
 
-#define CRC_VALUE         (*((unsigned int *) 0x0000FFFC))
-#define CODE_LENGTH       (*((unsigned int *) 0x0000FFF8))
 
 #define LENGTH_PACKET   125+LENGTH_CRC ///< maximum length is 127 bytes
-#define LEN_TX_PKT      30+LENGTH_CRC  ///< length of tx packet
-#define LEN_RX_PKT      20+LENGTH_CRC  ///< length of rx packet
+#define LEN_TX_ACK      30+LENGTH_CRC  ///< length of tx packet
+#define LEN_RX_FRAME    20+LENGTH_CRC  ///< length of rx packet
 #define CHANNEL         11             ///< 11=2.405GHz
 #define TIMER_PERIOD    1000           ///< 500 = 1ms@500kHz
 #define ID              0x99           ///< byte sent in the packets
+#define RX_GUARD_TICKS  100            ///< listen 200us either side of the expected SFD
+#define RX_STARTUP_TICKS 50            ///< receiver on 100us before listening, see radio_rxEnable()
+#define TX_RFTIMER_COMPAREID 0
 
 //=========================== variables =======================================
 
@@ -42,7 +46,6 @@ typedef struct {
             uint8_t         rxpk_lqi;
     
    volatile bool            rxpk_crc;
-   volatile bool            doing_initial_packet_search;
     
    volatile uint32_t        IF_estimate;
    volatile uint32_t        LQI_chip_errors;
@@ -53,11 +56,12 @@ app_vars_t app_vars;
 
 //=========================== prototypes ======================================
 
-void     cb_startFrame_tx(uint32_t timestamp);
-void     cb_endFrame_tx(uint32_t timestamp);
-void     cb_startFrame_rx(uint32_t timestamp);
-void     cb_endFrame_rx(uint32_t timestamp);
-void     cb_timer(void);
+void     pingpong_startFrame_tx(uint32_t timestamp);
+void     pingpong_endFrame_tx(uint32_t timestamp);
+void     pingpong_startFrame_rx(uint32_t timestamp);
+void     pingpong_endFrame_rx(uint32_t timestamp);
+void     pingpong_timer(void);
+void     pingpong_tune_rx(void);
 
 //=========================== main ============================================
 
@@ -74,27 +78,29 @@ int main(void) {
     // This function handles all the analog scan chain setup
     initialize_mote();
     
-    radio_setStartFrameTxCb(cb_startFrame_tx);
-    radio_setEndFrameTxCb(cb_endFrame_tx);
-    radio_setStartFrameRxCb(cb_startFrame_rx);
-    radio_setEndFrameRxCb(cb_endFrame_rx);
+    radio_setStartFrameTxCb(pingpong_startFrame_tx);
+    radio_setEndFrameTxCb(pingpong_endFrame_tx);
+    radio_setStartFrameRxCb(pingpong_startFrame_rx);
+    radio_setEndFrameRxCb(pingpong_endFrame_rx);
     
-    rftimer_set_callback(cb_timer);
+    rftimer_set_callback(pingpong_timer, TX_RFTIMER_COMPAREID);
+    sync_rx_init(RX_GUARD_TICKS, RX_STARTUP_TICKS, pingpong_tune_rx);
     
     // Disable interrupts for the radio and rftimer
     radio_disable_interrupts();
-    rftimer_disable_interrupts();
+    rftimer_disable_interrupts(TX_RFTIMER_COMPAREID);
     
     // Check CRC to ensure there were no errors during optical programming
     printf("\r\n-------------------\r\n");
     printf("Validating program integrity..."); 
     
-    calc_crc = crc32c(0x0000,CODE_LENGTH);
+    calc_crc = crc32c(HAL_IMAGE(0x0000),IMAGE_CODE_LENGTH);
     
-    if(calc_crc == CRC_VALUE){
+    if(calc_crc == IMAGE_CRC_VALUE){
         printf("CRC OK\r\n");
     } else{
         printf("\r\nProgramming Error - CRC DOES NOT MATCH - Halting Execution\r\n");
+        image_report_bad_blocks();
         while(1);
     }
     
@@ -125,16 +131,11 @@ int main(void) {
 
     printf("Listening for packets on ch %d \r\n",CHANNEL);
 
-    // First listen continuously for rx packet
-    app_vars.doing_initial_packet_search = true;
-    
     // Enable interrupts for the radio FSM
     radio_enable_interrupts();
 
-    // Begin listening
-    radio_setFrequency(CHANNEL, FREQ_RX);
-    radio_rxEnable();
-    radio_rxNow();
+    // First listen continuously for rx packet
+    sync_rx_listen();
     
     // Wait awhile
     for (t2=0; t2<100; t2++){
@@ -142,21 +143,25 @@ int main(void) {
         // Delay
         for(t=0; t<100000; t++);
         
-        if(app_vars.doing_initial_packet_search == false) {
+        if(sync_rx_locked()) {
             printf("Locked to incoming packet rate...\r\n");
             break;
         }
     }
     
     // If no packet received, then stop RX so can reprogram
-    if(app_vars.doing_initial_packet_search == true) {
-        radio_rfOff();
+    if(!sync_rx_locked()) {
+        sync_rx_stop();
         radio_disable_interrupts();
         printf("RX Stopped - Lock Failed\n");
     }
 
     while(1) {
         for(t=0; t<1000000; t++);
+        
+        printf("interval %u error %d listen %u misses %u\r\n",
+            sync_rx_interval(), sync_rx_last_error(),
+            sync_rx_last_listen_ticks(), sync_rx_misses());
     }
 }
 
@@ -164,13 +169,11 @@ int main(void) {
 
 //=========================== private =========================================
 
-void    cb_startFrame_tx(uint32_t timestamp){
+void    pingpong_startFrame_tx(uint32_t timestamp){
     
 }
 
-void    cb_endFrame_tx(uint32_t timestamp){
-    
-    // turn to listen
+void    pingpong_endFrame_tx(uint32_t timestamp){
     
     radio_rfOff();
     
@@ -180,17 +183,17 @@ void    cb_endFrame_tx(uint32_t timestamp){
 //        app_vars.cdr_tau_value
 //    );
     
-    radio_setFrequency(CHANNEL, FREQ_RX);
-    radio_rxEnable();
-    radio_rxNow();
+    // turn to listen, until the next window once locked
+    sync_rx_listen();
     
 }
 
-void    cb_startFrame_rx(uint32_t timestamp){
+void    pingpong_startFrame_rx(uint32_t timestamp){
     
+    sync_rx_startFrame(timestamp);
 }
 
-void    cb_endFrame_rx(uint32_t timestamp){
+void    pingpong_endFrame_rx(uint32_t timestamp){
     
     radio_getReceivedFrame(
         &(app_vars.packet[0]),
@@ -202,32 +205,22 @@ void    cb_endFrame_rx(uint32_t timestamp){
     
     // Check if the packet length is as expected (20 payload bytes + 2 for CRC)    
     // In this demo code, it is assumed the OpenMote is sending packets with 20B payloads
-    if(app_vars.packet_len != LEN_RX_PKT){
+    sync_rx_endFrame(app_vars.packet_len == LEN_RX_FRAME && radio_getCrcOk());
+    
+    if(app_vars.packet_len != LEN_RX_FRAME){
         
         // Keep listening
-        radio_setFrequency(CHANNEL, FREQ_RX);
-        radio_rxEnable();
-        radio_rxNow();
+        sync_rx_listen();
     } else {
         if (radio_getCrcOk()==false){
             // Length was right but CRC was wrong
             
             // Keep listening
-            radio_setFrequency(CHANNEL, FREQ_RX);
-            radio_rxEnable();
-            radio_rxNow();
+            sync_rx_listen();
     
             // Packet has good CRC value and is the correct length
         } else {
             
-            // If this is the first valid packet received, start timers for next expected packet
-            if(app_vars.doing_initial_packet_search == true){
-                
-                // Clear this flag to note we are no longer doing continuous RX listen
-                app_vars.doing_initial_packet_search = false;
-                
-            }
-            
             // Only record IF estimate, LQI, and CDR tau for valid packets
             app_vars.IF_estimate        = radio_getIFestimate();
             app_vars.LQI_chip_errors    = radio_getLQIchipErrors();
@@ -246,7 +239,7 @@ void    cb_endFrame_rx(uint32_t timestamp){
             app_vars.packet[2] = 's';
             app_vars.packet[3] = 't';
             
-            radio_loadPacket(app_vars.packet, LEN_TX_PKT);
+            radio_loadPacket(app_vars.packet, LEN_TX_ACK);
             
             radio_rfOff();
             
@@ -257,14 +250,19 @@ void    cb_endFrame_rx(uint32_t timestamp){
             radio_txEnable();
             
             // send frame after 2ms
-            rftimer_setCompareIn(rftimer_readCounter()+ TIMER_PERIOD);
+            rftimer_setCompareIn(rftimer_readCounter()+ TIMER_PERIOD, TX_RFTIMER_COMPAREID);
         }
     }
 }
 
-void    cb_timer(void) {
+void    pingpong_timer(void) {
     
     // Tranmit the packet
     radio_txNow();
 }
 
+void    pingpong_tune_rx(void) {
+    
+    radio_setFrequency(CHANNEL, FREQ_RX);
+}
+
@@ -0,0 +1,106 @@
+/**
+\brief Logging without formatting on the chip.
+
+binlog() sends a record instead of the text of the message:
+
+    [BINLOG_SYNC] [id] [RF timer counter, 4 bytes LE] [args] [checksum]
+
+Each argument is zigzag encoded into a base 128 varint, 1 byte for values up
+to +-63, and the checksum is the two's complement of the sum of all bytes
+after the sync byte. tools/binlog_decode.py turns the records back into the
+text of the format strings in binlog_messages.h, or into JSON/CSV, and passes
+whatever else printf sent through as is.
+
+With TELEMETRY_ENABLED the record goes out on the log channel of a telemetry
+frame instead, without the sync byte and checksum the frame makes redundant
+(see telemetry.c and tools/telemetry_receiver.py).
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "memory_map.h"
+#include "rftimer.h"
+#include "uart.h"
+#include "telemetry.h"
+#include "packet_encoder.h"
+#include "binlog.h"
+
+//=========================== defines =========================================
+
+#define BINLOG_MAX_RECORD_LEN   (1 + 1 + 4 + PACKET_MAX_VARINT_LEN * BINLOG_MAX_ARGS + 1)
+
+//=========================== variables =======================================
+
+#define BINLOG_MESSAGE(name, nargs, format) nargs,
+const uint8_t binlog_nargs[BINLOG_NUM_MESSAGES] = {
+#include "binlog_messages.h"
+};
+#undef BINLOG_MESSAGE
+
+#if BINLOG_AS_TEXT
+#define BINLOG_MESSAGE(name, nargs, format) format,
+const char* const binlog_formats[BINLOG_NUM_MESSAGES] = {
+#include "binlog_messages.h"
+};
+#undef BINLOG_MESSAGE
+#endif
+
+//=========================== prototypes ======================================
+
+//=========================== public ==========================================
+
+/* Logs message ID (a binlog_id_t, which armcc may store in a char, and that
+ * can't be the last argument before the ...), followed by as many int or
+ * unsigned int arguments as its entry in binlog_messages.h says. Safe to call
+ * from interrupt context.
+ */
+void binlog(uint32_t id, ...) {
+    va_list  args;
+#if !BINLOG_AS_TEXT
+    uint8_t  record[BINLOG_MAX_RECORD_LEN];
+    uint8_t  len;
+#if !TELEMETRY_ENABLED
+    uint8_t  sum;
+#endif
+    uint8_t  i;
+    uint32_t timestamp;
+    int32_t  value;
+#endif
+
+    va_start(args, id);
+#if BINLOG_AS_TEXT
+    vprintf(binlog_formats[id], args);
+#else
+    timestamp = rftimer_readCounter();
+
+    len = 0;
+#if !TELEMETRY_ENABLED
+    record[len++] = BINLOG_SYNC;
+#endif
+    record[len++] = (uint8_t) id;
+    record[len++] = (uint8_t)(timestamp);
+    record[len++] = (uint8_t)(timestamp >> 8);
+    record[len++] = (uint8_t)(timestamp >> 16);
+    record[len++] = (uint8_t)(timestamp >> 24);
+
+    for (i = 0; i < binlog_nargs[id]; i++) {
+        value = (int32_t) va_arg(args, int);
+        // zigzag, so small negative numbers stay short too
+        len  += packet_put_varint(&record[len], packet_zigzag(value));
+    }
+
+#if TELEMETRY_ENABLED
+    telemetry_send(TELEMETRY_CHANNEL_LOG, record, len);
+#else
+    sum = 0;
+    for (i = 1; i < len; i++) {
+        sum += record[i];
+    }
+    record[len++] = (uint8_t)(-sum);
+
+    uart_tx_write(record, len);
+#endif
+#endif
+    va_end(args);
+}
@@ -0,0 +1,31 @@
+#ifndef __BINLOG_H
+#define __BINLOG_H
+
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+// 1 to format messages on the chip as printf used to, 0 to send binary records
+#define BINLOG_AS_TEXT          0
+
+#define BINLOG_MAX_ARGS         12
+
+// first byte of a record, never part of the 7-bit text printf sends
+#define BINLOG_SYNC             0xA5
+
+//=========================== typedef =========================================
+
+#define BINLOG_MESSAGE(name, nargs, format) name,
+typedef enum {
+#include "binlog_messages.h"
+    BINLOG_NUM_MESSAGES
+} binlog_id_t;
+#undef BINLOG_MESSAGE
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void binlog(uint32_t id, ...);
+
+#endif
@@ -0,0 +1,22 @@
+/**
+\brief Messages that can be logged with binlog().
+
+BINLOG_MESSAGE(name, number of arguments, format) for each message. The
+position in this list is the message id that goes on the wire, so decoding a
+log needs this file as it was when the firmware was built, see
+tools/binlog_decode.py. Arguments are 32-bit integers, %s and floating point
+conversions aren't supported.
+
+Deliberately no include guard, see binlog.h.
+*/
+
+BINLOG_MESSAGE(BINLOG_RX_PACKET,        7,  "Packet num %d. Packet contents 1-3: %d %d %d coarse: %d\tmid: %d\tfine: %d\n")
+BINLOG_MESSAGE(BINLOG_TX_FRAME_START,   0,  "starting tx frame\n")
+BINLOG_MESSAGE(BINLOG_SWEEP_CONFIG,     3,  "coarse=%d, middle=%d, fine=%d\r\n")
+BINLOG_MESSAGE(BINLOG_CLOCK_COUNTS,     2,  "2M: %u, 32kHz: %u\n")
+BINLOG_MESSAGE(BINLOG_OPTICAL_CAL,      11, "HF=%d-%d   2M=%d-%d,%d,%d   LC=%d-%d   IF=%d-%d,%d\r\n")
+BINLOG_MESSAGE(BINLOG_IMU_DATA,         12, "AX: %3d %3d, AY: %3d %3d, AZ: %3d %3d, GX: %3d %3d, GY: %3d %3d, GZ: %3d %3d\n")
+BINLOG_MESSAGE(BINLOG_SWEEP_COARSE,     3,  "coarse %d: %d working, mids 0x%08x\n")
+BINLOG_MESSAGE(BINLOG_SWEEP_ROW,        5,  "coarse %d mid %d: fine %d-%d 0x%08x\n")
+BINLOG_MESSAGE(BINLOG_SWEEP_RESULTS,    1,  "sweep results: %d working\n")
+BINLOG_MESSAGE(BINLOG_SOLAR_SLEEP,      2,  "solar sleep %u ms, next %u ms\n")
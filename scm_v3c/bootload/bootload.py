@@ -4,6 +4,15 @@ import argparse
 import signal
 import sys
 
+# Per-block CRC table layout, must match scm3c_hw_interface.h
+BLOCK_SIZE = 1024
+BLOCK_CRC_MAGIC_ADDR = 0xFEF0
+BLOCK_CRC_MAGIC = b'BCRC'
+
+# Application config block, must match scm3c_hw_interface.h
+CONFIG_ADDR = 0xFE00
+CONFIG_END_ADDR = BLOCK_CRC_MAGIC_ADDR
+
 # Serial connections
 teensy_ser = None
 uart_ser = None
@@ -26,7 +35,7 @@ signal.signal(signal.SIGINT, signal_handler) # setup exit handler
 
 def program_cortex(teensy_port="COM10", scum_port=None, binary_image="../AllGPIOToggle.bin",
         boot_mode='optical', skip_reset=False, insert_CRC=False,
-        pad_random_payload=False):
+        pad_random_payload=False, insert_block_CRC=False, config_block=None):
     """
     Inputs:
         teensy_port: String. Name of the COM port that the Teensy
@@ -53,6 +62,14 @@ def program_cortex(teensy_port="COM10", scum_port=None, binary_image="../AllGPIO
             random data and check it with CRC. False = pad with zeros, do 
             not check integrity of padding. This is useful to check for 
             programming errors over full 64kB payload.
+        insert_block_CRC: Boolean. True = also insert a table of CRCs over
+            each 1kB block so SCM can report which blocks were corrupted.
+            Requires insert_CRC and code shorter than 0xFEF0 bytes, so it
+            is skipped when padding with random data.
+        config_block: String. Path to a config block written by e.g.
+            tools/experiment_config.py, placed at 0x0000FE00 so the
+            application picks its settings at boot without a rebuild.
+            Requires code shorter than 0xFE00 bytes. None = no block.
     Outputs:
         No return value. Feeds the input from binary_image to the Teensy to program SCM
         and programs SCM. 
@@ -98,6 +115,29 @@ def program_cortex(teensy_port="COM10", scum_port=None, binary_image="../AllGPIO
         bindata[65529] = code_length // 256
         bindata[65530] = 0
         bindata[65531] = 0
+
+    if config_block:
+        with open(config_block, 'rb') as f:
+            block = bytearray(f.read())
+        if code_length > CONFIG_ADDR or pad_random_payload:
+            print('Code overlaps config block, skipping it')
+        elif CONFIG_ADDR + len(block) > CONFIG_END_ADDR:
+            print('Config block too long, skipping it')
+        else:
+            bindata[CONFIG_ADDR:CONFIG_ADDR+len(block)] = block
+
+    if insert_CRC and insert_block_CRC:
+        if code_length > BLOCK_CRC_MAGIC_ADDR:
+            print('Code overlaps block CRC table, skipping block CRCs')
+            insert_block_CRC = False
+        else:
+            # Insert header at 0x0000FEF0, Teensy fills in the table after it
+            num_blocks = (code_length + BLOCK_SIZE - 1) // BLOCK_SIZE
+            bindata[BLOCK_CRC_MAGIC_ADDR:BLOCK_CRC_MAGIC_ADDR+4] = BLOCK_CRC_MAGIC
+            bindata[BLOCK_CRC_MAGIC_ADDR+4] = num_blocks
+            bindata[BLOCK_CRC_MAGIC_ADDR+5] = 0
+            bindata[BLOCK_CRC_MAGIC_ADDR+6] = 0
+            bindata[BLOCK_CRC_MAGIC_ADDR+7] = 0
     
     # Transfer payload to Teensy
     teensy_ser.write(b'transfersram\n')
@@ -105,6 +145,11 @@ def program_cortex(teensy_port="COM10", scum_port=None, binary_image="../AllGPIO
     # Send the binary data over uart
     teensy_ser.write(bindata)
 
+    if insert_CRC and insert_block_CRC:
+        # Have Teensy calculate a CRC over each 1kB block of the code
+        # It will store the table of 32-bit results from address 0x0000FEF8
+        teensy_ser.write(b'insertblockcrc\n')
+
     if insert_CRC:
         # Have Teensy calculate 32-bit CRC over the code length 
         # It will store the 32-bit result at address 0x0000FFFC
@@ -233,5 +278,20 @@ if __name__ == "__main__":
             programming errors over full 64kB payload.'
     )
     
+    parser.add_argument('-bc','--insert_block_CRC',
+        dest='insert_block_CRC',
+        default=False,
+        help='True = also insert a CRC for each 1kB block so SCM \
+            can report which blocks were corrupted. False = only \
+            insert the CRC over the whole code.'
+    )
+    
+    parser.add_argument('-cfg','--config_block',
+        dest='config_block',
+        default=None,
+        help='Path to a config block for the application, \
+            e.g. from tools/experiment_config.py. None = no block.'
+    )
+    
     argspace = vars(parser.parse_args())
     program_cortex(**argspace)
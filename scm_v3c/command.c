@@ -0,0 +1,272 @@
+/**
+\brief Line based command interpreter on the UART.
+
+The UART receive interrupt only collects characters into a line. A complete
+line is handed over to command_poll(), called from the main loop, which
+looks the first word up in the built-in and the application's command
+tables, parses the rest with the command's parser and runs its handler.
+Handlers can take their time and printf freely, they run outside of any
+interrupt. Up to COMMAND_NUM_LINES lines wait for their turn, a line that
+arrives when they are all taken is dropped, see the "stats" command.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory_map.h"
+#include "scm3c_hw_interface.h"
+#include "counters.h"
+#include "rftimer.h"
+#include "uart.h"
+#include "command.h"
+
+//=========================== defines =========================================
+
+#define COMMAND_LC_CODE_MAX     31
+
+// one slot stays empty to tell a full queue from an empty one
+#define COMMAND_NUM_LINES       5
+
+//=========================== variables =======================================
+
+typedef struct {
+    // filled by the UART interrupt
+    char                rx_line[COMMAND_MAX_LINE_LEN];
+    uint8_t             rx_len;
+    bool                rx_overlong;
+    
+    // handed over to command_poll(), the interrupt only moves lines_head
+    char                lines[COMMAND_NUM_LINES][COMMAND_MAX_LINE_LEN];
+    volatile uint8_t    lines_head;
+    volatile uint8_t    lines_tail;
+    
+    const command_t*    app_commands;
+    uint8_t             num_app_commands;
+    
+    uint32_t            num_run;
+    uint32_t            num_errors;
+    volatile uint32_t   num_dropped;
+} command_vars_t;
+
+command_vars_t command_vars;
+
+//=========================== prototypes ======================================
+
+void             command_rx_byte(uint8_t byte);
+const command_t* command_find(const char* name);
+void             command_help(const command_args_t* args);
+void             command_lc(const command_args_t* args);
+void             command_counters(const command_args_t* args);
+void             command_stats(const command_args_t* args);
+void             command_reset(const command_args_t* args);
+
+const command_t command_builtins[] = {
+    {"help",        command_parse_none, command_help,       "help"},
+    {"lc",          command_parse_lc,   command_lc,         "lc <coarse> <mid> <fine>"},
+    {"counters",    command_parse_int,  command_counters,   "counters <ms>"},
+    {"stats",       command_parse_none, command_stats,      "stats"},
+    {"reset",       command_parse_none, command_reset,      "reset"},
+};
+
+#define COMMAND_NUM_BUILTINS    (sizeof(command_builtins) / sizeof(command_builtins[0]))
+
+//=========================== public ==========================================
+
+/* Starts receiving commands. APP_COMMANDS, which must stay valid, adds to
+ * the built-in commands (and overrides those with the same name).
+ */
+void command_init(const command_t* app_commands, uint8_t num_app_commands) {
+    memset(&command_vars, 0, sizeof(command_vars_t));
+    command_vars.app_commands     = app_commands;
+    command_vars.num_app_commands = num_app_commands;
+    
+    uart_set_rx_callback(command_rx_byte);
+}
+
+/* Runs the oldest line received, if any, returns true if there was one.
+ * Call it regularly from the main loop.
+ */
+bool command_poll(void) {
+    const command_t* command;
+    command_args_t   args;
+    char*            name;
+    char*            rest;
+    
+    if (command_vars.lines_tail == command_vars.lines_head) {
+        return false;
+    }
+    
+    // split off the command name
+    name = command_vars.lines[command_vars.lines_tail];
+    while (*name == ' ') {
+        name++;
+    }
+    rest = name;
+    while (*rest != ' ' && *rest != '\0') {
+        rest++;
+    }
+    if (*rest != '\0') {
+        *rest++ = '\0';
+    }
+    
+    if (*name != '\0') {
+        command = command_find(name);
+        memset(&args, 0, sizeof(command_args_t));
+        
+        if (command == NULL) {
+            printf("unknown command '%s', try help\r\n", name);
+            command_vars.num_errors++;
+        } else if (!command->parse(rest, &args)) {
+            printf("usage: %s\r\n", command->usage);
+            command_vars.num_errors++;
+        } else {
+            command->handler(&args);
+            command_vars.num_run++;
+        }
+    }
+    
+    // only now the interrupt can reuse the line
+    command_vars.lines_tail = (command_vars.lines_tail + 1) % COMMAND_NUM_LINES;
+    return true;
+}
+
+bool command_parse_none(const char* text, command_args_t* args) {
+    while (*text == ' ') {
+        text++;
+    }
+    return *text == '\0';
+}
+
+// Up to COMMAND_MAX_ARGS decimal or 0x prefixed hexadecimal integers
+bool command_parse_ints(const char* text, command_args_t* args) {
+    char* end;
+    
+    args->count = 0;
+    while (1) {
+        while (*text == ' ') {
+            text++;
+        }
+        if (*text == '\0') {
+            return true;
+        }
+        if (args->count == COMMAND_MAX_ARGS) {
+            return false;
+        }
+        args->values[args->count++] = (int32_t) strtol(text, &end, 0);
+        if (end == text || (*end != ' ' && *end != '\0')) {
+            return false;
+        }
+        text = end;
+    }
+}
+
+// Exactly one integer
+bool command_parse_int(const char* text, command_args_t* args) {
+    return command_parse_ints(text, args) && args->count == 1;
+}
+
+// Coarse, mid and fine LC codes
+bool command_parse_lc(const char* text, command_args_t* args) {
+    uint8_t i;
+    
+    if (!command_parse_ints(text, args) || args->count != 3) {
+        return false;
+    }
+    for (i = 0; i < 3; i++) {
+        if (args->values[i] < 0 || args->values[i] > COMMAND_LC_CODE_MAX) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//=========================== private =========================================
+
+const command_t* command_find(const char* name) {
+    uint8_t i;
+    
+    for (i = 0; i < command_vars.num_app_commands; i++) {
+        if (strcmp(name, command_vars.app_commands[i].name) == 0) {
+            return &command_vars.app_commands[i];
+        }
+    }
+    for (i = 0; i < COMMAND_NUM_BUILTINS; i++) {
+        if (strcmp(name, command_builtins[i].name) == 0) {
+            return &command_builtins[i];
+        }
+    }
+    return NULL;
+}
+
+void command_help(const command_args_t* args) {
+    uint8_t i;
+    
+    for (i = 0; i < COMMAND_NUM_BUILTINS; i++) {
+        printf("  %s\r\n", command_builtins[i].usage);
+    }
+    for (i = 0; i < command_vars.num_app_commands; i++) {
+        printf("  %s\r\n", command_vars.app_commands[i].usage);
+    }
+}
+
+void command_lc(const command_args_t* args) {
+    LC_FREQCHANGE(args->values[0], args->values[1], args->values[2]);
+    printf("LC set to %d.%d.%d\r\n", args->values[0], args->values[1], args->values[2]);
+}
+
+void command_counters(const command_args_t* args) {
+    counters_snapshot_t snapshot;
+    
+    if (args->values[0] <= 0) {
+        printf("the duration must be positive\r\n");
+        return;
+    }
+    counters_measure(args->values[0] * RFTIMER_TICKS_PER_MS, &snapshot);
+    printf("%u ticks: 32k=%u 2M=%u HF=%u LC_div=%u IF=%u\r\n",
+        snapshot.elapsed_ticks, snapshot.count_32k, snapshot.count_2M,
+        snapshot.count_HF, snapshot.count_LC_div, snapshot.count_IF);
+}
+
+void command_stats(const command_args_t* args) {
+    printf("commands run %u, failed %u, lines dropped %u, uart bytes dropped %u\r\n",
+        command_vars.num_run, command_vars.num_errors, command_vars.num_dropped,
+        uart_tx_dropped());
+}
+
+void command_reset(const command_args_t* args) {
+    printf("resetting\r\n");
+    uart_tx_flush();
+    AIRCR = AIRCR_SYSRESETREQ;
+}
+
+//=========================== interrupt =======================================
+
+// Collects a line, handing it over to command_poll() at CR or LF
+void command_rx_byte(uint8_t byte) {
+    uint8_t next;
+    
+    if (byte == '\r' || byte == '\n') {
+        if (command_vars.rx_overlong) {
+            command_vars.num_dropped++;
+        } else if (command_vars.rx_len > 0) {
+            next = (command_vars.lines_head + 1) % COMMAND_NUM_LINES;
+            if (next == command_vars.lines_tail) {
+                command_vars.num_dropped++;
+            } else {
+                memcpy(command_vars.lines[command_vars.lines_head], command_vars.rx_line, command_vars.rx_len);
+                command_vars.lines[command_vars.lines_head][command_vars.rx_len] = '\0';
+                command_vars.lines_head = next;
+            }
+        }
+        command_vars.rx_len      = 0;
+        command_vars.rx_overlong = false;
+        return;
+    }
+    
+    if (command_vars.rx_len < COMMAND_MAX_LINE_LEN - 1) {
+        command_vars.rx_line[command_vars.rx_len++] = (char) byte;
+    } else {
+        command_vars.rx_overlong = true;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef __COMMAND_H
+#define __COMMAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+#define COMMAND_MAX_LINE_LEN    64
+#define COMMAND_MAX_ARGS        6
+
+//=========================== typedef =========================================
+
+typedef struct {
+    int32_t     values[COMMAND_MAX_ARGS];
+    uint8_t     count;
+} command_args_t;
+
+// Parses the text after the command name into ARGS, false if it is invalid
+typedef bool (*command_parser_t)(const char* text, command_args_t* args);
+// Runs the command, from command_poll() in the main loop
+typedef void (*command_handler_t)(const command_args_t* args);
+
+typedef struct {
+    const char*         name;
+    command_parser_t    parse;
+    command_handler_t   handler;
+    const char*         usage;
+} command_t;
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void command_init(const command_t* app_commands, uint8_t num_app_commands);
+bool command_poll(void);
+
+// argument parsers for the command tables
+bool command_parse_none(const char* text, command_args_t* args);
+bool command_parse_int(const char* text, command_args_t* args);
+bool command_parse_ints(const char* text, command_args_t* args);
+bool command_parse_lc(const char* text, command_args_t* args);
+
+#endif
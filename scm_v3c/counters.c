@@ -0,0 +1,136 @@
+#include <string.h>
+#include <stdio.h>
+
+#include "memory_map.h"
+#include "rftimer.h"
+#include "telemetry.h"
+#include "counters.h"
+
+//=========================== defines =========================================
+
+#define COUNTERS_RFTIMER_COMPAREID  2
+// shortest window, a compare set any closer could be passed before it is armed
+// and would only match after the RF timer wraps
+#define COUNTERS_MIN_DURATION_TICKS 5
+
+//=========================== variables =======================================
+
+typedef struct {
+    counters_cbt            cb;
+    counters_snapshot_t     snapshot;
+    uint32_t                start_tick;
+    volatile bool           busy;
+} counters_vars_t;
+
+counters_vars_t counters_vars;
+
+//=========================== prototypes ======================================
+
+void counters_window_end(void);
+
+//=========================== public ==========================================
+
+/* Resets and enables all counters, then stops them DURATION_TICKS RF timer
+ * ticks later from the RF timer compare interrupt. The snapshot is passed
+ * to CB (which may be NULL) from interrupt context. Windows shorter than
+ * COUNTERS_MIN_DURATION_TICKS are lengthened to it. Returns false if a
+ * measurement is already running.
+ */
+bool counters_start(uint32_t duration_ticks, counters_cbt cb) {
+    if (counters_vars.busy) {
+        return false;
+    }
+    if (duration_ticks < COUNTERS_MIN_DURATION_TICKS) {
+        duration_ticks = COUNTERS_MIN_DURATION_TICKS;
+    }
+    
+    counters_vars.cb   = cb;
+    counters_vars.busy = true;
+    
+    rftimer_set_callback(counters_window_end, COUNTERS_RFTIMER_COMPAREID);
+    
+    counters_restart();
+    rftimer_setCompareIn(counters_vars.start_tick + duration_ticks, COUNTERS_RFTIMER_COMPAREID);
+    
+    return true;
+}
+
+bool counters_busy(void) {
+    return counters_vars.busy;
+}
+
+/* Synchronous version of counters_start(). Sleeps until the window is over
+ * when called from the main loop. From inside an ISR the compare interrupt
+ * cannot preempt us, so the RF timer is polled instead, and a window started
+ * with counters_start() can't be waited for: the snapshot is zeroed and it
+ * returns false rather than resetting the counters under it.
+ */
+bool counters_measure(uint32_t duration_ticks, counters_snapshot_t* snapshot) {
+    if (ICSR & ICSR_VECTACTIVE) {
+        if (counters_vars.busy) {
+            memset(snapshot, 0, sizeof(counters_snapshot_t));
+            return false;
+        }
+        counters_restart();
+        while (rftimer_readCounter() - counters_vars.start_tick < duration_ticks);
+        counters_stop(snapshot);
+        return true;
+    }
+    
+    while (!counters_start(duration_ticks, NULL)) {
+        HAL_IDLE();
+    }
+    
+    // interrupts stay masked between the check and the sleep so the compare
+    // can't slip in between, a pending interrupt still wakes up WFI
+    HAL_DISABLE_INTERRUPTS();
+    while (counters_vars.busy) {
+        HAL_WAIT_FOR_INTERRUPT();
+        HAL_ENABLE_INTERRUPTS();
+        HAL_DISABLE_INTERRUPTS();
+    }
+    HAL_ENABLE_INTERRUPTS();
+    
+    memcpy(snapshot, &counters_vars.snapshot, sizeof(counters_snapshot_t));
+    return true;
+}
+
+// Resets and enables all counters, starting a window that ends at counters_stop()
+void counters_restart(void) {
+    ANALOG_CFG_REG__0 = COUNTERS_RESET;
+    ANALOG_CFG_REG__0 = COUNTERS_ENABLE;
+    counters_vars.start_tick = rftimer_readCounter();
+}
+
+// Disables all counters and reads them along with the ticks since counters_restart()
+void counters_stop(counters_snapshot_t* snapshot) {
+    ANALOG_CFG_REG__0 = COUNTERS_DISABLE;
+    snapshot->elapsed_ticks = rftimer_readCounter() - counters_vars.start_tick;
+    
+    snapshot->count_32k     = COUNTER_REG__32K_LSB    + (COUNTER_REG__32K_MSB    << 16);
+    snapshot->count_2M      = COUNTER_REG__2M_LSB     + (COUNTER_REG__2M_MSB     << 16);
+    snapshot->count_HF      = COUNTER_REG__HF_LSB     + (COUNTER_REG__HF_MSB     << 16);
+    snapshot->count_LC_div  = COUNTER_REG__LC_DIV_LSB + (COUNTER_REG__LC_DIV_MSB << 16);
+    snapshot->count_IF      = COUNTER_REG__IF_LSB     + (COUNTER_REG__IF_MSB     << 16);
+}
+
+/* Sends SNAPSHOT on the counters channel, the six words of counters_snapshot_t
+ * little endian as they are in memory. Returns false if it was dropped.
+ */
+bool counters_send(const counters_snapshot_t* snapshot) {
+    return telemetry_send(TELEMETRY_CHANNEL_COUNTERS, (const uint8_t*) snapshot, sizeof(counters_snapshot_t));
+}
+
+//=========================== private =========================================
+
+void counters_window_end(void) {
+    counters_stop(&counters_vars.snapshot);
+    
+    // one shot, don't fire again when the RF timer wraps around
+    RFTIMER_REG__COMPARE2_CONTROL = 0x0;
+    counters_vars.busy = false;
+    
+    if (counters_vars.cb != NULL) {
+        counters_vars.cb(&counters_vars.snapshot);
+    }
+}
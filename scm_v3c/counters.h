@@ -0,0 +1,34 @@
+#ifndef __COUNTERS_H
+#define __COUNTERS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+//=========================== typedef =========================================
+
+// Counts of all five clock counters over one measurement window
+typedef struct {
+    uint32_t count_32k;
+    uint32_t count_2M;
+    uint32_t count_HF;
+    uint32_t count_LC_div;
+    uint32_t count_IF;
+    uint32_t elapsed_ticks; // RF timer ticks the counters actually ran for
+} counters_snapshot_t;
+
+typedef void (*counters_cbt)(const counters_snapshot_t* snapshot);
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+bool counters_start(uint32_t duration_ticks, counters_cbt cb);
+bool counters_busy(void);
+bool counters_measure(uint32_t duration_ticks, counters_snapshot_t* snapshot);
+void counters_restart(void);
+void counters_stop(counters_snapshot_t* snapshot);
+bool counters_send(const counters_snapshot_t* snapshot);
+
+#endif
@@ -0,0 +1,307 @@
+/**
+\brief Fixed point arithmetic in 32-bit Q formats.
+
+A fix_t holds a value times 2^q. The functions take Q as an argument, so the
+same code handles the Q10 clock ratios, Q16 filter coefficients and Q28
+angles. Results that don't fit are saturated to FIX_MIN or FIX_MAX instead of
+wrapping.
+
+The Cortex-M0 only has a 32x32->32 multiply and no divide, and the compiler's
+64-bit multiply and divide are library calls. Products are therefore built
+from 16x16->32 partial products. Division multiplies by a Newton-Raphson
+reciprocal and then corrects the quotient with one exact multiply, so the
+result is the same as an exact 64-bit divide. 64-bit integers only ever
+see adds, compares and shifts, which compile to a few instructions.
+*/
+
+#include <stdbool.h>
+
+#include "fixed_point.h"
+
+//=========================== defines =========================================
+
+// trig polynomials are evaluated with pi/2 in this format
+#define FIX_TRIG_Q          29
+#define FIX_TRIG_PI         FIX_CONST(3.14159265358979324, FIX_TRIG_Q)
+
+// linear seed of the reciprocal, 48/17 - 32/17*d with d in [0.5, 1), in Q30
+#define FIX_RECIP_SEED_C0   3031741621u
+#define FIX_RECIP_SEED_C1   2021161080u
+// each Newton-Raphson step doubles the 4 correct bits of the seed
+#define FIX_RECIP_STEPS     3
+
+//=========================== variables =======================================
+
+// 1/(k*(k+1)) for the Taylor terms of sin up to x^13, in FIX_TRIG_Q
+static const fix_t fix_sin_terms[] = {
+    FIX_CONST(1.0 / 6,   FIX_TRIG_Q),
+    FIX_CONST(1.0 / 20,  FIX_TRIG_Q),
+    FIX_CONST(1.0 / 42,  FIX_TRIG_Q),
+    FIX_CONST(1.0 / 72,  FIX_TRIG_Q),
+    FIX_CONST(1.0 / 110, FIX_TRIG_Q),
+    FIX_CONST(1.0 / 156, FIX_TRIG_Q)
+};
+
+//=========================== prototypes ======================================
+
+uint32_t fix_abs(int32_t a);
+fix_t    fix_saturate(uint64_t magnitude, bool negative);
+uint64_t fix_umull(uint32_t a, uint32_t b);
+uint8_t  fix_clz(uint32_t x);
+uint32_t fix_reciprocal(uint32_t d);
+uint64_t fix_udiv(uint32_t n, uint32_t d, uint8_t q);
+fix_t    fix_trig_const(fix_t c, uint8_t q);
+fix_t    fix_sin_reduced(fix_t x, uint8_t q);
+
+//=========================== public ==========================================
+
+fix_t fix_add_sat(fix_t a, fix_t b) {
+    fix_t sum;
+
+    sum = (fix_t) ((uint32_t) a + (uint32_t) b);
+    // overflow when both have the same sign and the sum has the other one
+    if (((a ^ sum) & (b ^ sum)) < 0) {
+        return (a < 0) ? FIX_MIN : FIX_MAX;
+    }
+    return sum;
+}
+
+fix_t fix_sub_sat(fix_t a, fix_t b) {
+    fix_t diff;
+
+    diff = (fix_t) ((uint32_t) a - (uint32_t) b);
+    if (((a ^ b) & (a ^ diff)) < 0) {
+        return (a < 0) ? FIX_MIN : FIX_MAX;
+    }
+    return diff;
+}
+
+// Full 64-bit product, for sums of products that are scaled once at the end
+int64_t fix_mul64(int32_t a, int32_t b) {
+    int64_t product;
+
+    product = (int64_t) fix_umull(fix_abs(a), fix_abs(b));
+    return ((a < 0) != (b < 0)) ? -product : product;
+}
+
+// A * B, both in Q
+fix_t fix_mul(fix_t a, fix_t b, uint8_t q) {
+    uint64_t product;
+
+    product = fix_umull(fix_abs(a), fix_abs(b));
+#if FIX_ROUNDING
+    if (q > 0) {
+        product += (uint64_t) 1 << (q - 1);
+    }
+#endif
+    return fix_saturate(product >> q, (a < 0) != (b < 0));
+}
+
+// A / B, both in Q. Dividing by 0 saturates toward the sign of A.
+fix_t fix_div(fix_t a, fix_t b, uint8_t q) {
+    if (a == 0) {
+        return 0;
+    }
+    if (b == 0) {
+        return (a < 0) ? FIX_MIN : FIX_MAX;
+    }
+    return fix_saturate(fix_udiv(fix_abs(a), fix_abs(b), q), (a < 0) != (b < 0));
+}
+
+// Square root of A in Q, 0 for A <= 0
+fix_t fix_sqrt(fix_t a, uint8_t q) {
+    uint64_t radicand, root, bit;
+
+    if (a <= 0) {
+        return 0;
+    }
+
+    // digit by digit on A * 2^q, the root comes out in Q
+    radicand = (uint64_t) a << q;
+    root = 0;
+    bit = (uint64_t) 1 << 62;
+    while (bit > radicand) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (radicand >= root + bit) {
+            radicand -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+#if FIX_ROUNDING
+    // (root + 1/2)^2 = root^2 + root + 1/4, so round up past a remainder of root
+    if (radicand > root) {
+        root++;
+    }
+#endif
+    return (fix_t) root;
+}
+
+// Sine of ANGLE radians in Q, Q up to FIX_TRIG_MAX_Q
+fix_t fix_sin(fix_t angle, uint8_t q) {
+    uint32_t x, pi;
+    bool     negative;
+
+    pi = (uint32_t) fix_trig_const(FIX_TRIG_PI, q);
+
+    // sin is odd, reduce |angle| to [0, pi/2]
+    negative = angle < 0;
+    x = fix_abs(angle) % (2 * pi);
+    if (x > pi) {
+        x -= pi;
+        negative = !negative;
+    }
+    if (x > pi / 2) {
+        x = pi - x;
+    }
+
+    x = (uint32_t) fix_sin_reduced((fix_t) x, q);
+    return negative ? -(fix_t) x : (fix_t) x;
+}
+
+// Cosine of ANGLE radians in Q, Q up to FIX_TRIG_MAX_Q
+fix_t fix_cos(fix_t angle, uint8_t q) {
+    uint32_t x, pi;
+
+    pi = (uint32_t) fix_trig_const(FIX_TRIG_PI, q);
+
+    // cos is even, reduce |angle| to [0, pi] and take sin(pi/2 - x)
+    x = fix_abs(angle) % (2 * pi);
+    if (x > pi) {
+        x = 2 * pi - x;
+    }
+    return fix_sin_reduced(fix_trig_const(FIX_TRIG_PI / 2, q) - (fix_t) x, q);
+}
+
+//=========================== private =========================================
+
+uint32_t fix_abs(int32_t a) {
+    return (a < 0) ? 0u - (uint32_t) a : (uint32_t) a;
+}
+
+fix_t fix_saturate(uint64_t magnitude, bool negative) {
+    if (negative) {
+        if (magnitude > 0x80000000u) {
+            return FIX_MIN;
+        }
+        return (fix_t) (0u - (uint32_t) magnitude);
+    }
+    if (magnitude > 0x7FFFFFFFu) {
+        return FIX_MAX;
+    }
+    return (fix_t) magnitude;
+}
+
+uint64_t fix_umull(uint32_t a, uint32_t b) {
+    uint32_t a_lo, a_hi, b_lo, b_hi;
+    uint32_t lo_lo, lo_hi, hi_lo, hi_hi, middle;
+
+    a_lo = a & 0xFFFF;
+    a_hi = a >> 16;
+    b_lo = b & 0xFFFF;
+    b_hi = b >> 16;
+
+    lo_lo = a_lo * b_lo;
+    lo_hi = a_lo * b_hi;
+    hi_lo = a_hi * b_lo;
+    hi_hi = a_hi * b_hi;
+
+    // bits 16..47, three 16-bit terms can't overflow
+    middle = (lo_lo >> 16) + (lo_hi & 0xFFFF) + (hi_lo & 0xFFFF);
+
+    return ((uint64_t) (hi_hi + (lo_hi >> 16) + (hi_lo >> 16) + (middle >> 16)) << 32) |
+           ((middle << 16) | (lo_lo & 0xFFFF));
+}
+
+// leading zeros of X, 32 for 0, there is no CLZ on the M0
+uint8_t fix_clz(uint32_t x) {
+    uint8_t n;
+
+    if (x == 0) {
+        return 32;
+    }
+    n = 0;
+    if ((x & 0xFFFF0000) == 0) { n += 16; x <<= 16; }
+    if ((x & 0xFF000000) == 0) { n +=  8; x <<=  8; }
+    if ((x & 0xF0000000) == 0) { n +=  4; x <<=  4; }
+    if ((x & 0xC0000000) == 0) { n +=  2; x <<=  2; }
+    if ((x & 0x80000000) == 0) { n +=  1; }
+    return n;
+}
+
+// 2^62 / D for D with bit 31 set, i.e. 1/d for d = D/2^32 in [0.5, 1), in Q30
+uint32_t fix_reciprocal(uint32_t d) {
+    uint32_t x, t;
+    uint8_t  i;
+
+    x = FIX_RECIP_SEED_C0 - (uint32_t) (fix_umull(FIX_RECIP_SEED_C1, d) >> 32);
+    for (i = 0; i < FIX_RECIP_STEPS; i++) {
+        // x = x * (2 - d*x)
+        t = (uint32_t) (fix_umull(d, x) >> 32);
+        x = (uint32_t) (fix_umull(x, 0x80000000u - t) >> 30);
+    }
+    return x;
+}
+
+// N * 2^q / D, more than 0x80000000 when it won't fit
+uint64_t fix_udiv(uint32_t n, uint32_t d, uint8_t q) {
+    uint64_t numerator, quotient;
+    int64_t  remainder;
+    uint8_t  n_shift, d_shift, shift;
+
+    // normalized N/D times the Q30 reciprocal is the quotient times 2^shift
+    n_shift = fix_clz(n);
+    d_shift = fix_clz(d);
+    shift = 62 + n_shift - d_shift - q;
+    if (shift <= 30) {
+        return (uint64_t) 1 << 32;
+    }
+    if (shift >= 64) {
+        quotient = 0;
+    } else {
+        quotient = fix_umull(n << n_shift, fix_reciprocal(d << d_shift)) >> shift;
+    }
+
+    // the estimate is off by a few, fix it with the exact remainder
+    numerator = (uint64_t) n << q;
+    remainder = (int64_t) (numerator - fix_umull((uint32_t) quotient, d));
+    while (remainder < 0) {
+        quotient--;
+        remainder += d;
+    }
+    while (remainder >= (int64_t) d) {
+        quotient++;
+        remainder -= d;
+    }
+#if FIX_ROUNDING
+    if (2 * (uint64_t) remainder >= d) {
+        quotient++;
+    }
+#endif
+    return quotient;
+}
+
+// C from FIX_TRIG_Q to Q, rounded
+fix_t fix_trig_const(fix_t c, uint8_t q) {
+    return (c + (FIX_ONE(FIX_TRIG_Q - 1 - q))) >> (FIX_TRIG_Q - q);
+}
+
+// sin(X) for X in Q within [-pi/2, pi/2], by Taylor series up to x^13
+fix_t fix_sin_reduced(fix_t x, uint8_t q) {
+    fix_t x2, sum;
+    int8_t i;
+
+    x *= FIX_ONE(FIX_TRIG_Q - q);
+    x2 = fix_mul(x, x, FIX_TRIG_Q);
+
+    // x * (1 - x^2/(2*3) * (1 - x^2/(4*5) * (1 - ...)))
+    sum = FIX_ONE(FIX_TRIG_Q);
+    for (i = sizeof(fix_sin_terms) / sizeof(fix_sin_terms[0]) - 1; i >= 0; i--) {
+        sum = FIX_ONE(FIX_TRIG_Q) - fix_mul(fix_mul(x2, fix_sin_terms[i], FIX_TRIG_Q), sum, FIX_TRIG_Q);
+    }
+    return fix_trig_const(fix_mul(x, sum, FIX_TRIG_Q), q);
+}
@@ -0,0 +1,49 @@
+#ifndef __FIXED_POINT_H
+#define __FIXED_POINT_H
+
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+// 1 rounds the results of fix_mul(), fix_div() and fix_sqrt() to nearest,
+// 0 truncates them, which saves a few instructions per call
+#define FIX_ROUNDING        1
+
+#define FIX_MAX             ((fix_t) 0x7FFFFFFF)
+#define FIX_MIN             ((fix_t) -0x7FFFFFFF - 1)
+
+// Q is the number of fractional bits, from 0 to 30
+#define FIX_ONE(q)          ((fix_t) 1 << (q))
+
+// Converts a floating point constant, folded by the compiler so no floating
+// point reaches the image. Only use it with constant X.
+#define FIX_CONST(x, q)     ((fix_t) ((x) * (double) (1uL << (q)) + ((x) < 0 ? -0.5 : 0.5)))
+
+#define FIX_FROM_INT(i, q)  ((fix_t) (i) * FIX_ONE(q))
+// rounded down
+#define FIX_TO_INT(f, q)    ((int32_t) ((f) >> (q)))
+// rounded to nearest, halves up
+#define FIX_ROUND(f, q)     ((int32_t) (((f) + (FIX_ONE(q) >> 1)) >> (q)))
+#define FIX_CONVERT(f, from_q, to_q) \
+    ((to_q) >= (from_q) ? (fix_t) ((f) * FIX_ONE((to_q) - (from_q))) : (fix_t) ((f) >> ((from_q) - (to_q))))
+
+// fix_sin() and fix_cos() take radians with Q up to FIX_TRIG_MAX_Q, so 2*pi fits
+#define FIX_TRIG_MAX_Q      28
+#define FIX_PI(q)           FIX_CONST(3.14159265358979324, q)
+
+//=========================== typedef =========================================
+
+typedef int32_t fix_t;
+
+//=========================== prototypes ======================================
+
+fix_t   fix_add_sat(fix_t a, fix_t b);
+fix_t   fix_sub_sat(fix_t a, fix_t b);
+int64_t fix_mul64(int32_t a, int32_t b);
+fix_t   fix_mul(fix_t a, fix_t b, uint8_t q);
+fix_t   fix_div(fix_t a, fix_t b, uint8_t q);
+fix_t   fix_sqrt(fix_t a, uint8_t q);
+fix_t   fix_sin(fix_t angle, uint8_t q);
+fix_t   fix_cos(fix_t angle, uint8_t q);
+
+#endif
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include "optical.h" 
  
 // ISRs for external interrupts
@@ -0,0 +1,174 @@
+/**
+\brief Replays precomputed GPIO output words from RF timer compares.
+
+A segment is a buffer of words for GPIO_REG__OUTPUT, optionally with the RF
+timer ticks to wait after each one. Each step is a single store of the next
+word, with no read-modify-write. The words therefore hold every output,
+including pins that are not part of the pattern, such as the IMU chip
+select.
+
+Segments are double buffered. While one plays, the producer can queue the
+next, and it starts on the deadline right after the last step of the
+current one. The callback passed to gpio_sequencer_init() runs from the
+interrupt each time a segment is done, so it can queue the one after. The
+deadlines accumulate like those of waveform.c, so the rate does not
+drift. A sequencer that runs out of segments stops and counts it; the
+next gpio_sequencer_queue() starts it again.
+*/
+
+#include <string.h>
+
+#include "memory_map.h"
+#include "rftimer.h"
+#include "gpio_sequencer.h"
+
+//=========================== defines =========================================
+
+#define GPIO_SEQUENCER_RFTIMER_COMPAREID    6
+
+// a compare closer than this to the counter might be missed
+#define GPIO_SEQUENCER_MIN_ADVANCE_TICKS    5
+
+//=========================== variables =======================================
+
+typedef struct {
+    const uint16_t* outputs;
+    const uint16_t* delays;         // NULL for step_ticks after each word
+    uint16_t        num_steps;
+    volatile bool   full;           // set by the producer, cleared by the interrupt
+} gpio_segment_t;
+
+typedef struct {
+    gpio_segment_t      slots[GPIO_SEQUENCER_NUM_SLOTS];
+    uint8_t             fill;       // next slot to queue, only moved by the producer
+    volatile uint8_t    play;       // slot playing, only moved by the interrupt
+    uint16_t            index;      // next step of the slot playing
+    uint32_t            step_ticks;
+    uint32_t            next_tick;
+    gpio_sequencer_cbt  cb;
+    volatile bool       running;
+    volatile uint32_t   starved;    // times the sequencer ran out of segments
+} gpio_sequencer_vars_t;
+
+gpio_sequencer_vars_t gpio_sequencer_vars;
+
+//=========================== prototypes ======================================
+
+void gpio_sequencer_tick(void);
+
+//=========================== public ==========================================
+
+/* Stops the sequencer and drops the queued segments. Steps without their own
+ * delays are STEP_TICKS RF timer ticks apart. CB (which may be NULL) is
+ * called after each segment, from interrupt context unless the segment was
+ * done within gpio_sequencer_queue().
+ */
+void gpio_sequencer_init(uint32_t step_ticks, gpio_sequencer_cbt cb) {
+    gpio_sequencer_stop();
+    memset(&gpio_sequencer_vars, 0, sizeof(gpio_sequencer_vars_t));
+    gpio_sequencer_vars.step_ticks = step_ticks;
+    gpio_sequencer_vars.cb         = cb;
+
+    rftimer_set_callback(gpio_sequencer_tick, GPIO_SEQUENCER_RFTIMER_COMPAREID);
+    rftimer_set_repeat(false, GPIO_SEQUENCER_RFTIMER_COMPAREID);
+}
+
+/* Queues NUM_STEPS words of OUTPUTS, each followed by the matching entry of
+ * DELAYS in RF timer ticks, or by the step ticks if DELAYS is NULL. The
+ * buffers must stay valid until the segment is done. An idle sequencer
+ * stores the first word right away. Returns false if both slots are taken.
+ */
+bool gpio_sequencer_queue(const uint16_t* outputs, const uint16_t* delays, uint16_t num_steps) {
+    gpio_segment_t* slot;
+
+    slot = &gpio_sequencer_vars.slots[gpio_sequencer_vars.fill];
+    if (slot->full || num_steps == 0) {
+        return false;
+    }
+    slot->outputs   = outputs;
+    slot->delays    = delays;
+    slot->num_steps = num_steps;
+    // the interrupt only looks at a slot once it is full
+    slot->full      = true;
+    gpio_sequencer_vars.fill = (gpio_sequencer_vars.fill + 1) % GPIO_SEQUENCER_NUM_SLOTS;
+
+    // checked after the slot is full, a sequencer that stopped before can't see it
+    if (!gpio_sequencer_vars.running) {
+        gpio_sequencer_vars.running   = true;
+        gpio_sequencer_vars.next_tick = rftimer_readCounter();
+        gpio_sequencer_tick();
+    }
+    return true;
+}
+
+bool gpio_sequencer_busy(void) {
+    return gpio_sequencer_vars.running;
+}
+
+uint8_t gpio_sequencer_free_slots(void) {
+    uint8_t i, free_slots;
+
+    free_slots = 0;
+    for (i = 0; i < GPIO_SEQUENCER_NUM_SLOTS; i++) {
+        if (!gpio_sequencer_vars.slots[i].full) {
+            free_slots++;
+        }
+    }
+    return free_slots;
+}
+
+// Stops right away, the outputs keep the last word stored
+void gpio_sequencer_stop(void) {
+    uint8_t i;
+
+    gpio_sequencer_vars.running = false;
+    // only this compare, rftimer_disable_interrupts() would mask all of them
+    RFTIMER_REG__COMPARE_CONTROL(GPIO_SEQUENCER_RFTIMER_COMPAREID) = 0x0;
+
+    for (i = 0; i < GPIO_SEQUENCER_NUM_SLOTS; i++) {
+        gpio_sequencer_vars.slots[i].full = false;
+    }
+    gpio_sequencer_vars.fill  = 0;
+    gpio_sequencer_vars.play  = 0;
+    gpio_sequencer_vars.index = 0;
+}
+
+uint32_t gpio_sequencer_starved(void) {
+    return gpio_sequencer_vars.starved;
+}
+
+//=========================== interrupt =======================================
+
+void gpio_sequencer_tick(void) {
+    gpio_segment_t* slot;
+
+    while (gpio_sequencer_vars.running) {
+        slot = &gpio_sequencer_vars.slots[gpio_sequencer_vars.play];
+        if (!slot->full) {
+            gpio_sequencer_vars.running = false;
+            gpio_sequencer_vars.starved++;
+            RFTIMER_REG__COMPARE_CONTROL(GPIO_SEQUENCER_RFTIMER_COMPAREID) = 0x0;
+            return;
+        }
+
+        GPIO_REG__OUTPUT = slot->outputs[gpio_sequencer_vars.index];
+        gpio_sequencer_vars.next_tick += (slot->delays != NULL) ?
+            slot->delays[gpio_sequencer_vars.index] : gpio_sequencer_vars.step_ticks;
+
+        gpio_sequencer_vars.index++;
+        if (gpio_sequencer_vars.index == slot->num_steps) {
+            gpio_sequencer_vars.index = 0;
+            gpio_sequencer_vars.play  = (gpio_sequencer_vars.play + 1) % GPIO_SEQUENCER_NUM_SLOTS;
+            slot->full = false;
+            if (gpio_sequencer_vars.cb != NULL) {
+                gpio_sequencer_vars.cb();
+            }
+        }
+
+        // a deadline that already passed is played right away
+        if ((int32_t) (gpio_sequencer_vars.next_tick - rftimer_readCounter()) >= GPIO_SEQUENCER_MIN_ADVANCE_TICKS) {
+            rftimer_setCompareIn(gpio_sequencer_vars.next_tick, GPIO_SEQUENCER_RFTIMER_COMPAREID);
+            return;
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef __GPIO_SEQUENCER_H
+#define __GPIO_SEQUENCER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+// segments that can be queued, one playing and one waiting
+#define GPIO_SEQUENCER_NUM_SLOTS    2
+
+//=========================== typedef =========================================
+
+typedef void (*gpio_sequencer_cbt)(void);
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void     gpio_sequencer_init(uint32_t step_ticks, gpio_sequencer_cbt cb);
+bool     gpio_sequencer_queue(const uint16_t* outputs, const uint16_t* delays, uint16_t num_steps);
+bool     gpio_sequencer_busy(void);
+uint8_t  gpio_sequencer_free_slots(void);
+void     gpio_sequencer_stop(void);
+uint32_t gpio_sequencer_starved(void);
+
+#endif
@@ -0,0 +1,340 @@
+/**
+\brief Core of the host emulator: virtual time, event scheduler and NVIC.
+
+The event list is one slot per emu_event_t, each peripheral model owning its
+slots, and the earliest deadline is cached so the per-access cost stays low.
+Interrupts are dispatched from the access hook (i.e. between two register
+accesses of the firmware), when they get unmasked and when the firmware idles,
+never while an ISR runs since SCuM doesn't use nesting priorities.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "memory_map.h"
+#include "emu.h"
+
+//=========================== defines =========================================
+
+#define EMU_NO_EVENT        0xFFFFFFFFFFFFFFFFull
+
+#define NVIC_BASE           0xE000E100
+#define NVIC_SIZE           0x200
+#define NVIC_ISER           0xE000E100
+#define NVIC_ICER           0xE000E180
+#define NVIC_ISPR           0xE000E200
+#define NVIC_ICPR           0xE000E280
+#define SCB_ICSR            0xE000ED04
+#define SCB_AIRCR           0xE000ED0C
+
+//=========================== variables =======================================
+
+typedef void (*emu_isr_t)(void);
+
+typedef struct {
+    uint64_t        now;
+    uint64_t        event_time[EMU_NUM_EVENTS];
+    emu_event_cbt   event_cb[EMU_NUM_EVENTS];
+    uint64_t        next_event_time;
+
+    uint32_t        irq_enabled;
+    uint32_t        irq_pending;
+    bool            in_isr;
+
+    clock_t         start_clock;
+} emu_vars_t;
+
+emu_vars_t emu_vars;
+
+emu_config_t emu_config;
+emu_stats_t  emu_stats;
+
+//=========================== prototypes ======================================
+
+// the vector table of cm0dsasm.s
+void uart_rx_isr(void);
+void ext_gpio3_activehigh_debounced_isr(void);
+void optical_32_isr(void);
+void adc_isr(void);
+void radio_isr(void);
+void rftimer_isr(void);
+void rawchips_startval_isr(void);
+void rawchips_32_isr(void);
+void optical_sfd_isr(void);
+void ext_gpio8_activehigh_isr(void);
+void ext_gpio9_activelow_isr(void);
+void ext_gpio10_activelow_isr(void);
+
+void emu_advance_to(uint64_t time);
+void emu_update_next_event(void);
+bool emu_dispatch(void);
+void emu_access(void);
+void emu_idle(void);
+void emu_nvic_write(uint32_t addr, uint32_t value);
+void emu_scb_write(uint32_t addr, uint32_t value);
+
+//=========================== variables (cont.) ===============================
+
+const emu_isr_t emu_vector_table[EMU_NUM_IRQS] = {
+    uart_rx_isr,                        //  0
+    ext_gpio3_activehigh_debounced_isr, //  1
+    optical_32_isr,                     //  2
+    adc_isr,                            //  3
+    NULL,
+    NULL,
+    radio_isr,                          //  6
+    rftimer_isr,                        //  7
+    rawchips_startval_isr,              //  8
+    rawchips_32_isr,                    //  9
+    NULL,
+    optical_sfd_isr,                    // 11
+    ext_gpio8_activehigh_isr,           // 12
+    ext_gpio9_activelow_isr,            // 13
+    ext_gpio10_activelow_isr,           // 14
+};
+
+//=========================== public ==========================================
+
+// Resets the register file and attaches all peripheral models to it
+void emu_init(void) {
+    uint8_t i;
+
+    memset(&emu_vars, 0, sizeof(emu_vars_t));
+    memset(&emu_stats, 0, sizeof(emu_stats_t));
+    for (i = 0; i < EMU_NUM_EVENTS; i++) {
+        emu_vars.event_time[i] = EMU_NO_EVENT;
+    }
+    emu_vars.next_event_time = EMU_NO_EVENT;
+    emu_vars.start_clock     = clock();
+
+    hal_reset();
+    hal_set_hooks(NVIC_BASE, NVIC_SIZE, NULL, emu_nvic_write);
+    hal_set_hooks(SCB_AIRCR, 4, NULL, emu_scb_write);
+    hal_set_access_hook(emu_access);
+    hal_set_idle_hook(emu_idle);
+
+    emu_rftimer_init();
+    emu_radio_init();
+    emu_analog_init();
+    emu_io_init();
+}
+
+uint64_t emu_now(void) {
+    return emu_vars.now;
+}
+
+void emu_set_event_callback(emu_event_t event, emu_event_cbt cb) {
+    emu_vars.event_cb[event] = cb;
+}
+
+// Replaces any earlier deadline of EVENT
+void emu_schedule(emu_event_t event, uint64_t at) {
+    if (at < emu_vars.now) {
+        at = emu_vars.now;
+    }
+    if (emu_vars.event_time[event] == emu_vars.next_event_time) {
+        emu_vars.event_time[event] = at;
+        emu_update_next_event();
+    } else {
+        emu_vars.event_time[event] = at;
+        if (at < emu_vars.next_event_time) {
+            emu_vars.next_event_time = at;
+        }
+    }
+}
+
+void emu_cancel(emu_event_t event) {
+    emu_vars.event_time[event] = EMU_NO_EVENT;
+    emu_update_next_event();
+}
+
+bool emu_scheduled(emu_event_t event) {
+    return emu_vars.event_time[event] != EMU_NO_EVENT;
+}
+
+void emu_irq_set_pending(uint8_t irq) {
+    emu_vars.irq_pending |= 1u << irq;
+}
+
+bool emu_irq_enabled(uint8_t irq) {
+    return (emu_vars.irq_enabled & (1u << irq)) != 0;
+}
+
+// Prints the run summary and leaves
+void emu_finish(int status) {
+    double host_s, virtual_s;
+    uint8_t i;
+
+    fflush(stdout);
+
+    host_s    = (double)(clock() - emu_vars.start_clock) / CLOCKS_PER_SEC;
+    virtual_s = (double) emu_vars.now / EMU_NS_PER_S;
+
+    fprintf(stderr, "\n== emulator summary\n");
+    fprintf(stderr, "virtual time      %.3f s (%.1f%% idle)\n",
+        virtual_s, virtual_s > 0 ? 100.0 * emu_stats.idle_ns / emu_vars.now : 0.0);
+    fprintf(stderr, "host time         %.3f s (%.0fx real time)\n",
+        host_s, host_s > 0 ? virtual_s / host_s : 0.0);
+    fprintf(stderr, "register accesses %llu\n", (unsigned long long) emu_stats.accesses);
+    fprintf(stderr, "tx frames         %u (%u heard on channel 11)\n",
+        emu_stats.tx_frames, emu_stats.tx_frames_heard);
+    fprintf(stderr, "rx frames         %u of %u injected\n",
+        emu_stats.rx_frames, emu_stats.rx_injected);
+    fprintf(stderr, "scan chain loads  %u\n", emu_stats.scan_chain_loads);
+    fprintf(stderr, "gpio writes       %u\n", emu_stats.gpio_writes);
+    for (i = 0; i < EMU_NUM_IRQS; i++) {
+        if (emu_stats.isr_count[i] != 0) {
+            fprintf(stderr, "irq %-2u            %u\n", i, emu_stats.isr_count[i]);
+        }
+    }
+
+    exit(status);
+}
+
+// Diagnostics of the models, timestamped and kept apart from the firmware's printf
+void emu_log(const char* format, ...) {
+    va_list args;
+
+    fflush(stdout);
+    fprintf(stderr, "[%11.6f] ", (double) emu_vars.now / EMU_NS_PER_S);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+//=========================== private =========================================
+
+// Moves virtual time forward, firing every event that falls due on the way
+void emu_advance_to(uint64_t time) {
+    uint8_t i;
+
+    while (emu_vars.next_event_time <= time) {
+        emu_vars.now = emu_vars.next_event_time;
+
+        for (i = 0; i < EMU_NUM_EVENTS; i++) {
+            if (emu_vars.event_time[i] == emu_vars.now) {
+                emu_vars.event_time[i] = EMU_NO_EVENT;
+                emu_vars.event_cb[i]((emu_event_t) i);
+            }
+        }
+        emu_update_next_event();
+    }
+
+    if (time > emu_vars.now) {
+        emu_vars.now = time;
+    }
+
+    if (emu_vars.now >= emu_config.duration_ns) {
+        emu_log("time limit reached");
+        emu_finish(0);
+    }
+}
+
+void emu_update_next_event(void) {
+    uint8_t i;
+
+    emu_vars.next_event_time = EMU_NO_EVENT;
+    for (i = 0; i < EMU_NUM_EVENTS; i++) {
+        if (emu_vars.event_time[i] < emu_vars.next_event_time) {
+            emu_vars.next_event_time = emu_vars.event_time[i];
+        }
+    }
+}
+
+// Runs the lowest numbered enabled and pending interrupt, returns false if none can run
+bool emu_dispatch(void) {
+    uint32_t runnable;
+    uint8_t  irq;
+
+    if (emu_vars.in_isr || !hal_interrupts_enabled()) {
+        return false;
+    }
+
+    runnable = emu_vars.irq_pending & emu_vars.irq_enabled;
+    if (runnable == 0) {
+        return false;
+    }
+
+    for (irq = 0; (runnable & (1u << irq)) == 0; irq++);
+    emu_vars.irq_pending &= ~(1u << irq);
+    emu_stats.isr_count[irq]++;
+
+    if (emu_vector_table[irq] == NULL) {
+        return true;
+    }
+
+    // the handlers in cm0dsasm.s run with PRIMASK set
+    emu_vars.in_isr = true;
+    hal_poke(SCB_ICSR, 16 + irq);
+    hal_set_interrupts_enabled(0);
+
+    emu_vector_table[irq]();
+
+    hal_sync();
+    hal_poke(SCB_ICSR, 0);
+    hal_set_interrupts_enabled(1);
+    emu_vars.in_isr = false;
+
+    return true;
+}
+
+// Access hook: every register access takes a bit of time, and may be preempted
+void emu_access(void) {
+    emu_stats.accesses++;
+    emu_advance_to(emu_vars.now + EMU_NS_PER_ACCESS);
+    while (emu_dispatch());
+}
+
+// Idle hook: sleep until an interrupt is pending, running it if not masked
+void emu_idle(void) {
+    while (1) {
+        if (emu_dispatch()) {
+            while (emu_dispatch());
+            break;
+        }
+        if (emu_vars.irq_pending & emu_vars.irq_enabled) {
+            // masked, WFI still wakes up
+            break;
+        }
+        if (emu_vars.next_event_time == EMU_NO_EVENT) {
+            emu_log("firmware idle with nothing left to wake it up");
+            emu_finish(0);
+        }
+        emu_stats.idle_ns += emu_vars.next_event_time - emu_vars.now;
+        emu_advance_to(emu_vars.next_event_time);
+    }
+}
+
+// ISER/ICER/ISPR/ICPR are write-one-to-act, consumed like strobes
+void emu_nvic_write(uint32_t addr, uint32_t value) {
+    switch (addr) {
+        case NVIC_ISER:
+            emu_vars.irq_enabled |= value;
+            emu_io_irq_enabled(value);
+            break;
+        case NVIC_ICER:
+            emu_vars.irq_enabled &= ~value;
+            break;
+        case NVIC_ISPR:
+            emu_vars.irq_pending |= value;
+            break;
+        case NVIC_ICPR:
+            emu_vars.irq_pending &= ~value;
+            break;
+        default:
+            // priorities, not modeled
+            return;
+    }
+    hal_poke(addr, 0);
+}
+
+void emu_scb_write(uint32_t addr, uint32_t value) {
+    if (value == AIRCR_SYSRESETREQ) {
+        emu_log("soft reset requested");
+        emu_finish(0);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef __EMU_H
+#define __EMU_H
+
+/**
+\brief Host emulator of the SCuM v3c peripherals.
+
+Runs an unmodified application (built with -Dmain=app_main) against models of
+the RF controller, RF timer, analog counters, scan chain, GPIO, UART and ADC
+hooked into the register file of hal_host.c. Time is virtual: every register
+access costs EMU_NS_PER_ACCESS, and when the firmware waits for an interrupt
+(HAL_WAIT_FOR_INTERRUPT() or HAL_IDLE()) time jumps straight to the next
+scheduled peripheral event, so hours of sweeping run in seconds.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+#define EMU_NS_PER_US               1000ull
+#define EMU_NS_PER_MS               1000000ull
+#define EMU_NS_PER_S                1000000000ull
+
+#define EMU_NS_PER_ACCESS           100     // one register access at HCLK ~10MHz
+#define EMU_NS_PER_RFTIMER_TICK     2000    // 500kHz
+
+#define EMU_NUM_IRQS                32
+
+// NVIC lines, see the vector table in cm0dsasm.s
+#define EMU_IRQ_UART                0
+#define EMU_IRQ_EXT_GPIO3           1
+#define EMU_IRQ_OPTICAL_32          2
+#define EMU_IRQ_ADC                 3
+#define EMU_IRQ_RADIO               6
+#define EMU_IRQ_RFTIMER             7
+#define EMU_IRQ_RAWCHIPS_STARTVAL   8
+#define EMU_IRQ_RAWCHIPS_32         9
+#define EMU_IRQ_OPTICAL_SFD         11
+#define EMU_IRQ_EXT_GPIO8           12
+#define EMU_IRQ_EXT_GPIO9           13
+#define EMU_IRQ_EXT_GPIO10          14
+
+//=========================== typedef =========================================
+
+typedef enum {
+    EMU_EVENT_RFTIMER_COMPARE0  = 0,    // one per compare, 0-7
+    EMU_EVENT_RADIO             = 8,
+    EMU_EVENT_RADIO_INJECT      = 9,
+    EMU_EVENT_OPTICAL           = 10,
+    EMU_EVENT_UART_RX           = 11,
+    EMU_EVENT_ADC               = 12,
+    EMU_NUM_EVENTS              = 13
+} emu_event_t;
+
+typedef void (*emu_event_cbt)(emu_event_t event);
+
+typedef struct {
+    uint64_t        duration_ns;        // stop after this much virtual time
+    uint64_t        rx_period_ns;       // period of injected RX frames, 0 for none
+    uint8_t         rx_crc_error_pct;   // share of injected frames with a bad CRC
+    const char*     uart_input;         // injected on the UART once the app starts
+    bool            verbose;            // log every frame on the air
+    const char*     config_block;       // file copied into the config block of the image
+
+    // process offsets of the emulated chip, what optical calibration corrects
+    double          hf_offset;          // relative
+    double          rc2m_offset;        // relative
+    double          if_offset;          // relative
+    double          lc_offset_hz;
+    uint32_t        adc_value;
+} emu_config_t;
+
+typedef struct {
+    uint64_t        accesses;
+    uint64_t        idle_ns;
+    uint32_t        isr_count[EMU_NUM_IRQS];
+    uint32_t        tx_frames;
+    uint32_t        tx_frames_heard;    // by the reference receiver on channel 11
+    uint32_t        rx_injected;
+    uint32_t        rx_frames;
+    uint32_t        scan_chain_loads;
+    uint32_t        gpio_writes;
+} emu_stats_t;
+
+//=========================== variables =======================================
+
+extern emu_config_t emu_config;
+extern emu_stats_t  emu_stats;
+
+//=========================== prototypes ======================================
+
+// core, emu.c
+void        emu_init(void);
+uint64_t    emu_now(void);
+void        emu_set_event_callback(emu_event_t event, emu_event_cbt cb);
+void        emu_schedule(emu_event_t event, uint64_t at);
+void        emu_cancel(emu_event_t event);
+bool        emu_scheduled(emu_event_t event);
+void        emu_irq_set_pending(uint8_t irq);
+bool        emu_irq_enabled(uint8_t irq);
+void        emu_finish(int status);
+void        emu_log(const char* format, ...);
+
+// RF timer, emu_rftimer.c
+void        emu_rftimer_init(void);
+uint32_t    emu_rftimer_counter(void);
+void        emu_rftimer_capture_pulse(uint32_t input_sel);
+
+// RF controller, emu_radio.c
+void        emu_radio_init(void);
+void        emu_radio_strobe(uint32_t control);
+void        emu_radio_start_injection(void);
+
+// analog configuration, counters and scan chain, emu_analog.c
+void        emu_analog_init(void);
+double      emu_analog_lo_freq(void);
+void        emu_analog_set_if_estimate(uint32_t estimate);
+const uint32_t* emu_analog_scan_chain(void);
+
+// GPIO, UART, ADC and optical programmer, emu_io.c
+void        emu_io_init(void);
+void        emu_io_set_gpio_input(uint32_t value);
+void        emu_io_irq_enabled(uint32_t mask);
+
+#endif
@@ -0,0 +1,297 @@
+/**
+\brief Analog configuration model: clock counters, scan chain and LO.
+
+Several ANALOG_CFG_REG addresses read back chip status rather than what was
+written (see COUNTER_REG__* in memory_map.h); the written values are kept here
+and the register file holds the readback. Since hal_host.c only reports writes
+that change a register, writing the value a readback register currently reads
+goes unnoticed. The clock frequencies follow the
+tuning codes latched in the scan chain (and the LO code in ANALOG_CFG_REG__7/8)
+with step sizes taken from the optical calibration comments, plus per-chip
+offsets from emu_config so that calibration has something to correct.
+*/
+
+#include <string.h>
+
+#include "memory_map.h"
+#include "emu.h"
+
+//=========================== defines =========================================
+
+#define ANALOG_NUM_REGS         31
+#define ANALOG_SIZE             (ANALOG_NUM_REGS * 0x40000)
+
+#define SCAN_CHAIN_WORDS        38
+
+// ANALOG_CFG_REG__22 bits driving the scan chain, see analog_scan_chain_write()
+#define SCAN_IN_INVERTED        0x01
+#define SCAN_PHI2               0x04
+#define SCAN_LOAD               0x08
+
+#define IF_ESTIMATE_VALID       0x400
+#define IF_ESTIMATE_NOMINAL     500
+
+#define FREQ_32K                32768.0
+#define FREQ_HF                 20000000.0
+#define FREQ_2M                 2000000.0
+#define FREQ_IF                 16000000.0
+#define FREQ_LO                 2402500000.0
+#define LC_DIV_RATIO            960.0
+
+typedef enum {
+    COUNTER_32K = 0,
+    COUNTER_HF,
+    COUNTER_2M,
+    COUNTER_LC_DIV,
+    COUNTER_IF,
+    NUM_COUNTERS
+} emu_counter_t;
+
+//=========================== variables =======================================
+
+typedef struct {
+    uint32_t    cfg[ANALOG_NUM_REGS];       // as last written by the firmware
+    uint32_t    if_estimate;
+
+    uint32_t    shift[SCAN_CHAIN_WORDS];
+    uint32_t    latched[SCAN_CHAIN_WORDS];
+    bool        loaded;
+
+    // counts up to counting_since, plus what accumulated since at freq[]
+    double      counts[NUM_COUNTERS];
+    double      freq[NUM_COUNTERS];
+    bool        counting;
+    uint64_t    counting_since;
+} emu_analog_vars_t;
+
+emu_analog_vars_t emu_analog_vars;
+
+// readback register of each counter's LSB, the MSB follows
+const uint8_t emu_counter_lsb_reg[NUM_COUNTERS] = {0, 4, 6, 10, 12};
+
+//=========================== prototypes ======================================
+
+uint32_t emu_analog_read(uint32_t addr, uint32_t value);
+void     emu_analog_write(uint32_t addr, uint32_t value);
+void     emu_analog_scan_chain_clock(uint32_t old_value, uint32_t value);
+void     emu_analog_fold_counts(void);
+void     emu_analog_update_freqs(void);
+uint32_t emu_analog_count(emu_counter_t counter);
+uint32_t emu_analog_asc_bit(uint32_t position);
+uint32_t emu_analog_rev5(uint32_t value);
+
+//=========================== public ==========================================
+
+void emu_analog_init(void) {
+    memset(&emu_analog_vars, 0, sizeof(emu_analog_vars_t));
+    emu_analog_vars.if_estimate = IF_ESTIMATE_NOMINAL;
+    emu_analog_update_freqs();
+    hal_set_hooks(APB_ANALOG_CFG_BASE, ANALOG_SIZE, emu_analog_read, emu_analog_write);
+}
+
+// Carrier frequency for the LO code in ANALOG_CFG_REG__7/8, see LC_FREQCHANGE()
+double emu_analog_lo_freq(void) {
+    uint32_t fcode, fcode2;
+    uint32_t coarse, mid, fine;
+
+    fcode  = emu_analog_vars.cfg[7];
+    fcode2 = emu_analog_vars.cfg[8];
+
+    coarse = emu_analog_rev5(fcode & 0x1F);
+    mid    = emu_analog_rev5((fcode >> 6) & 0x1F);
+    fine   = emu_analog_rev5((((fcode >> 9) & 0x78) | ((fcode2 & 0x1) << 7)) >> 3);
+
+    // LC_monotonic() steps mid by 3 every 23 fine codes, so coarse 23 mid 3
+    // fine 18 is the centre (its default LC code 600)
+    return FREQ_LO + emu_config.lc_offset_hz
+        + ((int) coarse - 23) * 15e6
+        + ((int) mid    -  3) * 0.8e6
+        + ((int) fine   - 18) * 0.1e6;
+}
+
+// Zero-crossing count the IF estimator reports after a received frame
+void emu_analog_set_if_estimate(uint32_t estimate) {
+    emu_analog_vars.if_estimate = estimate;
+}
+
+const uint32_t* emu_analog_scan_chain(void) {
+    return emu_analog_vars.latched;
+}
+
+//=========================== private =========================================
+
+uint32_t emu_analog_read(uint32_t addr, uint32_t value) {
+    uint32_t n;
+    uint8_t  i;
+
+    n = (addr - APB_ANALOG_CFG_BASE) / 0x40000;
+    for (i = 0; i < NUM_COUNTERS; i++) {
+        if (n == emu_counter_lsb_reg[i]) {
+            return emu_analog_count(i) & 0xFFFF;
+        }
+        if (n == emu_counter_lsb_reg[i] + 1u) {
+            return emu_analog_count(i) >> 16;
+        }
+    }
+    switch (n) {
+        case 16:
+            return IF_ESTIMATE_VALID | (emu_analog_vars.if_estimate & 0x3FF);
+        case 21:    // LQI chip errors
+        case 25:    // CDR tau
+            return 0;
+        default:
+            return value;
+    }
+}
+
+void emu_analog_write(uint32_t addr, uint32_t value) {
+    uint32_t n, old_value;
+
+    n = (addr - APB_ANALOG_CFG_BASE) / 0x40000;
+    if (n >= ANALOG_NUM_REGS) {
+        return;
+    }
+    old_value = emu_analog_vars.cfg[n];
+    emu_analog_vars.cfg[n] = value;
+
+    switch (n) {
+        case 0:
+            // the 7 LSBs are active low resets, the next 7 bits enables
+            emu_analog_fold_counts();
+            if ((value & 0x7F) == 0) {
+                memset(emu_analog_vars.counts, 0, sizeof(emu_analog_vars.counts));
+            }
+            emu_analog_vars.counting = (value & 0x3F80) != 0 && (value & 0x7F) != 0;
+            break;
+        case 7:
+        case 8:
+            emu_analog_fold_counts();
+            emu_analog_update_freqs();
+            break;
+        case 22:
+            emu_analog_scan_chain_clock(old_value, value);
+            break;
+        default:
+            break;
+    }
+}
+
+// Clocks the bit-banged scan chain, see analog_scan_chain_write() and _load()
+void emu_analog_scan_chain_clock(uint32_t old_value, uint32_t value) {
+    uint32_t bit;
+    int8_t   i;
+
+    if ((value & SCAN_PHI2) && !(old_value & SCAN_PHI2)) {
+        // scan position p is ASC[p/32] bit 31-(p%32), the new bit enters at 0
+        bit = (value & SCAN_IN_INVERTED) ? 0 : 1;
+        for (i = SCAN_CHAIN_WORDS - 1; i > 0; i--) {
+            emu_analog_vars.shift[i] = (emu_analog_vars.shift[i] >> 1) |
+                                       (emu_analog_vars.shift[i - 1] << 31);
+        }
+        emu_analog_vars.shift[0] = (emu_analog_vars.shift[0] >> 1) | (bit << 31);
+    }
+
+    if ((value & SCAN_LOAD) && !(old_value & SCAN_LOAD)) {
+        emu_analog_fold_counts();
+        memcpy(emu_analog_vars.latched, emu_analog_vars.shift, sizeof(emu_analog_vars.latched));
+        emu_analog_vars.loaded = true;
+        emu_analog_update_freqs();
+        emu_stats.scan_chain_loads++;
+    }
+}
+
+// Accumulates the counts so far, before the frequencies or the counting change
+void emu_analog_fold_counts(void) {
+    double  elapsed_s;
+    uint8_t i;
+
+    if (emu_analog_vars.counting) {
+        elapsed_s = (double)(emu_now() - emu_analog_vars.counting_since) / EMU_NS_PER_S;
+        for (i = 0; i < NUM_COUNTERS; i++) {
+            emu_analog_vars.counts[i] += elapsed_s * emu_analog_vars.freq[i];
+        }
+    }
+    emu_analog_vars.counting_since = emu_now();
+}
+
+void emu_analog_update_freqs(void) {
+    uint32_t hf_coarse, hf_fine;
+    uint32_t rc2m_coarse, rc2m_fine, rc2m_superfine;
+    uint32_t if_coarse, if_fine;
+    uint32_t asc34;
+    uint8_t  j;
+
+    // power-on codes, the calibrated centre of the models below
+    hf_coarse       = 3;
+    hf_fine         = 19;
+    rc2m_coarse     = 15;
+    rc2m_fine       = 13;
+    rc2m_superfine  = 16;
+    if_coarse       = 22;
+    if_fine         = 20;
+
+    if (emu_analog_vars.loaded) {
+        // set_sys_clk_secondary_freq()
+        hf_fine   = emu_analog_asc_bit(870) | (emu_analog_asc_bit(871) << 1) |
+                    (emu_analog_asc_bit(872) << 2) | (emu_analog_asc_bit(873) << 3) |
+                    ((emu_analog_asc_bit(874) ^ 1) << 4);
+        hf_coarse = emu_analog_asc_bit(860) | (emu_analog_asc_bit(861) << 1) |
+                    ((emu_analog_asc_bit(875) ^ 1) << 2) | ((emu_analog_asc_bit(876) ^ 1) << 3) |
+                    ((emu_analog_asc_bit(877) ^ 1) << 4);
+
+        // set_2M_RC_frequency(), coarse3 is the one calibration moves
+        asc34           = emu_analog_vars.latched[34];
+        rc2m_coarse     = emu_analog_rev5((asc34 >> 16) & 0x1F);
+        rc2m_fine       = emu_analog_rev5((asc34 >> 11) & 0x1F);
+        rc2m_superfine  = emu_analog_rev5((asc34 >> 6) & 0x1F);
+
+        // set_IF_clock_frequency()
+        if_coarse = 0;
+        if_fine   = 0;
+        for (j = 0; j <= 4; j++) {
+            if_coarse |= emu_analog_asc_bit(431 - j) << j;
+            if_fine   |= emu_analog_asc_bit(437 - j) << j;
+        }
+    }
+
+    // lower codes run faster, steps are from the comments in optical_sfd_isr()
+    emu_analog_vars.freq[COUNTER_32K] = FREQ_32K;
+    emu_analog_vars.freq[COUNTER_HF]  = FREQ_HF * (1 + emu_config.hf_offset
+        - 0.003  * ((int) hf_fine - 19)
+        - 0.05   * ((int) hf_coarse - 3));
+    emu_analog_vars.freq[COUNTER_2M]  = FREQ_2M * (1 + emu_config.rc2m_offset
+        - 0.0055   * ((int) rc2m_coarse - 15)
+        - 0.00075  * ((int) rc2m_fine - 13)
+        - 0.000125 * ((int) rc2m_superfine - 16));
+    emu_analog_vars.freq[COUNTER_IF]  = FREQ_IF * (1 + emu_config.if_offset
+        - 0.0156  * ((int) if_coarse - 22)
+        - 0.00175 * ((int) if_fine - 20));
+    emu_analog_vars.freq[COUNTER_LC_DIV] = emu_analog_lo_freq() / LC_DIV_RATIO;
+}
+
+uint32_t emu_analog_count(emu_counter_t counter) {
+    double count;
+
+    count = emu_analog_vars.counts[counter];
+    if (emu_analog_vars.counting) {
+        count += (double)(emu_now() - emu_analog_vars.counting_since) / EMU_NS_PER_S *
+                 emu_analog_vars.freq[counter];
+    }
+    return (uint32_t) count;
+}
+
+uint32_t emu_analog_asc_bit(uint32_t position) {
+    return (emu_analog_vars.latched[position >> 5] >> (31 - (position & 31))) & 0x1;
+}
+
+// Reverses a 5-bit code, as flip_lsb8(code) >> 3 does
+uint32_t emu_analog_rev5(uint32_t value) {
+    uint32_t out;
+    uint8_t  j;
+
+    out = 0;
+    for (j = 0; j < 5; j++) {
+        out |= ((value >> j) & 0x1) << (4 - j);
+    }
+    return out;
+}
@@ -0,0 +1,152 @@
+/**
+\brief GPIO, UART, ADC and optical programmer models.
+
+UART_REG__TX_DATA and UART_REG__RX_DATA share an address, so a transmitted
+byte is consumed and the register put back to the last received byte, with
+bit 8 set so that the next byte written always changes the register and
+reaches the write hook (reads should only use the low 8 bits). The
+optical programmer (the Teensy during calibration) is modeled as an SFD pulse
+every 100ms, starting as soon as the firmware enables the optical SFD or the
+GPIO8 interrupt and stopping once both are disabled again.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "memory_map.h"
+#include "emu.h"
+
+//=========================== defines =========================================
+
+#define GPIO_INPUT              (APB_GPIO_BASE + 0x000000)
+#define GPIO_OUTPUT             (APB_GPIO_BASE + 0x040000)
+#define GPIO_SIZE               0x80000
+#define UART_DATA               APB_UART_BASE
+#define ADC_START               (APB_ADC_BASE + 0x000000)
+#define ADC_DATA                (APB_ADC_BASE + 0x040000)
+#define ADC_SIZE                0x80000
+
+#define UART_RX_UNWRITTEN       0x100
+#define UART_NS_PER_BYTE        (10 * EMU_NS_PER_S / 19200)    // 19200 8N1
+#define ADC_CONVERSION_NS       (20 * EMU_NS_PER_US)
+#define OPTICAL_SFD_PERIOD_NS   (100 * EMU_NS_PER_MS)
+
+#define OPTICAL_IRQ_MASK        ((1u << EMU_IRQ_OPTICAL_SFD) | (1u << EMU_IRQ_EXT_GPIO8))
+
+//=========================== variables =======================================
+
+typedef struct {
+    uint32_t    gpio_input;
+    uint8_t     uart_rx_byte;
+    const char* uart_input;
+} emu_io_vars_t;
+
+emu_io_vars_t emu_io_vars;
+
+//=========================== prototypes ======================================
+
+void emu_io_gpio_write(uint32_t addr, uint32_t value);
+void emu_io_uart_write(uint32_t addr, uint32_t value);
+void emu_io_adc_write(uint32_t addr, uint32_t value);
+void emu_io_uart_rx_event(emu_event_t event);
+void emu_io_adc_event(emu_event_t event);
+void emu_io_optical_event(emu_event_t event);
+
+//=========================== public ==========================================
+
+void emu_io_init(void) {
+    memset(&emu_io_vars, 0, sizeof(emu_io_vars_t));
+    emu_io_vars.uart_input = emu_config.uart_input;
+
+    hal_set_hooks(APB_GPIO_BASE, GPIO_SIZE, NULL, emu_io_gpio_write);
+    hal_set_hooks(APB_UART_BASE, 4, NULL, emu_io_uart_write);
+    hal_poke(UART_DATA, UART_RX_UNWRITTEN);
+    hal_set_hooks(APB_ADC_BASE, ADC_SIZE, NULL, emu_io_adc_write);
+
+    emu_set_event_callback(EMU_EVENT_UART_RX, emu_io_uart_rx_event);
+    emu_set_event_callback(EMU_EVENT_ADC, emu_io_adc_event);
+    emu_set_event_callback(EMU_EVENT_OPTICAL, emu_io_optical_event);
+
+    if (emu_io_vars.uart_input != NULL && emu_io_vars.uart_input[0] != '\0') {
+        emu_schedule(EMU_EVENT_UART_RX, UART_NS_PER_BYTE);
+    }
+}
+
+// Drives the GPIO input pins, raising the external interrupts on their edges
+void emu_io_set_gpio_input(uint32_t value) {
+    uint32_t rising, falling;
+
+    rising  =  value & ~emu_io_vars.gpio_input;
+    falling = ~value &  emu_io_vars.gpio_input;
+    emu_io_vars.gpio_input = value;
+    hal_poke(GPIO_INPUT, value);
+
+    if (rising & (1u << 3)) {
+        emu_irq_set_pending(EMU_IRQ_EXT_GPIO3);
+    }
+    if (rising & (1u << 8)) {
+        emu_irq_set_pending(EMU_IRQ_EXT_GPIO8);
+    }
+    if (falling & (1u << 9)) {
+        emu_irq_set_pending(EMU_IRQ_EXT_GPIO9);
+    }
+    if (falling & (1u << 10)) {
+        emu_irq_set_pending(EMU_IRQ_EXT_GPIO10);
+    }
+}
+
+// Called with the bits just written to ISER
+void emu_io_irq_enabled(uint32_t mask) {
+    if ((mask & OPTICAL_IRQ_MASK) && !emu_scheduled(EMU_EVENT_OPTICAL)) {
+        emu_log("optical programmer: sending calibration pulses");
+        emu_schedule(EMU_EVENT_OPTICAL, emu_now() + OPTICAL_SFD_PERIOD_NS);
+    }
+}
+
+//=========================== private =========================================
+
+void emu_io_gpio_write(uint32_t addr, uint32_t value) {
+    if (addr == GPIO_OUTPUT) {
+        emu_stats.gpio_writes++;
+    } else if (addr == GPIO_INPUT) {
+        // inputs aren't writable
+        hal_poke(GPIO_INPUT, emu_io_vars.gpio_input);
+    }
+}
+
+void emu_io_uart_write(uint32_t addr, uint32_t value) {
+    putchar((char) value);
+    hal_poke(UART_DATA, UART_RX_UNWRITTEN | emu_io_vars.uart_rx_byte);
+}
+
+void emu_io_adc_write(uint32_t addr, uint32_t value) {
+    if (addr == ADC_START) {
+        hal_poke(ADC_START, 0);
+        emu_schedule(EMU_EVENT_ADC, emu_now() + ADC_CONVERSION_NS);
+    }
+}
+
+void emu_io_uart_rx_event(emu_event_t event) {
+    emu_io_vars.uart_rx_byte = (uint8_t) *emu_io_vars.uart_input++;
+    hal_poke(UART_DATA, UART_RX_UNWRITTEN | emu_io_vars.uart_rx_byte);
+    emu_irq_set_pending(EMU_IRQ_UART);
+
+    if (*emu_io_vars.uart_input != '\0') {
+        emu_schedule(EMU_EVENT_UART_RX, emu_now() + UART_NS_PER_BYTE);
+    }
+}
+
+void emu_io_adc_event(emu_event_t event) {
+    hal_poke(ADC_DATA, emu_config.adc_value);
+    emu_irq_set_pending(EMU_IRQ_ADC);
+}
+
+// Optical bootloading, over the 3-wire bus the pulse would come on GPIO8 instead
+void emu_io_optical_event(emu_event_t event) {
+    if (!emu_irq_enabled(EMU_IRQ_OPTICAL_SFD) && !emu_irq_enabled(EMU_IRQ_EXT_GPIO8)) {
+        emu_log("optical programmer: done");
+        return;
+    }
+    emu_irq_set_pending(EMU_IRQ_OPTICAL_SFD);
+    emu_schedule(EMU_EVENT_OPTICAL, emu_now() + OPTICAL_SFD_PERIOD_NS);
+}
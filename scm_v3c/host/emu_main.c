@@ -0,0 +1,112 @@
+/**
+\brief Runs a SCuM application on the host emulator.
+
+The application is compiled with -Dmain=app_main and linked against
+libscum_host.a and the emulator, see the emu_% rule in the Makefile.
+
+  emu_<app> [-t seconds] [-r rx_period_ms] [-e crc_error_pct] [-u uart_input] [-v]
+            [-c config_block]
+
+The firmware's printf goes to stdout, the emulator's log and the summary
+printed at the end of the run to stderr.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "scm3c_hw_interface.h"
+#include "emu.h"
+
+//=========================== defines =========================================
+
+#define DEFAULT_DURATION_S      10
+
+//=========================== prototypes ======================================
+
+int  app_main(void);
+void usage(const char* name);
+int  load_config_block(const char* path);
+
+//=========================== main ============================================
+
+int main(int argc, char** argv) {
+    int opt;
+
+    emu_config.duration_ns  = DEFAULT_DURATION_S * EMU_NS_PER_S;
+    emu_config.hf_offset    =  0.004;
+    emu_config.rc2m_offset  = -0.008;
+    emu_config.if_offset    =  0.01;
+    emu_config.lc_offset_hz = -1.5e6;
+    emu_config.adc_value    = 0x1FF;
+
+    while ((opt = getopt(argc, argv, "t:r:e:u:vc:h")) != -1) {
+        switch (opt) {
+            case 't':
+                emu_config.duration_ns = (uint64_t)(atof(optarg) * EMU_NS_PER_S);
+                break;
+            case 'r':
+                emu_config.rx_period_ns = (uint64_t)(atof(optarg) * EMU_NS_PER_MS);
+                break;
+            case 'e':
+                emu_config.rx_crc_error_pct = atoi(optarg);
+                break;
+            case 'u':
+                emu_config.uart_input = optarg;
+                break;
+            case 'v':
+                emu_config.verbose = true;
+                break;
+            case 'c':
+                emu_config.config_block = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    // stdout is usually a pipe to a log parser, keep it in order with stderr
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    emu_init();
+    if (emu_config.config_block != NULL && load_config_block(emu_config.config_block) != 0) {
+        return 1;
+    }
+    emu_radio_start_injection();
+
+    app_main();
+
+    emu_log("app_main returned");
+    emu_finish(0);
+    return 0;
+}
+
+void usage(const char* name) {
+    fprintf(stderr,
+        "usage: %s [-t seconds] [-r rx_period_ms] [-e crc_error_pct] [-u uart_input] [-v]\n"
+        "          [-c config_block]\n"
+        "  -t  virtual time to run for (default %u s)\n"
+        "  -r  inject a frame on channel 11 every rx_period_ms\n"
+        "  -e  share of injected frames with a CRC error, in percent\n"
+        "  -u  characters to send to the UART\n"
+        "  -v  log every transmitted frame\n"
+        "  -c  config block to put in the image, see tools/experiment_config.py\n",
+        name, DEFAULT_DURATION_S);
+}
+
+// Copies the block as bootload.py would, the image is empty otherwise
+int load_config_block(const char* path) {
+    FILE*  f;
+    size_t len;
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    len = fread(HAL_IMAGE(IMAGE_CONFIG_ADDR), 1, IMAGE_CONFIG_HEADER_LEN + IMAGE_CONFIG_MAX_LEN, f);
+    fclose(f);
+    emu_log("config block of %u bytes from %s", (unsigned) len, path);
+    return 0;
+}
@@ -0,0 +1,278 @@
+/**
+\brief RF controller model: TX/RX state machine, DMA and interrupts.
+
+Frames go on the air at 250kbps (32us per byte) after a 5 byte preamble and
+SFD. The carrier is whatever the analog model says the LO is at when the SFD
+goes out. A reference receiver sitting on channel 11 counts the frames that
+land within its bandwidth, which is what a frequency sweep is trying to hit.
+In the other direction frames from a reference transmitter on channel 11 are
+injected periodically and received only if the radio is listening with the LO
+close enough to channel 11 minus the 2.5MHz IF.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory_map.h"
+#include "emu.h"
+
+//=========================== defines =========================================
+
+#define RF_CONTROL              (AHB_RF_BASE + 0x00)
+#define RF_STATUS               (AHB_RF_BASE + 0x04)
+#define RF_TX_DATA_ADDR         (AHB_RF_BASE + 0x08)
+#define RF_TX_PACK_LEN          (AHB_RF_BASE + 0x0C)
+#define RF_INT                  (AHB_RF_BASE + 0x10)
+#define RF_INT_CONFIG           (AHB_RF_BASE + 0x14)
+#define RF_INT_CLEAR            (AHB_RF_BASE + 0x18)
+#define RF_ERROR                (AHB_RF_BASE + 0x1C)
+#define RF_ERROR_CONFIG         (AHB_RF_BASE + 0x20)
+#define RF_ERROR_CLEAR          (AHB_RF_BASE + 0x24)
+#define RF_SIZE                 0x28
+#define DMA_RF_RX_ADDR          (AHB_DMA_BASE + 0x14)
+
+#define RADIO_NS_PER_BYTE       (32 * EMU_NS_PER_US)
+#define RADIO_PREAMBLE_SFD_NS   (5 * RADIO_NS_PER_BYTE)
+#define RADIO_TX_LOAD_NS        (10 * EMU_NS_PER_US)
+#define RADIO_MAX_FRAME_LEN     127
+
+#define CHANNEL_11_HZ           2405000000.0
+#define RECEIVER_BANDWIDTH_HZ   500000.0    // either side of the channel
+#define IF_HZ                   2500000.0
+#define IF_ESTIMATE_HZ_PER_LSB  5000.0      // see radio_frequency_housekeeping()
+#define IF_ESTIMATE_NOMINAL     500
+
+#define INJECTED_FRAME_LEN      6           // LEN_RX_PKT, with the 2 CRC bytes
+
+//=========================== variables =======================================
+
+typedef enum {
+    RADIO_STATE_IDLE,
+    RADIO_STATE_TX_LOADING,
+    RADIO_STATE_TX_READY,
+    RADIO_STATE_TX_SFD,
+    RADIO_STATE_TX_SENDING,
+    RADIO_STATE_RX_LISTENING,
+    RADIO_STATE_RX_SFD,
+    RADIO_STATE_RX_RECEIVING
+} emu_radio_state_t;
+
+typedef struct {
+    emu_radio_state_t   state;
+    uint8_t             frame[RADIO_MAX_FRAME_LEN];
+    uint8_t             frame_len;
+    double              frame_freq;
+    bool                frame_crc_error;
+    uint32_t            injected_seqnum;
+} emu_radio_vars_t;
+
+emu_radio_vars_t emu_radio_vars;
+
+//=========================== prototypes ======================================
+
+void emu_radio_write(uint32_t addr, uint32_t value);
+void emu_radio_event(emu_event_t event);
+void emu_radio_inject_event(emu_event_t event);
+void emu_radio_set_int(uint32_t bit);
+void emu_radio_air_tx(void);
+
+//=========================== public ==========================================
+
+void emu_radio_init(void) {
+    memset(&emu_radio_vars, 0, sizeof(emu_radio_vars_t));
+    hal_set_hooks(AHB_RF_BASE, RF_SIZE, NULL, emu_radio_write);
+    emu_set_event_callback(EMU_EVENT_RADIO, emu_radio_event);
+    emu_set_event_callback(EMU_EVENT_RADIO_INJECT, emu_radio_inject_event);
+}
+
+// Commands of RFCONTROLLER_REG__CONTROL, also driven by RF timer compares
+void emu_radio_strobe(uint32_t control) {
+    uint32_t len;
+    char*    data;
+
+    if (control & RF_RESET) {
+        emu_radio_vars.state = RADIO_STATE_IDLE;
+        emu_cancel(EMU_EVENT_RADIO);
+    }
+
+    if (control & TX_LOAD) {
+        len  = hal_peek(RF_TX_PACK_LEN);
+        data = hal_peek_ptr(RF_TX_DATA_ADDR);
+        if (len > RADIO_MAX_FRAME_LEN) {
+            len = RADIO_MAX_FRAME_LEN;
+        }
+        if (data != NULL) {
+            memcpy(emu_radio_vars.frame, data, len);
+        }
+        emu_radio_vars.frame_len = len;
+        emu_radio_vars.state     = RADIO_STATE_TX_LOADING;
+        emu_schedule(EMU_EVENT_RADIO, emu_now() + RADIO_TX_LOAD_NS);
+    }
+
+    if ((control & TX_SEND) && emu_radio_vars.state == RADIO_STATE_TX_READY) {
+        emu_radio_vars.state = RADIO_STATE_TX_SFD;
+        emu_schedule(EMU_EVENT_RADIO, emu_now() + RADIO_PREAMBLE_SFD_NS);
+    }
+
+    if ((control & RX_START) && emu_radio_vars.state == RADIO_STATE_IDLE) {
+        emu_radio_vars.state = RADIO_STATE_RX_LISTENING;
+    }
+
+    if (control & RX_STOP) {
+        if (emu_radio_vars.state >= RADIO_STATE_RX_LISTENING) {
+            emu_radio_vars.state = RADIO_STATE_IDLE;
+            emu_cancel(EMU_EVENT_RADIO);
+        }
+    }
+}
+
+void emu_radio_start_injection(void) {
+    if (emu_config.rx_period_ns != 0) {
+        emu_schedule(EMU_EVENT_RADIO_INJECT, emu_now() + emu_config.rx_period_ns);
+    }
+}
+
+//=========================== private =========================================
+
+void emu_radio_write(uint32_t addr, uint32_t value) {
+    switch (addr) {
+        case RF_CONTROL:
+            emu_radio_strobe(value);
+            hal_poke(RF_CONTROL, 0);
+            break;
+        case RF_INT_CLEAR:
+            hal_poke(RF_INT, hal_peek(RF_INT) & ~value);
+            hal_poke(RF_INT_CLEAR, 0);
+            break;
+        case RF_ERROR_CLEAR:
+            hal_poke(RF_ERROR, hal_peek(RF_ERROR) & ~value);
+            hal_poke(RF_ERROR_CLEAR, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+// Next step of the frame in flight
+void emu_radio_event(emu_event_t event) {
+    uint8_t* dma;
+
+    switch (emu_radio_vars.state) {
+        case RADIO_STATE_TX_LOADING:
+            emu_radio_vars.state = RADIO_STATE_TX_READY;
+            emu_radio_set_int(TX_LOAD_DONE_INT);
+            break;
+        case RADIO_STATE_TX_SFD:
+            emu_radio_vars.frame_freq = emu_analog_lo_freq();
+            emu_radio_vars.state      = RADIO_STATE_TX_SENDING;
+            emu_radio_set_int(TX_SFD_DONE_INT);
+            emu_schedule(EMU_EVENT_RADIO,
+                emu_now() + (emu_radio_vars.frame_len + 1) * RADIO_NS_PER_BYTE);
+            break;
+        case RADIO_STATE_TX_SENDING:
+            emu_radio_air_tx();
+            emu_radio_vars.state = RADIO_STATE_IDLE;
+            emu_radio_set_int(TX_SEND_DONE_INT);
+            break;
+        case RADIO_STATE_RX_SFD:
+            emu_radio_vars.state = RADIO_STATE_RX_RECEIVING;
+            emu_radio_set_int(RX_SFD_DONE_INT);
+            emu_schedule(EMU_EVENT_RADIO,
+                emu_now() + (emu_radio_vars.frame_len + 1) * RADIO_NS_PER_BYTE);
+            break;
+        case RADIO_STATE_RX_RECEIVING:
+            // DMA as [length][payload and CRC]
+            dma = (uint8_t*) hal_peek_ptr(DMA_RF_RX_ADDR);
+            if (dma != NULL) {
+                dma[0] = emu_radio_vars.frame_len;
+                memcpy(&dma[1], emu_radio_vars.frame, emu_radio_vars.frame_len);
+            }
+            emu_stats.rx_frames++;
+            emu_radio_vars.state = RADIO_STATE_IDLE;
+            if (emu_radio_vars.frame_crc_error &&
+                (hal_peek(RF_ERROR_CONFIG) & RX_CRC_ERROR_EN)) {
+                hal_poke(RF_ERROR, hal_peek(RF_ERROR) | RX_CRC_ERROR);
+            }
+            emu_radio_set_int(RX_DONE_INT);
+            break;
+        default:
+            break;
+    }
+}
+
+// The reference transmitter sends a frame on channel 11
+void emu_radio_inject_event(emu_event_t event) {
+    double lo, offset;
+    uint8_t i;
+
+    emu_schedule(EMU_EVENT_RADIO_INJECT, emu_now() + emu_config.rx_period_ns);
+    emu_stats.rx_injected++;
+
+    if (emu_radio_vars.state != RADIO_STATE_RX_LISTENING) {
+        return;
+    }
+
+    lo     = emu_analog_lo_freq();
+    offset = CHANNEL_11_HZ - (lo + IF_HZ);
+    if (offset > RECEIVER_BANDWIDTH_HZ || offset < -RECEIVER_BANDWIDTH_HZ) {
+        return;
+    }
+
+    emu_radio_vars.frame_len = INJECTED_FRAME_LEN;
+    for (i = 0; i < INJECTED_FRAME_LEN; i++) {
+        emu_radio_vars.frame[i] = (uint8_t)(emu_radio_vars.injected_seqnum + i);
+    }
+    emu_radio_vars.injected_seqnum++;
+    emu_radio_vars.frame_crc_error = (rand() % 100) < emu_config.rx_crc_error_pct;
+    emu_analog_set_if_estimate(IF_ESTIMATE_NOMINAL + (int)(offset / IF_ESTIMATE_HZ_PER_LSB));
+
+    emu_radio_vars.state = RADIO_STATE_RX_SFD;
+    emu_schedule(EMU_EVENT_RADIO, emu_now() + RADIO_PREAMBLE_SFD_NS);
+}
+
+void emu_radio_set_int(uint32_t bit) {
+    uint32_t config;
+
+    config = hal_peek(RF_INT_CONFIG);
+    hal_poke(RF_INT, hal_peek(RF_INT) | bit);
+
+    if (config & bit) {
+        emu_irq_set_pending(EMU_IRQ_RADIO);
+    }
+    // RFTIMER pulse enables sit 5 bits above the interrupt enables, and the
+    // capture input selects 2 bits above the interrupt flags
+    if (config & (bit << 5)) {
+        emu_rftimer_capture_pulse(bit << 2);
+    }
+}
+
+// The frame that just went out, as seen by the reference receiver
+void emu_radio_air_tx(void) {
+    double  offset;
+    bool    heard;
+    char    hex[3 * RADIO_MAX_FRAME_LEN + 1];
+    uint8_t i, payload_len;
+
+    offset = emu_radio_vars.frame_freq - CHANNEL_11_HZ;
+    heard  = offset <= RECEIVER_BANDWIDTH_HZ && offset >= -RECEIVER_BANDWIDTH_HZ;
+
+    emu_stats.tx_frames++;
+    if (heard) {
+        emu_stats.tx_frames_heard++;
+    }
+
+    if (emu_config.verbose || heard) {
+        // the payloads are binary, see tools/packet_decode.py, the radio fills in the CRC
+        payload_len = (emu_radio_vars.frame_len > 2) ? emu_radio_vars.frame_len - 2 : 0;
+        hex[0] = '\0';
+        for (i = 0; i < payload_len; i++) {
+            sprintf(&hex[3 * i], " %02X", emu_radio_vars.frame[i]);
+        }
+        emu_log("air: %u bytes at %.4f MHz%s:%s",
+            emu_radio_vars.frame_len,
+            emu_radio_vars.frame_freq / 1e6,
+            heard ? ", heard on channel 11" : "",
+            hex);
+    }
+}
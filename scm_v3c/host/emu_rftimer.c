@@ -0,0 +1,209 @@
+/**
+\brief RF timer model: 500kHz counter, 8 compares and 4 captures.
+
+The counter is derived from virtual time rather than stored, so it is only
+computed when the firmware reads it. A compare is a scheduled event at the
+next time the counter reaches its value, recomputed whenever the compare or
+its control register is written. The timer runs from an ideal 500kHz, i.e.
+it does not follow the HF clock it is divided from on the chip.
+*/
+
+#include <string.h>
+
+#include "memory_map.h"
+#include "emu.h"
+
+//=========================== defines =========================================
+
+#define RFTIMER_NUM_COMPARES    8
+#define RFTIMER_NUM_CAPTURES    4
+
+#define RFTIMER_CONTROL         (AHB_RFTIMER_BASE + 0x00)
+#define RFTIMER_COUNTER         (AHB_RFTIMER_BASE + 0x04)
+#define RFTIMER_MAX_COUNT       (AHB_RFTIMER_BASE + 0x08)
+#define RFTIMER_COMPARE(n)      (AHB_RFTIMER_BASE + 0x10 + ((n) << 2))
+#define RFTIMER_COMPARE_CTRL(n) (AHB_RFTIMER_BASE + 0x30 + ((n) << 2))
+#define RFTIMER_CAPTURE(n)      (AHB_RFTIMER_BASE + 0x50 + ((n) << 2))
+#define RFTIMER_CAPTURE_CTRL(n) (AHB_RFTIMER_BASE + 0x60 + ((n) << 2))
+#define RFTIMER_INT             (AHB_RFTIMER_BASE + 0x70)
+#define RFTIMER_INT_CLEAR       (AHB_RFTIMER_BASE + 0x74)
+#define RFTIMER_SIZE            0x78
+
+//=========================== variables =======================================
+
+typedef struct {
+    // the counter read base_count at base_time
+    uint64_t    base_time;
+    uint32_t    base_count;
+    bool        running;
+} emu_rftimer_vars_t;
+
+emu_rftimer_vars_t emu_rftimer_vars;
+
+//=========================== prototypes ======================================
+
+uint32_t emu_rftimer_read(uint32_t addr, uint32_t value);
+void     emu_rftimer_write(uint32_t addr, uint32_t value);
+void     emu_rftimer_compare_event(emu_event_t event);
+void     emu_rftimer_schedule_compare(uint8_t n);
+uint64_t emu_rftimer_period(void);
+void     emu_rftimer_rebase(void);
+void     emu_rftimer_set_int(uint32_t bits);
+void     emu_rftimer_capture(uint8_t n);
+
+//=========================== public ==========================================
+
+void emu_rftimer_init(void) {
+    uint8_t n;
+
+    memset(&emu_rftimer_vars, 0, sizeof(emu_rftimer_vars_t));
+    hal_poke(RFTIMER_MAX_COUNT, RFTIMER_MAX_COUNT);
+    hal_set_hooks(AHB_RFTIMER_BASE, RFTIMER_SIZE, emu_rftimer_read, emu_rftimer_write);
+
+    for (n = 0; n < RFTIMER_NUM_COMPARES; n++) {
+        emu_set_event_callback(EMU_EVENT_RFTIMER_COMPARE0 + n, emu_rftimer_compare_event);
+    }
+}
+
+uint32_t emu_rftimer_counter(void) {
+    uint64_t ticks;
+
+    if (!emu_rftimer_vars.running) {
+        return emu_rftimer_vars.base_count;
+    }
+    ticks = (emu_now() - emu_rftimer_vars.base_time) / EMU_NS_PER_RFTIMER_TICK;
+    return (uint32_t)((emu_rftimer_vars.base_count + ticks) % emu_rftimer_period());
+}
+
+// Capture inputs from the radio, INPUT_SEL is one of RFTIMER_CAPTURE_INPUT_SEL_*
+void emu_rftimer_capture_pulse(uint32_t input_sel) {
+    uint8_t n;
+
+    for (n = 0; n < RFTIMER_NUM_CAPTURES; n++) {
+        if (hal_peek(RFTIMER_CAPTURE_CTRL(n)) & input_sel) {
+            emu_rftimer_capture(n);
+        }
+    }
+}
+
+//=========================== private =========================================
+
+uint32_t emu_rftimer_read(uint32_t addr, uint32_t value) {
+    if (addr == RFTIMER_COUNTER) {
+        return emu_rftimer_counter();
+    }
+    return value;
+}
+
+void emu_rftimer_write(uint32_t addr, uint32_t value) {
+    uint8_t n;
+
+    if (addr == RFTIMER_CONTROL) {
+        emu_rftimer_rebase();
+        if (value & RFTIMER_REG__CONTROL_COUNT_RESET) {
+            emu_rftimer_vars.base_count = 0;
+        }
+        emu_rftimer_vars.running = (value & RFTIMER_REG__CONTROL_ENABLE) != 0;
+        for (n = 0; n < RFTIMER_NUM_COMPARES; n++) {
+            emu_rftimer_schedule_compare(n);
+        }
+    } else if (addr == RFTIMER_COUNTER || addr == RFTIMER_MAX_COUNT) {
+        emu_rftimer_rebase();
+        if (addr == RFTIMER_COUNTER) {
+            emu_rftimer_vars.base_count = value;
+        }
+        for (n = 0; n < RFTIMER_NUM_COMPARES; n++) {
+            emu_rftimer_schedule_compare(n);
+        }
+    } else if (addr >= RFTIMER_COMPARE(0) && addr < RFTIMER_COMPARE_CTRL(RFTIMER_NUM_COMPARES)) {
+        emu_rftimer_schedule_compare(((addr - RFTIMER_COMPARE(0)) >> 2) % RFTIMER_NUM_COMPARES);
+    } else if (addr >= RFTIMER_CAPTURE_CTRL(0) && addr < RFTIMER_INT) {
+        n = (addr - RFTIMER_CAPTURE_CTRL(0)) >> 2;
+        if (value & RFTIMER_CAPTURE_NOW) {
+            emu_rftimer_capture(n);
+            hal_poke(addr, value & ~RFTIMER_CAPTURE_NOW);
+        }
+    } else if (addr == RFTIMER_INT_CLEAR) {
+        hal_poke(RFTIMER_INT, hal_peek(RFTIMER_INT) & ~value);
+        hal_poke(RFTIMER_INT_CLEAR, 0);
+    }
+}
+
+void emu_rftimer_compare_event(emu_event_t event) {
+    uint8_t  n;
+    uint32_t control;
+
+    n       = event - EMU_EVENT_RFTIMER_COMPARE0;
+    control = hal_peek(RFTIMER_COMPARE_CTRL(n));
+
+    if (control & RFTIMER_COMPARE_INTERRUPT_ENABLE) {
+        emu_rftimer_set_int(1u << n);
+    }
+    // compares can drive the radio FSM directly
+    emu_radio_strobe(
+        ((control & RFTIMER_COMPARE_TX_LOAD_ENABLE)  ? TX_LOAD  : 0) |
+        ((control & RFTIMER_COMPARE_TX_SEND_ENABLE)  ? TX_SEND  : 0) |
+        ((control & RFTIMER_COMPARE_RX_START_ENABLE) ? RX_START : 0) |
+        ((control & RFTIMER_COMPARE_RX_STOP_ENABLE)  ? RX_STOP  : 0)
+    );
+
+    // matches again once the counter wraps around
+    emu_rftimer_schedule_compare(n);
+}
+
+void emu_rftimer_schedule_compare(uint8_t n) {
+    uint64_t ticks_now, ticks_to_match, period;
+    uint32_t compare;
+
+    if (!emu_rftimer_vars.running ||
+        (hal_peek(RFTIMER_COMPARE_CTRL(n)) & RFTIMER_COMPARE_ENABLE) == 0) {
+        emu_cancel(EMU_EVENT_RFTIMER_COMPARE0 + n);
+        return;
+    }
+
+    period    = emu_rftimer_period();
+    compare   = hal_peek(RFTIMER_COMPARE(n));
+    ticks_now = (emu_now() - emu_rftimer_vars.base_time) / EMU_NS_PER_RFTIMER_TICK;
+
+    ticks_to_match = (compare + period - (emu_rftimer_vars.base_count + ticks_now) % period) % period;
+    if (ticks_to_match == 0) {
+        ticks_to_match = period;
+    }
+
+    emu_schedule(
+        EMU_EVENT_RFTIMER_COMPARE0 + n,
+        emu_rftimer_vars.base_time + (ticks_now + ticks_to_match) * EMU_NS_PER_RFTIMER_TICK
+    );
+}
+
+uint64_t emu_rftimer_period(void) {
+    return (uint64_t) hal_peek(RFTIMER_MAX_COUNT) + 1;
+}
+
+// Folds the elapsed ticks into base_count, before the counting changes
+void emu_rftimer_rebase(void) {
+    emu_rftimer_vars.base_count = emu_rftimer_counter();
+    emu_rftimer_vars.base_time  = emu_now();
+}
+
+void emu_rftimer_set_int(uint32_t bits) {
+    hal_poke(RFTIMER_INT, hal_peek(RFTIMER_INT) | bits);
+    if (hal_peek(RFTIMER_CONTROL) & RFTIMER_REG__CONTROL_INTERRUPT_ENABLE) {
+        emu_irq_set_pending(EMU_IRQ_RFTIMER);
+    }
+}
+
+void emu_rftimer_capture(uint8_t n) {
+    uint32_t control;
+
+    control = hal_peek(RFTIMER_CAPTURE_CTRL(n));
+    hal_poke(RFTIMER_CAPTURE(n), emu_rftimer_counter());
+
+    if (control & RFTIMER_CAPTURE_INTERRUPT_ENABLE) {
+        if (hal_peek(RFTIMER_INT) & (RFTIMER_REG__INT_CAPTURE0_INT << n)) {
+            emu_rftimer_set_int(RFTIMER_REG__INT_CAPTURE0_OVERFLOW_INT << n);
+        } else {
+            emu_rftimer_set_int(RFTIMER_REG__INT_CAPTURE0_INT << n);
+        }
+    }
+}
@@ -0,0 +1,239 @@
+/**
+\brief Host backend for scum_hal.h: a sparse in-memory register file.
+
+Every register is a cell created on first access. Peripheral models attach
+read and write hooks to address ranges. A write hook cannot run inside the
+store itself, since the firmware writes through the pointer hal_reg()
+returned, so the store is committed (and the hook called if the value
+changed) at the next register access or at hal_sync(). Models of strobe
+registers (e.g. RFCONTROLLER_REG__CONTROL, RFTIMER_REG__INT_CLEAR) should
+hal_poke() the register back to 0 once consumed, so that writing the same
+command again is seen as a change.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scum_hal.h"
+
+//=========================== defines =========================================
+
+#define HAL_NUM_CELLS       1024    // power of two
+#define HAL_NUM_HOOKS       16
+
+//=========================== variables =======================================
+
+typedef struct {
+    uint32_t            addr;
+    uint8_t             used;
+    union {
+        unsigned int    u32;
+        char*           ptr;
+        uint64_t        raw;
+    } value;
+} hal_cell_t;
+
+typedef struct {
+    uint32_t            base;
+    uint32_t            size;
+    hal_read_hook_t     read_hook;
+    hal_write_hook_t    write_hook;
+} hal_hook_t;
+
+typedef struct {
+    hal_cell_t          cells[HAL_NUM_CELLS];
+    hal_hook_t          hooks[HAL_NUM_HOOKS];
+    uint8_t             num_hooks;
+    
+    // last access to a register with a write hook, committed by hal_sync()
+    hal_cell_t*         pending_cell;
+    hal_hook_t*         pending_hook;
+    uint64_t            pending_old_value;
+    
+    hal_idle_hook_t     idle_hook;
+    hal_access_hook_t   access_hook;
+    int                 interrupts_disabled;
+} hal_vars_t;
+
+hal_vars_t hal_vars;
+
+unsigned char hal_image[HAL_IMAGE_SIZE];
+
+//=========================== prototypes ======================================
+
+hal_cell_t* hal_find_cell(uint32_t addr);
+hal_hook_t* hal_find_hook(uint32_t addr);
+void        hal_access(void);
+
+//=========================== public ==========================================
+
+volatile unsigned int* hal_reg(uint32_t addr) {
+    hal_cell_t* cell;
+    hal_hook_t* hook;
+    
+    hal_sync();
+    hal_access();
+    
+    cell = hal_find_cell(addr);
+    hook = hal_find_hook(addr);
+    
+    if (hook != NULL) {
+        if (hook->read_hook != NULL) {
+            cell->value.u32 = hook->read_hook(addr, cell->value.u32);
+        }
+        if (hook->write_hook != NULL) {
+            hal_vars.pending_cell       = cell;
+            hal_vars.pending_hook       = hook;
+            hal_vars.pending_old_value  = cell->value.raw;
+        }
+    }
+    
+    return (volatile unsigned int*) &cell->value.u32;
+}
+
+char* volatile* hal_reg_ptr(uint32_t addr) {
+    hal_cell_t* cell;
+    hal_hook_t* hook;
+    
+    hal_sync();
+    hal_access();
+    
+    cell = hal_find_cell(addr);
+    hook = hal_find_hook(addr);
+    
+    if (hook != NULL && hook->write_hook != NULL) {
+        hal_vars.pending_cell       = cell;
+        hal_vars.pending_hook       = hook;
+        hal_vars.pending_old_value  = cell->value.raw;
+    }
+    
+    return (char* volatile*) &cell->value.ptr;
+}
+
+// Commits the last register access, calling the write hook if it changed
+void hal_sync(void) {
+    hal_cell_t* cell;
+    hal_hook_t* hook;
+    
+    cell = hal_vars.pending_cell;
+    hook = hal_vars.pending_hook;
+    if (cell == NULL) {
+        return;
+    }
+    
+    // clear first, the hook may access registers itself
+    hal_vars.pending_cell = NULL;
+    hal_vars.pending_hook = NULL;
+    
+    if (cell->value.raw != hal_vars.pending_old_value) {
+        hook->write_hook(cell->addr, cell->value.u32);
+    }
+}
+
+// Clears all registers and hooks
+void hal_reset(void) {
+    memset(&hal_vars, 0, sizeof(hal_vars_t));
+}
+
+uint32_t hal_peek(uint32_t addr) {
+    hal_sync();
+    return hal_find_cell(addr)->value.u32;
+}
+
+void hal_poke(uint32_t addr, uint32_t value) {
+    hal_sync();
+    hal_find_cell(addr)->value.raw = value;
+}
+
+char* hal_peek_ptr(uint32_t addr) {
+    hal_sync();
+    return hal_find_cell(addr)->value.ptr;
+}
+
+void hal_set_hooks(uint32_t base, uint32_t size,
+    hal_read_hook_t read_hook, hal_write_hook_t write_hook) {
+    hal_hook_t* hook;
+    
+    if (hal_vars.num_hooks == HAL_NUM_HOOKS) {
+        fprintf(stderr, "hal: too many hooks\n");
+        exit(1);
+    }
+    
+    hook = &hal_vars.hooks[hal_vars.num_hooks++];
+    hook->base          = base;
+    hook->size          = size;
+    hook->read_hook     = read_hook;
+    hook->write_hook    = write_hook;
+}
+
+void hal_set_idle_hook(hal_idle_hook_t idle_hook) {
+    hal_vars.idle_hook = idle_hook;
+}
+
+void hal_set_access_hook(hal_access_hook_t access_hook) {
+    hal_vars.access_hook = access_hook;
+}
+
+// Stands in for __wfi(): lets the peripheral models advance until something happens
+void hal_wait_for_interrupt(void) {
+    hal_sync();
+    if (hal_vars.idle_hook != NULL) {
+        hal_vars.idle_hook();
+    }
+}
+
+void hal_set_interrupts_enabled(int enabled) {
+    hal_sync();
+    hal_vars.interrupts_disabled = !enabled;
+    if (enabled) {
+        // lets an interrupt that became pending while masked run now
+        hal_access();
+    }
+}
+
+int hal_interrupts_enabled(void) {
+    return !hal_vars.interrupts_disabled;
+}
+
+//=========================== private =========================================
+
+hal_cell_t* hal_find_cell(uint32_t addr) {
+    uint32_t i, n;
+    hal_cell_t* cell;
+    
+    i = (addr * 2654435761u) >> 22;
+    for (n = 0; n < HAL_NUM_CELLS; n++) {
+        cell = &hal_vars.cells[(i + n) & (HAL_NUM_CELLS - 1)];
+        if (!cell->used) {
+            cell->used = 1;
+            cell->addr = addr;
+            return cell;
+        }
+        if (cell->addr == addr) {
+            return cell;
+        }
+    }
+    
+    fprintf(stderr, "hal: register file full at 0x%08x\n", addr);
+    exit(1);
+}
+
+// Runs the access hook, which may run an ISR, committing what the ISR left pending
+void hal_access(void) {
+    if (hal_vars.access_hook != NULL) {
+        hal_vars.access_hook();
+        hal_sync();
+    }
+}
+
+hal_hook_t* hal_find_hook(uint32_t addr) {
+    uint8_t i;
+    
+    for (i = 0; i < hal_vars.num_hooks; i++) {
+        if (addr - hal_vars.hooks[i].base < hal_vars.hooks[i].size) {
+            return &hal_vars.hooks[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,1232 @@
+/**
+\brief Host tests for the register file in hal_host.c and the drivers on top of it.
+
+Run with "make test" from this directory.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "memory_map.h"
+#include "rftimer.h"
+#include "counters.h"
+#include "uart.h"
+#include "telemetry.h"
+#include "spi.h"
+#include "imu_sampler.h"
+#include "temperature.h"
+#include "fixed_point.h"
+#include "zappy2.h"
+#include "gpio_sequencer.h"
+#include "packet_encoder.h"
+#include "sweep_results.h"
+#include "solar_duty.h"
+#include "aggregator.h"
+#include "radio.h"
+#include "ack_engine.h"
+#include "sync_rx.h"
+#include "scm3c_hw_interface.h"
+
+//=========================== defines =========================================
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define TEST_BASE   0x60000000
+
+// destination PAN ID in the RX buffer, after the length, frame control and sequence number
+#define PANID_INDEX 4
+
+// the RF timer compare of sync_rx.c, 5 is waveform.c's
+#define SYNC_RX_COMPARE 7
+
+// IMU wiring, see spi.c
+#define IMU_CS      (1u << 15)
+#define IMU_CLK     (1u << 14)
+#define IMU_SDO     (1u << 13)
+#define IMU_SDI     (1u << 12)
+
+//=========================== variables =======================================
+
+uint32_t    num_writes;
+uint32_t    last_write_addr;
+uint32_t    last_write_value;
+uint32_t    fake_counter;
+uint8_t     uart_bytes[256];
+uint32_t    num_uart_bytes;
+uint32_t    imu_last_output;
+uint32_t    imu_transactions;
+uint32_t    imu_bits;
+uint8_t     imu_addr;
+uint32_t    spi_mosi_bits;
+uint16_t    gpio_outputs[256];
+uint32_t    num_gpio_outputs;
+uint32_t    num_segments_done;
+
+extern rftimer_vars_t rftimer_vars;
+extern bool           tx_rx_mode;
+
+void ack_engine_endFrame_tx(uint32_t timestamp);
+
+//=========================== hooks ===========================================
+
+void record_write(uint32_t addr, uint32_t value) {
+    num_writes++;
+    last_write_addr  = addr;
+    last_write_value = value;
+}
+
+// strobe register: consumed and cleared by the "hardware"
+void strobe_write(uint32_t addr, uint32_t value) {
+    record_write(addr, value);
+    hal_poke(addr, 0);
+}
+
+uint32_t counter_read(uint32_t addr, uint32_t value) {
+    if (addr == (AHB_RFTIMER_BASE + 0x04)) {
+        return fake_counter;
+    }
+    return value;
+}
+
+uint32_t ticking_counter_read(uint32_t addr, uint32_t value) {
+    if (addr == (AHB_RFTIMER_BASE + 0x04)) {
+        return fake_counter++;
+    }
+    return value;
+}
+
+// flags the register after each byte so that the same byte again is a change
+void uart_write(uint32_t addr, uint32_t value) {
+    uart_bytes[num_uart_bytes++] = (uint8_t) value;
+    hal_poke(addr, 0x100);
+}
+
+// an IMU whose registers read back their own address, with auto-increment,
+// plus one for each transaction after the first
+void imu_gpio_write(uint32_t addr, uint32_t value) {
+    uint32_t rising;
+    uint8_t  data;
+    
+    rising = value & ~imu_last_output;
+    imu_last_output = value;
+    
+    if (value & IMU_CS) {
+        imu_bits = 0;
+        return;
+    }
+    if (!(rising & IMU_CLK)) {
+        return;
+    }
+    if (imu_bits == 0) {
+        imu_transactions++;
+        imu_addr = 0;
+    }
+    if (imu_bits < 8) {
+        imu_addr = (uint8_t)((imu_addr << 1) | ((value & IMU_SDI) ? 1 : 0));
+    } else {
+        // the bit is sampled right after the rising edge
+        data = (uint8_t)((imu_addr & 0x7F) + (imu_bits - 8) / 8 + imu_transactions - 1);
+        GPIO_REG__INPUT = ((data >> (7 - (imu_bits - 8) % 8)) & 0x1) ? IMU_SDO : 0;
+    }
+    imu_bits++;
+}
+
+// loops MOSI (GPIO5) back to MISO (GPIO6), recording it on rising clock (GPIO4) edges
+void loopback_gpio_write(uint32_t addr, uint32_t value) {
+    if ((value & (1u << 4)) && !(imu_last_output & (1u << 4))) {
+        spi_mosi_bits = (spi_mosi_bits << 1) | ((value >> 5) & 0x1);
+    }
+    imu_last_output = value;
+    GPIO_REG__INPUT = (value & (1u << 5)) ? (1u << 6) : 0;
+}
+
+void record_gpio_write(uint32_t addr, uint32_t value) {
+    gpio_outputs[num_gpio_outputs++] = (uint16_t) value;
+}
+
+// what rftimer_isr() does for a compare match
+void rftimer_isr_callback(uint8_t id) {
+    rftimer_vars.rftimer_cbs[id]();
+}
+
+//=========================== tests ===========================================
+
+void test_registers(void) {
+    hal_reset();
+    
+    CHECK(HAL_REG(TEST_BASE) == 0);
+    HAL_REG(TEST_BASE) = 0x12345678;
+    HAL_REG(TEST_BASE + 4) |= 0x3;
+    HAL_REG(TEST_BASE + 4) |= 0x4;
+    CHECK(HAL_REG(TEST_BASE) == 0x12345678);
+    CHECK(HAL_REG(TEST_BASE + 4) == 0x7);
+    
+    // pointer registers hold a full host pointer
+    RFCONTROLLER_REG__TX_DATA_ADDR = (char*) &num_writes;
+    CHECK(hal_peek_ptr(AHB_RF_BASE + 0x08) == (char*) &num_writes);
+}
+
+void test_write_hooks(void) {
+    hal_reset();
+    num_writes = 0;
+    hal_set_hooks(TEST_BASE, 0x10, NULL, record_write);
+    hal_set_hooks(TEST_BASE + 0x10, 0x10, NULL, strobe_write);
+    
+    // committed at the next access or sync, only when the value changed
+    HAL_REG(TEST_BASE) = 5;
+    CHECK(num_writes == 0);
+    hal_sync();
+    CHECK(num_writes == 1 && last_write_addr == TEST_BASE && last_write_value == 5);
+    HAL_REG(TEST_BASE) = 5;
+    hal_sync();
+    CHECK(num_writes == 1);
+    
+    // reading doesn't count as a write
+    CHECK(HAL_REG(TEST_BASE) == 5);
+    hal_sync();
+    CHECK(num_writes == 1);
+    
+    // a strobe can be written with the same value again
+    HAL_REG(TEST_BASE + 0x10) = 1;
+    HAL_REG(TEST_BASE + 0x10) = 1;
+    hal_sync();
+    CHECK(num_writes == 3);
+    CHECK(hal_peek(TEST_BASE + 0x10) == 0);
+}
+
+void test_rftimer(void) {
+    hal_reset();
+    num_writes = 0;
+    hal_set_hooks(0xE000E100, 0x4, NULL, strobe_write);
+    
+    rftimer_setCompareIn(1234, 3);
+    hal_sync();
+    
+    CHECK(RFTIMER_REG__COMPARE3 == 1234);
+    CHECK(RFTIMER_REG__COMPARE3_CONTROL == (RFTIMER_COMPARE_ENABLE | RFTIMER_COMPARE_INTERRUPT_ENABLE));
+    CHECK(last_write_addr == 0xE000E100 && last_write_value == 0x80);
+}
+
+void test_counters(void) {
+    counters_snapshot_t snapshot;
+    
+    hal_reset();
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    
+    fake_counter = 1000;
+    counters_restart();
+    CHECK(ANALOG_CFG_REG__0 == COUNTERS_ENABLE);
+    
+    COUNTER_REG__2M_LSB     = 0x5678;
+    COUNTER_REG__2M_MSB     = 0x1234;
+    COUNTER_REG__IF_LSB     = 100;
+    fake_counter = 1500;
+    counters_stop(&snapshot);
+    
+    CHECK(ANALOG_CFG_REG__0 == COUNTERS_DISABLE);
+    CHECK(snapshot.count_2M == 0x12345678);
+    CHECK(snapshot.count_IF == 100);
+    CHECK(snapshot.elapsed_ticks == 500);
+    
+    // a window too short for the compare gets the minimum
+    fake_counter = 2000;
+    CHECK(counters_start(1, NULL));
+    CHECK(RFTIMER_REG__COMPARE(2) == 2005);
+    
+    // an interrupt can't measure under it, nor restart the counters
+    ICSR = 1;
+    fake_counter = 2002;
+    CHECK(!counters_measure(100, &snapshot));
+    CHECK(snapshot.count_2M == 0 && ANALOG_CFG_REG__0 == COUNTERS_ENABLE);
+    ICSR = 0;
+    fake_counter = 2005;
+    rftimer_isr_callback(2);
+    CHECK(!counters_busy() && ANALOG_CFG_REG__0 == COUNTERS_DISABLE);
+}
+
+void test_telemetry(void) {
+    const uint8_t payload[] = {0x11, 0x00, 0x22, 0x00};
+    uint8_t  frame[16];
+    uint32_t i, j, len, code;
+    
+    hal_reset();
+    num_uart_bytes = 0;
+    hal_set_hooks(APB_UART_BASE, 0x4, NULL, uart_write);
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, ticking_counter_read, NULL);
+    hal_poke(APB_UART_BASE, 0x100);
+    
+    CHECK(telemetry_crc16((const uint8_t*) "123456789", 9) == 0x29B1);
+    
+    // from "interrupt context" the flush writes the buffer out directly
+    ICSR = 1;
+    CHECK(telemetry_send(TELEMETRY_CHANNEL_TRACE, payload, sizeof(payload)));
+    CHECK(telemetry_send(TELEMETRY_CHANNEL_TRACE, payload, 0));
+    uart_tx_flush();
+    hal_sync();
+    ICSR = 0;
+    
+    // 0x00 COBS(channel, seq, payload, crc) 0x00, twice
+    CHECK(uart_bytes[0] == 0x00);
+    len = 0;
+    i   = 1;
+    while (uart_bytes[i] != 0x00) {
+        code = uart_bytes[i++];
+        for (j = 1; j < code; j++) {
+            frame[len++] = uart_bytes[i++];
+        }
+        if (code < 0xFF && uart_bytes[i] != 0x00) {
+            frame[len++] = 0x00;
+        }
+    }
+    CHECK(len == 2 + sizeof(payload) + 2);
+    CHECK(frame[0] == TELEMETRY_CHANNEL_TRACE && frame[1] == 0);
+    CHECK(memcmp(&frame[2], payload, sizeof(payload)) == 0);
+    CHECK(telemetry_crc16(frame, len - 2) == (frame[len - 2] | (frame[len - 1] << 8)));
+    
+    // the second frame carries the next sequence number
+    CHECK(uart_bytes[i + 1] == 0x00);
+    CHECK(uart_bytes[i + 3] == TELEMETRY_CHANNEL_TRACE && uart_bytes[i + 4] == 1);
+}
+
+void test_uart_rftimer_init(void) {
+    uint32_t i;
+    
+    hal_reset();
+    num_uart_bytes = 0;
+    hal_set_hooks(APB_UART_BASE, 0x4, NULL, uart_write);
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    hal_poke(APB_UART_BASE, 0x100);
+    
+    // before the RF timer runs, nothing would pump, so it goes straight out
+    CHECK(uart_tx_write((const uint8_t*) "Init", 4));
+    hal_sync();
+    CHECK(num_uart_bytes == 4);
+    
+    // output queued with the timer running survives rftimer_init()
+    RFTIMER_REG__CONTROL = RFTIMER_REG__CONTROL_ENABLE;
+    fake_counter = 1000;
+    CHECK(uart_tx_write((const uint8_t*) "Validating", 10));
+    hal_sync();
+    CHECK(num_uart_bytes == 5);
+    rftimer_init();
+    CHECK(RFTIMER_REG__CONTROL & RFTIMER_REG__CONTROL_ENABLE);
+    for (i = 0; i < 10 && RFTIMER_REG__COMPARE_CONTROL(3) != 0; i++) {
+        fake_counter = RFTIMER_REG__COMPARE(3);
+        rftimer_isr_callback(3);
+    }
+    hal_sync();
+    CHECK(num_uart_bytes == 14);
+    CHECK(memcmp(uart_bytes, "InitValidating", 14) == 0);
+    uart_tx_flush();
+}
+
+void test_imu_burst(void) {
+    imu_data_t imu_measurement;
+    
+    hal_reset();
+    hal_set_hooks(APB_GPIO_BASE + 0x040000, 0x4, NULL, imu_gpio_write);
+    imu_last_output  = 0;
+    imu_transactions = 0;
+    spi_chip_deselect();
+    
+    read_all_imu_data(&imu_measurement);
+    
+    CHECK(imu_transactions == 1);
+    CHECK(imu_measurement.acc_x.value  == 0x2D2E);
+    CHECK(imu_measurement.acc_z.value  == 0x3132);
+    CHECK(imu_measurement.gyro_z.value == 0x3738);
+}
+
+void test_spi_transfer(void) {
+    const spi_device_t device = {3, 4, 5, 6, SPI_MODE_0, true};
+    const uint8_t tx[] = {0x01, 0x03};
+    uint8_t rx[2];
+    
+    hal_reset();
+    hal_set_hooks(APB_GPIO_BASE + 0x040000, 0x4, NULL, loopback_gpio_write);
+    imu_last_output = 0;
+    spi_mosi_bits   = 0;
+    GPIO_REG__OUTPUT = (1u << 3) | 0x1;
+    
+    spi_select(&device);
+    CHECK((GPIO_REG__OUTPUT & (1u << 3)) == 0);
+    spi_transfer(tx, rx, sizeof(tx));
+    spi_deselect();
+    
+    // full duplex, least significant bit first, clock back low, other pins kept
+    CHECK(rx[0] == 0x01 && rx[1] == 0x03);
+    CHECK(spi_mosi_bits == 0x80C0);
+    CHECK(GPIO_REG__OUTPUT == ((1u << 3) | 0x1));
+}
+
+void test_imu_sampler(void) {
+    uint8_t frame[64];
+    uint8_t len;
+    
+    hal_reset();
+    hal_set_hooks(APB_GPIO_BASE + 0x040000, 0x4, NULL, imu_gpio_write);
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    imu_last_output  = 0;
+    imu_transactions = 0;
+    fake_counter     = 1000;
+    spi_chip_deselect();
+    
+    CHECK(!imu_sampler_start(IMU_SAMPLER_MAX_RATE_HZ + 1));
+    CHECK(imu_sampler_start(1000));
+    
+    // two deadlines on time, one so late that the next is skipped, one more
+    fake_counter = 1500;
+    rftimer_isr_callback(4);
+    fake_counter = 2000;
+    rftimer_isr_callback(4);
+    fake_counter = 3100;
+    rftimer_isr_callback(4);
+    fake_counter = 3500;
+    rftimer_isr_callback(4);
+    CHECK(imu_sampler_count() == 4);
+    CHECK(imu_sampler_missed() == 1);
+    
+    // the first sample raw, each byte one up in the next two: deltas of +257
+    len = imu_sampler_pack(frame, sizeof(frame));
+    CHECK(len == IMU_FRAME_HEADER_LEN + IMU_FRAME_SAMPLE_LEN + 2 * 6 * 2);
+    CHECK(frame[0] == 3);
+    CHECK((frame[1] | (frame[2] << 8)) == 1500);
+    CHECK((frame[5] | (frame[6] << 8)) == 500);
+    CHECK(frame[7] == 0x2E && frame[8] == 0x2D);
+    CHECK(frame[19] == 0x82 && frame[20] == 0x04);
+    
+    // the sample after the gap starts a frame of its own
+    len = imu_sampler_pack(frame, sizeof(frame));
+    CHECK(len == IMU_FRAME_HEADER_LEN + IMU_FRAME_SAMPLE_LEN);
+    CHECK(frame[0] == 1 && (frame[1] | (frame[2] << 8)) == 3500);
+    CHECK(imu_sampler_pack(frame, sizeof(frame)) == 0);
+    
+    imu_sampler_stop();
+}
+
+// The models in freq_sweep_rx_tx.c, evaluated the way the double version did
+double double_model(uint32_t count_2M, uint32_t count_32k, double slope, double offset) {
+    double ratio;
+    
+    ratio = floor((double) count_2M * (1 << CLOCK_RATIO_Q) / count_32k) / (1 << CLOCK_RATIO_Q);
+    return slope * ratio + offset;
+}
+
+void check_model(uint32_t count_2M, uint32_t count_32k, double slope, double offset, int32_t scale) {
+    double  expected;
+    int32_t actual;
+    
+    expected = double_model(count_2M, count_32k, slope, offset) * scale;
+    actual   = clock_ratio_model(clock_ratio(count_2M, count_32k),
+                                 CLOCK_RATIO_COEF(slope), CLOCK_RATIO_COEF(offset), scale);
+    
+    // exactly on a step the double lands on either side of it
+    if (fabs(expected - floor(expected + 0.5)) < 1e-6) {
+        CHECK(abs(actual - (int32_t) expected) <= 1);
+    } else {
+        CHECK(actual == (int32_t) expected);
+    }
+}
+
+void test_temperature(void) {
+    uint32_t count_2M, count_32k;
+    
+    CHECK(CLOCK_RATIO_COEF(-19.293) == -19293);
+    CHECK(CLOCK_RATIO_COEF(1298.134) == 1298134);
+    CHECK(clock_ratio(200000, 3277) == (200000u << CLOCK_RATIO_Q) / 3277);
+    CHECK(clock_ratio(0xFFFFFFFF, 0x3FFFFF) == (uint32_t)(((uint64_t) 0xFFFFFFFF << CLOCK_RATIO_Q) / 0x3FFFFF));
+    CHECK(clock_ratio(1, 0) == 0);
+    check_model(200000, 3277, -19.293, 1298.134, -100);
+    check_model(199000, 3277, 10.567, -710.411, -1000);
+    
+    // 2MHz counts up to the 2^21 fix_init() allowed, over 32kHz counts of
+    // 1 to 400ms windows
+    for (count_32k = 33; count_32k <= 13107; count_32k += 97) {
+        for (count_2M = 0; count_2M < (1u << 21); count_2M += 61) {
+            check_model(count_2M, count_32k, -19.293, 1298.134, 100);
+            check_model(count_2M, count_32k, -10.567, 710.411, 1);
+        }
+    }
+}
+
+uint32_t test_random(void) {
+    static uint32_t state = 0x12345678;
+    
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// exact A * 2^SHIFT / B, rounded half away from zero and saturated
+int32_t exact_quotient(int64_t a, int64_t b, uint8_t shift) {
+    int64_t  n, d, q;
+    
+    n = (a < 0 ? -a : a) << shift;
+    d = b < 0 ? -b : b;
+    q = (n + d / 2) / d;
+    if ((a < 0) != (b < 0)) {
+        q = -q;
+    }
+    if (q > 0x7FFFFFFF) return FIX_MAX;
+    if (q < -0x7FFFFFFFLL - 1) return FIX_MIN;
+    return (int32_t) q;
+}
+
+// exact A * B / 2^SHIFT, rounded half away from zero and saturated
+int32_t exact_product(int64_t a, int64_t b, uint8_t shift) {
+    return exact_quotient(a * b, (int64_t) 1 << shift, 0);
+}
+
+void test_fixed_point(void) {
+    static const uint8_t formats[] = {0, 10, 16, 24, 30};
+    int32_t  a, b;
+    double   x;
+    uint32_t i;
+    uint8_t  j, q;
+    
+    CHECK(FIX_CONST(1.5, 16) == 0x18000);
+    CHECK(FIX_CONST(-0.25, 10) == -256);
+    CHECK(FIX_TO_INT(FIX_CONST(-1.5, 8), 8) == -2);
+    CHECK(FIX_ROUND(FIX_CONST(2.5, 8), 8) == 3);
+    CHECK(FIX_CONVERT(FIX_CONST(1.25, 10), 10, 16) == FIX_CONST(1.25, 16));
+    
+    CHECK(fix_add_sat(FIX_MAX, 1) == FIX_MAX);
+    CHECK(fix_add_sat(FIX_MIN, -1) == FIX_MIN);
+    CHECK(fix_sub_sat(FIX_MIN, 1) == FIX_MIN);
+    CHECK(fix_sub_sat(0, FIX_MIN) == FIX_MAX);
+    CHECK(fix_sub_sat(-5, 7) == -12);
+    CHECK(fix_mul64(FIX_MIN, FIX_MIN) == (int64_t) 1 << 62);
+    CHECK(fix_mul(FIX_MIN, FIX_MIN, 16) == FIX_MAX);
+    CHECK(fix_div(FIX_MIN, 1 << 16, 16) == FIX_MIN);
+    CHECK(fix_div(5, 0, 16) == FIX_MAX);
+    CHECK(fix_div(-5, 0, 16) == FIX_MIN);
+    CHECK(fix_sqrt(-1, 16) == 0);
+    
+    for (i = 0; i < 200000; i++) {
+        // full range and small values alike
+        a = (int32_t) test_random() >> (test_random() & 31);
+        b = (int32_t) test_random() >> (test_random() & 31);
+        q = formats[i % sizeof(formats)];
+        
+        CHECK(fix_add_sat(a, b) == exact_quotient((int64_t) a + b, 1, 0));
+        CHECK(fix_sub_sat(a, b) == exact_quotient((int64_t) a - b, 1, 0));
+        CHECK(fix_mul64(a, b) == (int64_t) a * b);
+        CHECK(fix_mul(a, b, q) == exact_product(a, b, q));
+        if (b != 0) {
+            CHECK(fix_div(a, b, q) == exact_quotient(a, b, q));
+        }
+        if (a > 0) {
+            x = sqrt((double) a * ldexp(1, q));
+            CHECK(fabs(fix_sqrt(a, q) - x) <= 0.5 + 1e-6);
+        }
+    }
+    
+    // angles of up to 8 turns, against libm to a few LSB of each format
+    for (j = 8; j <= FIX_TRIG_MAX_Q; j += 4) {
+        for (i = 0; i < 20000; i++) {
+            x = ((double) test_random() / 0xFFFFFFFFu - 0.5) * 32 * M_PI;
+            if (fabs(x) * ldexp(1, j) >= 0x7FFFFFFF) {
+                continue;
+            }
+            a = (int32_t) floor(x * ldexp(1, j) + 0.5);
+            x = a / ldexp(1, j);
+            CHECK(fabs(fix_sin(a, j) / ldexp(1, j) - sin(x)) <= ldexp(1, -j) * 2 + 2e-8 + fabs(x) * ldexp(1, -j));
+            CHECK(fabs(fix_cos(a, j) / ldexp(1, j) - cos(x)) <= ldexp(1, -j) * 2 + 2e-8 + fabs(x) * ldexp(1, -j));
+        }
+    }
+}
+
+// the GPIO values the old spin loop sara_start() went through
+uint32_t sara_reference(unsigned int toggles, uint16_t a, uint16_t b, uint16_t* outputs) {
+    uint16_t value, first;
+    uint32_t n, x, i;
+    
+    n = 0;
+    value = a;
+    outputs[n++] = value;
+    for (x = 1; x < toggles; x++) {
+        for (i = 0; i < 15; i++) {
+            outputs[n++] = value ^= 0x40;
+        }
+        // B first while A is high, else A first
+        first = (value & a) ? b : a;
+        outputs[n++] = value ^= 0x40 | first;
+        for (i = 0; i < 3; i++) {
+            outputs[n++] = value ^= 0x40;
+        }
+        outputs[n++] = value ^= 0x40 | (a ^ b ^ first);
+    }
+    for (i = 0; i < 10; i++) {
+        outputs[n++] = value ^= 0x40;
+    }
+    outputs[n++] = value |= a | b;
+    for (i = 0; i < 12; i++) {
+        outputs[n++] = value ^= 0x40;
+    }
+    return n;
+}
+
+// plays the waveform to the end, one compare at a time
+void play_waveform(uint32_t period_ticks) {
+    uint32_t deadline;
+    
+    while (waveform_busy()) {
+        deadline = RFTIMER_REG__COMPARE(5);
+        CHECK(deadline - fake_counter == period_ticks);
+        fake_counter = deadline;
+        rftimer_isr_callback(5);
+    }
+    CHECK(RFTIMER_REG__COMPARE_CONTROL(5) == 0);
+}
+
+void test_waveform(void) {
+    waveform_t waveform;
+    uint16_t   expected[256];
+    uint32_t   n, toggles;
+    
+    hal_reset();
+    hal_set_hooks(APB_GPIO_BASE + 0x040000, 0x4, NULL, record_gpio_write);
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    
+    // the phase swaps of an even and an odd number of cycles
+    for (toggles = 4; toggles <= 5; toggles++) {
+        GPIO_REG__OUTPUT = 0;
+        (void) GPIO_REG__OUTPUT;
+        num_gpio_outputs = 0;
+        fake_counter = 1000;
+        sara_compile(&waveform, toggles, 0x0100, 0x0200, 250);
+        CHECK(waveform_play(&waveform));
+        CHECK(!waveform_play(&waveform));
+        play_waveform(250);
+        (void) GPIO_REG__OUTPUT;
+        
+        n = sara_reference(toggles, 0x0100, 0x0200, expected);
+        CHECK(num_gpio_outputs == n);
+        CHECK(memcmp(gpio_outputs, expected, n * sizeof(expected[0])) == 0);
+    }
+    
+    // edges that are already late are applied right away, on the same grid
+    waveform_init(&waveform);
+    CHECK(waveform_add(&waveform, WAVEFORM_TOGGLE, 0x1, 2, 100));
+    CHECK(waveform_add_loop(&waveform, 0, 3));
+    CHECK(!waveform_add_loop(&waveform, 0, 3));
+    CHECK(!waveform_add(&waveform, WAVEFORM_TOGGLE, 0x1, 0, 100));
+    num_gpio_outputs = 0;
+    fake_counter = 1000;
+    CHECK(waveform_play(&waveform));
+    fake_counter = 1250;
+    rftimer_isr_callback(5);
+    (void) GPIO_REG__OUTPUT;
+    CHECK(num_gpio_outputs == 3);
+    CHECK(RFTIMER_REG__COMPARE(5) == 1300);
+    waveform_stop();
+    CHECK(!waveform_busy());
+}
+
+void count_segment_done(void) {
+    num_segments_done++;
+}
+
+void test_gpio_sequencer(void) {
+    static const uint16_t first[]   = {0x0011, 0x0022, 0x0033};
+    static const uint16_t second[]  = {0x0044, 0x0055};
+    static const uint16_t delays[]  = {50, 150};
+    static const uint32_t deadlines[] = {1100, 1200, 1300, 1350, 1500};
+    uint32_t i;
+    
+    hal_reset();
+    hal_set_hooks(APB_GPIO_BASE + 0x040000, 0x4, NULL, record_gpio_write);
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    num_gpio_outputs  = 0;
+    num_segments_done = 0;
+    fake_counter = 1000;
+    
+    gpio_sequencer_init(100, count_segment_done);
+    CHECK(gpio_sequencer_queue(first, NULL, 3));
+    CHECK(gpio_sequencer_busy());
+    CHECK(gpio_sequencer_queue(second, delays, 2));
+    CHECK(gpio_sequencer_free_slots() == 0);
+    CHECK(!gpio_sequencer_queue(first, NULL, 3));
+    
+    // the second segment follows on the next deadline, with its own delays
+    for (i = 0; i < sizeof(deadlines) / sizeof(deadlines[0]); i++) {
+        CHECK(RFTIMER_REG__COMPARE(6) == deadlines[i]);
+        fake_counter = deadlines[i];
+        rftimer_isr_callback(6);
+        if (i == 2) {
+            CHECK(num_segments_done == 1);
+            CHECK(gpio_sequencer_free_slots() == 1);
+        }
+    }
+    (void) GPIO_REG__OUTPUT;
+    
+    CHECK(num_gpio_outputs == 5);
+    CHECK(gpio_outputs[0] == 0x0011 && gpio_outputs[3] == 0x0044 && gpio_outputs[4] == 0x0055);
+    CHECK(num_segments_done == 2);
+    CHECK(!gpio_sequencer_busy());
+    CHECK(gpio_sequencer_starved() == 1);
+    CHECK(RFTIMER_REG__COMPARE_CONTROL(6) == 0);
+    
+    // queueing again starts over from now
+    fake_counter = 5000;
+    CHECK(gpio_sequencer_queue(second, NULL, 2));
+    CHECK(RFTIMER_REG__COMPARE(6) == 5100);
+    gpio_sequencer_stop();
+    CHECK(gpio_sequencer_free_slots() == GPIO_SEQUENCER_NUM_SLOTS);
+}
+
+void test_packet_encoder(void) {
+    static const uint8_t expected[] = {
+        7,
+        PACKET_LC_CONFIG,    2, 0x9F, 0x0E,
+        PACKET_CLOCK_COUNTS, 5, 0xA2, 0xFC, 0x0A, 0xCD, 0x19
+    };
+    uint8_t buf[32];
+    packet_encoder_t enc;
+    
+    // 3/20/31, 179746 and 3277 counts, and no room left for the temperature
+    packet_encoder_begin(&enc, buf, 16, 7);
+    CHECK(packet_add_lc_config(&enc, 3, 20, 31));
+    CHECK(packet_add_clock_counts(&enc, 179746, 3277));
+    CHECK(!enc.overflow);
+    CHECK(!packet_add_temperature(&enc, -250));
+    CHECK(enc.overflow);
+    CHECK(packet_encoder_end(&enc) == sizeof(expected) + 2);
+    CHECK(memcmp(buf, expected, sizeof(expected)) == 0);
+    
+    // -2.50 degrees zigzags to 499, padded up to the shortest frame
+    packet_encoder_begin(&enc, buf, sizeof(buf), 1);
+    CHECK(packet_add_temperature(&enc, -250));
+    CHECK(packet_encoder_end(&enc) == PACKET_MIN_FRAME_LEN);
+    CHECK(buf[1] == PACKET_TEMPERATURE && buf[2] == 2 && buf[3] == 0xF3 && buf[4] == 0x03);
+    CHECK(buf[5] == PACKET_PAD);
+    
+    // the sampler is empty after test_imu_sampler()
+    CHECK(!packet_add_imu(&enc));
+    CHECK(!enc.overflow);
+}
+
+void test_sweep_results(void) {
+    uint8_t buf[16];
+    packet_encoder_t enc;
+    uint16_t next_row;
+    uint8_t first, last;
+    
+    sweep_results_clear();
+    sweep_results_mark(3, 20, 7);
+    sweep_results_mark(3, 20, 31);
+    sweep_results_mark(3, 20, 7);
+    sweep_results_mark(3, 4, 0);
+    sweep_results_mark(30, 1, 2);
+    CHECK(sweep_results_count() == 4);
+    CHECK(sweep_results_get(3, 20, 31) && !sweep_results_get(3, 20, 30));
+    CHECK(sweep_results_fines(3, 20) == 0x80000080);
+    CHECK(sweep_results_mids(3) == ((1u << 20) | (1u << 4)));
+    CHECK(sweep_results_fine_range(3, 20, &first, &last) && first == 7 && last == 31);
+    CHECK(!sweep_results_fine_range(3, 21, &first, &last));
+    
+    // a 16 byte frame holds one row, so the three take three payloads
+    next_row = 0;
+    packet_encoder_begin(&enc, buf, sizeof(buf), 0);
+    CHECK(!sweep_results_pack(&enc, &next_row));
+    CHECK(next_row == 3 * 32 + 20);
+    CHECK(buf[1] == PACKET_SWEEP_ROW && buf[3] == 3 && buf[4] == 4 && buf[5] == 0x01);
+    
+    packet_encoder_begin(&enc, buf, sizeof(buf), 1);
+    CHECK(!sweep_results_pack(&enc, &next_row));
+    CHECK(buf[4] == 20 && buf[5] == 0x80 && buf[8] == 0x80);
+    
+    packet_encoder_begin(&enc, buf, sizeof(buf), 2);
+    CHECK(sweep_results_pack(&enc, &next_row));
+    CHECK(buf[3] == 30 && buf[4] == 1 && buf[5] == 0x04);
+    CHECK(next_row == SWEEP_RESULTS_NUM_ROWS);
+    
+    sweep_results_clear();
+    CHECK(sweep_results_count() == 0 && sweep_results_mids(3) == 0);
+}
+
+// Supply monitor input at each wake up of test_solar_duty()
+static const uint32_t solar_power_good[] = {0x0100, 0x0100, 0x0000, 0x0000, 0x0100};
+uint8_t solar_wakes;
+
+// Stands in for the sleep: jumps to the compare and sets the monitor input
+void solar_idle(void) {
+    fake_counter = RFTIMER_REG__COMPARE(1);
+    hal_poke(APB_GPIO_BASE, solar_power_good[solar_wakes++]);
+    rftimer_isr_callback(1);
+}
+
+void test_solar_duty(void) {
+    hal_reset();
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    hal_set_idle_hook(solar_idle);
+    fake_counter = 1000;
+    solar_wakes  = 0;
+    
+    // a quarter shorter after each good supply
+    solar_duty_init(1000, 8000, 0x0100);
+    solar_duty_sleep();
+    CHECK(fake_counter == 1000 + 8000 * RFTIMER_TICKS_PER_MS);
+    CHECK(solar_duty_interval_ms() == 6000);
+    solar_duty_sleep();
+    CHECK(solar_duty_interval_ms() == 4500);
+    
+    // a low supply doubles it up to the maximum and sleeps until it is good
+    solar_duty_sleep();
+    CHECK(solar_wakes == 5);
+    CHECK(solar_duty_last_sleep_ms() == 4500 + 8000 + 8000);
+    CHECK(solar_duty_power_waits() == 2);
+    CHECK(solar_duty_interval_ms() == 8000);
+    
+    // no monitor, no adapting
+    solar_wakes = 0;
+    solar_duty_init(1000, 8000, 0);
+    solar_duty_sleep();
+    CHECK(solar_wakes == 1 && solar_duty_interval_ms() == 8000);
+    
+    hal_set_idle_hook(NULL);
+}
+
+uint8_t aggregate_sent[64];
+uint8_t aggregate_sent_len;
+uint8_t aggregate_sends;
+bool    aggregate_budget_ok;
+
+void aggregate_send(uint8_t* payload, uint8_t len) {
+    memcpy(aggregate_sent, payload, len);
+    aggregate_sent_len = len;
+    aggregate_sends++;
+}
+
+bool aggregate_budget(void) {
+    return aggregate_budget_ok;
+}
+
+void test_aggregator(void) {
+    static const uint8_t expected[] = {
+        0,
+        PACKET_TIME,        2, 0xE8, 0x07,
+        PACKET_TEMPERATURE, 2, 0xCC, 0x21,
+        PACKET_TIME,        1, 10,
+        PACKET_TEMPERATURE, 2, 0xCE, 0x21
+    };
+    uint8_t buf[24];
+    
+    hal_reset();
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    aggregate_sends = 0;
+    
+    // 21.50 and 21.51 degrees at 1000 and 1010 ms share a frame
+    aggregator_init(buf, sizeof(buf), 1000, aggregate_send);
+    fake_counter = 1000 * RFTIMER_TICKS_PER_MS + 123;
+    CHECK(aggregator_add_temperature(2150));
+    fake_counter += 10 * RFTIMER_TICKS_PER_MS;
+    CHECK(aggregator_add_temperature(2151));
+    CHECK(aggregator_pending() == 2 && aggregate_sends == 0);
+    
+    // full, the third reading starts the next frame
+    fake_counter += 10 * RFTIMER_TICKS_PER_MS;
+    CHECK(aggregator_add_temperature(2152));
+    CHECK(aggregate_sends == 1 && aggregator_pending() == 1);
+    CHECK(aggregate_sent_len == sizeof(expected) + 2);
+    CHECK(memcmp(aggregate_sent, expected, sizeof(expected)) == 0);
+    
+    // sent once its first reading is a second old
+    fake_counter += 999 * RFTIMER_TICKS_PER_MS;
+    CHECK(!aggregator_poll());
+    fake_counter += RFTIMER_TICKS_PER_MS;
+    CHECK(aggregator_poll());
+    CHECK(aggregate_sends == 2 && aggregate_sent[0] == 1 && aggregator_pending() == 0);
+    CHECK(!aggregator_poll());
+    
+    // without the budget the frame waits, and what does not fit is dropped
+    aggregator_set_budget(aggregate_budget);
+    aggregate_budget_ok = false;
+    CHECK(aggregator_add_clock_counts(179746, 3277));
+    CHECK(aggregator_add_clock_counts(179746, 3277));
+    CHECK(!aggregator_add_clock_counts(179746, 3277));
+    fake_counter += 2000 * RFTIMER_TICKS_PER_MS;
+    CHECK(!aggregator_poll());
+    CHECK(aggregator_dropped() == 1 && aggregator_pending() == 2);
+    aggregate_budget_ok = true;
+    CHECK(aggregator_poll());
+    CHECK(aggregator_frames() == 3 && aggregate_sends == 3);
+    
+    aggregator_set_budget(NULL);
+}
+
+uint8_t ack_rx_frames;
+
+void ack_rx(uint8_t* packet, uint8_t packet_len) {
+    ack_rx_frames++;
+}
+
+// the radio interrupt for INT at RF timer time NOW
+void ack_radio_isr(uint32_t now, uint32_t interrupt, uint32_t error) {
+    fake_counter               = now;
+    RFCONTROLLER_REG__INT      = interrupt;
+    RFCONTROLLER_REG__ERROR    = error;
+    radio_isr();
+    RFCONTROLLER_REG__INT      = 0;
+    RFCONTROLLER_REG__ERROR    = 0;
+}
+
+void ack_receive(uint32_t now, uint8_t counter, uint32_t error) {
+    uint8_t* rx_buf;
+    
+    ack_radio_isr(now - 1000, RX_SFD_DONE_INT, 0);
+    rx_buf    = (uint8_t*) DMA_REG__RF_RX_ADDR;
+    rx_buf[0] = LEN_RX_PKT;
+    rx_buf[1] = counter;
+    ack_radio_isr(now, RX_DONE_INT, error);
+}
+
+void test_ack_engine(void) {
+    uint8_t expected[ACK_ENGINE_MAX_LEN];
+    uint8_t expected_len;
+    
+    hal_reset();
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    hal_set_hooks(AHB_RF_BASE, 0x4, NULL, record_write);
+    hal_set_hooks(APB_UART_BASE, 0x4, NULL, uart_write);
+    ack_rx_frames = 0;
+    
+    radio_setCallbacks(ack_rx);
+    ack_engine_init(1000);
+    ack_engine_enable(22, 15, 24, 3);
+    ack_engine_listen(21, 17, 22);
+    radio_rxEnable();
+    tx_rx_mode = 1;
+    
+    // loaded at RX done, sent a turnaround later, with the counter and the RX code
+    ack_receive(2000, 42, 0);
+    CHECK(ack_rx_frames == 1);
+    CHECK(RFTIMER_REG__COMPARE(0) == 2000 + ACK_ENGINE_MIN_WARMUP_TICKS);
+    expected_len = ack_engine_build(expected, 42, 21, 17, 22);
+    CHECK(RFCONTROLLER_REG__TX_PACK_LEN == expected_len);
+    CHECK(memcmp((uint8_t*) RFCONTROLLER_REG__TX_DATA_ADDR, expected, expected_len - LENGTH_CRC) == 0);
+    CHECK(last_write_value == TX_LOAD);
+    fake_counter = 3000;
+    rftimer_isr_callback(0);
+    CHECK(last_write_value == TX_SEND);
+    CHECK(ack_engine_last_turnaround() == 1000);
+    
+    // the second one is timed from the end of the first
+    ack_radio_isr(3700, TX_SEND_DONE_INT, 0);
+    CHECK(ack_engine_sent() == 1);
+    CHECK(RFTIMER_REG__COMPARE(0) == 4700);
+    fake_counter = 4700;
+    rftimer_isr_callback(0);
+    CHECK(last_write_value == TX_SEND);
+    
+    // handled too close to its turnaround, the third still gets the warm-up
+    fake_counter = 6350;
+    ack_engine_endFrame_tx(5400);
+    CHECK(ack_engine_late() == 1);
+    CHECK(last_write_value == TX_LOAD);
+    CHECK(RFTIMER_REG__COMPARE(0) == 6350 + ACK_ENGINE_MIN_WARMUP_TICKS);
+    fake_counter = 7350;
+    rftimer_isr_callback(0);
+    CHECK(last_write_value == TX_SEND);
+    ack_radio_isr(8050, TX_SEND_DONE_INT, 0);
+    CHECK(ack_engine_sent() == 3);
+    CHECK(rftimer_vars.rftimer_cbs[0] == cb_timer);
+    
+    // nothing for a bad CRC or once disabled
+    ack_receive(10000, 43, 0x08);
+    ack_engine_disable();
+    ack_receive(11000, 44, 0);
+    CHECK(ack_rx_frames == 3);
+    CHECK(RFTIMER_REG__COMPARE(0) == 7350);
+    CHECK(ack_engine_sent() == 3 && ack_engine_late() == 1);
+    
+    // a turnaround shorter than the warm-up is kept, the radio can't do better
+    ack_engine_init(250);
+    ack_engine_enable(22, 15, 24, 1);
+    ack_receive(20000, 45, 0);
+    CHECK(RFTIMER_REG__COMPARE(0) == 20000 + ACK_ENGINE_MIN_WARMUP_TICKS);
+    CHECK(ack_engine_late() == 1);
+}
+
+// runs the window of the sync_rx compare through to the listen
+void sync_rx_open_window(void) {
+    fake_counter = RFTIMER_REG__COMPARE(SYNC_RX_COMPARE);
+    rftimer_isr_callback(SYNC_RX_COMPARE);
+    fake_counter = RFTIMER_REG__COMPARE(SYNC_RX_COMPARE);
+    rftimer_isr_callback(SYNC_RX_COMPARE);
+}
+
+void test_sync_rx(void) {
+    uint8_t i;
+    
+    hal_reset();
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    
+    // the interval comes from the first two frames
+    sync_rx_init(100, 50, NULL);
+    sync_rx_listen();
+    sync_rx_startFrame(10000);
+    sync_rx_endFrame(true);
+    CHECK(!sync_rx_locked());
+    fake_counter = 60000;
+    sync_rx_startFrame(60000);
+    sync_rx_endFrame(true);
+    CHECK(sync_rx_locked() && sync_rx_interval() == 50000);
+    
+    // on at 110000 - guard - startup, listening from 110000 - guard to 110000 + guard
+    CHECK(RFTIMER_REG__COMPARE(SYNC_RX_COMPARE) == 109850);
+    fake_counter = 109850;
+    rftimer_isr_callback(SYNC_RX_COMPARE);
+    CHECK(RFTIMER_REG__COMPARE(SYNC_RX_COMPARE) == 109900);
+    fake_counter = 109900;
+    rftimer_isr_callback(SYNC_RX_COMPARE);
+    CHECK(RFTIMER_REG__COMPARE(SYNC_RX_COMPARE) == 110100);
+    
+    // 40 ticks late: half of it goes in the interval, the next window follows the SFD
+    sync_rx_startFrame(110040);
+    CHECK(RFTIMER_REG__COMPARE(SYNC_RX_COMPARE) == 110040 + 2100);
+    CHECK(sync_rx_last_listen_ticks() == 190);
+    fake_counter = 110500;
+    sync_rx_endFrame(true);
+    CHECK(sync_rx_last_error() == 40 && sync_rx_interval() == 50020);
+    CHECK(RFTIMER_REG__COMPARE(SYNC_RX_COMPARE) == 160060 - 150);
+    
+    // a miss widens the next window
+    sync_rx_open_window();
+    fake_counter = RFTIMER_REG__COMPARE(SYNC_RX_COMPARE);
+    rftimer_isr_callback(SYNC_RX_COMPARE);
+    CHECK(sync_rx_misses() == 1 && sync_rx_locked());
+    CHECK(RFTIMER_REG__COMPARE(SYNC_RX_COMPARE) == 210080 - 200 - 50);
+    
+    // and enough of them in a row drop the lock
+    for (i = 1; i < 8; i++) {
+        sync_rx_open_window();
+        fake_counter = RFTIMER_REG__COMPARE(SYNC_RX_COMPARE);
+        rftimer_isr_callback(SYNC_RX_COMPARE);
+    }
+    CHECK(sync_rx_misses() == 8 && !sync_rx_locked());
+    sync_rx_stop();
+}
+
+uint8_t rx_filter_frames;
+
+void count_rx_frame(uint32_t timestamp) {
+    rx_filter_frames++;
+}
+
+void test_radio_rx_filter(void) {
+    // data frame, short destination, PAN ID compression, to 0x0001 on 0xcafe
+    static const uint8_t frame[] = {20 + LENGTH_CRC, 0x41, 0x88, 7, 0xfe, 0xca, 0x01, 0x00};
+    radio_rx_filter_t filter;
+    uint8_t*          rx_buf;
+    
+    hal_reset();
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, counter_read, NULL);
+    hal_set_hooks(AHB_RF_BASE, 0x4, NULL, record_write);
+    radio_init();
+    radio_setEndFrameRxCb(count_rx_frame);
+    radio_rxEnable();
+    rx_buf = (uint8_t*) DMA_REG__RF_RX_ADDR;
+    rx_filter_frames = 0;
+    
+    filter.checks      = RADIO_FILTER_LENGTH | RADIO_FILTER_TYPE | RADIO_FILTER_PANID | RADIO_FILTER_DEST;
+    filter.min_len     = 10;
+    filter.max_len     = 30;
+    filter.frame_types = 1 << 1;
+    filter.panid       = DEFAULT_PANID;
+    filter.short_addr  = 0x0001;
+    radio_setRxFilter(&filter);
+    
+    memcpy(rx_buf, frame, sizeof(frame));
+    ack_radio_isr(1000, RX_DONE_INT, 0);
+    CHECK(rx_filter_frames == 1 && radio_getRxFiltered() == 0);
+    
+    // another PAN, another address or an ACK frame are dropped and the receiver re-armed
+    rx_buf[PANID_INDEX] = 0xfd;
+    ack_radio_isr(2000, RX_DONE_INT, 0);
+    CHECK(last_write_value == RX_START);
+    rx_buf[PANID_INDEX] = 0xff;
+    rx_buf[PANID_INDEX + 1] = 0xff;
+    rx_buf[PANID_INDEX + 2] = 0x02;
+    ack_radio_isr(3000, RX_DONE_INT, 0);
+    rx_buf[PANID_INDEX + 2] = 0x01;
+    rx_buf[1] = 0x42;
+    ack_radio_isr(4000, RX_DONE_INT, 0);
+    rx_buf[0] = 5;
+    ack_radio_isr(5000, RX_DONE_INT, 0);
+    CHECK(rx_filter_frames == 1 && radio_getRxFiltered() == 4);
+    
+    // broadcast PAN, and no filter
+    rx_buf[0] = 20 + LENGTH_CRC;
+    rx_buf[1] = 0x41;
+    ack_radio_isr(6000, RX_DONE_INT, 0);
+    CHECK(rx_filter_frames == 2);
+    radio_setRxFilter(NULL);
+    rx_buf[0] = 5;
+    ack_radio_isr(7000, RX_DONE_INT, 0);
+    CHECK(rx_filter_frames == 3 && radio_getRxFiltered() == 4);
+}
+
+void test_image_config(void) {
+    uint32_t* header;
+    uint8_t   config[4];
+    
+    header = (uint32_t*) HAL_IMAGE(IMAGE_CONFIG_ADDR);
+    memset(HAL_IMAGE(0), 0, HAL_IMAGE_SIZE);
+    
+    // same CRC as the Teensy, zlib.crc32() in tools/experiment_config.py
+    CHECK(crc32c((unsigned char*) "123456789", 9) == 0xCBF43926);
+    
+    memset(config, 0xEE, sizeof(config));
+    CHECK(!image_read_config(config, sizeof(config)));
+    CHECK(config[0] == 0xEE);
+    
+    header[0] = IMAGE_CONFIG_MAGIC;
+    header[1] = 4;
+    memcpy(HAL_IMAGE(IMAGE_CONFIG_ADDR + IMAGE_CONFIG_HEADER_LEN), "\x01\x02\x03\x04", 4);
+    header[2] = crc32c(HAL_IMAGE(IMAGE_CONFIG_ADDR + IMAGE_CONFIG_HEADER_LEN), 4);
+    IMAGE_CODE_LENGTH = 0x8000;
+    CHECK(image_read_config(config, sizeof(config)));
+    CHECK(config[0] == 1 && config[3] == 4);
+    
+    // a block for another layout, a corrupted one or one under the code is ignored
+    memset(config, 0xEE, sizeof(config));
+    CHECK(!image_read_config(config, 3));
+    *HAL_IMAGE(IMAGE_CONFIG_ADDR + IMAGE_CONFIG_HEADER_LEN + 1) ^= 0x10;
+    CHECK(!image_read_config(config, sizeof(config)));
+    *HAL_IMAGE(IMAGE_CONFIG_ADDR + IMAGE_CONFIG_HEADER_LEN + 1) ^= 0x10;
+    IMAGE_CODE_LENGTH = IMAGE_CONFIG_ADDR + 1;
+    CHECK(!image_read_config(config, sizeof(config)));
+    CHECK(config[0] == 0xEE);
+    
+    memset(HAL_IMAGE(0), 0, HAL_IMAGE_SIZE);
+}
+
+void test_image_blocks(void) {
+    uint32_t*    table;
+    uint32_t     bad_block_map[2];
+    unsigned int i, length;
+    
+    table = (uint32_t*) HAL_IMAGE(IMAGE_BLOCK_CRC_TABLE_ADDR);
+    memset(HAL_IMAGE(0), 0, HAL_IMAGE_SIZE);
+    
+    // four blocks, the last one cut short
+    IMAGE_CODE_LENGTH = 3 * IMAGE_BLOCK_SIZE + 100;
+    for (i = 0; i < IMAGE_CODE_LENGTH; i++) {
+        *HAL_IMAGE(i) = (uint8_t) (i * 7 + (i >> 8));
+    }
+    IMAGE_CRC_VALUE = crc32c(HAL_IMAGE(0), IMAGE_CODE_LENGTH);
+    
+    *((uint32_t*) HAL_IMAGE(IMAGE_BLOCK_CRC_MAGIC_ADDR)) = IMAGE_BLOCK_CRC_MAGIC;
+    *((uint32_t*) HAL_IMAGE(IMAGE_BLOCK_CRC_COUNT_ADDR)) = 4;
+    for (i = 0; i < 4; i++) {
+        length = i < 3 ? IMAGE_BLOCK_SIZE : 100;
+        table[i] = crc32c(HAL_IMAGE(i * IMAGE_BLOCK_SIZE), length);
+    }
+    
+    CHECK(image_has_block_crcs());
+    bad_block_map[0] = 0;
+    bad_block_map[1] = 0;
+    CHECK(image_verify_blocks(0, IMAGE_MAX_BLOCKS, bad_block_map) == 0);
+    CHECK(bad_block_map[0] == 0 && bad_block_map[1] == 0);
+    CHECK(image_verify_range(0, IMAGE_CODE_LENGTH));
+    
+    // one flipped byte only marks its own block
+    *HAL_IMAGE(2 * IMAGE_BLOCK_SIZE + 17) ^= 0x01;
+    CHECK(image_verify_blocks(0, IMAGE_MAX_BLOCKS, bad_block_map) == 1);
+    CHECK(bad_block_map[0] == (1u << 2) && bad_block_map[1] == 0);
+    CHECK(!image_verify_range(2 * IMAGE_BLOCK_SIZE + 500, 4));
+    CHECK(!image_verify_range(IMAGE_BLOCK_SIZE + 1000, 100));
+    CHECK(image_verify_range(0, 2 * IMAGE_BLOCK_SIZE));
+    CHECK(image_verify_range(3 * IMAGE_BLOCK_SIZE, 100));
+    
+    // without a valid magic word only the whole image CRC is used
+    *((uint32_t*) HAL_IMAGE(IMAGE_BLOCK_CRC_MAGIC_ADDR)) = 0;
+    CHECK(!image_has_block_crcs());
+    CHECK(image_report_bad_blocks() == 0);
+    CHECK(!image_verify_range(0, 4));
+    *((uint32_t*) HAL_IMAGE(IMAGE_BLOCK_CRC_MAGIC_ADDR)) = IMAGE_BLOCK_CRC_MAGIC ^ 0x100;
+    CHECK(!image_has_block_crcs());
+    *HAL_IMAGE(2 * IMAGE_BLOCK_SIZE + 17) ^= 0x01;
+    CHECK(image_verify_range(0, 4));
+    
+    // a table that does not cover the code is not used either
+    *((uint32_t*) HAL_IMAGE(IMAGE_BLOCK_CRC_MAGIC_ADDR)) = IMAGE_BLOCK_CRC_MAGIC;
+    CHECK(image_has_block_crcs());
+    *((uint32_t*) HAL_IMAGE(IMAGE_BLOCK_CRC_COUNT_ADDR)) = 3;
+    CHECK(!image_has_block_crcs());
+    
+    memset(HAL_IMAGE(0), 0, HAL_IMAGE_SIZE);
+}
+
+// word 2 of the SRAM test range has bit 4 stuck at 1
+uint32_t sram_stuck_read(uint32_t addr, uint32_t value) {
+    return value | 0x10;
+}
+
+// writing word 5 clears bit 8 of word 6
+void sram_coupled_write(uint32_t addr, uint32_t value) {
+    hal_poke(TEST_BASE + 6 * 4, hal_peek(TEST_BASE + 6 * 4) & ~0x100u);
+}
+
+void test_sram_march(void) {
+    sram_test_result_t result;
+    
+    hal_reset();
+    hal_set_hooks(AHB_RFTIMER_BASE, 0x80, ticking_counter_read, NULL);
+    
+    CHECK(sram_march_test((unsigned int*) TEST_BASE, 16, &result));
+    CHECK(result.num_errors == 0 && result.failing_bits == 0 && result.failing_passes == 0);
+    CHECK(result.bytes_accessed == 16 * 4 * (6 * 10 + 4));
+    CHECK(HAL_REG(TEST_BASE + 4) == ~(TEST_BASE + 4));
+    
+    hal_set_hooks(TEST_BASE + 2 * 4, 4, sram_stuck_read, NULL);
+    hal_set_hooks(TEST_BASE + 5 * 4, 4, NULL, sram_coupled_write);
+    CHECK(sram_march_test((unsigned int*) TEST_BASE, 16, &result));
+    CHECK(result.num_errors > 0);
+    CHECK(result.first_error_addr == TEST_BASE + 2 * 4);
+    CHECK(result.first_error_expected == 0 && result.first_error_actual == 0x10);
+    CHECK(result.failing_bits == 0x110);
+    // all 6 backgrounds have both values of both bits, and the address pass bit 4 clear
+    CHECK(result.failing_passes == 0x7F);
+}
+
+//=========================== main ============================================
+
+int main(void) {
+    test_registers();
+    test_write_hooks();
+    test_rftimer();
+    test_counters();
+    test_telemetry();
+    test_uart_rftimer_init();
+    test_imu_burst();
+    test_spi_transfer();
+    test_imu_sampler();
+    test_temperature();
+    test_fixed_point();
+    test_waveform();
+    test_gpio_sequencer();
+    test_packet_encoder();
+    test_sweep_results();
+    test_solar_duty();
+    test_aggregator();
+    test_ack_engine();
+    test_sync_rx();
+    test_radio_rx_filter();
+    test_sram_march();
+    test_image_config();
+    test_image_blocks();
+    
+    printf("test_hal: all passed\n");
+    return 0;
+}
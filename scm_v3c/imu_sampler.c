@@ -0,0 +1,209 @@
+/**
+\brief Periodic IMU sampling into a FIFO, packed into delta encoded frames.
+
+An RF timer compare reads the IMU at fixed deadlines, each one the previous
+plus the period, so the sample timestamps stay on a grid instead of drifting
+by the interrupt latency. Deadlines that already passed are skipped and
+counted, and a sample that finds the FIFO full is dropped and counted.
+
+imu_sampler_pack() turns the oldest samples into one frame:
+
+    [samples] [timestamp, 4 bytes LE] [period, 2 bytes LE]
+    [first sample, 6 x int16 LE] [6 zigzag varint deltas] ...
+
+with acc x/y/z then gyro x/y/z in each sample. The samples of a frame are
+consecutive deadlines, a gap starts a new frame. tools/telemetry_receiver.py
+decodes the frames sent on TELEMETRY_CHANNEL_IMU.
+*/
+
+#include <string.h>
+
+#include "memory_map.h"
+#include "rftimer.h"
+#include "packet_encoder.h"
+#include "imu_sampler.h"
+
+//=========================== defines =========================================
+
+#define IMU_SAMPLER_RFTIMER_COMPAREID   4
+
+#define IMU_SAMPLER_FIFO_MASK           (IMU_SAMPLER_FIFO_SIZE - 1)
+#define IMU_NUM_AXES                    6
+
+//=========================== variables =======================================
+
+typedef struct {
+    imu_sample_t        fifo[IMU_SAMPLER_FIFO_SIZE];
+    volatile uint16_t   head;           // next free slot, only moved by the sampler
+    volatile uint16_t   tail;           // oldest sample, only moved by the reader
+    uint32_t            period_ticks;
+    uint32_t            next_tick;
+    volatile bool       running;
+    volatile uint32_t   dropped;        // samples lost to a full FIFO
+    volatile uint32_t   missed;         // deadlines skipped because we were late
+} imu_sampler_vars_t;
+
+imu_sampler_vars_t imu_sampler_vars;
+
+//=========================== prototypes ======================================
+
+void    imu_sampler_tick(void);
+void    imu_sampler_axes(const imu_data_t* data, int16_t* axes);
+
+//=========================== public ==========================================
+
+/* Starts sampling at RATE_HZ, from IMU_SAMPLER_MIN_RATE_HZ to
+ * IMU_SAMPLER_MAX_RATE_HZ, with an empty FIFO. The period is rounded down to
+ * whole RF timer ticks. The IMU must have been initialized.
+ */
+bool imu_sampler_start(uint16_t rate_hz) {
+    if (rate_hz < IMU_SAMPLER_MIN_RATE_HZ || rate_hz > IMU_SAMPLER_MAX_RATE_HZ) {
+        return false;
+    }
+
+    imu_sampler_stop();
+    memset(&imu_sampler_vars, 0, sizeof(imu_sampler_vars_t));
+    imu_sampler_vars.period_ticks = (RFTIMER_TICKS_PER_MS * 1000u) / rate_hz;
+
+    rftimer_set_callback(imu_sampler_tick, IMU_SAMPLER_RFTIMER_COMPAREID);
+    rftimer_set_repeat(false, IMU_SAMPLER_RFTIMER_COMPAREID);
+
+    imu_sampler_vars.running   = true;
+    imu_sampler_vars.next_tick = rftimer_readCounter() + imu_sampler_vars.period_ticks;
+    rftimer_setCompareIn(imu_sampler_vars.next_tick, IMU_SAMPLER_RFTIMER_COMPAREID);
+    return true;
+}
+
+void imu_sampler_stop(void) {
+    imu_sampler_vars.running = false;
+    // only this compare, rftimer_disable_interrupts() would mask all of them
+    RFTIMER_REG__COMPARE_CONTROL(IMU_SAMPLER_RFTIMER_COMPAREID) = 0x0;
+}
+
+uint16_t imu_sampler_count(void) {
+    return (imu_sampler_vars.head - imu_sampler_vars.tail) & IMU_SAMPLER_FIFO_MASK;
+}
+
+// Takes the oldest sample out of the FIFO, from the main loop only
+bool imu_sampler_pop(imu_sample_t* sample) {
+    if (imu_sampler_vars.tail == imu_sampler_vars.head) {
+        return false;
+    }
+    memcpy(sample, &imu_sampler_vars.fifo[imu_sampler_vars.tail], sizeof(imu_sample_t));
+    imu_sampler_vars.tail = (imu_sampler_vars.tail + 1) & IMU_SAMPLER_FIFO_MASK;
+    return true;
+}
+
+/* Packs as many of the oldest samples as fit in MAX_LEN bytes into FRAME (see
+ * the top of this file) and takes them out of the FIFO. Returns the length of
+ * the frame, 0 if there was no sample or no room for one. From the main loop
+ * only.
+ */
+uint8_t imu_sampler_pack(uint8_t* frame, uint8_t max_len) {
+    int16_t  prev[IMU_NUM_AXES];
+    int16_t  axes[IMU_NUM_AXES];
+    uint8_t  delta[IMU_FRAME_MAX_DELTA_LEN];
+    uint8_t  len, delta_len, num_samples, i;
+    uint16_t index;
+    int32_t  d;
+    const imu_sample_t* sample;
+
+    index = imu_sampler_vars.tail;
+    if (index == imu_sampler_vars.head || max_len < IMU_FRAME_HEADER_LEN + IMU_FRAME_SAMPLE_LEN) {
+        return 0;
+    }
+
+    sample = &imu_sampler_vars.fifo[index];
+    frame[1] = (uint8_t)  sample->timestamp;
+    frame[2] = (uint8_t) (sample->timestamp >> 8);
+    frame[3] = (uint8_t) (sample->timestamp >> 16);
+    frame[4] = (uint8_t) (sample->timestamp >> 24);
+    frame[5] = (uint8_t)  imu_sampler_vars.period_ticks;
+    frame[6] = (uint8_t) (imu_sampler_vars.period_ticks >> 8);
+    len = IMU_FRAME_HEADER_LEN;
+
+    imu_sampler_axes(&sample->data, prev);
+    for (i = 0; i < IMU_NUM_AXES; i++) {
+        frame[len++] = (uint8_t)  prev[i];
+        frame[len++] = (uint8_t) ((uint16_t) prev[i] >> 8);
+    }
+    num_samples = 1;
+    index = (index + 1) & IMU_SAMPLER_FIFO_MASK;
+
+    while (index != imu_sampler_vars.head) {
+        if (imu_sampler_vars.fifo[index].timestamp - sample->timestamp != imu_sampler_vars.period_ticks) {
+            break;
+        }
+        sample = &imu_sampler_vars.fifo[index];
+
+        imu_sampler_axes(&sample->data, axes);
+        delta_len = 0;
+        for (i = 0; i < IMU_NUM_AXES; i++) {
+            // zigzag, small changes either way take one byte
+            d = (int32_t) axes[i] - prev[i];
+            delta_len += packet_put_varint(&delta[delta_len], packet_zigzag(d));
+        }
+        if (len + delta_len > max_len) {
+            break;
+        }
+        memcpy(&frame[len], delta, delta_len);
+        len += delta_len;
+        memcpy(prev, axes, sizeof(prev));
+
+        num_samples++;
+        index = (index + 1) & IMU_SAMPLER_FIFO_MASK;
+    }
+
+    frame[0] = num_samples;
+    imu_sampler_vars.tail = index;
+    return len;
+}
+
+uint32_t imu_sampler_dropped(void) {
+    return imu_sampler_vars.dropped;
+}
+
+uint32_t imu_sampler_missed(void) {
+    return imu_sampler_vars.missed;
+}
+
+//=========================== private =========================================
+
+void imu_sampler_axes(const imu_data_t* data, int16_t* axes) {
+    axes[0] = data->acc_x.value;
+    axes[1] = data->acc_y.value;
+    axes[2] = data->acc_z.value;
+    axes[3] = data->gyro_x.value;
+    axes[4] = data->gyro_y.value;
+    axes[5] = data->gyro_z.value;
+}
+
+//=========================== interrupt =======================================
+
+void imu_sampler_tick(void) {
+    uint16_t next_head;
+    uint32_t late;
+
+    if (!imu_sampler_vars.running) {
+        return;
+    }
+
+    next_head = (imu_sampler_vars.head + 1) & IMU_SAMPLER_FIFO_MASK;
+    if (next_head == imu_sampler_vars.tail) {
+        imu_sampler_vars.dropped++;
+    } else {
+        read_all_imu_data(&imu_sampler_vars.fifo[imu_sampler_vars.head].data);
+        imu_sampler_vars.fifo[imu_sampler_vars.head].timestamp = imu_sampler_vars.next_tick;
+        imu_sampler_vars.head = next_head;
+    }
+
+    // skip the deadlines we can't make any more, staying on the grid
+    imu_sampler_vars.next_tick += imu_sampler_vars.period_ticks;
+    late = rftimer_readCounter() - imu_sampler_vars.next_tick;
+    if ((int32_t) late >= 0) {
+        late = late / imu_sampler_vars.period_ticks + 1;
+        imu_sampler_vars.next_tick += late * imu_sampler_vars.period_ticks;
+        imu_sampler_vars.missed    += late;
+    }
+    rftimer_setCompareIn(imu_sampler_vars.next_tick, IMU_SAMPLER_RFTIMER_COMPAREID);
+}
@@ -0,0 +1,44 @@
+#ifndef __IMU_SAMPLER_H
+#define __IMU_SAMPLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "spi.h"
+
+//=========================== define ==========================================
+
+// power of 2, so the indexes can wrap with a mask
+#define IMU_SAMPLER_FIFO_SIZE       64
+
+// the period in RF timer ticks has to fit the 16 bits of the frame header
+#define IMU_SAMPLER_MIN_RATE_HZ     8
+#define IMU_SAMPLER_MAX_RATE_HZ     1000
+
+// [samples] [timestamp, 4 bytes LE] [period in RF timer ticks, 2 bytes LE]
+#define IMU_FRAME_HEADER_LEN        7
+// the first sample of a frame, 6 int16 LE in imu_data_t order
+#define IMU_FRAME_SAMPLE_LEN        12
+// the others, 6 zigzag varint deltas to the sample before
+#define IMU_FRAME_MAX_DELTA_LEN     18
+
+//=========================== typedef =========================================
+
+typedef struct {
+    uint32_t    timestamp;      // RF timer counter at the deadline it was taken for
+    imu_data_t  data;
+} imu_sample_t;
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+bool     imu_sampler_start(uint16_t rate_hz);
+void     imu_sampler_stop(void);
+uint16_t imu_sampler_count(void);
+bool     imu_sampler_pop(imu_sample_t* sample);
+uint8_t  imu_sampler_pack(uint8_t* frame, uint8_t max_len);
+uint32_t imu_sampler_dropped(void);
+uint32_t imu_sampler_missed(void);
+
+#endif
@@ -5,6 +5,11 @@
 \author Tengfei Chang   <tengfei.chang@inria.fr>    August 2016.
 */
 
+#ifndef __MEMORY_MAP_H
+#define __MEMORY_MAP_H
+
+#include "scum_hal.h"
+
 // ========================== AHB Peripheral ==================================
 
 #define     AHB_BOOTLOAD_BASE           0x01000000
@@ -22,16 +27,16 @@
 
 // ========================== RFCONTRLLER Registers ===========================
 
-#define RFCONTROLLER_REG__CONTROL       *(unsigned int*)(AHB_RF_BASE + 0x00)
-#define RFCONTROLLER_REG__STATUS        *(unsigned int*)(AHB_RF_BASE + 0x04)
-#define RFCONTROLLER_REG__TX_DATA_ADDR  *(char**)(AHB_RF_BASE + 0x08)
-#define RFCONTROLLER_REG__TX_PACK_LEN   *(unsigned int*)(AHB_RF_BASE + 0x0C)
-#define RFCONTROLLER_REG__INT           *(unsigned int*)(AHB_RF_BASE + 0x10)
-#define RFCONTROLLER_REG__INT_CONFIG    *(unsigned int*)(AHB_RF_BASE + 0x14)
-#define RFCONTROLLER_REG__INT_CLEAR     *(unsigned int*)(AHB_RF_BASE + 0x18)
-#define RFCONTROLLER_REG__ERROR         *(unsigned int*)(AHB_RF_BASE + 0x1C)
-#define RFCONTROLLER_REG__ERROR_CONFIG  *(unsigned int*)(AHB_RF_BASE + 0x20)
-#define RFCONTROLLER_REG__ERROR_CLEAR   *(unsigned int*)(AHB_RF_BASE + 0x24)
+#define RFCONTROLLER_REG__CONTROL       HAL_REG(AHB_RF_BASE + 0x00)
+#define RFCONTROLLER_REG__STATUS        HAL_REG(AHB_RF_BASE + 0x04)
+#define RFCONTROLLER_REG__TX_DATA_ADDR  HAL_REG_PTR(AHB_RF_BASE + 0x08)
+#define RFCONTROLLER_REG__TX_PACK_LEN   HAL_REG(AHB_RF_BASE + 0x0C)
+#define RFCONTROLLER_REG__INT           HAL_REG(AHB_RF_BASE + 0x10)
+#define RFCONTROLLER_REG__INT_CONFIG    HAL_REG(AHB_RF_BASE + 0x14)
+#define RFCONTROLLER_REG__INT_CLEAR     HAL_REG(AHB_RF_BASE + 0x18)
+#define RFCONTROLLER_REG__ERROR         HAL_REG(AHB_RF_BASE + 0x1C)
+#define RFCONTROLLER_REG__ERROR_CONFIG  HAL_REG(AHB_RF_BASE + 0x20)
+#define RFCONTROLLER_REG__ERROR_CLEAR   HAL_REG(AHB_RF_BASE + 0x24)
 
 // ==== RFCONTROLLER interruption bit configuration
 
@@ -80,27 +85,31 @@
 
 // ========================== RFTIMER Registers ===============================
 
-#define RFTIMER_REG__COMPARE0_ADDR          (unsigned int*)(AHB_RFTIMER_BASE + 0x10)
-#define RFTIMER_REG__COMPARE1_ADDR          (unsigned int*)(AHB_RFTIMER_BASE + 0x14)
-#define RFTIMER_REG__COMPARE2_ADDR          (unsigned int*)(AHB_RFTIMER_BASE + 0x18)
-#define RFTIMER_REG__COMPARE3_ADDR          (unsigned int*)(AHB_RFTIMER_BASE + 0x1C)
-#define RFTIMER_REG__COMPARE4_ADDR          (unsigned int*)(AHB_RFTIMER_BASE + 0x20)
-#define RFTIMER_REG__COMPARE5_ADDR          (unsigned int*)(AHB_RFTIMER_BASE + 0x24)
-#define RFTIMER_REG__COMPARE6_ADDR          (unsigned int*)(AHB_RFTIMER_BASE + 0x28)
-#define RFTIMER_REG__COMPARE7_ADDR          (unsigned int*)(AHB_RFTIMER_BASE + 0x2C)
+#define RFTIMER_REG__COMPARE0_ADDR          (&HAL_REG(AHB_RFTIMER_BASE + 0x10))
+#define RFTIMER_REG__COMPARE1_ADDR          (&HAL_REG(AHB_RFTIMER_BASE + 0x14))
+#define RFTIMER_REG__COMPARE2_ADDR          (&HAL_REG(AHB_RFTIMER_BASE + 0x18))
+#define RFTIMER_REG__COMPARE3_ADDR          (&HAL_REG(AHB_RFTIMER_BASE + 0x1C))
+#define RFTIMER_REG__COMPARE4_ADDR          (&HAL_REG(AHB_RFTIMER_BASE + 0x20))
+#define RFTIMER_REG__COMPARE5_ADDR          (&HAL_REG(AHB_RFTIMER_BASE + 0x24))
+#define RFTIMER_REG__COMPARE6_ADDR          (&HAL_REG(AHB_RFTIMER_BASE + 0x28))
+#define RFTIMER_REG__COMPARE7_ADDR          (&HAL_REG(AHB_RFTIMER_BASE + 0x2C))
 	
-#define RFTIMER_REG__COMPARE0_CONTROL_ADDR  (unsigned int*)(AHB_RFTIMER_BASE + 0x30)
-#define RFTIMER_REG__COMPARE1_CONTROL_ADDR  (unsigned int*)(AHB_RFTIMER_BASE + 0x34)
-#define RFTIMER_REG__COMPARE2_CONTROL_ADDR  (unsigned int*)(AHB_RFTIMER_BASE + 0x38)
-#define RFTIMER_REG__COMPARE3_CONTROL_ADDR  (unsigned int*)(AHB_RFTIMER_BASE + 0x3C)
-#define RFTIMER_REG__COMPARE4_CONTROL_ADDR  (unsigned int*)(AHB_RFTIMER_BASE + 0x40)
-#define RFTIMER_REG__COMPARE5_CONTROL_ADDR  (unsigned int*)(AHB_RFTIMER_BASE + 0x44)
-#define RFTIMER_REG__COMPARE6_CONTROL_ADDR  (unsigned int*)(AHB_RFTIMER_BASE + 0x48)
-#define RFTIMER_REG__COMPARE7_CONTROL_ADDR  (unsigned int*)(AHB_RFTIMER_BASE + 0x4C)
-
-#define RFTIMER_REG__CONTROL           *(unsigned int*)(AHB_RFTIMER_BASE + 0x00)
-#define RFTIMER_REG__COUNTER           *(unsigned int*)(AHB_RFTIMER_BASE + 0x04)
-#define RFTIMER_REG__MAX_COUNT         *(unsigned int*)(AHB_RFTIMER_BASE + 0x08)
+#define RFTIMER_REG__COMPARE0_CONTROL_ADDR  (&HAL_REG(AHB_RFTIMER_BASE + 0x30))
+#define RFTIMER_REG__COMPARE1_CONTROL_ADDR  (&HAL_REG(AHB_RFTIMER_BASE + 0x34))
+#define RFTIMER_REG__COMPARE2_CONTROL_ADDR  (&HAL_REG(AHB_RFTIMER_BASE + 0x38))
+#define RFTIMER_REG__COMPARE3_CONTROL_ADDR  (&HAL_REG(AHB_RFTIMER_BASE + 0x3C))
+#define RFTIMER_REG__COMPARE4_CONTROL_ADDR  (&HAL_REG(AHB_RFTIMER_BASE + 0x40))
+#define RFTIMER_REG__COMPARE5_CONTROL_ADDR  (&HAL_REG(AHB_RFTIMER_BASE + 0x44))
+#define RFTIMER_REG__COMPARE6_CONTROL_ADDR  (&HAL_REG(AHB_RFTIMER_BASE + 0x48))
+#define RFTIMER_REG__COMPARE7_CONTROL_ADDR  (&HAL_REG(AHB_RFTIMER_BASE + 0x4C))
+
+// compare registers by index (0-7)
+#define RFTIMER_REG__COMPARE(id)            HAL_REG(AHB_RFTIMER_BASE + 0x10 + ((id) << 2))
+#define RFTIMER_REG__COMPARE_CONTROL(id)    HAL_REG(AHB_RFTIMER_BASE + 0x30 + ((id) << 2))
+
+#define RFTIMER_REG__CONTROL           HAL_REG(AHB_RFTIMER_BASE + 0x00)
+#define RFTIMER_REG__COUNTER           HAL_REG(AHB_RFTIMER_BASE + 0x04)
+#define RFTIMER_REG__MAX_COUNT         HAL_REG(AHB_RFTIMER_BASE + 0x08)
 #define RFTIMER_REG__COMPARE0          *RFTIMER_REG__COMPARE0_ADDR
 #define RFTIMER_REG__COMPARE1          *RFTIMER_REG__COMPARE1_ADDR
 #define RFTIMER_REG__COMPARE2          *RFTIMER_REG__COMPARE2_ADDR
@@ -117,16 +126,16 @@
 #define RFTIMER_REG__COMPARE5_CONTROL  *RFTIMER_REG__COMPARE5_CONTROL_ADDR
 #define RFTIMER_REG__COMPARE6_CONTROL  *RFTIMER_REG__COMPARE6_CONTROL_ADDR
 #define RFTIMER_REG__COMPARE7_CONTROL  *RFTIMER_REG__COMPARE7_CONTROL_ADDR
-#define RFTIMER_REG__CAPTURE0          *(unsigned int*)(AHB_RFTIMER_BASE + 0x50)
-#define RFTIMER_REG__CAPTURE1          *(unsigned int*)(AHB_RFTIMER_BASE + 0x54)
-#define RFTIMER_REG__CAPTURE2          *(unsigned int*)(AHB_RFTIMER_BASE + 0x58)
-#define RFTIMER_REG__CAPTURE3          *(unsigned int*)(AHB_RFTIMER_BASE + 0x5C)
-#define RFTIMER_REG__CAPTURE0_CONTROL  *(unsigned int*)(AHB_RFTIMER_BASE + 0x60)
-#define RFTIMER_REG__CAPTURE1_CONTROL  *(unsigned int*)(AHB_RFTIMER_BASE + 0x64)
-#define RFTIMER_REG__CAPTURE2_CONTROL  *(unsigned int*)(AHB_RFTIMER_BASE + 0x68)
-#define RFTIMER_REG__CAPTURE3_CONTROL  *(unsigned int*)(AHB_RFTIMER_BASE + 0x6C)
-#define RFTIMER_REG__INT               *(unsigned int*)(AHB_RFTIMER_BASE + 0x70)
-#define RFTIMER_REG__INT_CLEAR         *(unsigned int*)(AHB_RFTIMER_BASE + 0x74)
+#define RFTIMER_REG__CAPTURE0          HAL_REG(AHB_RFTIMER_BASE + 0x50)
+#define RFTIMER_REG__CAPTURE1          HAL_REG(AHB_RFTIMER_BASE + 0x54)
+#define RFTIMER_REG__CAPTURE2          HAL_REG(AHB_RFTIMER_BASE + 0x58)
+#define RFTIMER_REG__CAPTURE3          HAL_REG(AHB_RFTIMER_BASE + 0x5C)
+#define RFTIMER_REG__CAPTURE0_CONTROL  HAL_REG(AHB_RFTIMER_BASE + 0x60)
+#define RFTIMER_REG__CAPTURE1_CONTROL  HAL_REG(AHB_RFTIMER_BASE + 0x64)
+#define RFTIMER_REG__CAPTURE2_CONTROL  HAL_REG(AHB_RFTIMER_BASE + 0x68)
+#define RFTIMER_REG__CAPTURE3_CONTROL  HAL_REG(AHB_RFTIMER_BASE + 0x6C)
+#define RFTIMER_REG__INT               HAL_REG(AHB_RFTIMER_BASE + 0x70)
+#define RFTIMER_REG__INT_CLEAR         HAL_REG(AHB_RFTIMER_BASE + 0x74)
 
 // ==== RFTIMER compare control bit
 
@@ -175,69 +184,97 @@
 
 // ========================== DMA Registers ===================================
 
-#define DMA_REG__RF_RX_ADDR     *(char**)(AHB_DMA_BASE + 0x14)
+#define DMA_REG__RF_RX_ADDR     HAL_REG_PTR(AHB_DMA_BASE + 0x14)
 
 // ========================== ADC Registers ===================================
 
-#define ADC_REG__START          *(unsigned int*)(APB_ADC_BASE + 0x000000)
-#define ADC_REG__DATA           *(unsigned int*)(APB_ADC_BASE + 0x040000)
+#define ADC_REG__START          HAL_REG(APB_ADC_BASE + 0x000000)
+#define ADC_REG__DATA           HAL_REG(APB_ADC_BASE + 0x040000)
 
 // ========================== UART Registers ==================================
 
-#define UART_REG__TX_DATA       *(unsigned int*)(APB_UART_BASE)
-#define UART_REG__RX_DATA       *(unsigned int*)(APB_UART_BASE)
+#define UART_REG__TX_DATA       HAL_REG(APB_UART_BASE)
+#define UART_REG__RX_DATA       HAL_REG(APB_UART_BASE)
     
 // ========================== GPIO Registers ==================================
 
-#define GPIO_REG__INPUT         *(unsigned int*)(APB_GPIO_BASE + 0x000000)
-#define GPIO_REG__OUTPUT        *(unsigned int*)(APB_GPIO_BASE + 0x040000)
+#define GPIO_REG__INPUT         HAL_REG(APB_GPIO_BASE + 0x000000)
+#define GPIO_REG__OUTPUT        HAL_REG(APB_GPIO_BASE + 0x040000)
     
 // ========================== Analog Configure Registers ======================
 
-#define ANALOG_CFG_REG__0       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x000000)
-#define ANALOG_CFG_REG__1       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x040000)
-#define ANALOG_CFG_REG__2       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x080000)
-#define ANALOG_CFG_REG__3       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x0C0000)
-#define ANALOG_CFG_REG__4       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x100000)
-#define ANALOG_CFG_REG__5       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x140000) // contains 2.4 GHz divider control, see bucket_o_functions/divProgram()
-#define ANALOG_CFG_REG__6       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x180000) // contains 2.4 GHz divider control, see bucket_o_functions/divProgram()
-#define ANALOG_CFG_REG__7       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x1C0000) // contains 2.4 GHz oscillator control, see bucket_o_functions/LC_freqchange
-#define ANALOG_CFG_REG__8       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x200000) // contains 2.4 GHz oscillator control, see bucket_o_functions/LC_freqchange
-#define ANALOG_CFG_REG__9       *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x240000)
-#define ANALOG_CFG_REG__10      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x280000)
-#define ANALOG_CFG_REG__11      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x2C0000) // contains control bits for the arbitrary TX FIFO, apparently
-#define ANALOG_CFG_REG__12      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x300000)
-#define ANALOG_CFG_REG__13      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x340000)
-#define ANALOG_CFG_REG__14      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x380000)
-#define ANALOG_CFG_REG__15      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x3C0000)
-#define ANALOG_CFG_REG__16      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x400000)
-#define ANALOG_CFG_REG__17      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x440000)
-#define ANALOG_CFG_REG__18      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x480000)
-#define ANALOG_CFG_REG__19      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x4C0000)
-#define ANALOG_CFG_REG__20      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x500000)
-#define ANALOG_CFG_REG__21      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x540000)
-#define ANALOG_CFG_REG__22      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x580000)
-#define ANALOG_CFG_REG__23      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x5C0000)
-#define ANALOG_CFG_REG__24      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x600000)
-#define ANALOG_CFG_REG__25      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x640000)
-#define ANALOG_CFG_REG__26      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x680000)
-#define ANALOG_CFG_REG__27      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x6C0000)
-#define ANALOG_CFG_REG__28      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x700000)
-#define ANALOG_CFG_REG__29      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x740000)
-#define ANALOG_CFG_REG__30      *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x780000)
-
-#define ACFG_LO__ADDR           *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x1C0000)
-#define ACFG_LO__ADDR_2         *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x200000)
+#define ANALOG_CFG_REG__0       HAL_REG(APB_ANALOG_CFG_BASE + 0x000000)
+#define ANALOG_CFG_REG__1       HAL_REG(APB_ANALOG_CFG_BASE + 0x040000)
+#define ANALOG_CFG_REG__2       HAL_REG(APB_ANALOG_CFG_BASE + 0x080000)
+#define ANALOG_CFG_REG__3       HAL_REG(APB_ANALOG_CFG_BASE + 0x0C0000)
+#define ANALOG_CFG_REG__4       HAL_REG(APB_ANALOG_CFG_BASE + 0x100000)
+#define ANALOG_CFG_REG__5       HAL_REG(APB_ANALOG_CFG_BASE + 0x140000) // contains 2.4 GHz divider control, see bucket_o_functions/divProgram()
+#define ANALOG_CFG_REG__6       HAL_REG(APB_ANALOG_CFG_BASE + 0x180000) // contains 2.4 GHz divider control, see bucket_o_functions/divProgram()
+#define ANALOG_CFG_REG__7       HAL_REG(APB_ANALOG_CFG_BASE + 0x1C0000) // contains 2.4 GHz oscillator control, see bucket_o_functions/LC_freqchange
+#define ANALOG_CFG_REG__8       HAL_REG(APB_ANALOG_CFG_BASE + 0x200000) // contains 2.4 GHz oscillator control, see bucket_o_functions/LC_freqchange
+#define ANALOG_CFG_REG__9       HAL_REG(APB_ANALOG_CFG_BASE + 0x240000)
+#define ANALOG_CFG_REG__10      HAL_REG(APB_ANALOG_CFG_BASE + 0x280000)
+#define ANALOG_CFG_REG__11      HAL_REG(APB_ANALOG_CFG_BASE + 0x2C0000) // contains control bits for the arbitrary TX FIFO, apparently
+#define ANALOG_CFG_REG__12      HAL_REG(APB_ANALOG_CFG_BASE + 0x300000)
+#define ANALOG_CFG_REG__13      HAL_REG(APB_ANALOG_CFG_BASE + 0x340000)
+#define ANALOG_CFG_REG__14      HAL_REG(APB_ANALOG_CFG_BASE + 0x380000)
+#define ANALOG_CFG_REG__15      HAL_REG(APB_ANALOG_CFG_BASE + 0x3C0000)
+#define ANALOG_CFG_REG__16      HAL_REG(APB_ANALOG_CFG_BASE + 0x400000)
+#define ANALOG_CFG_REG__17      HAL_REG(APB_ANALOG_CFG_BASE + 0x440000)
+#define ANALOG_CFG_REG__18      HAL_REG(APB_ANALOG_CFG_BASE + 0x480000)
+#define ANALOG_CFG_REG__19      HAL_REG(APB_ANALOG_CFG_BASE + 0x4C0000)
+#define ANALOG_CFG_REG__20      HAL_REG(APB_ANALOG_CFG_BASE + 0x500000)
+#define ANALOG_CFG_REG__21      HAL_REG(APB_ANALOG_CFG_BASE + 0x540000)
+#define ANALOG_CFG_REG__22      HAL_REG(APB_ANALOG_CFG_BASE + 0x580000)
+#define ANALOG_CFG_REG__23      HAL_REG(APB_ANALOG_CFG_BASE + 0x5C0000)
+#define ANALOG_CFG_REG__24      HAL_REG(APB_ANALOG_CFG_BASE + 0x600000)
+#define ANALOG_CFG_REG__25      HAL_REG(APB_ANALOG_CFG_BASE + 0x640000)
+#define ANALOG_CFG_REG__26      HAL_REG(APB_ANALOG_CFG_BASE + 0x680000)
+#define ANALOG_CFG_REG__27      HAL_REG(APB_ANALOG_CFG_BASE + 0x6C0000)
+#define ANALOG_CFG_REG__28      HAL_REG(APB_ANALOG_CFG_BASE + 0x700000)
+#define ANALOG_CFG_REG__29      HAL_REG(APB_ANALOG_CFG_BASE + 0x740000)
+#define ANALOG_CFG_REG__30      HAL_REG(APB_ANALOG_CFG_BASE + 0x780000)
+
+#define ACFG_LO__ADDR           HAL_REG(APB_ANALOG_CFG_BASE + 0x1C0000)
+#define ACFG_LO__ADDR_2         HAL_REG(APB_ANALOG_CFG_BASE + 0x200000)
+
+// ========================== Clock Counter Registers =========================
+
+// Counter values are read back from the analog config space as 16-bit halves
+// Only valid once the counters have been disabled through ANALOG_CFG_REG__0
+#define COUNTER_REG__32K_LSB    HAL_REG(APB_ANALOG_CFG_BASE + 0x000000)
+#define COUNTER_REG__32K_MSB    HAL_REG(APB_ANALOG_CFG_BASE + 0x040000)
+#define COUNTER_REG__HF_LSB     HAL_REG(APB_ANALOG_CFG_BASE + 0x100000)
+#define COUNTER_REG__HF_MSB     HAL_REG(APB_ANALOG_CFG_BASE + 0x140000)
+#define COUNTER_REG__2M_LSB     HAL_REG(APB_ANALOG_CFG_BASE + 0x180000)
+#define COUNTER_REG__2M_MSB     HAL_REG(APB_ANALOG_CFG_BASE + 0x1C0000)
+#define COUNTER_REG__LC_DIV_LSB HAL_REG(APB_ANALOG_CFG_BASE + 0x280000)
+#define COUNTER_REG__LC_DIV_MSB HAL_REG(APB_ANALOG_CFG_BASE + 0x2C0000)
+#define COUNTER_REG__IF_LSB     HAL_REG(APB_ANALOG_CFG_BASE + 0x300000)
+#define COUNTER_REG__IF_MSB     HAL_REG(APB_ANALOG_CFG_BASE + 0x340000)
+
+// Values written to ANALOG_CFG_REG__0 to control all counters at once
+#define COUNTERS_RESET          0x0000
+#define COUNTERS_ENABLE         0x3FFF
+#define COUNTERS_DISABLE        0x007F
 
 // Interrupt clear/set enable register
-#define ISER                    *(unsigned int*)(0xE000E100)
-#define ICER                    *(unsigned int*)(0xE000E180)
+#define ISER                    HAL_REG(0xE000E100)
+#define ICER                    HAL_REG(0xE000E180)
 // Interrupt clear/set pending register
-#define ICPR                    *(unsigned int*)(0xE000E280)
-#define ISPR                    *(unsigned int*)(0xE000E200)
+#define ICPR                    HAL_REG(0xE000E280)
+#define ISPR                    HAL_REG(0xE000E200)
+// Interrupt control and state register, VECTACTIVE is non-zero inside an ISR
+#define ICSR                    HAL_REG(0xE000ED04)
+#define ICSR_VECTACTIVE         0x1FF
+// Application interrupt and reset control register, write AIRCR_SYSRESETREQ to reset
+#define AIRCR                   HAL_REG(0xE000ED0C)
+#define AIRCR_SYSRESETREQ       0x05FA0004
 
 // =========================== Priority Registers =============================
 
-#define IPR0                    *(unsigned int*)( 0xE000E400 )
-#define IPR6                    *(unsigned int*)( 0xE000E418 )
-#define IPR7                    *(unsigned int*)( 0xE000E41C )
+#define IPR0                    HAL_REG(0xE000E400)
+#define IPR6                    HAL_REG(0xE000E418)
+#define IPR7                    HAL_REG(0xE000E41C)
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "memory_map.h"
 #include "scm3c_hw_interface.h"
+#include "counters.h"
+#include "binlog.h"
 
 #include "radio.h"
 #include "scum_defs.h"
@@ -117,8 +119,7 @@ void optical_sfd_isr(){
     optical_vars.optical_cal_iteration++;
     
 		// Reset the counters in preparation of next iteration
-    reset_counters();
-		enable_counters();
+    counters_restart();
         
     // Don't make updates on the first two executions of this ISR
 		// only make updates until the number of desired iterations is reached
@@ -207,7 +208,7 @@ void optical_sfd_isr(){
         analog_scan_chain_load();
 				
 				// Debugging output
-				printf("HF=%d-%d   2M=%d-%d,%d,%d   LC=%d-%d   IF=%d-%d,%d\r\n",count_HFclock,HF_CLOCK_fine,count_2M,RC2M_coarse,RC2M_fine,RC2M_superfine,count_LC,optical_vars.LC_code,count_IF,IF_coarse,IF_fine); 
+				binlog(BINLOG_OPTICAL_CAL,count_HFclock,HF_CLOCK_fine,count_2M,RC2M_coarse,RC2M_fine,RC2M_superfine,count_LC,optical_vars.LC_code,count_IF,IF_coarse,IF_fine); 
     }
     
 		// on the very last iteration of optical calibration, store the final counts
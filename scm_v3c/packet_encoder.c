@@ -0,0 +1,206 @@
+/**
+\brief Builds binary TX payloads out of type-length-value records.
+
+A payload is the packet counter followed by records:
+
+    [counter] [type] [length] [value] [type] [length] [value] ... [0 padding]
+
+The record types and the layout of their values are in packet_encoder.h.
+Counts and temperatures are base 128 varints, like the binlog arguments, so
+the usual values take 2 or 3 bytes instead of 6 or more digits and the
+formatting is a few shifts instead of a call to sprintf. The length lets the
+decoder skip record types it does not know. tools/packet_decode.py decodes
+the payloads.
+
+A record that does not fit is left out and sets the overflow flag, the
+records before it are still sent.
+*/
+
+#include <string.h>
+
+#include "radio.h"
+#include "scm3c_hw_interface.h"
+#include "imu_sampler.h"
+#include "packet_encoder.h"
+
+//=========================== defines =========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+uint8_t* packet_open_record(packet_encoder_t* enc, uint8_t type, uint8_t value_len);
+bool     packet_add_varint(packet_encoder_t* enc, uint8_t type, uint32_t value);
+
+//=========================== public ==========================================
+
+/* Starts a payload in BUF, BUF_LEN bytes long including the room for the CRC
+ * the radio appends, with COUNTER as the first byte.
+ */
+void packet_encoder_begin(packet_encoder_t* enc, uint8_t* buf, uint8_t buf_len, uint8_t counter) {
+    enc->buf      = buf;
+    enc->max_len  = buf_len - LENGTH_CRC;
+    enc->overflow = false;
+    enc->buf[0]   = counter;
+    enc->len      = 1;
+}
+
+// Pads the payload to the shortest frame and returns the length for send_packet_len()
+uint8_t packet_encoder_end(packet_encoder_t* enc) {
+    while (enc->len + LENGTH_CRC < PACKET_MIN_FRAME_LEN && enc->len < enc->max_len) {
+        enc->buf[enc->len++] = PACKET_PAD;
+    }
+    return enc->len + LENGTH_CRC;
+}
+
+bool packet_add_lc_config(packet_encoder_t* enc, uint8_t coarse, uint8_t mid, uint8_t fine) {
+    uint8_t* value;
+    uint16_t config;
+
+    value = packet_open_record(enc, PACKET_LC_CONFIG, 2);
+    if (value == NULL) {
+        return false;
+    }
+    config = ((uint16_t) (coarse & 0x1F) << 10) | ((uint16_t) (mid & 0x1F) << 5) | (fine & 0x1F);
+    value[0] = (uint8_t)  config;
+    value[1] = (uint8_t) (config >> 8);
+    return true;
+}
+
+bool packet_add_clock_counts(packet_encoder_t* enc, uint32_t count_2M, uint32_t count_32k) {
+    uint8_t  varints[2 * PACKET_MAX_VARINT_LEN];
+    uint8_t  len;
+    uint8_t* value;
+
+    len  = packet_put_varint(&varints[0], count_2M);
+    len += packet_put_varint(&varints[len], count_32k);
+
+    value = packet_open_record(enc, PACKET_CLOCK_COUNTS, len);
+    if (value == NULL) {
+        return false;
+    }
+    memcpy(value, varints, len);
+    return true;
+}
+
+bool packet_add_temperature(packet_encoder_t* enc, int32_t centi_degrees) {
+    // zigzag, so a few degrees below zero is as short as above
+    return packet_add_varint(enc, PACKET_TEMPERATURE, packet_zigzag(centi_degrees));
+}
+
+// The current HF clock, RC 2 MHz and IF settings, one byte each
+bool packet_add_optical(packet_encoder_t* enc) {
+    uint8_t* value;
+
+    value = packet_open_record(enc, PACKET_OPTICAL, PACKET_OPTICAL_LEN);
+    if (value == NULL) {
+        return false;
+    }
+    value[0] = (uint8_t) scm3c_hw_interface_get_HF_CLOCK_coarse();
+    value[1] = (uint8_t) scm3c_hw_interface_get_HF_CLOCK_fine();
+    value[2] = (uint8_t) scm3c_hw_interface_get_RC2M_coarse();
+    value[3] = (uint8_t) scm3c_hw_interface_get_RC2M_fine();
+    value[4] = (uint8_t) scm3c_hw_interface_get_RC2M_superfine();
+    value[5] = (uint8_t) scm3c_hw_interface_get_IF_coarse();
+    value[6] = (uint8_t) scm3c_hw_interface_get_IF_fine();
+    return true;
+}
+
+/* Packs the oldest IMU samples into a frame filling what is left of the
+ * payload. Returns false if there were none or no sample fits.
+ */
+bool packet_add_imu(packet_encoder_t* enc) {
+    uint8_t room, len;
+
+    if (enc->len + PACKET_RECORD_HEADER_LEN > enc->max_len) {
+        enc->overflow = true;
+        return false;
+    }
+    room = enc->max_len - enc->len - PACKET_RECORD_HEADER_LEN;
+
+    len = imu_sampler_pack(&enc->buf[enc->len + PACKET_RECORD_HEADER_LEN], room);
+    if (len == 0) {
+        return false;
+    }
+    enc->buf[enc->len]     = PACKET_IMU;
+    enc->buf[enc->len + 1] = len;
+    enc->len += PACKET_RECORD_HEADER_LEN + len;
+    return true;
+}
+
+// Fine codes that worked at COARSE/MID, code n at bit n of FINES
+bool packet_add_sweep_row(packet_encoder_t* enc, uint8_t coarse, uint8_t mid, uint32_t fines) {
+    uint8_t* value;
+
+    value = packet_open_record(enc, PACKET_SWEEP_ROW, PACKET_SWEEP_ROW_LEN);
+    if (value == NULL) {
+        return false;
+    }
+    value[0] = coarse;
+    value[1] = mid;
+    value[2] = (uint8_t)  fines;
+    value[3] = (uint8_t) (fines >> 8);
+    value[4] = (uint8_t) (fines >> 16);
+    value[5] = (uint8_t) (fines >> 24);
+    return true;
+}
+
+// Time of the records after it, see PACKET_TIME
+bool packet_add_time(packet_encoder_t* enc, uint32_t ms) {
+    return packet_add_varint(enc, PACKET_TIME, ms);
+}
+
+bool packet_add_adc(packet_encoder_t* enc, uint16_t value) {
+    return packet_add_varint(enc, PACKET_ADC, value);
+}
+
+// Base 128, low bits first, returns the number of bytes written
+uint8_t packet_put_varint(uint8_t* buf, uint32_t value) {
+    uint8_t len;
+
+    len = 0;
+    while (value >= 0x80) {
+        buf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[len++] = (uint8_t) value;
+    return len;
+}
+
+// Maps 0, -1, 1, -2... to 0, 1, 2, 3..., so small negative values make short varints too
+uint32_t packet_zigzag(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t)(value >> 31);
+}
+
+//=========================== private =========================================
+
+// Writes the record header, returns where the value goes or NULL if it does not fit
+uint8_t* packet_open_record(packet_encoder_t* enc, uint8_t type, uint8_t value_len) {
+    uint8_t* value;
+
+    if (enc->len + PACKET_RECORD_HEADER_LEN + value_len > enc->max_len) {
+        enc->overflow = true;
+        return NULL;
+    }
+    enc->buf[enc->len]     = type;
+    enc->buf[enc->len + 1] = value_len;
+    value = &enc->buf[enc->len + PACKET_RECORD_HEADER_LEN];
+    enc->len += PACKET_RECORD_HEADER_LEN + value_len;
+    return value;
+}
+
+// A record holding a single varint
+bool packet_add_varint(packet_encoder_t* enc, uint8_t type, uint32_t value) {
+    uint8_t  varint[PACKET_MAX_VARINT_LEN];
+    uint8_t  len;
+    uint8_t* record;
+
+    len = packet_put_varint(varint, value);
+
+    record = packet_open_record(enc, type, len);
+    if (record == NULL) {
+        return false;
+    }
+    memcpy(record, varint, len);
+    return true;
+}
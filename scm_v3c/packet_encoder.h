@@ -0,0 +1,57 @@
+#ifndef __PACKET_ENCODER_H
+#define __PACKET_ENCODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+// record types, 0 pads the end of the payload
+enum {
+    PACKET_PAD              = 0x00,
+    PACKET_LC_CONFIG        = 0x01,     // coarse<<10 | mid<<5 | fine, 2 bytes LE
+    PACKET_CLOCK_COUNTS     = 0x02,     // 2 MHz and 32 kHz counts, 2 varints
+    PACKET_TEMPERATURE      = 0x03,     // hundredths of a degree, zigzag varint
+    PACKET_OPTICAL          = 0x04,     // optical calibration settings, 7 bytes
+    PACKET_IMU              = 0x05,     // an imu_sampler_pack() frame
+    PACKET_SWEEP_ROW        = 0x06,     // coarse, mid, working fine codes 4 bytes LE, see sweep_results.c
+    PACKET_TIME             = 0x07,     // ms since the previous time record, the first since boot, varint
+    PACKET_ADC              = 0x08      // ADC reading, varint
+};
+
+// [type] [length of the value]
+#define PACKET_RECORD_HEADER_LEN    2
+#define PACKET_OPTICAL_LEN          7
+#define PACKET_SWEEP_ROW_LEN        6
+// frames shorter than this were seen not to arrive, see LEN_TX_PKT
+#define PACKET_MIN_FRAME_LEN        8
+// a 32-bit value takes at most 5 varint bytes
+#define PACKET_MAX_VARINT_LEN       5
+
+//=========================== typedef =========================================
+
+typedef struct {
+    uint8_t*    buf;
+    uint8_t     len;
+    uint8_t     max_len;        // payload bytes that fit, without the CRC
+    bool        overflow;       // a record did not fit and was left out
+} packet_encoder_t;
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void    packet_encoder_begin(packet_encoder_t* enc, uint8_t* buf, uint8_t buf_len, uint8_t counter);
+uint8_t packet_encoder_end(packet_encoder_t* enc);
+bool    packet_add_lc_config(packet_encoder_t* enc, uint8_t coarse, uint8_t mid, uint8_t fine);
+bool    packet_add_clock_counts(packet_encoder_t* enc, uint32_t count_2M, uint32_t count_32k);
+bool    packet_add_temperature(packet_encoder_t* enc, int32_t centi_degrees);
+bool    packet_add_optical(packet_encoder_t* enc);
+bool    packet_add_imu(packet_encoder_t* enc);
+bool    packet_add_sweep_row(packet_encoder_t* enc, uint8_t coarse, uint8_t mid, uint32_t fines);
+bool    packet_add_time(packet_encoder_t* enc, uint32_t ms);
+bool    packet_add_adc(packet_encoder_t* enc, uint16_t value);
+uint8_t packet_put_varint(uint8_t* buf, uint32_t value);
+uint32_t packet_zigzag(int32_t value);
+
+#endif
@@ -7,6 +7,11 @@
 #include "scm3c_hw_interface.h"
 #include "radio.h"
 #include "rftimer.h"
+#include "counters.h"
+#include "uart.h"
+#include "binlog.h"
+#include "telemetry.h"
+#include "ack_engine.h"
 
 // raw_chip interrupt related
 unsigned int chips[100];
@@ -44,12 +49,25 @@ signed short cdr_tau_history[11] = {0};
 
 #define FREQ_UPDATE_RATE        15
 
+// LC_div counting window per step when building the channel tables, about
+// as long as the 16000 iteration spin loop it replaces at nominal HCLK
+#define CHANNEL_CAL_COUNT_DURATION_TICKS    (6 * RFTIMER_TICKS_PER_MS)
+
 //===== for recognizing panid
 
 #define  LEN_PKT_INDEX           0x00
+#define  FCF_LBYTE_PKT_INDEX     0x01
+#define  FCF_HBYTE_PKT_INDEX     0x02
 #define  PANID_LBYTE_PKT_INDEX   0x04
 #define  PANID_HBYTE_PKT_INDEX   0x05
-#define  DEFAULT_PANID           0xcafe
+#define  DEST_LBYTE_PKT_INDEX    0x06
+#define  DEST_HBYTE_PKT_INDEX    0x07
+
+#define  FCF_FRAME_TYPE_MASK     0x07    // in the low byte
+#define  FCF_DEST_MODE_SHIFT     2       // in the high byte
+#define  FCF_DEST_MODE_NONE      0
+#define  FCF_DEST_MODE_SHORT     2
+#define  BROADCAST_ID            0xffff
 
 //===== tx/rx parameters
 
@@ -75,6 +93,9 @@ typedef struct {
             uint8_t     current_frequency;
             bool        crc_ok;
             
+            radio_rx_filter_t rx_filter;
+            uint32_t    rx_filtered;
+            
             uint32_t    rx_channel_codes[NUM_CHANNELS];
             uint32_t    tx_channel_codes[NUM_CHANNELS];
     
@@ -120,6 +141,7 @@ radio_rx_cb receive_cb;
 //=========================== prototypes ======================================
 
 void        setFrequencyTX(uint8_t channel);
+bool        radio_rxFilterPass(void);
 void        setFrequencyRX(uint8_t channel);
 
 uint32_t    build_RX_channel_table(uint32_t channel_11_LC_code);
@@ -140,6 +162,11 @@ void radio_setCallbacks(radio_rx_cb rx_cb) { // rx_callback is custom callback s
 }
 
 void send_packet(uint8_t coarse, uint8_t mid, uint8_t fine, uint8_t *packet) {
+	send_packet_len(coarse, mid, fine, packet, LEN_TX_PKT);
+}
+
+// LEN includes the LENGTH_CRC bytes the radio fills in, up to MAX_LEN_TX_PKT
+void send_packet_len(uint8_t coarse, uint8_t mid, uint8_t fine, uint8_t *packet, uint8_t len) {
 	uint8_t copy_size;
 	uint8_t i;
 	int j;	
@@ -153,7 +180,7 @@ void send_packet(uint8_t coarse, uint8_t mid, uint8_t fine, uint8_t *packet) {
 //	}
 
 	//radio_loadPacket(app_vars_tx.packet, LEN_TX_PKT);	
-	radio_loadPacket(packet, LEN_TX_PKT);	
+	radio_loadPacket(packet, len);	
 	LC_FREQCHANGE(coarse, mid, fine);
 	
 	// log the packet contents
@@ -166,7 +193,9 @@ void send_packet(uint8_t coarse, uint8_t mid, uint8_t fine, uint8_t *packet) {
 	rftimer_setCompareIn(rftimer_readCounter()+TIMER_PERIOD_TX, RFTIMER_COMPAREID);
 	app_vars_tx.sendDone = false;
 		
-	while (app_vars_tx.sendDone==false);
+	while (app_vars_tx.sendDone==false) {
+		HAL_IDLE();
+	}
 }
 
 void receive_packet(uint8_t coarse, uint8_t mid, uint8_t fine) {	
@@ -189,24 +218,20 @@ void receive_packet(uint8_t coarse, uint8_t mid, uint8_t fine) {
 	app_vars_rx.changeConfig = false;
 	// the first check is to wait until the timer period is up
 	// the second check is to wait until the end frame rx is done (could take a while if sending ack packets)
-	while (app_vars_rx.changeConfig==false);
+	while (app_vars_rx.changeConfig==false) {
+		HAL_IDLE();
+	}
 }
 
+// Sends one ACK now, in the binary format of ack_engine.c, which sends them on time from the interrupts
 void send_ack(uint8_t coarse, uint8_t mid, uint8_t fine,uint8_t rx_coarse, uint8_t rx_mid, uint8_t rx_fine, uint8_t acknum) {
-	char tx_packet[LEN_TX_PKT];
-	
-//	tx_packet[0] = acknum;
-//	tx_packet[1] = rx_coarse;
-//	tx_packet[2] = rx_mid;
-//	tx_packet[3] = rx_fine;
+	uint8_t tx_packet[ACK_ENGINE_MAX_LEN];
 	
-	sprintf(tx_packet, "%d %d %d %d", acknum, rx_coarse, rx_mid, rx_fine);
-	
-	send_packet(coarse, mid, fine, tx_packet);
+	send_packet_len(coarse, mid, fine, tx_packet, ack_engine_build(tx_packet, acknum, rx_coarse, rx_mid, rx_fine));
 }
 
 void cb_startFrame_tx(uint32_t timestamp){
-	printf("starting tx frame\n");
+	binlog(BINLOG_TX_FRAME_START);
 }
 
 void cb_endFrame_tx(uint32_t timestamp){
@@ -240,7 +265,7 @@ void cb_endFrame_rx(uint32_t timestamp){
         
         //printf(
         //    "pkt received on ch%d %c%c%c%c.%d.%d.%d\r\n",
-				printf("Packet num %d. Packet contents 1-3: %d %d %d coarse: %d\tmid: %d\tfine: %d\n",
+				binlog(BINLOG_RX_PACKET,
             app_vars_rx.packet[0],
             app_vars_rx.packet[1],
             app_vars_rx.packet[2],
@@ -325,6 +350,17 @@ void radio_setEndFrameRxCb(radio_capture_cbt cb) {
     radio_vars.endFrame_rx_cb      = cb;
 }
 
+/* Frames that fail FILTER are dropped in radio_isr() and the receiver listens
+ * again right away, NULL to let everything through. Call it after radio_init().
+ */
+void radio_setRxFilter(const radio_rx_filter_t* filter) {
+    if (filter == NULL) {
+        radio_vars.rx_filter.checks = 0;
+        return;
+    }
+    radio_vars.rx_filter = *filter;
+}
+
 void radio_reset(void) {
     // reset SCuM radio module
     RFCONTROLLER_REG__CONTROL = RF_RESET;
@@ -598,8 +634,60 @@ int16_t radio_get_cdr_tau_value(void){
     return ANALOG_CFG_REG__25;
 }
 
+// Frames dropped by the RX filter since radio_init()
+uint32_t radio_getRxFiltered(void){
+    return radio_vars.rx_filtered;
+}
+
 //=========================== private =========================================
 
+// Checks the frame in the DMA buffer against the RX filter, without copying it
+bool radio_rxFilterPass(void){
+    radio_rx_filter_t*  filter = &radio_vars.rx_filter;
+    uint8_t*            frame  = radio_vars.radio_rx_buffer;
+    uint8_t             dest_mode;
+    uint16_t            id;
+    
+    if (filter->checks == 0) {
+        return true;
+    }
+    
+    if (filter->checks & RADIO_FILTER_LENGTH) {
+        if (frame[LEN_PKT_INDEX] < filter->min_len || frame[LEN_PKT_INDEX] > filter->max_len) {
+            return false;
+        }
+    }
+    
+    // the MAC header has to be there for the rest, up to the short address
+    if (frame[LEN_PKT_INDEX] < DEST_HBYTE_PKT_INDEX + LENGTH_CRC) {
+        return (filter->checks & ~RADIO_FILTER_LENGTH) == 0;
+    }
+    
+    if (filter->checks & RADIO_FILTER_TYPE) {
+        if ((filter->frame_types & (1 << (frame[FCF_LBYTE_PKT_INDEX] & FCF_FRAME_TYPE_MASK))) == 0) {
+            return false;
+        }
+    }
+    
+    dest_mode = (frame[FCF_HBYTE_PKT_INDEX] >> FCF_DEST_MODE_SHIFT) & 0x3;
+    
+    if (filter->checks & RADIO_FILTER_PANID) {
+        id = frame[PANID_LBYTE_PKT_INDEX] | (frame[PANID_HBYTE_PKT_INDEX] << 8);
+        if (dest_mode == FCF_DEST_MODE_NONE || (id != filter->panid && id != BROADCAST_ID)) {
+            return false;
+        }
+    }
+    
+    if (filter->checks & RADIO_FILTER_DEST) {
+        id = frame[DEST_LBYTE_PKT_INDEX] | (frame[DEST_HBYTE_PKT_INDEX] << 8);
+        if (dest_mode != FCF_DEST_MODE_SHORT || (id != filter->short_addr && id != BROADCAST_ID)) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
 // SCM has separate setFrequency functions for RX and TX because of the way the
 // radio is built. The LO needs to be set to a different frequency for TX vs RX.
 void setFrequencyRX(uint8_t channel){
@@ -617,9 +705,8 @@ void setFrequencyTX(uint8_t channel){
 
 uint32_t build_RX_channel_table(uint32_t channel_11_LC_code){
     
-    uint32_t    rdata_lsb,rdata_msb;
+    counters_snapshot_t snapshot;
     int32_t     i;
-    uint32_t    t;
     uint32_t    count_LC[16];
     uint32_t    count_targets[17];
     
@@ -635,22 +722,9 @@ uint32_t build_RX_channel_table(uint32_t channel_11_LC_code){
         //analog_scan_chain_write_3B_fromFPGA(&ASC[0]);
         //analog_scan_chain_load_3B_fromFPGA();
                     
-        // Reset all counters
-        ANALOG_CFG_REG__0 = 0x0000;
-        
-        // Enable all counters
-        ANALOG_CFG_REG__0 = 0x3FFF;    
-        
-        // Count for some arbitrary amount of time
-        for(t=1; t<16000; t++);
-        
-        // Disable all counters
-        ANALOG_CFG_REG__0 = 0x007F;
-
-        // Read count result
-        rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x280000);
-        rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x2C0000);
-        count_LC[i] = rdata_lsb + (rdata_msb << 16);
+        // Count LC_div for a fixed window
+        counters_measure(CHANNEL_CAL_COUNT_DURATION_TICKS, &snapshot);
+        count_LC[i] = snapshot.count_LC_div;
     
         count_targets[i+1] = ((961+(i+1)*2) * count_LC[0]) / 961;
         
@@ -685,8 +759,8 @@ uint32_t build_RX_channel_table(uint32_t channel_11_LC_code){
 
 void build_TX_channel_table(unsigned int channel_11_LC_code, unsigned int count_LC_RX_ch11){
     
-    unsigned int rdata_lsb,rdata_msb;
-    int t,i=0;
+    counters_snapshot_t snapshot;
+    int i=0;
     unsigned int count_LC[16] = {0};
     unsigned int count_targets[17] = {0};
     
@@ -705,22 +779,9 @@ void build_TX_channel_table(unsigned int channel_11_LC_code, unsigned int count_
         //analog_scan_chain_write_3B_fromFPGA(&ASC[0]);
         //analog_scan_chain_load_3B_fromFPGA();
                     
-        // Reset all counters
-        ANALOG_CFG_REG__0 = 0x0000;
-        
-        // Enable all counters
-        ANALOG_CFG_REG__0 = 0x3FFF;    
-        
-        // Count for some arbitrary amount of time
-        for(t=1; t<16000; t++);
-        
-        // Disable all counters
-        ANALOG_CFG_REG__0 = 0x007F;
-
-        // Read count result
-        rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x280000);
-        rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x2C0000);
-        count_LC[i] = rdata_lsb + (rdata_msb << 16);
+        // Count LC_div for a fixed window
+        counters_measure(CHANNEL_CAL_COUNT_DURATION_TICKS, &snapshot);
+        count_LC[i] = snapshot.count_LC_div;
         
         // Until figure out why modulation spacing is only 800kHz, only set 400khz above RF channel
         count_targets[i] = (nums[i] * count_LC_RX_ch11) / dens[i];
@@ -860,7 +921,12 @@ void radio_isr(void) {
         printf("RX DONE\r\n");
 #endif
         //printf("end frame rx interrupt %p\n", radio_vars.endFrame_rx_cb);
-        if (radio_vars.endFrame_rx_cb != 0) {
+        if (!radio_rxFilterPass()) {
+            // not for us, back to listening as if it never came
+            radio_vars.rx_filtered++;
+            radio_rxEnable();
+            radio_rxNow();
+        } else if (radio_vars.endFrame_rx_cb != 0) {
             radio_vars.endFrame_rx_cb(RFTIMER_REG__COUNTER);
         }
     }
@@ -894,19 +960,26 @@ void rawchips_32_isr() {
     ANALOG_CFG_REG__3 = acfg3_val;
 
     if(chip_index == 10){    
+#if TELEMETRY_ENABLED
+        // at the fast baud, the soft reset below brings the UART back to 19200
+        uart_set_fast_baud(true);
+        // chips[1..9] as the text dump below, little endian as they are in memory
+        telemetry_send(TELEMETRY_CHANNEL_RAW_CHIPS, (uint8_t*) &chips[1], 9 * sizeof(chips[0]));
+#else
         for(jj=1;jj<10;jj++){
             printf("%X\r\n",chips[jj]);
         }
+#endif
 
         ICER = 0x0100;
         ISER = 0x0200;
         chip_index = 0;
         
         // Wait for print to complete
-        for(jj=0;jj<10000;jj++);
+        uart_tx_flush();
         
         // Execute soft reset
-        *(unsigned int*)(0xE000ED0C) = 0x05FA0004;
+        AIRCR = AIRCR_SYSRESETREQ;
     }
 }
 
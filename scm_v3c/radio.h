@@ -9,6 +9,15 @@
 #define LENGTH_CRC      2
 #define LEN_TX_PKT          32+LENGTH_CRC  ///< length of tx packet //annecdotally length 7 packet didn't work, but length 8 did... maybe odd packet lengths don't work????
 #define LEN_RX_PKT          4+LENGTH_CRC  ///< length of rx packet
+#define MAX_LEN_TX_PKT      (125+LENGTH_CRC)  ///< longest frame send_packet_len() takes
+
+#define DEFAULT_PANID       0xcafe
+
+// checks of radio_rx_filter_t
+#define RADIO_FILTER_LENGTH     0x01
+#define RADIO_FILTER_TYPE       0x02
+#define RADIO_FILTER_PANID      0x04
+#define RADIO_FILTER_DEST       0x08
 
 typedef enum {
    FREQ_TX                        = 0x01,
@@ -25,6 +34,16 @@ typedef enum {
 typedef void  (*radio_capture_cbt)(uint32_t timestamp);
 typedef void  (*radio_rx_cb)(uint8_t *packet, uint8_t packet_len);
 
+// Frames radio_isr() drops at RX DONE, before any callback, see radio_setRxFilter()
+typedef struct {
+    uint8_t     checks;         // RADIO_FILTER_*, the others are not looked at
+    uint8_t     min_len;        // length byte of the frame, CRC included
+    uint8_t     max_len;
+    uint8_t     frame_types;    // 1 << 802.15.4 frame type, for each type let through
+    uint16_t    panid;          // destination PAN ID, 0xffff passes too
+    uint16_t    short_addr;     // destination short address, 0xffff passes too
+} radio_rx_filter_t;
+
 //=========================== variables =======================================
 
 //=========================== prototypes ======================================
@@ -38,6 +57,7 @@ void cb_endFrame_rx(uint32_t timestamp);
 void cb_timer(void);
 void radio_rxEnable_optical(void);
 void send_packet(uint8_t coarse, uint8_t mid, uint8_t fine, uint8_t *packet);
+void send_packet_len(uint8_t coarse, uint8_t mid, uint8_t fine, uint8_t *packet, uint8_t len);
 void receive_packet(uint8_t coarse, uint8_t mid, uint8_t fine);
 void send_ack(uint8_t coarse, uint8_t mid, uint8_t fine, uint8_t rx_coarse, uint8_t rx_mid, uint8_t rx_fine, uint8_t acknum);
 
@@ -48,6 +68,7 @@ void radio_setEndFrameTxCb(radio_capture_cbt cb);
 void radio_setStartFrameRxCb(radio_capture_cbt cb);
 void radio_setEndFrameRxCb(radio_capture_cbt cb);
 void radio_setErrorCb(radio_capture_cbt cb);
+void radio_setRxFilter(const radio_rx_filter_t* filter);
 void radio_rfOff(void);
 void radio_enable_interrupts(void);
 void radio_disable_interrupts(void);
@@ -57,6 +78,7 @@ bool        radio_getCrcOk(void);
 uint32_t    radio_getIFestimate(void);
 uint32_t    radio_getLQIchipErrors(void);
 int16_t     radio_get_cdr_tau_value(void);
+uint32_t    radio_getRxFiltered(void);
 
 //==== frequency
 void radio_frequency_housekeeping(
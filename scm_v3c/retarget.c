@@ -2,6 +2,7 @@
 #include <time.h>
 #include <rt_misc.h>
 #include "memory_map.h" 
+#include "uart.h"
 
  
 #pragma import(__use_no_semihosting)
@@ -25,11 +26,10 @@ int ferror(FILE *f) {
     return 0; 
 }
 
+// Buffered, see uart.c. Call uart_tx_flush() before anything that would lose
+// what is still queued, like a soft reset.
 int uart_out(int ch) {
-    unsigned char* UARTPtr;
-    UARTPtr = (unsigned char*)APB_UART_BASE;
-    *UARTPtr = (char)ch;
-    return(ch);
+    return(uart_tx_putc(ch));
 }
 
 int uart_in() {
@@ -20,36 +20,27 @@ bool delay_completed[NUM_INTERRUPTS]; // flag indicating whether the delay has c
 bool is_repeating[NUM_INTERRUPTS]; // flag indicating whethere each COMPARE will repeat at a fixed rate
 unsigned int timer_durations[NUM_INTERRUPTS]; // indicates length each COMPARE interrupt was set to run for. Used for repeating delay.
 
-unsigned int* RF_TIMER_REG_ADDRESSES[] = {RFTIMER_REG__COMPARE0_ADDR,
-																					RFTIMER_REG__COMPARE1_ADDR,
-																					RFTIMER_REG__COMPARE2_ADDR,
-																					RFTIMER_REG__COMPARE3_ADDR,
-																					RFTIMER_REG__COMPARE4_ADDR,
-																					RFTIMER_REG__COMPARE5_ADDR,
-																					RFTIMER_REG__COMPARE6_ADDR,
-																					RFTIMER_REG__COMPARE7_ADDR};
-
-unsigned int* RF_TIMER_REG_CONTROL_ADDRESES[] ={RFTIMER_REG__COMPARE0_CONTROL_ADDR,
-																								RFTIMER_REG__COMPARE1_CONTROL_ADDR,
-																								RFTIMER_REG__COMPARE2_CONTROL_ADDR,
-																								RFTIMER_REG__COMPARE3_CONTROL_ADDR,
-																								RFTIMER_REG__COMPARE4_CONTROL_ADDR,
-																								RFTIMER_REG__COMPARE5_CONTROL_ADDR,
-																								RFTIMER_REG__COMPARE6_CONTROL_ADDR,
-																								RFTIMER_REG__COMPARE7_CONTROL_ADDR};
-
 // ========================== prototype =======================================
 
 // ========================== public ==========================================
 
 void rftimer_init(void){
     
-    memset(&rftimer_vars, 0, sizeof(rftimer_vars_t));
+    // the callbacks stay, a module may have armed its compare already (uart.c
+    // does for the first printf)
+    rftimer_vars.rftimer_action_cb  = NULL;
+    rftimer_vars.last_compare_value = 0;
+    rftimer_vars.noNeedClearFlag    = 0;
     
     // set period of radiotimer
     RFTIMER_REG__MAX_COUNT          = RFTIMER_MAX_COUNT;
-    // enable timer and interrupt
-    RFTIMER_REG__CONTROL            = 0x07;
+    // enable timer and interrupt, resetting the count only if it is not running,
+    // so that the compares armed on it still match
+    if (RFTIMER_REG__CONTROL & RFTIMER_REG__CONTROL_ENABLE) {
+        RFTIMER_REG__CONTROL        = RFTIMER_REG__CONTROL_ENABLE | RFTIMER_REG__CONTROL_INTERRUPT_ENABLE;
+    } else {
+        RFTIMER_REG__CONTROL        = 0x07;
+    }
 }
 
 void rftimer_set_callback(rftimer_cbt cb, uint8_t id) {
@@ -59,7 +50,7 @@ void rftimer_set_callback(rftimer_cbt cb, uint8_t id) {
 void rftimer_setCompareIn(uint32_t val, uint8_t id){
     rftimer_enable_interrupts(id);
 	
-		*RF_TIMER_REG_ADDRESSES[id] = val & RFTIMER_MAX_COUNT;
+		RFTIMER_REG__COMPARE(id) = val & RFTIMER_MAX_COUNT;
     
     //RFTIMER_REG__COMPARE0           = val & RFTIMER_MAX_COUNT;
 }
@@ -70,13 +61,13 @@ uint32_t rftimer_readCounter(void){
 
 void rftimer_enable_interrupts(uint8_t id){
     // enable compare interrupt (this also cancels any pending interrupts)
-    *RF_TIMER_REG_CONTROL_ADDRESES[id]   = RFTIMER_COMPARE_ENABLE |   \
+    RFTIMER_REG__COMPARE_CONTROL(id)    = RFTIMER_COMPARE_ENABLE |   \
 																					 RFTIMER_COMPARE_INTERRUPT_ENABLE;
     ISER = 0x80;
 }
 
 void rftimer_disable_interrupts(uint8_t id){
-    *RF_TIMER_REG_CONTROL_ADDRESES[id] = 0x0;
+    RFTIMER_REG__COMPARE_CONTROL(id) = 0x0;
     ICER = 0x80;
 }
 
@@ -114,7 +105,9 @@ void delay_milliseconds_synchronous(unsigned int delay_milli, uint8_t id) {
 	delay_milliseconds_asynchronous(delay_milli, id);
 	
 	// do nothing until delay has finished
-	while (delay_completed[id] == false) {}
+	while (delay_completed[id] == false) {
+		HAL_IDLE();
+	}
 }
 
 // ========================== interrupt =======================================
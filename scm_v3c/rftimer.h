@@ -7,6 +7,7 @@
 //=========================== define ==========================================
 
 #define RFTIMER_MAX_COUNT   0xffffffff
+#define RFTIMER_TICKS_PER_MS    500 // RF timer runs at 500kHz
 
 //=========================== typedef =========================================
 
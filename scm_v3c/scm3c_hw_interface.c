@@ -6,6 +6,8 @@
 #include "radio.h"
 #include "optical.h"
 #include "rftimer.h"
+#include "counters.h"
+#include "uart.h"
 #include "scum_defs.h"
 
 //=========================== definition ======================================
@@ -23,11 +25,42 @@
 #define INIT_IF_COARSE              22
 #define INIT_IF_FINE                18
 
+// window over which the 2M and 32k counters are compared for temperature
+#define TEMPERATURE_COUNT_DURATION_TICKS    (10 * RFTIMER_TICKS_PER_MS)
+
+// sram test: background passes, then the address decoder pass
+#define SRAM_TEST_NUM_BACKGROUNDS       6
+#define SRAM_TEST_CHECKERBOARD_PASS     1
+#define SRAM_TEST_ADDRESS_PASS          SRAM_TEST_NUM_BACKGROUNDS
+#define SRAM_TEST_MARCH_OPS             10  // reads and writes per word in March C-
+#define SRAM_TEST_STACK_MARGIN          256 // bytes below the current stack frame kept out of the test
+// top of the stack, the first word of the vector table (__initial_sp in cm0dsasm.s)
+#define SRAM_TEST_INITIAL_SP            (*(unsigned int*) HAL_IMAGE(0))
+// word I of the range from START, through the register file in the host build so
+// tests can hook faults onto it
+#define SRAM_TEST_WORD(start, i)        HAL_REG((start) + (i) * 4)
+#ifndef SCUM_HOST
+// .data and .bss of the default layout of the IRAM, stack and heap included
+extern unsigned int Image$$RW_IRAM1$$Base;
+extern unsigned int Image$$RW_IRAM1$$ZI$$Limit;
+#define SRAM_TEST_RW_BASE               ((unsigned int) &Image$$RW_IRAM1$$Base)
+#define SRAM_TEST_RW_LIMIT              ((unsigned int) &Image$$RW_IRAM1$$ZI$$Limit)
+#else
+// the host build's globals are outside the register file
+#define SRAM_TEST_RW_BASE               0
+#define SRAM_TEST_RW_LIMIT              0
+#endif
+
 //=========================== variable ========================================
 
 // default setting
 static const uint32_t default_dac_2m_setting[] = {31,31,29,2,2};
 
+// solid, checkerboard, then stripes of 2, 4, 8 and 16 bits within a word
+static const uint32_t sram_test_backgrounds[SRAM_TEST_NUM_BACKGROUNDS] = {
+    0x00000000, 0x55555555, 0x33333333, 0x0F0F0F0F, 0x00FF00FF, 0x0000FFFF
+};
+
 typedef struct {
     uint32_t ASC[ASC_LEN];
     uint32_t dac_2M_settings[DAC_2M_SETTING_LEN];
@@ -60,6 +93,11 @@ scm3c_hw_interface_vars_t scm3c_hw_interface_vars;
 
 //=========================== prototype =======================================
 
+void save_counters(const counters_snapshot_t* snapshot);
+unsigned int sram_test_background(unsigned int b, unsigned int i);
+void sram_test_record_error(sram_test_result_t* result, unsigned int addr,
+    unsigned int expected, unsigned int actual, unsigned int pass);
+
 //=========================== public ==========================================
 
 // AUSTIN
@@ -70,6 +108,9 @@ void update_scan_chain() {
 
 // lowers clock frequency to 78.4kHz (or is it 700kHz?)
 void low_power_mode(void) {
+		// the UART divides HCLK, what was queued goes out at the current baud
+		uart_tx_flush();
+		
 		set_asc_bit(50);
 		set_asc_bit(51);
 		clear_asc_bit(52);
@@ -84,6 +125,9 @@ void low_power_mode(void) {
 
 // raises clock frequency to 5MHz
 void normal_power_mode(void) {
+		// the UART divides HCLK, what was queued goes out at the current baud
+		uart_tx_flush();
+		
 		clear_asc_bit(50);
 		clear_asc_bit(51);
 		clear_asc_bit(52);
@@ -132,59 +176,44 @@ void exit_low_power_mode_32k(void) {
 		update_scan_chain();
 }
 
+// Copies a counter snapshot to scm3c_hw_interface_vars for the get functions
+void save_counters(const counters_snapshot_t* snapshot) {
+	scm3c_hw_interface_vars.count_2M = snapshot->count_2M;
+	scm3c_hw_interface_vars.count_32k = snapshot->count_32k;
+	scm3c_hw_interface_vars.count_HF = snapshot->count_HF;
+	scm3c_hw_interface_vars.count_LC_div = snapshot->count_LC_div;
+	scm3c_hw_interface_vars.count_IF = snapshot->count_IF;
+}
+
 /* Resets clock counts and waits MEASURE_TIME_MILLISECONDS before saving the clocks counts. */
 void read_counters_duration(unsigned int measure_time_milliseconds) {
-	reset_counters();
-	enable_counters();
+	counters_snapshot_t snapshot;
 	
-	delay_milliseconds_synchronous(measure_time_milliseconds, 2);
+	counters_measure(measure_time_milliseconds * RFTIMER_TICKS_PER_MS, &snapshot);
 	
-	read_counters();
+	save_counters(&snapshot);
 }
 
 /* Disables all counters and writes the current clock counts for 2MHz, 32kHz, HF, LC div, and IF clocks to scm3c_hw_interface_vars. */
 void read_counters() {
-	unsigned int rdata_lsb, rdata_msb;
-	
-	disable_counters();
+	counters_snapshot_t snapshot;
 	
-	// 2MHz
-	rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x180000);
-	rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x1C0000);
-	scm3c_hw_interface_vars.count_2M = rdata_lsb + (rdata_msb << 16);
+	counters_stop(&snapshot);
 	
-	// 32kHz
-	rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x000000);
-	rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x040000);
-	scm3c_hw_interface_vars.count_32k = rdata_lsb + (rdata_msb << 16);
-	
-	// HF clock
-	rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x100000);
-	rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x140000);
-	scm3c_hw_interface_vars.count_HF = rdata_lsb + (rdata_msb << 16);
-	
-	// LC div
-	rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x280000);
-  rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x2C0000);
-	scm3c_hw_interface_vars.count_LC_div = rdata_lsb + (rdata_msb << 16);
-	
-	// IF
-	rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x300000);
-  rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x340000);
-	scm3c_hw_interface_vars.count_IF = rdata_lsb + (rdata_msb << 16);
+	save_counters(&snapshot);
 }
 
 void disable_counters(void) {
-	ANALOG_CFG_REG__0 = 0x007F;
+	ANALOG_CFG_REG__0 = COUNTERS_DISABLE;
 }
 
 void enable_counters(void) {
-	ANALOG_CFG_REG__0 = 0x3FFF;
+	ANALOG_CFG_REG__0 = COUNTERS_ENABLE;
 }
 
 // still need to perform a call to enable counters after resetting counters
 void reset_counters(void) {
-	ANALOG_CFG_REG__0 = 0x0000;	
+	ANALOG_CFG_REG__0 = COUNTERS_RESET;	
 }
 
 // AUSTIN DONE
@@ -204,7 +233,9 @@ void optical_calibrate(void) {
 		optical_enable();
 	
 		// Wait for optical cal to finish
-    while(optical_getCalibrationFinshed() == 0);
+    while(optical_getCalibrationFinshed() == 0) {
+        HAL_IDLE();
+    }
 	
 		radio_rfOff();
 		
@@ -374,6 +405,125 @@ unsigned int crc32c(unsigned char *message, unsigned int length) {
     return reverse(~crc);
 }
 
+// The block CRC table is only valid when the bootloader wrote the header and
+// the code does not overlap the table itself
+bool image_has_block_crcs(void) {
+    unsigned int num_blocks;
+    
+    if (*((unsigned int *) HAL_IMAGE(IMAGE_BLOCK_CRC_MAGIC_ADDR)) != IMAGE_BLOCK_CRC_MAGIC) {
+        return false;
+    }
+    
+    num_blocks = *((unsigned int *) HAL_IMAGE(IMAGE_BLOCK_CRC_COUNT_ADDR));
+    
+    return (num_blocks <= IMAGE_MAX_BLOCKS) &&
+        (IMAGE_CODE_LENGTH <= IMAGE_BLOCK_CRC_MAGIC_ADDR) &&
+        (num_blocks * IMAGE_BLOCK_SIZE >= IMAGE_CODE_LENGTH);
+}
+
+// Checks num_blocks blocks starting at first_block against the block CRC table.
+// Sets one bit per bad block in bad_block_map (two words), which may be NULL.
+// Returns the number of bad blocks.
+unsigned int image_verify_blocks(unsigned int first_block, unsigned int num_blocks, uint32_t* bad_block_map) {
+    unsigned int i, start, length, num_bad;
+    unsigned int* table;
+    
+    table   = (unsigned int *) HAL_IMAGE(IMAGE_BLOCK_CRC_TABLE_ADDR);
+    num_bad = 0;
+    
+    for (i = first_block; i < first_block + num_blocks && i < IMAGE_MAX_BLOCKS; i++) {
+        start = i * IMAGE_BLOCK_SIZE;
+        if (start >= IMAGE_CODE_LENGTH) {
+            break;
+        }
+        
+        // last block is cut at the code length
+        length = IMAGE_CODE_LENGTH - start;
+        if (length > IMAGE_BLOCK_SIZE) {
+            length = IMAGE_BLOCK_SIZE;
+        }
+        
+        if (crc32c(HAL_IMAGE(start), length) != table[i]) {
+            if (bad_block_map != NULL) {
+                bad_block_map[i >> 5] |= 1u << (i & 0x1F);
+            }
+            num_bad++;
+        }
+    }
+    
+    return num_bad;
+}
+
+// Verifies only the blocks covering [start_address, start_address+length),
+// e.g. a function or table that is about to be used. Without a block table
+// this falls back to the whole image CRC.
+bool image_verify_range(unsigned int start_address, unsigned int length) {
+    unsigned int first_block, last_block;
+    
+    if (length == 0) {
+        return true;
+    }
+    
+    if (!image_has_block_crcs()) {
+        return crc32c(HAL_IMAGE(0x0000), IMAGE_CODE_LENGTH) == IMAGE_CRC_VALUE;
+    }
+    
+    first_block = start_address / IMAGE_BLOCK_SIZE;
+    last_block  = (start_address + length - 1) / IMAGE_BLOCK_SIZE;
+    
+    return image_verify_blocks(first_block, last_block - first_block + 1, NULL) == 0;
+}
+
+// Checks every block and prints the bad ones on a single line so the host
+// only needs to re-send those. Returns the number of bad blocks.
+unsigned int image_report_bad_blocks(void) {
+    uint32_t bad_block_map[2];
+    unsigned int i, num_bad;
+    
+    if (!image_has_block_crcs()) {
+        printf("No block CRC table, cannot locate bad blocks\r\n");
+        return 0;
+    }
+    
+    bad_block_map[0] = 0;
+    bad_block_map[1] = 0;
+    
+    num_bad = image_verify_blocks(0, IMAGE_MAX_BLOCKS, bad_block_map);
+    
+    printf("Bad blocks (%d bytes each):", IMAGE_BLOCK_SIZE);
+    for (i = 0; i < IMAGE_MAX_BLOCKS; i++) {
+        if ((bad_block_map[i >> 5] >> (i & 0x1F)) & 0x1) {
+            printf(" %d", i);
+        }
+    }
+    printf("\r\n");
+    
+    return num_bad;
+}
+
+// Copies the payload of the config block into config if the bootloader wrote
+// one of exactly length bytes and it is intact. config is left alone otherwise
+// so it can hold the defaults.
+bool image_read_config(void* config, unsigned int length) {
+    unsigned int* header;
+    
+    header = (unsigned int *) HAL_IMAGE(IMAGE_CONFIG_ADDR);
+    
+    if (header[0] != IMAGE_CONFIG_MAGIC ||
+        header[1] != length ||
+        length > IMAGE_CONFIG_MAX_LEN ||
+        IMAGE_CODE_LENGTH > IMAGE_CONFIG_ADDR) {
+        return false;
+    }
+    
+    if (crc32c(HAL_IMAGE(IMAGE_CONFIG_ADDR + IMAGE_CONFIG_HEADER_LEN), length) != header[2]) {
+        return false;
+    }
+    
+    memcpy(config, HAL_IMAGE(IMAGE_CONFIG_ADDR + IMAGE_CONFIG_HEADER_LEN), length);
+    return true;
+}
+
 unsigned char flipChar(unsigned char b) {
     b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
     b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
@@ -576,87 +726,184 @@ void init_ldo_control(void){
 
 // SRAM Verification Test
 // BW 2-25-18
-// Adapted from March C- algorithm, Eqn (2) in [1]
+// Word-wide March C-, Eqn (2) in [1]:
+// {any(w0); up(r0,w1); up(r1,w0); down(r0,w1); down(r1,w0); any(r0)}
+// where 0/1 are a data background and its complement. Running it with the
+// solid, checkerboard and intra-word stripe backgrounds covers the coupling
+// faults between bits of one word that the bitwise version found [2].
 // [1] Van De Goor, Ad J. "Using march tests to test SRAMs." IEEE Design & Test of Computers 10.1 (1993): 8-14.
+// [2] Van De Goor, Ad J. et al. "March tests for word-oriented memories." DATE 1998.
 // Only works for DMEM since you must be able to read and write
-unsigned int sram_test(unsigned int * baseAddress, unsigned int num_dwords) {
-
-    int i;
-    int j;
+// Returns false without touching memory if the range overlaps the globals, the stack or this code
+bool sram_march_test(unsigned int * baseAddress, unsigned int num_dwords, sram_test_result_t* result) {
+    
+    unsigned int i, b, d0, d1, actual, start_tick;
+    unsigned int start, end, stack, stack_top;
+    
+    start     = (unsigned int) baseAddress;
+    end       = start + num_dwords * 4;
+    stack     = (unsigned int) &i - SRAM_TEST_STACK_MARGIN;
+    stack_top = SRAM_TEST_INITIAL_SP;
+    if (stack_top < (unsigned int) &i + SRAM_TEST_STACK_MARGIN) {
+        stack_top = (unsigned int) &i + SRAM_TEST_STACK_MARGIN;
+    }
     
-    unsigned int * addr;
-    unsigned int num_errors = 0;
-    addr = baseAddress;
+    memset(result, 0, sizeof(sram_test_result_t));
     
-    printf("\r\n\r\nStarting SRAM test from 0x%X to 0x%X...\r\n",baseAddress,baseAddress+num_dwords); 
-    printf("This takes awhile...\r\n");
-        
-    // Write 0 to all bits, in any address order
-    // Outer loop selects 32-bit dword, inner loop does single bit
-    for(i=0; i<num_dwords; i++) {
-        for(j=0; j<32; j++) {
-            addr[i] &= ~(1UL << j);
-        }
+    // The globals, the interrupts' included, are in RW/ZI, the frames of every caller between &i
+    // and the top of the stack, the result and code elsewhere
+    if ((SRAM_TEST_RW_LIMIT > start && SRAM_TEST_RW_BASE < end) ||
+        (stack_top > start && stack < end) ||
+        ((unsigned int) result + sizeof(sram_test_result_t) > start && (unsigned int) result < end) ||
+        ((unsigned int) sram_march_test >= start && (unsigned int) sram_march_test < end)) {
+        return false;
     }
     
-    // (r0,w1) (incr addr)
-    for(i=0; i<num_dwords; i++) {
-        for(j=0; j<32; j++) {
-            if((addr[i] & (1UL << j)) != 0x0) {
-                printf("\r\nERROR 1 @ address %X bit %d -- Value is %X",i,j,addr[i]);
-                num_errors++;
+    start_tick = rftimer_readCounter();
+    
+    for (b = 0; b < SRAM_TEST_NUM_BACKGROUNDS; b++) {
+        
+        // any(w0)
+        for (i = 0; i < num_dwords; i++) {
+            SRAM_TEST_WORD(start, i) = sram_test_background(b, i);
+        }
+        
+        // up(r0,w1)
+        for (i = 0; i < num_dwords; i++) {
+            d0 = sram_test_background(b, i);
+            actual = SRAM_TEST_WORD(start, i);
+            if (actual != d0) {
+                sram_test_record_error(result, start + i * 4, d0, actual, b);
             }
-            addr[i] |= 1UL << j;
+            SRAM_TEST_WORD(start, i) = ~d0;
         }
-    }
-    
-    // (r1,w0) (incr addr)
-    for(i=0; i<num_dwords; i++) {
-        for(j=0; j<32; j++) {
-            if((addr[i] & (1UL << j)) != 1UL << j) {
-                printf("\r\nERROR 2 @ address %X bit %d -- Value is %X",i,j,addr[i]);
-                num_errors++;
+        
+        // up(r1,w0)
+        for (i = 0; i < num_dwords; i++) {
+            d0 = sram_test_background(b, i);
+            d1 = ~d0;
+            actual = SRAM_TEST_WORD(start, i);
+            if (actual != d1) {
+                sram_test_record_error(result, start + i * 4, d1, actual, b);
             }
-            addr[i] &= ~(1UL << j);
+            SRAM_TEST_WORD(start, i) = d0;
         }
-    }
-    
-    // (r0,w1) (decr addr)
-    for(i=(num_dwords-1); i>=0; i--) {
-        for(j=31; j>=0; j--) {
-            if((addr[i] & (1UL << j)) != 0x0) {
-                printf("\r\nERROR 3 @ address %X bit %d -- Value is %X",i,j,addr[i]);
-                num_errors++;
+        
+        // down(r0,w1)
+        for (i = num_dwords; i-- > 0;) {
+            d0 = sram_test_background(b, i);
+            actual = SRAM_TEST_WORD(start, i);
+            if (actual != d0) {
+                sram_test_record_error(result, start + i * 4, d0, actual, b);
             }
-            addr[i] |= 1UL << j;
+            SRAM_TEST_WORD(start, i) = ~d0;
         }
-    }
-    
-    // (r1,w0) (decr addr)
-    for(i=(num_dwords-1); i>=0; i--) {
-        for(j=31; j>=0; j--) {
-            if((addr[i] & (1UL << j)) != 1UL << j) {
-                printf("\r\nERROR 4 @ address %X bit %d -- Value is %X",i,j,addr[i]);
-                num_errors++;
+        
+        // down(r1,w0)
+        for (i = num_dwords; i-- > 0;) {
+            d0 = sram_test_background(b, i);
+            d1 = ~d0;
+            actual = SRAM_TEST_WORD(start, i);
+            if (actual != d1) {
+                sram_test_record_error(result, start + i * 4, d1, actual, b);
             }
-            addr[i] &= ~(1UL << j);
+            SRAM_TEST_WORD(start, i) = d0;
         }
-    }
         
-    // r0 (any order)
-    for(i=0; i<num_dwords; i++) {
-        for(j=0; j<32; j++) {
-            if((addr[i] & (1UL << j)) != 0x0) {
-                printf("\r\nERROR 5 @ address %X bit %d -- Value is %X",i,j,addr[i]);
-                num_errors++;
+        // any(r0)
+        for (i = 0; i < num_dwords; i++) {
+            d0 = sram_test_background(b, i);
+            actual = SRAM_TEST_WORD(start, i);
+            if (actual != d0) {
+                sram_test_record_error(result, start + i * 4, d0, actual, b);
             }
         }
+        
+        result->bytes_accessed += num_dwords * 4 * SRAM_TEST_MARCH_OPS;
+    }
+    
+    // Address decoder: every word holds its own address, so two addresses
+    // selecting the same cell or a cell with no address show up as wrong data.
+    // Writing the complement downwards catches aliasing in the other direction.
+    for (i = 0; i < num_dwords; i++) {
+        SRAM_TEST_WORD(start, i) = start + i * 4;
+    }
+    for (i = 0; i < num_dwords; i++) {
+        d0 = start + i * 4;
+        actual = SRAM_TEST_WORD(start, i);
+        if (actual != d0) {
+            sram_test_record_error(result, start + i * 4, d0, actual, SRAM_TEST_ADDRESS_PASS);
+        }
     }
+    for (i = num_dwords; i-- > 0;) {
+        SRAM_TEST_WORD(start, i) = ~(start + i * 4);
+    }
+    for (i = num_dwords; i-- > 0;) {
+        d1 = ~(start + i * 4);
+        actual = SRAM_TEST_WORD(start, i);
+        if (actual != d1) {
+            sram_test_record_error(result, start + i * 4, d1, actual, SRAM_TEST_ADDRESS_PASS);
+        }
+    }
+    result->bytes_accessed += num_dwords * 4 * 4;
+    
+    result->elapsed_ticks = rftimer_readCounter() - start_tick;
+    
+    return true;
+}
 
-    printf("\r\nSRAM Test Complete -- %d Errors\r\n",num_errors);
+// Runs sram_march_test() and prints a one line summary plus the first error
+unsigned int sram_test(unsigned int * baseAddress, unsigned int num_dwords) {
     
-    return num_errors;
+    sram_test_result_t result;
+    unsigned int elapsed_ms;
     
+    printf("\r\n\r\nStarting SRAM test from 0x%X to 0x%X...\r\n",
+        (unsigned int) baseAddress, (unsigned int) (baseAddress + num_dwords));
+    
+    if (!sram_march_test(baseAddress, num_dwords, &result)) {
+        printf("SRAM test range overlaps the globals, the stack or test code, not testing\r\n");
+        return 0;
+    }
+    
+    elapsed_ms = result.elapsed_ticks / RFTIMER_TICKS_PER_MS;
+    if (elapsed_ms == 0) {
+        elapsed_ms = 1;
+    }
+    
+    printf("SRAM Test Complete -- %d Errors, %d ms, %d kB/s\r\n",
+        result.num_errors, elapsed_ms, (result.bytes_accessed / 1024) * 1000 / elapsed_ms);
+    
+    if (result.num_errors > 0) {
+        printf("First error @ 0x%X expected %X read %X -- failing bits %X, failing passes %X\r\n",
+            result.first_error_addr, result.first_error_expected, result.first_error_actual,
+            result.failing_bits, result.failing_passes);
+    }
+    
+    return result.num_errors;
+}
+
+//==== sram test helpers
+
+// Data background for word i of pass b, the checkerboard flips on every other
+// word so neighbouring cells across words hold opposite values
+unsigned int sram_test_background(unsigned int b, unsigned int i) {
+    if (b == SRAM_TEST_CHECKERBOARD_PASS && (i & 0x1)) {
+        return ~sram_test_backgrounds[b];
+    }
+    return sram_test_backgrounds[b];
+}
+
+void sram_test_record_error(sram_test_result_t* result, unsigned int addr,
+    unsigned int expected, unsigned int actual, unsigned int pass) {
+    if (result->num_errors == 0) {
+        result->first_error_addr     = addr;
+        result->first_error_expected = expected;
+        result->first_error_actual   = actual;
+    }
+    result->num_errors++;
+    result->failing_bits   |= expected ^ actual;
+    result->failing_passes |= 1UL << pass;
 }
 
 
@@ -1192,31 +1439,21 @@ void radio_init_divider(unsigned int div_value){
 
 void read_counters_3B(unsigned int* count_2M, unsigned int* count_LC, unsigned int* count_adc){
 
-    unsigned int rdata_lsb, rdata_msb;//, count_LC, count_32k;
+    counters_snapshot_t snapshot;
     
-    // Disable all counters
-    ANALOG_CFG_REG__0 = 0x007F;
-        
-    // Read 2M counter
-    rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x180000);
-    rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x1C0000);
-    *count_2M = rdata_lsb + (rdata_msb << 16);
-        
-    // Read LC_div counter (via counter4)
-    rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x280000);
-    rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x2C0000);
-    *count_LC = rdata_lsb + (rdata_msb << 16);
-        
-    // Read adc counter
-    rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x300000);
-    rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x340000);
-    *count_adc = rdata_lsb + (rdata_msb << 16);
+    // Stop and read all counters
+    counters_stop(&snapshot);
     
-    // Reset all counters
-    ANALOG_CFG_REG__0 = 0x0000;        
+    *count_2M = snapshot.count_2M;
     
-    // Enable all counters
-    ANALOG_CFG_REG__0 = 0x3FFF;    
+    // LC_div counter (via counter4)
+    *count_LC = snapshot.count_LC_div;
+    
+    // adc counter
+    *count_adc = snapshot.count_IF;
+    
+    // Reset and enable all counters for the next call
+    counters_restart();
     
     //printf("LC_count=%X\r\n",*count_LC);
     //printf("2M_count=%X\r\n",*count_2M);
@@ -1468,35 +1705,16 @@ void initialize_mote(){
 
 unsigned int estimate_temperature_2M_32k(){
     
-    unsigned int rdata_lsb,rdata_msb;
-    unsigned int count_2M,count_32k;
-    int t;
-    
-    // Reset all counters
-    ANALOG_CFG_REG__0 = 0x0000;
-    
-    // Enable all counters
-    ANALOG_CFG_REG__0 = 0x3FFF;    
+    counters_snapshot_t snapshot;
     
-    // Count for some arbitrary amount of time
-    for(t=1; t<50000; t++);
-    
-    // Disable all counters
-    ANALOG_CFG_REG__0 = 0x007F;
-
-    // Read 2M counter
-    rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x180000);
-    rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x1C0000);
-    count_2M = rdata_lsb + (rdata_msb << 16);
-        
-    // Read 32k counter
-    rdata_lsb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x000000);
-    rdata_msb = *(unsigned int*)(APB_ANALOG_CFG_BASE + 0x040000);
-    count_32k = rdata_lsb + (rdata_msb << 16);
+    // Count for a fixed window, only the ratio of the counts is used
+    if (!counters_measure(TEMPERATURE_COUNT_DURATION_TICKS, &snapshot) || snapshot.count_32k == 0) {
+        return 0;
+    }
     
-    //printf("%d - %d - %d\r\n",count_2M,count_32k,(count_2M << 13) / count_32k);
+    //printf("%d - %d - %d\r\n",snapshot.count_2M,snapshot.count_32k,(snapshot.count_2M << 13) / snapshot.count_32k);
     
-    return (count_2M << 13) / count_32k;
+    return (snapshot.count_2M << 13) / snapshot.count_32k;
 }
 
 
@@ -2,11 +2,44 @@
 #define __SCM3C_HW_INTERFACE_H
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "scum_hal.h"
 
 //=========================== define ==========================================
 
+// image layout filled in by bootload.py and the Teensy programmer
+#define IMAGE_CODE_LENGTH           (*((unsigned int *) HAL_IMAGE(0x0000FFF8)))
+#define IMAGE_CRC_VALUE             (*((unsigned int *) HAL_IMAGE(0x0000FFFC)))
+
+// optional table of per-block CRCs, only present if code fits below it
+#define IMAGE_BLOCK_CRC_MAGIC_ADDR  0x0000FEF0
+#define IMAGE_BLOCK_CRC_COUNT_ADDR  0x0000FEF4
+#define IMAGE_BLOCK_CRC_TABLE_ADDR  0x0000FEF8
+#define IMAGE_BLOCK_CRC_MAGIC       0x43524342  // "BCRC"
+#define IMAGE_BLOCK_SIZE            1024
+#define IMAGE_MAX_BLOCKS            64
+
+// optional settings block for the application, only valid below the block CRC table
+#define IMAGE_CONFIG_ADDR           0x0000FE00
+#define IMAGE_CONFIG_MAGIC          0x47464345  // "ECFG"
+#define IMAGE_CONFIG_HEADER_LEN     12          // magic, payload length, payload CRC
+#define IMAGE_CONFIG_MAX_LEN        (IMAGE_BLOCK_CRC_MAGIC_ADDR - IMAGE_CONFIG_ADDR - IMAGE_CONFIG_HEADER_LEN)
+
 //=========================== typedef =========================================
 
+// Compact summary of a sram_march_test() run
+typedef struct {
+    uint32_t num_errors;            // number of reads that returned wrong data
+    uint32_t first_error_addr;
+    uint32_t first_error_expected;
+    uint32_t first_error_actual;
+    uint32_t failing_bits;          // OR of (expected ^ actual) over all errors
+    uint32_t failing_passes;        // bit n set if background pass n saw errors
+    uint32_t elapsed_ticks;         // RF timer ticks taken by the whole test
+    uint32_t bytes_accessed;        // total bytes read and written
+} sram_test_result_t;
+
 //=========================== variables =======================================
 
 //=========================== prototypes ======================================
@@ -59,9 +92,15 @@ void scm3c_hw_interface_set_asc(uint32_t* asc_profile);
 //==== from scm3c_hardware_interface.h
 unsigned reverse(unsigned x);
 unsigned int crc32c(unsigned char *message, unsigned int length);
+bool image_has_block_crcs(void);
+unsigned int image_verify_blocks(unsigned int first_block, unsigned int num_blocks, uint32_t* bad_block_map);
+bool image_verify_range(unsigned int start_address, unsigned int length);
+unsigned int image_report_bad_blocks(void);
+bool image_read_config(void* config, unsigned int length);
 unsigned char flipChar(unsigned char b);
 void init_ldo_control(void);
 unsigned int sram_test(unsigned int * baseAddress, unsigned int num_dwords);
+bool sram_march_test(unsigned int * baseAddress, unsigned int num_dwords, sram_test_result_t* result);
 void radio_init_rx_MF(void);
 void radio_init_rx_ZCC(void);
 void radio_init_tx(void);
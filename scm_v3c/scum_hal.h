@@ -0,0 +1,87 @@
+#ifndef __SCUM_HAL_H
+#define __SCUM_HAL_H
+
+/**
+\brief Register accessors behind the macros in memory_map.h.
+
+On target these are plain volatile loads and stores. Building with SCUM_HOST
+defined (see host/Makefile) routes every access through an in-memory register
+file in host/hal_host.c instead, so the drivers can be built with gcc and run
+under tests and profilers on a workstation.
+*/
+
+#ifndef SCUM_HOST
+
+//=========================== define ==========================================
+
+// 32-bit peripheral register
+#define HAL_REG(addr)               (*(volatile unsigned int*)(addr))
+// register holding a pointer (RF TX data and RX DMA addresses)
+#define HAL_REG_PTR(addr)           (*(char* volatile*)(addr))
+// byte pointer into the loaded program image (starts at address 0)
+#define HAL_IMAGE(offset)           ((unsigned char*)(offset))
+
+#define HAL_WAIT_FOR_INTERRUPT()    __wfi()
+#define HAL_DISABLE_INTERRUPTS()    __disable_irq()
+#define HAL_ENABLE_INTERRUPTS()     __enable_irq()
+
+// body of a busy-wait on a flag set from an interrupt, nothing to do on target
+#define HAL_IDLE()
+
+#else
+
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+#define HAL_REG(addr)               (*hal_reg((uint32_t)(addr)))
+#define HAL_REG_PTR(addr)           (*hal_reg_ptr((uint32_t)(addr)))
+#define HAL_IMAGE(offset)           (&hal_image[(uint32_t)(offset)])
+
+#define HAL_WAIT_FOR_INTERRUPT()    hal_wait_for_interrupt()
+#define HAL_DISABLE_INTERRUPTS()    hal_set_interrupts_enabled(0)
+#define HAL_ENABLE_INTERRUPTS()     hal_set_interrupts_enabled(1)
+
+// nothing else would make time pass while spinning on a flag in memory
+#define HAL_IDLE()                  hal_wait_for_interrupt()
+
+#define HAL_IMAGE_SIZE              0x10000
+
+//=========================== typedef =========================================
+
+// Called before every access to a register in the hooked range, returns the
+// value the firmware should see (e.g. a free running counter)
+typedef uint32_t (*hal_read_hook_t)(uint32_t addr, uint32_t value);
+// Called once the firmware has changed a register in the hooked range
+typedef void     (*hal_write_hook_t)(uint32_t addr, uint32_t value);
+typedef void     (*hal_idle_hook_t)(void);
+// Called before every register access and when interrupts get enabled
+typedef void     (*hal_access_hook_t)(void);
+
+//=========================== variables =======================================
+
+extern unsigned char hal_image[HAL_IMAGE_SIZE];
+
+//=========================== prototypes ======================================
+
+volatile unsigned int*  hal_reg(uint32_t addr);
+char* volatile*         hal_reg_ptr(uint32_t addr);
+void                    hal_sync(void);
+void                    hal_reset(void);
+
+// side channel for peripheral models, never calls hooks
+uint32_t                hal_peek(uint32_t addr);
+void                    hal_poke(uint32_t addr, uint32_t value);
+char*                   hal_peek_ptr(uint32_t addr);
+
+void                    hal_set_hooks(uint32_t base, uint32_t size,
+                            hal_read_hook_t read_hook, hal_write_hook_t write_hook);
+void                    hal_set_idle_hook(hal_idle_hook_t idle_hook);
+void                    hal_set_access_hook(hal_access_hook_t access_hook);
+void                    hal_wait_for_interrupt(void);
+void                    hal_set_interrupts_enabled(int enabled);
+int                     hal_interrupts_enabled(void);
+
+#endif
+
+#endif
@@ -0,0 +1,137 @@
+/**
+\brief Duty cycling between radio events when running from a solar cell.
+
+solar_duty_sleep() puts HCLK in low_power_mode() and sleeps on WFI until an
+RF timer compare, so the length of the sleep does not depend on the clock
+the CPU runs from. It only returns to normal_power_mode() at the end.
+
+The interval adapts to a supply monitor on a GPIO input, e.g. the power good
+output of the harvester, high when the storage capacitor can take a radio
+event. If the supply is good when the interval is over, the next interval is
+a quarter shorter, down to the minimum. If not, the interval doubles, up to
+the maximum, and the sleep goes on for that long before the supply is
+checked again. The radio therefore runs as often as the harvested power
+allows, and never on a supply that is known to be low. Without a monitor
+the interval stays where it starts, at the maximum.
+
+The GPIO input has to be enabled with GPI_enables() by the application.
+*/
+
+#include "memory_map.h"
+#include "rftimer.h"
+#include "scm3c_hw_interface.h"
+#include "solar_duty.h"
+#include "uart.h"
+
+//=========================== defines =========================================
+
+// shared with the delays of the application, which never run during a sleep
+#define SOLAR_DUTY_RFTIMER_COMPAREID    1
+
+//=========================== variables =======================================
+
+typedef struct {
+    uint32_t            min_ms;
+    uint32_t            max_ms;
+    uint32_t            interval_ms;    // length of the next sleep
+    uint32_t            last_sleep_ms;  // length of the last sleep, extensions included
+    uint16_t            power_good_mask;
+    uint32_t            power_waits;    // intervals added because the supply was low
+    volatile bool       sleeping;
+} solar_duty_vars_t;
+
+solar_duty_vars_t solar_duty_vars;
+
+//=========================== prototypes ======================================
+
+void solar_duty_sleep_ms(uint32_t ms);
+void solar_duty_wake(void);
+
+//=========================== public ==========================================
+
+/* Sleeps will last from MIN_MS to MAX_MS, starting at MAX_MS. POWER_GOOD_MASK
+ * selects the GPIO input of the supply monitor, 0 if there is none.
+ */
+void solar_duty_init(uint32_t min_ms, uint32_t max_ms, uint16_t power_good_mask) {
+    solar_duty_vars.min_ms          = min_ms;
+    solar_duty_vars.max_ms          = max_ms;
+    solar_duty_vars.interval_ms     = max_ms;
+    solar_duty_vars.last_sleep_ms   = 0;
+    solar_duty_vars.power_good_mask = power_good_mask;
+    solar_duty_vars.power_waits     = 0;
+    solar_duty_vars.sleeping        = false;
+}
+
+// Sleeps in low power mode until the supply is good after at least the interval
+void solar_duty_sleep(void) {
+    // the binlog records of the last period, at the baud they were queued for
+    uart_tx_flush();
+    low_power_mode();
+
+    solar_duty_vars.last_sleep_ms = 0;
+    solar_duty_sleep_ms(solar_duty_vars.interval_ms);
+
+    // without a monitor there is nothing to adapt to
+    if (solar_duty_vars.power_good_mask != 0) {
+        if (solar_duty_power_good()) {
+            solar_duty_vars.interval_ms -= solar_duty_vars.interval_ms / 4;
+            if (solar_duty_vars.interval_ms < solar_duty_vars.min_ms) {
+                solar_duty_vars.interval_ms = solar_duty_vars.min_ms;
+            }
+        } else {
+            do {
+                solar_duty_vars.interval_ms *= 2;
+                if (solar_duty_vars.interval_ms > solar_duty_vars.max_ms) {
+                    solar_duty_vars.interval_ms = solar_duty_vars.max_ms;
+                }
+                solar_duty_vars.power_waits++;
+                solar_duty_sleep_ms(solar_duty_vars.interval_ms);
+            } while (!solar_duty_power_good());
+        }
+    }
+
+    normal_power_mode();
+}
+
+uint32_t solar_duty_interval_ms(void) {
+    return solar_duty_vars.interval_ms;
+}
+
+uint32_t solar_duty_last_sleep_ms(void) {
+    return solar_duty_vars.last_sleep_ms;
+}
+
+uint32_t solar_duty_power_waits(void) {
+    return solar_duty_vars.power_waits;
+}
+
+// What the supply monitor says, always good without one
+bool solar_duty_power_good(void) {
+    return solar_duty_vars.power_good_mask == 0 || (GPIO_REG__INPUT & solar_duty_vars.power_good_mask) != 0;
+}
+
+//=========================== private =========================================
+
+void solar_duty_sleep_ms(uint32_t ms) {
+    solar_duty_vars.last_sleep_ms += ms;
+    solar_duty_vars.sleeping = true;
+
+    rftimer_set_callback(solar_duty_wake, SOLAR_DUTY_RFTIMER_COMPAREID);
+    rftimer_set_repeat(false, SOLAR_DUTY_RFTIMER_COMPAREID);
+    rftimer_setCompareIn(rftimer_readCounter() + ms * RFTIMER_TICKS_PER_MS, SOLAR_DUTY_RFTIMER_COMPAREID);
+
+    // the UART and the other compares wake up WFI too, sleep again until ours
+    HAL_DISABLE_INTERRUPTS();
+    while (solar_duty_vars.sleeping) {
+        HAL_WAIT_FOR_INTERRUPT();
+        HAL_ENABLE_INTERRUPTS();
+        HAL_DISABLE_INTERRUPTS();
+    }
+    HAL_ENABLE_INTERRUPTS();
+}
+
+//=========================== interrupt =======================================
+
+void solar_duty_wake(void) {
+    solar_duty_vars.sleeping = false;
+}
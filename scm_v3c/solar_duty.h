@@ -0,0 +1,22 @@
+#ifndef __SOLAR_DUTY_H
+#define __SOLAR_DUTY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+//=========================== typedef =========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void     solar_duty_init(uint32_t min_ms, uint32_t max_ms, uint16_t power_good_mask);
+void     solar_duty_sleep(void);
+uint32_t solar_duty_interval_ms(void);
+uint32_t solar_duty_last_sleep_ms(void);
+uint32_t solar_duty_power_waits(void);
+bool     solar_duty_power_good(void);
+
+#endif
@@ -1,4 +1,5 @@
-#include "Memory_Map.h"
+#include <stdio.h>
+#include "memory_map.h"
 #include "spi.h"
 
 #define CS_PIN		15
@@ -6,6 +7,13 @@
 #define DIN_PIN		13 // for v1 new boards use 12, use 13 for v2 boards // Used when reading data from the IMU thus a SCuM input
 #define DATA_PIN	12 // for v1 new boards use 13, use 12 for v2 boards // Used when writing to the IMU thus a SCuM output
 
+// 1 to read all axes in one transaction, relying on the IMU's register
+// address auto-increment; 0 for devices without it, one transaction per register
+#define IMU_BURST_READ		1
+
+#define IMU_REG_ACCEL_XOUT_H	0x2D	// followed by ACCEL_Y/Z, then GYRO_X/Y/Z, high byte first
+#define IMU_READ_FLAG		0x80
+
 // GPIO 12 - IMU SDO // SCuM receives from this IMU output
 // GPIO 13 - IMU SDI // SCuM outputs to this IMU input
 // GPIO 14 - SCLK
@@ -14,6 +22,32 @@
 // DIN_PIN is where SCuM reads in from IMU
 // DATA_PIN is where SCuM writes out to IMU
 
+// the IMU clocks data in on the rising edge and out on the falling edge, clock idles high
+const spi_device_t spi_imu = {CS_PIN, CLK_PIN, DATA_PIN, DIN_PIN, SPI_MODE_3, false};
+
+// Port values for the selected device, computed in spi_select() from the
+// output register as it was then. A bit is two writes, first[d] then
+// second[d] for data bit d, and MISO is sampled after the second. Other GPIO
+// outputs must not change while a device is selected, spi_transfer() writes
+// the whole register and would undo it.
+typedef struct {
+	uint32_t first[2];
+	uint32_t second[2];
+	uint32_t idle;		// clock at its idle level, data low
+	uint32_t miso_mask;
+	uint32_t cs_mask;
+	bool lsb_first;
+} spi_vars_t;
+
+spi_vars_t spi_vars;
+
+//=========================== prototypes ======================================
+
+uint8_t spi_transfer_byte_msb(uint8_t out);
+uint8_t spi_transfer_byte_lsb(uint8_t out);
+
+//=========================== public ==========================================
+
 void initialize_imu(void) {
 	int i;
 	
@@ -29,62 +63,85 @@ void initialize_imu(void) {
 	for(i=0; i<50000; i++);
 }
 
-void spi_write(unsigned char writeByte) {
-	int j;
-	int t=0;
-	int clk_pin = CLK_PIN;
-	int data_pin = DATA_PIN;
-	
-	for (j=7;j>=0;j--) {
-		if ((writeByte&(0x01<<j)) != 0) {
-			GPIO_REG__OUTPUT &= ~(1 << clk_pin); // clock low
-			GPIO_REG__OUTPUT |= 1 << data_pin; // write a 1
-			GPIO_REG__OUTPUT |= 1 << clk_pin; // clock high
-		}
-		else {
-			GPIO_REG__OUTPUT &= ~(1 << clk_pin); // clock low
-			GPIO_REG__OUTPUT &= ~(1 << data_pin); // write a 0
-			GPIO_REG__OUTPUT |= (1 << clk_pin); // clock high
-		}
+// Drops the device's chip select with the clock at its idle level
+void spi_select(const spi_device_t* device) {
+	uint32_t clk_mask, mosi_mask, idle_clk, active_clk, shadow;
+	int t;
+	
+	clk_mask   = 1u << device->clk_pin;
+	mosi_mask  = 1u << device->mosi_pin;
+	idle_clk   = (device->mode & SPI_CPOL) ? clk_mask : 0;
+	active_clk = idle_clk ^ clk_mask;
+	
+	spi_vars.cs_mask   = 1u << device->cs_pin;
+	spi_vars.miso_mask = 1u << device->miso_pin;
+	spi_vars.lsb_first = device->lsb_first;
+	
+	shadow = GPIO_REG__OUTPUT & ~(clk_mask | mosi_mask);
+	GPIO_REG__OUTPUT = shadow | idle_clk;		// settle the clock before the device listens
+	
+	shadow &= ~spi_vars.cs_mask;
+	spi_vars.idle = shadow | idle_clk;
+	if (device->mode & SPI_CPHA) {
+		// data changes on the leading edge and is sampled on the trailing one
+		spi_vars.first[0]  = shadow | active_clk;
+		spi_vars.first[1]  = shadow | active_clk | mosi_mask;
+		spi_vars.second[0] = shadow | idle_clk;
+		spi_vars.second[1] = shadow | idle_clk | mosi_mask;
+	} else {
+		// data is set up while the clock idles and sampled on the leading edge
+		spi_vars.first[0]  = shadow | idle_clk;
+		spi_vars.first[1]  = shadow | idle_clk | mosi_mask;
+		spi_vars.second[0] = shadow | active_clk;
+		spi_vars.second[1] = shadow | active_clk | mosi_mask;
 	}
 	
-	GPIO_REG__OUTPUT &= ~(1 << data_pin); // set data out to 0
+	GPIO_REG__OUTPUT = spi_vars.idle;
+	for(t=0; t<50; t++);
 }
 
-unsigned char spi_read() {
-	unsigned char readByte;
-	int j;
-	int t = 0;
-	int clk_pin = CLK_PIN;
-	int din_pin = DIN_PIN;
-	readByte=0;
+void spi_deselect(void) {
+	GPIO_REG__OUTPUT |= spi_vars.cs_mask;
+}
 
+// Full duplex: sends tx (zeros if NULL) while receiving into rx (if not NULL)
+void spi_transfer(const uint8_t* tx, uint8_t* rx, uint16_t len) {
+	uint16_t i;
+	uint8_t in;
 	
-	GPIO_REG__OUTPUT &= ~(1 << clk_pin); // clock low
-	
-	for (j=7;j>=0;j--) {
-		GPIO_REG__OUTPUT |= (1 << clk_pin); // clock high
-		readByte |= ((GPIO_REG__INPUT&(1 << din_pin))>>din_pin)<<j;		
-		GPIO_REG__OUTPUT &= ~(1 << clk_pin); // clock low		
+	for (i=0; i<len; i++) {
+		if (spi_vars.lsb_first) {
+			in = spi_transfer_byte_lsb(tx != NULL ? tx[i] : 0);
+		} else {
+			in = spi_transfer_byte_msb(tx != NULL ? tx[i] : 0);
+		}
+		if (rx != NULL) {
+			rx[i] = in;
+		}
 	}
 	
+	// back to idle, a mode 0/2 byte ends with the clock active
+	GPIO_REG__OUTPUT = spi_vars.idle;
+}
+
+void spi_write(unsigned char writeByte) {
+	spi_transfer(&writeByte, NULL, 1);
+}
+
+unsigned char spi_read() {
+	uint8_t readByte;
+	
+	spi_transfer(NULL, &readByte, 1);
 	return readByte;
 }
 
 void spi_chip_select() {
-	int t = 0;
-	int dout_pin = DATA_PIN;
-	int cs_pin = CS_PIN;
-	// drop chip select low to select the chip
-	GPIO_REG__OUTPUT &= ~(1 << cs_pin);
-	GPIO_REG__OUTPUT &= ~(1 << dout_pin);
-	for(t=0; t<50; t++);
+	spi_select(&spi_imu);
 }
 
 void spi_chip_deselect() {
-	int cs_pin = CS_PIN;
 	// hold chip select high to deselect the chip
-	GPIO_REG__OUTPUT |= (1 << cs_pin);
+	GPIO_REG__OUTPUT |= (1 << CS_PIN);
 }
 
 unsigned int read_acc_x() {
@@ -208,11 +265,92 @@ void write_imu_register(unsigned char reg, unsigned char data) {
 	
 }
 
+void read_imu_registers(unsigned char reg, unsigned char* buf, unsigned char len) {
+	reg &= 0x7F;
+	reg |= IMU_READ_FLAG;
+	
+	spi_select(&spi_imu);           // drop chip select
+	spi_transfer(&reg, NULL, 1);    // write the first register, the IMU increments the address after each byte
+	spi_transfer(NULL, buf, len);
+	spi_deselect();                 // raise chip select
+}
+
 void read_all_imu_data(imu_data_t* imu_measurement) {
+#if IMU_BURST_READ == 1
+	unsigned char raw[IMU_DATA_LEN];
+	
+	// one chip select and address byte for the 12 data bytes, instead of one per byte
+	read_imu_registers(IMU_REG_ACCEL_XOUT_H, raw, IMU_DATA_LEN);
+	
+	// the IMU sends each axis high byte first
+	imu_measurement->acc_x.value  = (int16_t)((raw[0]  << 8) | raw[1]);
+	imu_measurement->acc_y.value  = (int16_t)((raw[2]  << 8) | raw[3]);
+	imu_measurement->acc_z.value  = (int16_t)((raw[4]  << 8) | raw[5]);
+	imu_measurement->gyro_x.value = (int16_t)((raw[6]  << 8) | raw[7]);
+	imu_measurement->gyro_y.value = (int16_t)((raw[8]  << 8) | raw[9]);
+	imu_measurement->gyro_z.value = (int16_t)((raw[10] << 8) | raw[11]);
+#else
 	imu_measurement->acc_x.value = read_acc_x();
 	imu_measurement->acc_y.value = read_acc_y();
 	imu_measurement->acc_z.value = read_acc_z();
 	imu_measurement->gyro_x.value = read_gyro_x(); 
 	imu_measurement->gyro_y.value = read_gyro_y(); 
 	imu_measurement->gyro_z.value = read_gyro_z();
+#endif
+}
+
+//=========================== private =========================================
+
+// One bit: two whole-register writes from the precomputed values, then
+// sample MISO. Unrolled, so the loop and the shifts are gone.
+#define SPI_BIT(mask) \
+	if (out & (mask)) { \
+		GPIO_REG__OUTPUT = first1; \
+		GPIO_REG__OUTPUT = second1; \
+	} else { \
+		GPIO_REG__OUTPUT = first0; \
+		GPIO_REG__OUTPUT = second0; \
+	} \
+	if (GPIO_REG__INPUT & miso_mask) { \
+		in |= (mask); \
+	}
+
+uint8_t spi_transfer_byte_msb(uint8_t out) {
+	uint32_t first0    = spi_vars.first[0];
+	uint32_t first1    = spi_vars.first[1];
+	uint32_t second0   = spi_vars.second[0];
+	uint32_t second1   = spi_vars.second[1];
+	uint32_t miso_mask = spi_vars.miso_mask;
+	uint8_t in = 0;
+	
+	SPI_BIT(0x80)
+	SPI_BIT(0x40)
+	SPI_BIT(0x20)
+	SPI_BIT(0x10)
+	SPI_BIT(0x08)
+	SPI_BIT(0x04)
+	SPI_BIT(0x02)
+	SPI_BIT(0x01)
+	
+	return in;
+}
+
+uint8_t spi_transfer_byte_lsb(uint8_t out) {
+	uint32_t first0    = spi_vars.first[0];
+	uint32_t first1    = spi_vars.first[1];
+	uint32_t second0   = spi_vars.second[0];
+	uint32_t second1   = spi_vars.second[1];
+	uint32_t miso_mask = spi_vars.miso_mask;
+	uint8_t in = 0;
+	
+	SPI_BIT(0x01)
+	SPI_BIT(0x02)
+	SPI_BIT(0x04)
+	SPI_BIT(0x08)
+	SPI_BIT(0x10)
+	SPI_BIT(0x20)
+	SPI_BIT(0x40)
+	SPI_BIT(0x80)
+	
+	return in;
 }
@@ -1,4 +1,30 @@
+#ifndef __SPI_H
+#define __SPI_H
+
 #include <stdint.h>
+#include <stdbool.h>
+
+// clock polarity and phase bits of spi_device_t.mode
+#define SPI_CPOL	0x02	// clock idles high
+#define SPI_CPHA	0x01	// data sampled on the trailing clock edge
+#define SPI_MODE_0	0
+#define SPI_MODE_1	(SPI_CPHA)
+#define SPI_MODE_2	(SPI_CPOL)
+#define SPI_MODE_3	(SPI_CPOL | SPI_CPHA)
+
+// accel and gyro bytes read by read_all_imu_data()
+#define IMU_DATA_LEN	12
+
+// A device on the bit-banged bus, devices share the clock and data pins
+// and each has its own chip select (active low)
+typedef struct spi_device_t{
+	uint8_t cs_pin;
+	uint8_t clk_pin;
+	uint8_t mosi_pin;	// SCuM output
+	uint8_t miso_pin;	// SCuM input
+	uint8_t mode;		// SPI_MODE_x
+	bool lsb_first;
+} spi_device_t;
 
 typedef union int16_buff_t{
 	int16_t value;
@@ -14,6 +40,14 @@ typedef struct imu_data_t{
 	int16_buff_t gyro_z;
 } imu_data_t;
 
+extern const spi_device_t spi_imu;
+
+void spi_select(const spi_device_t* device);
+
+void spi_deselect(void);
+
+void spi_transfer(const uint8_t* tx, uint8_t* rx, uint16_t len);
+
 unsigned int read_gyro_x();
 unsigned int read_gyro_y();
 unsigned int read_gyro_z();
@@ -38,4 +72,8 @@ unsigned char read_imu_register(unsigned char reg);
 
 void write_imu_register(unsigned char reg, unsigned char data);
 
+void read_imu_registers(unsigned char reg, unsigned char* buf, unsigned char len);
+
 void read_all_imu_data(imu_data_t* imu_measurement);
+
+#endif
@@ -0,0 +1,181 @@
+/**
+\brief Which LC configurations worked during a sweep, kept on the chip.
+
+One bit per (coarse, mid, fine), set when a frame was received with a good
+CRC at that configuration. The bits of a (coarse, mid) pair form a 32-bit
+row with fine code n at bit n, 4 KB for the 32x32x32 codes. The first and
+last working fine code of a row are its lowest and highest set bit, and a
+mask per coarse code tells which mid codes have any, so a sweep can skip
+the dead regions without scanning the rows.
+
+The results stay across sweeps until sweep_results_clear(). They are sent
+as binlog records on the UART with sweep_results_dump(), or packed into
+radio payloads with sweep_results_pack(), one record per row that has a
+working code.
+*/
+
+#include <string.h>
+
+#include "binlog.h"
+#include "sweep_results.h"
+
+//=========================== defines =========================================
+
+#define SWEEP_RESULTS_CODE_MASK     (SWEEP_RESULTS_NUM_CODES - 1)
+
+//=========================== variables =======================================
+
+typedef struct {
+    uint32_t    rows[SWEEP_RESULTS_NUM_CODES][SWEEP_RESULTS_NUM_CODES];    // [coarse][mid], bit per fine code
+    uint32_t    mids[SWEEP_RESULTS_NUM_CODES];                              // [coarse], bit per mid code with a working row
+    uint16_t    count;                                                      // bits set
+} sweep_results_vars_t;
+
+sweep_results_vars_t sweep_results_vars;
+
+//=========================== prototypes ======================================
+
+uint8_t sweep_results_lowest_bit(uint32_t bits);
+uint8_t sweep_results_highest_bit(uint32_t bits);
+uint8_t sweep_results_count_bits(uint32_t bits);
+
+//=========================== public ==========================================
+
+void sweep_results_clear(void) {
+    memset(&sweep_results_vars, 0, sizeof(sweep_results_vars_t));
+}
+
+void sweep_results_mark(uint8_t coarse, uint8_t mid, uint8_t fine) {
+    uint32_t* row;
+    uint32_t  bit;
+
+    coarse &= SWEEP_RESULTS_CODE_MASK;
+    mid    &= SWEEP_RESULTS_CODE_MASK;
+    row = &sweep_results_vars.rows[coarse][mid];
+    bit = (uint32_t) 1 << (fine & SWEEP_RESULTS_CODE_MASK);
+    if (*row & bit) {
+        return;
+    }
+    *row |= bit;
+    sweep_results_vars.mids[coarse] |= (uint32_t) 1 << mid;
+    sweep_results_vars.count++;
+}
+
+bool sweep_results_get(uint8_t coarse, uint8_t mid, uint8_t fine) {
+    return (sweep_results_fines(coarse, mid) >> (fine & SWEEP_RESULTS_CODE_MASK)) & 1;
+}
+
+// Working fine codes of COARSE/MID, code n at bit n
+uint32_t sweep_results_fines(uint8_t coarse, uint8_t mid) {
+    return sweep_results_vars.rows[coarse & SWEEP_RESULTS_CODE_MASK][mid & SWEEP_RESULTS_CODE_MASK];
+}
+
+// Mid codes of COARSE with at least one working fine code, code n at bit n
+uint32_t sweep_results_mids(uint8_t coarse) {
+    return sweep_results_vars.mids[coarse & SWEEP_RESULTS_CODE_MASK];
+}
+
+// First and last working fine code of COARSE/MID, false if there is none
+bool sweep_results_fine_range(uint8_t coarse, uint8_t mid, uint8_t* first, uint8_t* last) {
+    uint32_t fines;
+
+    fines = sweep_results_fines(coarse, mid);
+    if (fines == 0) {
+        return false;
+    }
+    *first = sweep_results_lowest_bit(fines);
+    *last  = sweep_results_highest_bit(fines);
+    return true;
+}
+
+uint16_t sweep_results_count(void) {
+    return sweep_results_vars.count;
+}
+
+/* Logs a record per coarse code with working codes and one per row under
+ * it, then the total, see BINLOG_SWEEP_* in binlog_messages.h.
+ */
+void sweep_results_dump(void) {
+    uint8_t  coarse, mid, first, last, count;
+    uint32_t mids;
+
+    for (coarse = 0; coarse < SWEEP_RESULTS_NUM_CODES; coarse++) {
+        mids = sweep_results_vars.mids[coarse];
+        if (mids == 0) {
+            continue;
+        }
+        count = 0;
+        for (mid = 0; mid < SWEEP_RESULTS_NUM_CODES; mid++) {
+            count += sweep_results_count_bits(sweep_results_vars.rows[coarse][mid]);
+        }
+        binlog(BINLOG_SWEEP_COARSE, coarse, count, mids);
+
+        for (mid = 0; mid < SWEEP_RESULTS_NUM_CODES; mid++) {
+            if (sweep_results_fine_range(coarse, mid, &first, &last)) {
+                binlog(BINLOG_SWEEP_ROW, coarse, mid, first, last, sweep_results_vars.rows[coarse][mid]);
+            }
+        }
+    }
+    binlog(BINLOG_SWEEP_RESULTS, sweep_results_vars.count);
+}
+
+/* Adds the rows with working codes from *NEXT_ROW (coarse * 32 + mid) on to
+ * ENC, as many as fit, and moves *NEXT_ROW past them. Start from 0 and send
+ * payloads until it returns true, when all rows are in.
+ */
+bool sweep_results_pack(packet_encoder_t* enc, uint16_t* next_row) {
+    uint8_t  coarse, mid;
+    uint32_t fines;
+
+    while (*next_row < SWEEP_RESULTS_NUM_ROWS) {
+        coarse = (uint8_t) (*next_row / SWEEP_RESULTS_NUM_CODES);
+        mid    = (uint8_t) (*next_row % SWEEP_RESULTS_NUM_CODES);
+
+        // a whole coarse code without results is skipped at once
+        if (sweep_results_vars.mids[coarse] == 0) {
+            *next_row = (uint16_t) (coarse + 1) * SWEEP_RESULTS_NUM_CODES;
+            continue;
+        }
+        fines = sweep_results_vars.rows[coarse][mid];
+        if (fines != 0 && !packet_add_sweep_row(enc, coarse, mid, fines)) {
+            return false;
+        }
+        (*next_row)++;
+    }
+    return true;
+}
+
+//=========================== private =========================================
+
+// there is no CLZ on the M0, BITS must not be 0
+uint8_t sweep_results_lowest_bit(uint32_t bits) {
+    uint8_t n;
+
+    n = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        n++;
+    }
+    return n;
+}
+
+uint8_t sweep_results_highest_bit(uint32_t bits) {
+    uint8_t n;
+
+    n = 0;
+    while (bits >>= 1) {
+        n++;
+    }
+    return n;
+}
+
+uint8_t sweep_results_count_bits(uint32_t bits) {
+    uint8_t n;
+
+    n = 0;
+    while (bits != 0) {
+        bits &= bits - 1;
+        n++;
+    }
+    return n;
+}
@@ -0,0 +1,31 @@
+#ifndef __SWEEP_RESULTS_H
+#define __SWEEP_RESULTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "packet_encoder.h"
+
+//=========================== define ==========================================
+
+// each of coarse, mid and fine is a 5-bit code
+#define SWEEP_RESULTS_NUM_CODES     32
+#define SWEEP_RESULTS_NUM_ROWS      (SWEEP_RESULTS_NUM_CODES * SWEEP_RESULTS_NUM_CODES)
+
+//=========================== typedef =========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void     sweep_results_clear(void);
+void     sweep_results_mark(uint8_t coarse, uint8_t mid, uint8_t fine);
+bool     sweep_results_get(uint8_t coarse, uint8_t mid, uint8_t fine);
+uint32_t sweep_results_fines(uint8_t coarse, uint8_t mid);
+uint32_t sweep_results_mids(uint8_t coarse);
+bool     sweep_results_fine_range(uint8_t coarse, uint8_t mid, uint8_t* first, uint8_t* last);
+uint16_t sweep_results_count(void);
+void     sweep_results_dump(void);
+bool     sweep_results_pack(packet_encoder_t* enc, uint16_t* next_row);
+
+#endif
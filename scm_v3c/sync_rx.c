@@ -0,0 +1,258 @@
+/**
+\brief Listens only around the expected arrival of a peer that sends at a steady rate.
+
+The synchronized listen of the v3b example_setup (SFD_timestamp, guard_time,
+radio_startup_time...), on the free running RF timer and a single compare:
+- until it is locked, the receiver listens continuously, and the interval is
+  learned from the SFDs of the first two valid frames,
+- once locked, the receiver is turned on startup_ticks before the window,
+  listens from guard_ticks before the expected SFD and is turned off
+  guard_ticks after it if no SFD came,
+- every valid frame moves the next arrival to its own SFD plus the interval,
+  and half of its timing error goes into the interval to follow the drift
+  between the two clocks.
+A missed frame widens the next window by another guard_ticks. After
+SYNC_RX_MAX_MISSES of them in a row the lock is dropped and it searches again.
+
+The application keeps its own radio callbacks and passes the SFD and the
+outcome of each frame on. Between two windows the radio is its own, e.g. to
+send an ACK, as long as it is done before the next window opens.
+*/
+
+#include <stddef.h>
+
+#include "memory_map.h"
+#include "radio.h"
+#include "rftimer.h"
+#include "telemetry.h"
+#include "sync_rx.h"
+
+//=========================== defines =========================================
+
+// its own, only the RF timer test of mode 16 borrows it
+#define SYNC_RX_RFTIMER_COMPAREID   7
+#define SYNC_RX_MAX_MISSES          8
+// closest a window may open after it is scheduled
+#define SYNC_RX_MIN_LEAD_TICKS      10
+// longest frame after its SFD, 128 bytes at 32us, with some margin
+#define SYNC_RX_MAX_FRAME_TICKS     2100
+
+typedef enum {
+    SYNC_RX_OFF = 0,
+    SYNC_RX_SEARCH,                     // listening continuously for a first frame
+    SYNC_RX_LEARN,                      // and for the second, to get the interval
+    SYNC_RX_IDLE,                       // locked, radio off until the window
+    SYNC_RX_WARMUP,                     // receiver on, not listening yet
+    SYNC_RX_LISTEN,                     // in the window
+    SYNC_RX_RECEIVING                   // SFD seen in the window
+} sync_rx_state_t;
+
+//=========================== variables =======================================
+
+typedef struct {
+    sync_rx_state_t     state;
+    uint32_t            guard_ticks;
+    uint32_t            startup_ticks;
+    sync_rx_tune_cbt    tune;
+    uint32_t            interval;       // RF timer ticks between two frames of the peer
+    uint32_t            expected;       // RF timer time of the next SFD
+    uint32_t            window_guard;   // guard of the next window, wider after misses
+    uint32_t            sfd;            // time of the last SFD
+    uint32_t            first_sfd;      // of the first valid frame, to learn the interval
+    uint32_t            listen_start;
+    uint32_t            last_listen_ticks;
+    int32_t             last_error;
+    uint8_t             consecutive_misses;
+    uint32_t            misses;
+} sync_rx_vars_t;
+
+sync_rx_vars_t sync_rx_vars;
+
+//=========================== prototypes ======================================
+
+void sync_rx_schedule(void);
+void sync_rx_miss(void);
+void sync_rx_tick(void);
+
+//=========================== public ==========================================
+
+/* Each window opens GUARD_TICKS before the expected SFD, with the receiver
+ * turned on STARTUP_TICKS before that. TUNE, if not NULL, sets the LO first.
+ */
+void sync_rx_init(uint32_t guard_ticks, uint32_t startup_ticks, sync_rx_tune_cbt tune) {
+    sync_rx_vars.state              = SYNC_RX_OFF;
+    sync_rx_vars.guard_ticks        = guard_ticks;
+    sync_rx_vars.startup_ticks      = startup_ticks;
+    sync_rx_vars.tune               = tune;
+    sync_rx_vars.interval           = 0;
+    sync_rx_vars.last_listen_ticks  = 0;
+    sync_rx_vars.last_error         = 0;
+    sync_rx_vars.consecutive_misses = 0;
+    sync_rx_vars.misses             = 0;
+
+    rftimer_set_callback(sync_rx_tick, SYNC_RX_RFTIMER_COMPAREID);
+    rftimer_set_repeat(false, SYNC_RX_RFTIMER_COMPAREID);
+}
+
+/* Listens continuously until locked, call it again whenever the radio is free
+ * after a frame. Once locked the windows open on their own and it does nothing.
+ */
+void sync_rx_listen(void) {
+    if (sync_rx_vars.state == SYNC_RX_OFF) {
+        sync_rx_vars.state = SYNC_RX_SEARCH;
+    }
+    if (sync_rx_vars.state != SYNC_RX_SEARCH && sync_rx_vars.state != SYNC_RX_LEARN) {
+        return;
+    }
+    if (sync_rx_vars.tune != NULL) {
+        sync_rx_vars.tune();
+    }
+    radio_rxEnable();
+    radio_rxNow();
+}
+
+void sync_rx_stop(void) {
+    RFTIMER_REG__COMPARE_CONTROL(SYNC_RX_RFTIMER_COMPAREID) = 0x0;
+    radio_rfOff();
+    sync_rx_vars.state = SYNC_RX_OFF;
+}
+
+// From the start of frame RX callback
+void sync_rx_startFrame(uint32_t timestamp) {
+    sync_rx_vars.sfd = timestamp;
+
+    if (sync_rx_vars.state == SYNC_RX_LISTEN) {
+        // the watchdog waits for the frame now, in case its end never comes
+        // (e.g. the radio RX filter drops it)
+        rftimer_setCompareIn(timestamp + SYNC_RX_MAX_FRAME_TICKS, SYNC_RX_RFTIMER_COMPAREID);
+        sync_rx_vars.last_listen_ticks = timestamp - sync_rx_vars.listen_start;
+        sync_rx_vars.state = SYNC_RX_RECEIVING;
+    }
+}
+
+// From the end of frame RX callback, VALID if it is a frame of the peer (length, CRC...)
+void sync_rx_endFrame(bool valid) {
+    switch (sync_rx_vars.state) {
+        case SYNC_RX_SEARCH:
+            if (valid) {
+                sync_rx_vars.first_sfd = sync_rx_vars.sfd;
+                sync_rx_vars.state     = SYNC_RX_LEARN;
+            }
+            break;
+        case SYNC_RX_LEARN:
+            if (valid) {
+                sync_rx_vars.interval           = sync_rx_vars.sfd - sync_rx_vars.first_sfd;
+                sync_rx_vars.expected           = sync_rx_vars.sfd + sync_rx_vars.interval;
+                sync_rx_vars.last_error         = 0;
+                sync_rx_vars.consecutive_misses = 0;
+                telemetry_trace(TELEMETRY_TRACE_SYNC_LOCK, sync_rx_vars.interval);
+                sync_rx_schedule();
+            }
+            break;
+        case SYNC_RX_RECEIVING:
+            if (!valid) {
+                sync_rx_miss();
+                break;
+            }
+            sync_rx_vars.last_error         = (int32_t)(sync_rx_vars.sfd - sync_rx_vars.expected);
+            sync_rx_vars.interval          += sync_rx_vars.last_error / 2;
+            sync_rx_vars.expected           = sync_rx_vars.sfd + sync_rx_vars.interval;
+            sync_rx_vars.consecutive_misses = 0;
+            telemetry_trace(TELEMETRY_TRACE_SYNC_FRAME, (uint32_t) sync_rx_vars.last_error);
+            sync_rx_schedule();
+            break;
+        default:
+            break;
+    }
+}
+
+bool sync_rx_locked(void) {
+    return sync_rx_vars.state >= SYNC_RX_IDLE;
+}
+
+uint32_t sync_rx_interval(void) {
+    return sync_rx_vars.interval;
+}
+
+// RF timer ticks the last SFD came after the expected time, negative if before
+int32_t sync_rx_last_error(void) {
+    return sync_rx_vars.last_error;
+}
+
+// RF timer ticks the receiver was on in the last window, up to the SFD
+uint32_t sync_rx_last_listen_ticks(void) {
+    return sync_rx_vars.last_listen_ticks;
+}
+
+uint32_t sync_rx_misses(void) {
+    return sync_rx_vars.misses;
+}
+
+//=========================== private =========================================
+
+// Sets the RF timer to turn the receiver on for the window of the expected SFD
+void sync_rx_schedule(void) {
+    uint32_t open;
+
+    sync_rx_vars.window_guard = sync_rx_vars.guard_ticks * (1 + sync_rx_vars.consecutive_misses);
+    if (sync_rx_vars.window_guard > sync_rx_vars.interval / 4) {
+        sync_rx_vars.window_guard = sync_rx_vars.interval / 4;
+    }
+
+    // a window the application kept the radio past is skipped
+    open = sync_rx_vars.expected - sync_rx_vars.window_guard - sync_rx_vars.startup_ticks;
+    while ((int32_t)(open - rftimer_readCounter()) < SYNC_RX_MIN_LEAD_TICKS) {
+        sync_rx_vars.expected += sync_rx_vars.interval;
+        open                  += sync_rx_vars.interval;
+    }
+
+    sync_rx_vars.state = SYNC_RX_IDLE;
+    rftimer_setCompareIn(open, SYNC_RX_RFTIMER_COMPAREID);
+}
+
+void sync_rx_miss(void) {
+    sync_rx_vars.misses++;
+    telemetry_trace(TELEMETRY_TRACE_SYNC_MISS, sync_rx_vars.consecutive_misses + 1);
+    if (++sync_rx_vars.consecutive_misses >= SYNC_RX_MAX_MISSES) {
+        sync_rx_vars.consecutive_misses = 0;
+        sync_rx_vars.state = SYNC_RX_SEARCH;
+        sync_rx_listen();
+        return;
+    }
+    sync_rx_vars.expected += sync_rx_vars.interval;
+    sync_rx_schedule();
+}
+
+//=========================== interrupt =======================================
+
+void sync_rx_tick(void) {
+    switch (sync_rx_vars.state) {
+        case SYNC_RX_IDLE:
+            if (sync_rx_vars.tune != NULL) {
+                sync_rx_vars.tune();
+            }
+            radio_rxEnable();
+            sync_rx_vars.listen_start = rftimer_readCounter();
+            sync_rx_vars.state = SYNC_RX_WARMUP;
+            rftimer_setCompareIn(sync_rx_vars.expected - sync_rx_vars.window_guard, SYNC_RX_RFTIMER_COMPAREID);
+            break;
+        case SYNC_RX_WARMUP:
+            radio_rxNow();
+            sync_rx_vars.state = SYNC_RX_LISTEN;
+            rftimer_setCompareIn(sync_rx_vars.expected + sync_rx_vars.window_guard, SYNC_RX_RFTIMER_COMPAREID);
+            break;
+        case SYNC_RX_LISTEN:
+            // nothing in the window
+            radio_rfOff();
+            sync_rx_vars.last_listen_ticks = rftimer_readCounter() - sync_rx_vars.listen_start;
+            sync_rx_miss();
+            break;
+        case SYNC_RX_RECEIVING:
+            // no end of frame, not one of the peer's
+            radio_rfOff();
+            sync_rx_miss();
+            break;
+        default:
+            break;
+    }
+}
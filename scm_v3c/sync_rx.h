@@ -0,0 +1,29 @@
+#ifndef __SYNC_RX_H
+#define __SYNC_RX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+//=========================== typedef =========================================
+
+// Tunes the LO for RX, called before the receiver is turned on
+typedef void (*sync_rx_tune_cbt)(void);
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void     sync_rx_init(uint32_t guard_ticks, uint32_t startup_ticks, sync_rx_tune_cbt tune);
+void     sync_rx_listen(void);
+void     sync_rx_stop(void);
+void     sync_rx_startFrame(uint32_t timestamp);
+void     sync_rx_endFrame(bool valid);
+bool     sync_rx_locked(void);
+uint32_t sync_rx_interval(void);
+int32_t  sync_rx_last_error(void);
+uint32_t sync_rx_last_listen_ticks(void);
+uint32_t sync_rx_misses(void);
+
+#endif
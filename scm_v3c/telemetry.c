@@ -0,0 +1,171 @@
+/**
+\brief Framed telemetry over the UART.
+
+Each frame carries [channel][sequence number][payload][CRC-16, LE], COBS
+encoded and with a 0x00 delimiter on both sides:
+
+    0x00 COBS([channel][seq][payload][crc_lo][crc_hi]) 0x00
+
+COBS leaves no 0x00 inside the frame, so a receiver resynchronizes at the
+next delimiter after a dropped byte and loses only the frame it was in. The
+leading delimiter keeps plain printf text, which never contains 0x00, out of
+the frame that follows it. The CRC is CRC-16/CCITT-FALSE over the channel,
+sequence number and payload. Sequence numbers count per channel, so the
+receiver (tools/telemetry_receiver.py) can tell lost and reordered frames
+apart for each stream.
+*/
+
+#include <string.h>
+
+#include "memory_map.h"
+#include "rftimer.h"
+#include "uart.h"
+#include "telemetry.h"
+
+//=========================== defines =========================================
+
+#define TELEMETRY_HEADER_LEN        2
+#define TELEMETRY_CRC_LEN           2
+#define TELEMETRY_MAX_FRAME_LEN     (TELEMETRY_HEADER_LEN + TELEMETRY_MAX_PAYLOAD_LEN + TELEMETRY_CRC_LEN)
+// a COBS overhead byte every 254 bytes, plus the two delimiters
+#define TELEMETRY_MAX_ENCODED_LEN   (TELEMETRY_MAX_FRAME_LEN + TELEMETRY_MAX_FRAME_LEN / 254 + 1 + 2)
+
+#define TELEMETRY_TRACE_LEN         9
+
+#define TELEMETRY_DELIMITER         0x00
+#define TELEMETRY_CRC_INIT          0xFFFF
+
+//=========================== variables =======================================
+
+typedef struct {
+    uint8_t     seq[TELEMETRY_NUM_CHANNELS];
+} telemetry_vars_t;
+
+telemetry_vars_t telemetry_vars;
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021) a nibble at a time
+const uint16_t telemetry_crc16_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+//=========================== prototypes ======================================
+
+uint16_t telemetry_cobs_encode(const uint8_t* in, uint16_t len, uint8_t* out);
+
+//=========================== public ==========================================
+
+/* Sends LEN bytes of PAYLOAD as one frame on CHANNEL. Safe to call from
+ * interrupt context. Returns false if the frame was dropped, because it is
+ * too long or because the UART buffer was full (the receiver sees a gap in
+ * the channel's sequence numbers).
+ */
+bool telemetry_send(telemetry_channel_t channel, const uint8_t* payload, uint8_t len) {
+    uint8_t  frame[TELEMETRY_MAX_FRAME_LEN];
+    uint8_t  encoded[TELEMETRY_MAX_ENCODED_LEN];
+    uint16_t frame_len;
+    uint16_t encoded_len;
+    uint16_t crc;
+    bool     in_isr;
+
+    if (channel >= TELEMETRY_NUM_CHANNELS || len > TELEMETRY_MAX_PAYLOAD_LEN) {
+        return false;
+    }
+
+    frame[0] = (uint8_t) channel;
+
+    // interrupts can send on the same channel, take the sequence number
+    // atomically; frames can still be queued out of order, which the
+    // receiver reports as reordered
+    in_isr = (ICSR & ICSR_VECTACTIVE) != 0;
+    if (!in_isr) {
+        HAL_DISABLE_INTERRUPTS();
+    }
+    frame[1] = telemetry_vars.seq[channel]++;
+    if (!in_isr) {
+        HAL_ENABLE_INTERRUPTS();
+    }
+
+    memcpy(&frame[TELEMETRY_HEADER_LEN], payload, len);
+    frame_len = TELEMETRY_HEADER_LEN + len;
+
+    crc = telemetry_crc16(frame, frame_len);
+    frame[frame_len++] = (uint8_t)(crc);
+    frame[frame_len++] = (uint8_t)(crc >> 8);
+
+    encoded_len = 0;
+    encoded[encoded_len++] = TELEMETRY_DELIMITER;
+    encoded_len += telemetry_cobs_encode(frame, frame_len, &encoded[encoded_len]);
+    encoded[encoded_len++] = TELEMETRY_DELIMITER;
+
+    return uart_tx_write(encoded, encoded_len);
+}
+
+/* Sends EVENT with ARG and the RF timer counter on the trace channel. Short
+ * enough for the radio interrupts, once their timing critical part is done.
+ * Does nothing without TELEMETRY_ENABLED, the unframed stream has no room for it.
+ */
+bool telemetry_trace(telemetry_trace_event_t event, uint32_t arg) {
+#if TELEMETRY_ENABLED
+    uint8_t  payload[TELEMETRY_TRACE_LEN];
+    uint32_t timestamp;
+
+    timestamp  = rftimer_readCounter();
+    payload[0] = (uint8_t) event;
+    payload[1] = (uint8_t)(timestamp);
+    payload[2] = (uint8_t)(timestamp >> 8);
+    payload[3] = (uint8_t)(timestamp >> 16);
+    payload[4] = (uint8_t)(timestamp >> 24);
+    payload[5] = (uint8_t)(arg);
+    payload[6] = (uint8_t)(arg >> 8);
+    payload[7] = (uint8_t)(arg >> 16);
+    payload[8] = (uint8_t)(arg >> 24);
+    return telemetry_send(TELEMETRY_CHANNEL_TRACE, payload, TELEMETRY_TRACE_LEN);
+#else
+    return false;
+#endif
+}
+
+uint16_t telemetry_crc16(const uint8_t* data, uint16_t len) {
+    uint16_t crc;
+    uint16_t i;
+
+    crc = TELEMETRY_CRC_INIT;
+    for (i = 0; i < len; i++) {
+        crc = (crc << 4) ^ telemetry_crc16_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ telemetry_crc16_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+//=========================== private =========================================
+
+// Consistent overhead byte stuffing, returns the encoded length
+uint16_t telemetry_cobs_encode(const uint8_t* in, uint16_t len, uint8_t* out) {
+    uint16_t code_pos;
+    uint16_t out_len;
+    uint16_t i;
+    uint8_t  code;
+
+    code_pos = 0;
+    out_len  = 1;
+    code     = 1;
+
+    for (i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = out_len++;
+            code     = 1;
+        } else {
+            out[out_len++] = in[i];
+            code++;
+            if (code == 0xFF) {
+                out[code_pos] = code;
+                code_pos = out_len++;
+                code     = 1;
+            }
+        }
+    }
+    out[code_pos] = code;
+    return out_len;
+}
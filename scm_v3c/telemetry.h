@@ -0,0 +1,44 @@
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+// 1 to send binlog records and bulk dumps as telemetry frames, 0 for the
+// unframed binlog records (see tools/binlog_decode.py) and plain text dumps
+#define TELEMETRY_ENABLED           1
+
+#define TELEMETRY_MAX_PAYLOAD_LEN   128
+
+//=========================== typedef =========================================
+
+// logical channels multiplexed on the UART, each with its own sequence number
+typedef enum {
+    TELEMETRY_CHANNEL_LOG       = 0,    // binlog records without their sync and checksum
+    TELEMETRY_CHANNEL_COUNTERS  = 1,    // counters_snapshot_t, 6 x uint32 LE, see counters_send()
+    TELEMETRY_CHANNEL_IMU       = 2,    // IMU samples
+    TELEMETRY_CHANNEL_TRACE     = 3,    // [event] [RF timer, uint32 LE] [arg, uint32 LE], see telemetry_trace()
+    TELEMETRY_CHANNEL_RAW_CHIPS = 4,    // raw chip captures, 32-bit little endian words
+    TELEMETRY_NUM_CHANNELS
+} telemetry_channel_t;
+
+// events on the trace channel, timing of the radio interrupts
+typedef enum {
+    TELEMETRY_TRACE_ACK_SENT    = 0,    // arg: RF timer ticks from the end of the frame
+    TELEMETRY_TRACE_ACK_LATE    = 1,    // arg: RF timer ticks it goes out past the turnaround
+    TELEMETRY_TRACE_SYNC_LOCK   = 2,    // arg: interval learned, RF timer ticks
+    TELEMETRY_TRACE_SYNC_FRAME  = 3,    // arg: SFD error, RF timer ticks, int32
+    TELEMETRY_TRACE_SYNC_MISS   = 4     // arg: misses in a row
+} telemetry_trace_event_t;
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+bool     telemetry_send(telemetry_channel_t channel, const uint8_t* payload, uint8_t len);
+bool     telemetry_trace(telemetry_trace_event_t event, uint32_t arg);
+uint16_t telemetry_crc16(const uint8_t* data, uint16_t len);
+
+#endif
@@ -1,32 +1,86 @@
-#include "temperature.h"
-#include "scm3c_hw_interface.h"
-#include "Memory_map.h"
-#include "rftimer.h"
-#include "fixed-point.h"
-
-/* Uses RF Timer to measure 2MHz and 32kHz clock counts over MEASUREMENT_TIME_MILLISECONDS. Then calculates the ratio
- * of these clocks and uses that ratio to calculate the returned value as follows:
- * return CLOCK_RATIO_VS_TEMP_OFFSET + (CLOCK_RATIO_VS_TEMP_SLOPE * ratio).
- * CLOCK_RATIO_VS_TEMP_OFFSET and CLOCK_RATIO_VS_TEMP_SLOPE represent the parameters of a linear regression model used
- * to relate the ratio fo the 2MHz and 32kHz clocks to a temperature value in degrees Celcius.
- */
-double get_2MHz_32k_ratio_temp_estimate(unsigned int measurement_time_milliseconds, double clock_ratio_vs_temp_slope,
-	double clock_ratio_vs_temp_offset) {
-	unsigned int count_2M, count_32k;
-	double ratio;
-		
-	// Measure the 2MHz and 32kHz counters over MEASUREMENT_TIME_MILLISECONDS	
-	read_counters_duration(measurement_time_milliseconds);
-	count_2M = scm3c_hw_interface_get_count_2M();
-	count_32k = scm3c_hw_interface_get_count_32k();
-	
-	reset_counters();
-	enable_counters();
-		
-	// Calculate the ratio between the 2M and the 32kHZz clocks
-	ratio = fix_double(fix_div(fix_init(count_2M), fix_init(count_32k)));
-	
-	// Using our linear model that we fit based on fixed point temperature measurement
-	// we can determine an estimate for temperature.
-	return clock_ratio_vs_temp_slope * ratio + clock_ratio_vs_temp_offset;
-}
+#include "temperature.h"
+#include "scm3c_hw_interface.h"
+#include "memory_map.h"
+#include "rftimer.h"
+#include "fixed_point.h"
+
+/* Returns COUNT_2M / COUNT_32K with CLOCK_RATIO_Q fractional bits, rounded down, which is what
+ * fix_div(fix_init(count_2M), fix_init(count_32k)) gave. The division is split into the integer
+ * part and the remainder so it only needs 32 bit divides, which holds for up to 2^22 32kHz counts
+ * (two minutes) where fix_init() overflowed past 2^21 2MHz counts.
+ */
+uint32_t clock_ratio(uint32_t count_2M, uint32_t count_32k) {
+	uint32_t quotient, remainder;
+
+	if (count_32k == 0) {
+		return 0;
+	}
+	quotient = count_2M / count_32k;
+	remainder = count_2M % count_32k;
+
+	return (quotient << CLOCK_RATIO_Q) + (remainder << CLOCK_RATIO_Q) / count_32k;
+}
+
+/* Evaluates the linear model SLOPE * RATIO + OFFSET, with RATIO from clock_ratio() and SLOPE and
+ * OFFSET from CLOCK_RATIO_COEF(), and returns it times SCALE truncated toward zero, as the cast
+ * of the double result did. A SCALE of 100 gives centi-degrees for a temperature model. Only
+ * 32 bit operations, as long as SLOPE times the integer part of RATIO fits in an int32_t.
+ */
+int32_t clock_ratio_model(uint32_t ratio, int32_t slope, int32_t offset, int32_t scale) {
+	int32_t whole, part, fraction, scaled;
+	int32_t abs_scale;
+
+	// the model in thousandths is WHOLE + FRACTION / 2^CLOCK_RATIO_Q, 0 <= FRACTION < 2^CLOCK_RATIO_Q,
+	// the coefficients stay decimal so it matches the fitted one exactly
+	part     = slope * (int32_t) (ratio & ((1 << CLOCK_RATIO_Q) - 1));
+	whole    = slope * (int32_t) (ratio >> CLOCK_RATIO_Q) + offset + (part >> CLOCK_RATIO_Q);
+	fraction = part & ((1 << CLOCK_RATIO_Q) - 1);
+
+	// then in units, WHOLE + (PART + FRACTION / 2^CLOCK_RATIO_Q) / 1000 with 0 <= PART < 1000, so
+	// scaling what is left of a unit stays below 1000 << CLOCK_RATIO_Q times SCALE
+	part  = whole % 1000;
+	whole = whole / 1000;
+	if (part < 0) {
+		part  += 1000;
+		whole -= 1;
+	}
+	part = (part << CLOCK_RATIO_Q) + fraction;
+
+	// truncating toward zero, what is left of a unit rounds up below zero
+	abs_scale = scale < 0 ? -scale : scale;
+	scaled    = whole * abs_scale;
+	if (scaled >= 0) {
+		scaled += part * abs_scale / (1000 << CLOCK_RATIO_Q);
+	} else {
+		scaled += (part * abs_scale + (1000 << CLOCK_RATIO_Q) - 1) / (1000 << CLOCK_RATIO_Q);
+	}
+	return scale < 0 ? -scaled : scaled;
+}
+
+/* Uses RF Timer to measure 2MHz and 32kHz clock counts over MEASUREMENT_TIME_MILLISECONDS. Then calculates the ratio
+ * of these clocks and uses that ratio to calculate the returned value as follows:
+ * return CLOCK_RATIO_VS_TEMP_OFFSET + (CLOCK_RATIO_VS_TEMP_SLOPE * ratio).
+ * CLOCK_RATIO_VS_TEMP_OFFSET and CLOCK_RATIO_VS_TEMP_SLOPE represent the parameters of a linear regression model used
+ * to relate the ratio fo the 2MHz and 32kHz clocks to a temperature value, given with CLOCK_RATIO_COEF().
+ * The temperature is returned in hundredths of a degree Celcius.
+ */
+int32_t get_2MHz_32k_ratio_temp_estimate(unsigned int measurement_time_milliseconds, int32_t clock_ratio_vs_temp_slope,
+	int32_t clock_ratio_vs_temp_offset) {
+	unsigned int count_2M, count_32k;
+	uint32_t ratio;
+
+	// Measure the 2MHz and 32kHz counters over MEASUREMENT_TIME_MILLISECONDS
+	read_counters_duration(measurement_time_milliseconds);
+	count_2M = scm3c_hw_interface_get_count_2M();
+	count_32k = scm3c_hw_interface_get_count_32k();
+
+	reset_counters();
+	enable_counters();
+
+	// Calculate the ratio between the 2M and the 32kHZz clocks
+	ratio = clock_ratio(count_2M, count_32k);
+
+	// Using our linear model that we fit based on fixed point temperature measurement
+	// we can determine an estimate for temperature.
+	return clock_ratio_model(ratio, clock_ratio_vs_temp_slope, clock_ratio_vs_temp_offset, 100);
+}
@@ -1,2 +1,24 @@
-// Functions
-double get_2MHz_32k_ratio_temp_estimate(unsigned int measurement_time_milliseconds, double clock_ratio_vs_temp_slope, double clock_ratio_vs_temp_offset);
\ No newline at end of file
+#ifndef __TEMPERATURE_H
+#define __TEMPERATURE_H
+
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+// fractional bits of the 2MHz/32kHz clock ratio
+#define CLOCK_RATIO_Q 10
+
+/* Model coefficients are passed in thousandths, so the three decimals of a
+ * fitted slope or offset are exact. The constant is folded by the compiler,
+ * e.g. CLOCK_RATIO_COEF(-19.293) is -19293 and no floating point reaches the
+ * image.
+ */
+#define CLOCK_RATIO_COEF(x) ((int32_t)((x) * 1000 + ((x) < 0 ? -0.5 : 0.5)))
+
+//=========================== prototypes ======================================
+
+uint32_t clock_ratio(uint32_t count_2M, uint32_t count_32k);
+int32_t  clock_ratio_model(uint32_t ratio, int32_t slope, int32_t offset, int32_t scale);
+int32_t  get_2MHz_32k_ratio_temp_estimate(unsigned int measurement_time_milliseconds, int32_t clock_ratio_vs_temp_slope, int32_t clock_ratio_vs_temp_offset);
+
+#endif
@@ -0,0 +1,278 @@
+"""
+Decodes the binary log records sent by binlog() (see scm_v3c/binlog.c).
+
+The message dictionary is read from binlog_messages.h, which must be the one
+the firmware was built with. Any bytes that aren't part of a valid record,
+like the output of a plain printf, are passed through as text.
+
+    python binlog_decode.py capture.bin                 # text, as printf would have
+    python binlog_decode.py --port COM5 --format csv    # live, from the serial port
+    python binlog_decode.py --dump-dict dict.json       # to keep next to a build
+
+The output formats:
+    text  the formatted message, prefixed by the timestamp with --timestamps
+    json  one object per line: {"t_ms", "id", "name", "args"} or {"text"}
+    csv   t_ms,name,arg0,arg1,...; other text becomes a comment line
+"""
+
+import argparse
+import codecs
+import csv
+import json
+import os
+import re
+import sys
+
+# =========================== defines =========================================
+
+BINLOG_SYNC         = 0xA5
+TIMESTAMP_LEN       = 4
+RFTIMER_TICKS_PER_MS = 500.0
+MAX_VARINT_LEN      = 5
+
+DEFAULT_MESSAGES    = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'binlog_messages.h')
+DEFAULT_BAUDRATE    = 19200
+
+MESSAGE_RE = re.compile(
+    r'^\s*BINLOG_MESSAGE\(\s*(\w+)\s*,\s*(\d+)\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)\)',
+    re.MULTILINE,
+)
+STRING_RE  = re.compile(r'"((?:[^"\\]|\\.)*)"')
+# C conversion specifiers that take an argument, for the Python % operator
+CONVERSION_RE = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l)?([diuxXoc%])')
+
+# =========================== helpers =========================================
+
+def load_dictionary(path):
+    with open(path) as f:
+        source = f.read()
+    messages = []
+    for match in MESSAGE_RE.finditer(source):
+        name, nargs, literal = match.groups()
+        fmt = ''.join(codecs.decode(s, 'unicode_escape') for s in STRING_RE.findall(literal))
+        messages.append({'id': len(messages), 'name': name, 'nargs': int(nargs), 'format': fmt})
+    return messages
+
+def format_message(message, args):
+    values = iter(args)
+
+    def convert(match):
+        flags, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+        value = next(values)
+        if conversion in 'uxXo':
+            value &= 0xFFFFFFFF
+        if conversion == 'u':
+            conversion = 'd'
+        if conversion == 'c':
+            value = chr(value & 0xFF)
+        return ('%' + flags + conversion) % value
+
+    return CONVERSION_RE.sub(convert, message['format'])
+
+def read_varint(data, pos):
+    value = 0
+    for i in range(MAX_VARINT_LEN):
+        if pos + i >= len(data):
+            return None, pos
+        value |= (data[pos + i] & 0x7F) << (7 * i)
+        if not data[pos + i] & 0x80:
+            # undo the zigzag
+            value &= 0xFFFFFFFF
+            return (value >> 1) ^ -(value & 1), pos + i + 1
+    raise ValueError('varint too long')
+
+# =========================== decoder =========================================
+
+class BinlogDecoder(object):
+    '''
+    Splits a byte stream into records and text. feed() returns what could be
+    decoded so far as ('record', message, t_ms, args) and ('text', str) items,
+    keeping an incomplete record for the next call.
+    '''
+
+    def __init__(self, messages):
+        self.messages = messages
+        self.buffer   = bytearray()
+
+    def feed(self, data):
+        self.buffer += data
+        out  = []
+        text = bytearray()
+        pos  = 0
+
+        while pos < len(self.buffer):
+            if self.buffer[pos] != BINLOG_SYNC:
+                text.append(self.buffer[pos])
+                pos += 1
+                continue
+            try:
+                record = self._parse(pos)
+            except ValueError:
+                record = None
+            if record == 'incomplete':
+                break
+            if record is None:
+                # a corrupted record, or a 0xA5 that happened to be on the line
+                text.append(self.buffer[pos])
+                pos += 1
+                continue
+            if text:
+                out.append(('text', text.decode('ascii', 'replace')))
+                text = bytearray()
+            item, pos = record
+            out.append(item)
+
+        if text:
+            out.append(('text', text.decode('ascii', 'replace')))
+        del self.buffer[:pos]
+        return out
+
+    def _parse(self, start):
+        data = self.buffer
+        pos  = start + 1
+        if pos >= len(data):
+            return 'incomplete'
+        msg_id = data[pos]
+        if msg_id >= len(self.messages):
+            return None
+        message = self.messages[msg_id]
+        pos += 1
+
+        if pos + TIMESTAMP_LEN > len(data):
+            return 'incomplete'
+        timestamp = int.from_bytes(bytes(data[pos:pos + TIMESTAMP_LEN]), 'little')
+        pos += TIMESTAMP_LEN
+
+        args = []
+        for _ in range(message['nargs']):
+            value, pos = read_varint(data, pos)
+            if value is None:
+                return 'incomplete'
+            args.append(value)
+
+        if pos >= len(data):
+            return 'incomplete'
+        if (sum(data[start + 1:pos + 1]) & 0xFF) != 0:
+            return None
+
+        return ('record', message, timestamp / RFTIMER_TICKS_PER_MS, args), pos + 1
+
+# =========================== writers =========================================
+
+class TextWriter(object):
+
+    def __init__(self, out, timestamps):
+        self.out        = out
+        self.timestamps = timestamps
+
+    def write(self, item):
+        if item[0] == 'text':
+            self.out.write(item[1])
+            return
+        _, message, t_ms, args = item
+        if self.timestamps:
+            self.out.write('[{0:12.3f}] '.format(t_ms))
+        self.out.write(format_message(message, args))
+
+class JsonWriter(object):
+
+    def __init__(self, out):
+        self.out  = out
+        self.text = ''
+
+    def write(self, item):
+        if item[0] == 'text':
+            # one object per line of text
+            self.text += item[1]
+            while '\n' in self.text:
+                line, self.text = self.text.split('\n', 1)
+                if line.strip():
+                    self.out.write(json.dumps({'text': line.rstrip('\r')}) + '\n')
+            return
+        _, message, t_ms, args = item
+        self.out.write(json.dumps({'t_ms': t_ms, 'id': message['id'], 'name': message['name'], 'args': args}) + '\n')
+
+class CsvWriter(object):
+
+    def __init__(self, out):
+        self.out    = out
+        self.writer = csv.writer(out, lineterminator='\n')
+        self.text   = ''
+
+    def write(self, item):
+        if item[0] == 'text':
+            self.text += item[1]
+            while '\n' in self.text:
+                line, self.text = self.text.split('\n', 1)
+                if line.strip():
+                    self.out.write('# ' + line.rstrip('\r') + '\n')
+            return
+        _, message, t_ms, args = item
+        self.writer.writerow(['{0:.3f}'.format(t_ms), message['name']] + args)
+
+# =========================== main ============================================
+
+def read_chunks(args):
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baudrate, timeout=0.1) as port:
+            while True:
+                yield port.read(256)
+    elif args.input == '-':
+        stream = sys.stdin.buffer
+        while True:
+            chunk = stream.read1(4096) if hasattr(stream, 'read1') else stream.read(4096)
+            if not chunk:
+                return
+            yield chunk
+    else:
+        with open(args.input, 'rb') as f:
+            while True:
+                chunk = f.read(4096)
+                if not chunk:
+                    return
+                yield chunk
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes SCuM binlog records.')
+    parser.add_argument('input', nargs='?', default='-', help='captured UART output, - for stdin')
+    parser.add_argument('--port', help='read from this serial port instead')
+    parser.add_argument('--baudrate', type=int, default=DEFAULT_BAUDRATE)
+    parser.add_argument('--messages', default=DEFAULT_MESSAGES, help='binlog_messages.h the firmware was built with')
+    parser.add_argument('--dictionary', help='JSON dictionary written by --dump-dict, instead of --messages')
+    parser.add_argument('--format', choices=['text', 'json', 'csv'], default='text')
+    parser.add_argument('--timestamps', action='store_true', help='prefix text records with the RF timer in ms')
+    parser.add_argument('--dump-dict', metavar='FILE', help='write the message dictionary as JSON and exit')
+    args = parser.parse_args()
+
+    if args.dictionary:
+        with open(args.dictionary) as f:
+            messages = json.load(f)
+    else:
+        messages = load_dictionary(args.messages)
+
+    if args.dump_dict:
+        with open(args.dump_dict, 'w') as f:
+            json.dump(messages, f, indent=4)
+        return
+
+    if args.format == 'json':
+        writer = JsonWriter(sys.stdout)
+    elif args.format == 'csv':
+        writer = CsvWriter(sys.stdout)
+    else:
+        writer = TextWriter(sys.stdout, args.timestamps)
+
+    decoder = BinlogDecoder(messages)
+    try:
+        for chunk in read_chunks(args):
+            for item in decoder.feed(chunk):
+                writer.write(item)
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,120 @@
+"""
+Writes the config block that sets the experiment of freq_sweep_rx_tx at boot
+(see experiment_config_t in applications/freq_sweep_rx_tx/freq_sweep_rx_tx.c),
+so one binary serves every mode and LC range without a rebuild.
+
+Fields not given keep the defaults of the firmware. LC codes are given as
+coarse,mid,fine and the sweep ranges as the six codes of the sweeptx/sweeprx
+commands, the stops exclusive.
+
+    python experiment_config.py -o rx.cfg mode=1 sweep_rx=0 fixed_rx=21,17,22
+    python experiment_config.py -o sweep.cfg sweep_range_tx=20,25,0,32,0,32
+    python bootload.py --config_block rx.cfg ...
+
+The emulator takes the same file with -c. --show prints the block of a file.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+# =========================== defines =========================================
+
+# must match scm3c_hw_interface.h
+CONFIG_ADDR             = 0xFE00
+CONFIG_MAGIC            = b'ECFG'
+CONFIG_MAX_LEN          = 0xFEF0 - CONFIG_ADDR - 12
+
+# in the order of experiment_config_t, with the defaults of the firmware
+FIELDS = [
+    ('mode',                [0]),
+    ('optical_calibrate',   [1]),
+    ('solar_mode',          [0]),
+    ('sweep_tx',            [0]),
+    ('sweep_rx',            [1]),
+    ('send_ack',            [1]),
+    ('num_ack',             [10]),
+    ('fixed_tx',            [22, 15, 24]),
+    ('fixed_rx',            [21, 17, 22]),
+    ('sweep_range_tx',      [20, 25, 0, 31, 0, 31]),
+    ('sweep_range_rx',      [21, 22, 20, 21, 6, 9]),
+]
+
+# =========================== block ===========================================
+
+def build_payload(values):
+    payload = bytearray()
+    for name, default in FIELDS:
+        payload += bytearray(values.get(name, default))
+    return payload
+
+def build_block(payload):
+    '''
+    Magic, payload length and CRC, then the payload. The CRC is the one the
+    Teensy puts over the code, crc32c() on the chip.
+    '''
+    if len(payload) > CONFIG_MAX_LEN:
+        raise ValueError('config of %d bytes does not fit' % len(payload))
+    header = CONFIG_MAGIC + struct.pack('<II', len(payload), zlib.crc32(bytes(payload)) & 0xFFFFFFFF)
+    return header + bytes(payload)
+
+def parse_block(block):
+    '''
+    Returns the field values of a block, raises ValueError if it is not valid.
+    '''
+    if block[:4] != CONFIG_MAGIC:
+        raise ValueError('no config magic')
+    length, crc = struct.unpack('<II', block[4:12])
+    payload = bytearray(block[12:12 + length])
+    if len(payload) != length or zlib.crc32(bytes(payload)) & 0xFFFFFFFF != crc:
+        raise ValueError('bad length or CRC')
+    expected = sum(len(default) for _, default in FIELDS)
+    if length != expected:
+        raise ValueError('%d bytes, the firmware takes %d' % (length, expected))
+    values = {}
+    pos = 0
+    for name, default in FIELDS:
+        values[name] = list(payload[pos:pos + len(default)])
+        pos += len(default)
+    return values
+
+def parse_assignment(text):
+    name, _, value = text.partition('=')
+    defaults = dict(FIELDS)
+    if name not in defaults:
+        raise ValueError('unknown field %s, one of %s' % (name, ', '.join(n for n, _ in FIELDS)))
+    codes = [int(v, 0) for v in value.split(',')]
+    if len(codes) != len(defaults[name]) or any(c < 0 or c > 255 for c in codes):
+        raise ValueError('%s takes %d values 0-255' % (name, len(defaults[name])))
+    return name, codes
+
+# =========================== main ============================================
+
+def main():
+    parser = argparse.ArgumentParser(description='Writes the freq_sweep_rx_tx config block.')
+    parser.add_argument('fields', nargs='*', help='name=value, see FIELDS')
+    parser.add_argument('-o', '--output', help='file to write the block to')
+    parser.add_argument('--show', metavar='FILE', help='print the fields of a block instead')
+    args = parser.parse_args()
+
+    try:
+        if args.show:
+            with open(args.show, 'rb') as f:
+                values = parse_block(f.read())
+        else:
+            values = dict(parse_assignment(a) for a in args.fields)
+            block = build_block(build_payload(values))
+            if args.output is None:
+                parser.error('no output file')
+            with open(args.output, 'wb') as f:
+                f.write(block)
+            values = parse_block(block)
+    except ValueError as e:
+        sys.exit(str(e))
+
+    for name, _ in FIELDS:
+        print('%-18s %s' % (name, ','.join(str(v) for v in values[name])))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,175 @@
+"""
+Decodes the binary TX payloads built by packet_encoder.c (see
+scm_v3c/packet_encoder.c) for the freq_sweep_rx_tx data sources.
+
+A payload is the packet counter followed by type-length-value records. Each
+input line holds one payload as hex, with or without separators, e.g. as
+dumped by the receiving OpenMote or a sniffer. The longest run of hex bytes
+on a line is taken as the payload, so prefixes like a timestamp or an RSSI
+are ignored. Pass --strip-crc if the payloads still end with the CRC. Lines
+without a payload are passed through.
+
+    python packet_decode.py received.txt
+    python packet_decode.py --format json --strip-crc sniffer.txt
+"""
+
+import argparse
+import io
+import json
+import re
+import sys
+
+import binlog_decode
+import telemetry_receiver
+
+# =========================== defines =========================================
+
+PACKET_PAD              = 0x00
+PACKET_LC_CONFIG        = 0x01
+PACKET_CLOCK_COUNTS     = 0x02
+PACKET_TEMPERATURE      = 0x03
+PACKET_OPTICAL          = 0x04
+PACKET_IMU              = 0x05
+PACKET_SWEEP_ROW        = 0x06
+PACKET_TIME             = 0x07
+PACKET_ADC              = 0x08
+
+RECORD_HEADER_LEN       = 2
+LENGTH_CRC              = 2
+# the chip pads shorter payloads, see PACKET_MIN_FRAME_LEN
+MIN_PAYLOAD_LEN         = 6
+
+OPTICAL_FIELDS          = ['HF_CLOCK_coarse', 'HF_CLOCK_fine', 'RC2M_coarse', 'RC2M_fine',
+                           'RC2M_superfine', 'IF_coarse', 'IF_fine']
+
+HEX_RUN_RE              = re.compile(r'(?:[0-9A-Fa-f]{2}[ :-]?){%d,}' % MIN_PAYLOAD_LEN)
+
+# =========================== decoder =========================================
+
+def read_unsigned_varint(data, pos):
+    '''
+    The counts are plain varints, binlog_decode.read_varint() undoes a zigzag.
+    '''
+    value = 0
+    for i in range(binlog_decode.MAX_VARINT_LEN):
+        if pos + i >= len(data):
+            return None, pos
+        value |= (data[pos + i] & 0x7F) << (7 * i)
+        if not data[pos + i] & 0x80:
+            return value & 0xFFFFFFFF, pos + i + 1
+    raise ValueError('varint too long')
+
+def decode_record(record_type, value):
+    if record_type == PACKET_LC_CONFIG and len(value) == 2:
+        config = value[0] | (value[1] << 8)
+        return 'lc_config', {'coarse': (config >> 10) & 0x1F, 'mid': (config >> 5) & 0x1F, 'fine': config & 0x1F}
+    if record_type == PACKET_CLOCK_COUNTS:
+        count_2M, pos = read_unsigned_varint(value, 0)
+        count_32k, pos = read_unsigned_varint(value, pos)
+        if count_32k is None or pos != len(value):
+            return None
+        return 'clock_counts', {'count_2M': count_2M, 'count_32k': count_32k}
+    if record_type == PACKET_TEMPERATURE:
+        centi_degrees, pos = binlog_decode.read_varint(value, 0)
+        if centi_degrees is None or pos != len(value):
+            return None
+        return 'temperature', {'degrees': centi_degrees / 100.0}
+    if record_type == PACKET_OPTICAL and len(value) == len(OPTICAL_FIELDS):
+        return 'optical', dict(zip(OPTICAL_FIELDS, value))
+    if record_type == PACKET_IMU:
+        samples = telemetry_receiver.decode_imu_frame(value)
+        if samples is None:
+            return None
+        return 'imu', {'samples': [{'t_ms': t, 'axes': axes} for (t, axes) in samples]}
+    if record_type == PACKET_SWEEP_ROW and len(value) == 6:
+        fines = value[2] | (value[3] << 8) | (value[4] << 16) | (value[5] << 24)
+        return 'sweep_row', {'coarse': value[0], 'mid': value[1], 'fines': [n for n in range(32) if fines >> n & 1]}
+    if record_type in (PACKET_TIME, PACKET_ADC):
+        number, pos = read_unsigned_varint(value, 0)
+        if number is None or pos != len(value):
+            return None
+        if record_type == PACKET_TIME:
+            return 'time', {'ms': number}
+        return 'adc', {'value': number}
+    return 'type{0}'.format(record_type), {'raw': value.hex()}
+
+def decode_payload(payload):
+    '''
+    Returns (counter, [(name, fields)]) for PAYLOAD without the CRC, None if
+    the records run past its end.
+    '''
+    if not payload:
+        return None
+    records = []
+    pos = 1
+    t_ms = None
+    try:
+        while pos < len(payload) and payload[pos] != PACKET_PAD:
+            if pos + RECORD_HEADER_LEN > len(payload):
+                return None
+            record_type, length = payload[pos], payload[pos + 1]
+            pos += RECORD_HEADER_LEN
+            if pos + length > len(payload):
+                return None
+            record = decode_record(record_type, payload[pos:pos + length])
+            if record is None:
+                return None
+            # the first time record is absolute, the next ones add to it
+            if record[0] == 'time':
+                t_ms = record[1]['ms'] if t_ms is None else t_ms + record[1]['ms']
+                record = ('time', {'t_ms': t_ms})
+            records.append(record)
+            pos += length
+    except ValueError:
+        return None
+    return payload[0], records
+
+def find_payload(line):
+    runs = HEX_RUN_RE.findall(line)
+    if not runs:
+        return None
+    run = max(runs, key=len)
+    return bytearray.fromhex(re.sub(r'[ :-]', '', run))
+
+# =========================== output ==========================================
+
+def format_text(counter, records):
+    parts = ['#{0}'.format(counter)]
+    for name, fields in records:
+        if name == 'imu':
+            parts.append('imu {0} samples'.format(len(fields['samples'])))
+            continue
+        parts.append(name + ' ' + ' '.join('{0}={1}'.format(k, fields[k]) for k in sorted(fields)))
+    return '  '.join(parts)
+
+# =========================== main ============================================
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes freq_sweep_rx_tx binary payloads.')
+    parser.add_argument('input', nargs='?', default='-', help='one hex payload per line, - for stdin')
+    parser.add_argument('--strip-crc', action='store_true', help='the payloads still end with the 2 CRC bytes')
+    parser.add_argument('--format', choices=['text', 'json'], default='text')
+    args = parser.parse_args()
+
+    # captures often have binlog records or noise mixed in
+    if args.input == '-':
+        lines = io.TextIOWrapper(sys.stdin.buffer, errors='replace')
+    else:
+        lines = io.open(args.input, errors='replace')
+    for line in lines:
+        line = line.rstrip('\r\n')
+        payload = find_payload(line)
+        if payload is not None and args.strip_crc:
+            payload = payload[:-LENGTH_CRC]
+        decoded = decode_payload(payload) if payload else None
+        if decoded is None:
+            sys.stdout.write(line + '\n')
+            continue
+        counter, records = decoded
+        if args.format == 'json':
+            sys.stdout.write(json.dumps({'counter': counter, 'records': [dict(fields, type=name) for (name, fields) in records]}) + '\n')
+        else:
+            sys.stdout.write(format_text(counter, records) + '\n')
+
+if __name__ == '__main__':
+    main()
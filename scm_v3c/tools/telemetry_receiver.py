@@ -0,0 +1,359 @@
+"""
+Receives the telemetry frames sent by telemetry_send() (see scm_v3c/telemetry.c).
+
+Frames are split on the 0x00 delimiters, COBS decoded and checked against
+their CRC-16. Sequence numbers are tracked per channel to count lost,
+reordered and duplicate frames. Text between frames, like the output of a
+plain printf, is passed through. Records on the log channel are formatted
+with the binlog dictionary, see binlog_decode.py, frames on the IMU
+channel are expanded into their samples, see imu_sampler.c, and counter
+snapshots and trace events are split into their fields.
+
+    python telemetry_receiver.py capture.bin
+    python telemetry_receiver.py --port COM5 --stats-interval 10
+    python telemetry_receiver.py --port COM5 --fast --format json   # after uart_set_fast_baud(true)
+
+Per channel statistics go to stderr at the end (Ctrl-C when reading a port).
+"""
+
+import argparse
+import json
+import struct
+import sys
+import time
+
+import binlog_decode
+
+# =========================== defines =========================================
+
+DELIMITER           = 0x00
+CRC_INIT            = 0xFFFF
+CRC_POLY            = 0x1021
+HEADER_LEN          = 2
+CRC_LEN             = 2
+
+BAUDRATE            = 19200
+BAUDRATE_FAST       = 76800     # HCLK divider in passthrough, see uart_set_fast_baud()
+
+SEQ_MODULO          = 256
+# a sequence number this far behind the expected one is a late frame,
+# anything closer ahead means frames were lost
+SEQ_WINDOW          = SEQ_MODULO // 2
+
+CHANNEL_LOG         = 0
+CHANNEL_COUNTERS    = 1
+CHANNEL_IMU         = 2
+CHANNEL_TRACE       = 3
+CHANNEL_RAW_CHIPS   = 4
+
+IMU_HEADER_LEN      = 7
+IMU_AXES            = ('acc_x', 'acc_y', 'acc_z', 'gyro_x', 'gyro_y', 'gyro_z')
+
+# counters_snapshot_t, see counters.h
+COUNTERS_FIELDS     = ('count_32k', 'count_2M', 'count_HF', 'count_LC_div', 'count_IF', 'elapsed_ticks')
+COUNTERS_FORMAT     = '<6I'
+
+# [event] [RF timer] [arg], see telemetry_trace()
+TRACE_FORMAT        = '<BIi'
+TRACE_EVENTS        = ('ack_sent', 'ack_late', 'sync_lock', 'sync_frame', 'sync_miss')
+
+CHANNEL_NAMES = {
+    CHANNEL_LOG:        'log',
+    CHANNEL_COUNTERS:   'counters',
+    CHANNEL_IMU:        'imu',
+    CHANNEL_TRACE:      'trace',
+    CHANNEL_RAW_CHIPS:  'raw_chips',
+}
+
+# =========================== helpers =========================================
+
+def crc16(data):
+    crc = CRC_INIT
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ CRC_POLY) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+def cobs_decode(data):
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        if code == 0 or pos + code > len(data):
+            return None
+        out += data[pos + 1:pos + code]
+        pos += code
+        if code < 0xFF and pos < len(data):
+            out.append(0)
+    return out
+
+def channel_name(channel):
+    return CHANNEL_NAMES.get(channel, 'channel{0}'.format(channel))
+
+def decode_imu_frame(payload):
+    '''
+    Returns the samples of an imu_sampler_pack() frame as (t_ms, [acc_x,
+    acc_y, acc_z, gyro_x, gyro_y, gyro_z]) tuples, None if it is malformed.
+    '''
+    if len(payload) < IMU_HEADER_LEN + 2 * len(IMU_AXES):
+        return None
+    num_samples, timestamp, period = struct.unpack_from('<BIH', payload)
+    axes = list(struct.unpack_from('<{0}h'.format(len(IMU_AXES)), payload, IMU_HEADER_LEN))
+    pos  = IMU_HEADER_LEN + 2 * len(IMU_AXES)
+
+    samples = [(timestamp / binlog_decode.RFTIMER_TICKS_PER_MS, list(axes))]
+    try:
+        for n in range(1, num_samples):
+            for i in range(len(IMU_AXES)):
+                delta, pos = binlog_decode.read_varint(payload, pos)
+                if delta is None:
+                    return None
+                # the chip wraps to int16 as well
+                axes[i] = (axes[i] + delta + 0x8000) % 0x10000 - 0x8000
+            t = ((timestamp + n * period) & 0xFFFFFFFF) / binlog_decode.RFTIMER_TICKS_PER_MS
+            samples.append((t, list(axes)))
+    except ValueError:
+        return None
+    if pos != len(payload):
+        return None
+    return samples
+
+# =========================== statistics ======================================
+
+class ChannelStats(object):
+
+    def __init__(self):
+        self.frames     = 0
+        self.bytes      = 0
+        self.lost       = 0
+        self.reordered  = 0
+        self.duplicates = 0
+        self.expected   = None
+        self.missing    = set()
+
+    def update(self, seq, payload_len):
+        self.frames += 1
+        self.bytes  += payload_len
+
+        if self.expected is None:
+            self.expected = (seq + 1) % SEQ_MODULO
+            return
+
+        ahead = (seq - self.expected) % SEQ_MODULO
+        if ahead < SEQ_WINDOW:
+            for i in range(ahead):
+                self.missing.add((self.expected + i) % SEQ_MODULO)
+            self.lost    += ahead
+            self.expected = (seq + 1) % SEQ_MODULO
+        elif seq in self.missing:
+            # counted as lost when the frames after it came in
+            self.missing.remove(seq)
+            self.lost      -= 1
+            self.reordered += 1
+        else:
+            self.duplicates += 1
+
+        # too old to come in late, before the sequence numbers wrap onto them
+        self.missing = set(s for s in self.missing if (self.expected - s) % SEQ_MODULO < SEQ_WINDOW)
+
+class Stats(object):
+
+    def __init__(self):
+        self.channels   = {}
+        self.bad_frames = 0
+        self.text_bytes = 0
+
+    def channel(self, channel):
+        if channel not in self.channels:
+            self.channels[channel] = ChannelStats()
+        return self.channels[channel]
+
+    def report(self, out):
+        out.write('{0:<10} {1:>8} {2:>10} {3:>6} {4:>9} {5:>10}\n'.format(
+            'channel', 'frames', 'bytes', 'lost', 'reordered', 'duplicates'))
+        for channel in sorted(self.channels):
+            s = self.channels[channel]
+            out.write('{0:<10} {1:>8} {2:>10} {3:>6} {4:>9} {5:>10}\n'.format(
+                channel_name(channel), s.frames, s.bytes, s.lost, s.reordered, s.duplicates))
+        out.write('bad frames {0}, text {1} bytes\n'.format(self.bad_frames, self.text_bytes))
+        out.flush()
+
+# =========================== receiver ========================================
+
+class TelemetryReceiver(object):
+    '''
+    feed() returns what could be decoded so far as ('frame', channel, seq,
+    payload), ('text', str) and ('bad', bytes) items, keeping the segment
+    after the last delimiter for the next call or flush().
+    '''
+
+    def __init__(self, stats):
+        self.stats   = stats
+        self.segment = bytearray()
+
+    def feed(self, data):
+        out = []
+        for byte in bytearray(data):
+            if byte != DELIMITER:
+                self.segment.append(byte)
+                continue
+            if self.segment:
+                out.append(self._segment(bytes(self.segment)))
+                self.segment = bytearray()
+        return out
+
+    def flush(self):
+        out = []
+        if self.segment:
+            out.append(self._segment(bytes(self.segment)))
+            self.segment = bytearray()
+        return out
+
+    def _segment(self, segment):
+        frame = cobs_decode(segment)
+        if frame is not None and len(frame) >= HEADER_LEN + CRC_LEN:
+            crc = frame[-2] | (frame[-1] << 8)
+            if crc16(frame[:-CRC_LEN]) == crc:
+                channel, seq = frame[0], frame[1]
+                payload = bytes(frame[HEADER_LEN:-CRC_LEN])
+                self.stats.channel(channel).update(seq, len(payload))
+                return ('frame', channel, seq, payload)
+
+        # text never contains 0x00, a frame hit by a dropped or flipped byte
+        # usually has some bytes that aren't printable
+        if all(b in b'\r\n\t' or 0x20 <= b < 0x7F for b in segment):
+            self.stats.text_bytes += len(segment)
+            return ('text', segment.decode('ascii'))
+        self.stats.bad_frames += 1
+        return ('bad', segment)
+
+# =========================== writers =========================================
+
+class Writer(object):
+
+    def __init__(self, out, fmt, messages):
+        self.out      = out
+        self.fmt      = fmt
+        self.messages = messages
+
+    def write(self, item):
+        if item[0] == 'bad':
+            return
+        if item[0] == 'text':
+            if self.fmt == 'json':
+                for line in item[1].splitlines():
+                    if line.strip():
+                        self.out.write(json.dumps({'text': line}) + '\n')
+            else:
+                self.out.write(item[1])
+            return
+
+        _, channel, seq, payload = item
+        record = {'channel': channel_name(channel), 'seq': seq}
+
+        if channel == CHANNEL_LOG:
+            # the binlog record without its sync byte and checksum
+            message, t_ms, args = self._decode_log(payload)
+            if message is None:
+                record['payload'] = payload.hex()
+            elif self.fmt == 'json':
+                record.update({'t_ms': t_ms, 'name': message['name'], 'args': args})
+            else:
+                self.out.write(binlog_decode.format_message(message, args))
+                return
+        elif channel == CHANNEL_COUNTERS and len(payload) == struct.calcsize(COUNTERS_FORMAT):
+            record.update(zip(COUNTERS_FIELDS, struct.unpack(COUNTERS_FORMAT, payload)))
+            if self.fmt != 'json':
+                self.out.write(' '.join('{0}={1}'.format(f, record[f]) for f in COUNTERS_FIELDS) + '\n')
+                return
+        elif channel == CHANNEL_TRACE and len(payload) == struct.calcsize(TRACE_FORMAT):
+            event, timestamp, arg = struct.unpack(TRACE_FORMAT, payload)
+            record.update({'t_ms': timestamp / binlog_decode.RFTIMER_TICKS_PER_MS,
+                           'event': TRACE_EVENTS[event] if event < len(TRACE_EVENTS) else event,
+                           'arg': arg})
+            if self.fmt != 'json':
+                self.out.write('[{0:12.3f}] {1} {2}\n'.format(record['t_ms'], record['event'], arg))
+                return
+        elif channel == CHANNEL_RAW_CHIPS:
+            words = struct.unpack('<{0}I'.format(len(payload) // 4), payload[:len(payload) // 4 * 4])
+            if self.fmt != 'json':
+                self.out.write(''.join('{0:X}\r\n'.format(w) for w in words))
+                return
+            record['words'] = list(words)
+        elif channel == CHANNEL_IMU:
+            samples = decode_imu_frame(payload)
+            if samples is None:
+                record['payload'] = payload.hex()
+            elif self.fmt == 'json':
+                record['samples'] = [dict(zip(('t_ms',) + IMU_AXES, [t] + axes)) for t, axes in samples]
+            else:
+                for t, axes in samples:
+                    self.out.write('[{0:12.3f}] {1}\n'.format(t, ' '.join('{0:6d}'.format(a) for a in axes)))
+                return
+        else:
+            record['payload'] = payload.hex()
+
+        if self.fmt == 'json':
+            self.out.write(json.dumps(record) + '\n')
+        else:
+            self.out.write('[{0} #{1}] {2}\n'.format(record['channel'], seq, record.get('payload', '')))
+
+    def _decode_log(self, payload):
+        if len(payload) < 1 + binlog_decode.TIMESTAMP_LEN or payload[0] >= len(self.messages):
+            return None, None, None
+        message   = self.messages[payload[0]]
+        pos       = 1 + binlog_decode.TIMESTAMP_LEN
+        timestamp = int.from_bytes(payload[1:pos], 'little')
+        args      = []
+        try:
+            for _ in range(message['nargs']):
+                value, pos = binlog_decode.read_varint(payload, pos)
+                if value is None:
+                    return None, None, None
+                args.append(value)
+        except ValueError:
+            return None, None, None
+        if pos != len(payload):
+            return None, None, None
+        return message, timestamp / binlog_decode.RFTIMER_TICKS_PER_MS, args
+
+# =========================== main ============================================
+
+def main():
+    parser = argparse.ArgumentParser(description='Receives SCuM telemetry frames.')
+    parser.add_argument('input', nargs='?', default='-', help='captured UART output, - for stdin')
+    parser.add_argument('--port', help='read from this serial port instead')
+    parser.add_argument('--baudrate', type=int, default=BAUDRATE)
+    parser.add_argument('--fast', action='store_true', help='{0} baud, see uart_set_fast_baud()'.format(BAUDRATE_FAST))
+    parser.add_argument('--messages', default=binlog_decode.DEFAULT_MESSAGES, help='binlog_messages.h the firmware was built with')
+    parser.add_argument('--format', choices=['text', 'json'], default='text')
+    parser.add_argument('--stats-interval', type=float, default=0, help='also print the statistics every so many seconds')
+    args = parser.parse_args()
+
+    if args.fast:
+        args.baudrate = BAUDRATE_FAST
+
+    stats     = Stats()
+    receiver  = TelemetryReceiver(stats)
+    writer    = Writer(sys.stdout, args.format, binlog_decode.load_dictionary(args.messages))
+    last_report = time.time()
+
+    try:
+        for chunk in binlog_decode.read_chunks(args):
+            for item in receiver.feed(chunk):
+                writer.write(item)
+            sys.stdout.flush()
+            if args.stats_interval and time.time() - last_report >= args.stats_interval:
+                stats.report(sys.stderr)
+                last_report = time.time()
+    except KeyboardInterrupt:
+        pass
+
+    for item in receiver.flush():
+        writer.write(item)
+    stats.report(sys.stderr)
+
+if __name__ == '__main__':
+    main()
@@ -1,4 +1,233 @@
+/**
+\brief Buffered UART output.
+
+Writing UART_REG__TX_DATA while the previous character is still being shifted
+out stalls the bus until it is done, so a printf used to cost about 0.5ms per
+character. Characters now go into a ring buffer and an RF timer compare
+writes one every character time, i.e. once the UART is free again. There is
+no TX ready interrupt to do this with. Until rftimer_init() has started the
+RF timer, the characters are written directly as before.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "memory_map.h"
+#include "rftimer.h"
+#include "scm3c_hw_interface.h"
+#include "uart.h"
+
+//=========================== defines =========================================
+
+#define UART_RFTIMER_COMPAREID      3
+
+// 10 bits at 19200 baud is 260.4 RF timer ticks, round up so we never stall
+#define UART_TICKS_PER_CHAR         261
+// the UART divides HCLK by a fixed ratio, HCLK at HF_CLOCK/1 instead of /4
+// (20MHz instead of 5MHz) runs it at 76800 baud
+#define UART_TICKS_PER_CHAR_FAST    66
+#define ASC_HCLK_DIV_PASSTHROUGH    37
+
+#define UART_TX_BUFFER_MASK         (UART_TX_BUFFER_SIZE - 1)
+
+//=========================== variables =======================================
+
+typedef struct {
+    uint8_t             tx_buffer[UART_TX_BUFFER_SIZE];
+    volatile uint16_t   tx_head;        // next free slot, only moved by uart_tx_write()
+    volatile uint16_t   tx_tail;        // next character out, only moved by the pump
+    volatile bool       tx_pumping;     // the compare is armed
+    uint32_t            tx_next_tick;
+    bool                fast_baud;
+    volatile uint32_t   tx_dropped;
+    uart_rx_cbt         rx_cb;
+} uart_vars_t;
+
+uart_vars_t uart_vars;
+
+//=========================== prototypes ======================================
+
+void     uart_tx_pump(void);
+void     uart_tx_direct(const uint8_t* buf, uint16_t len);
+uint16_t uart_tx_room(void);
+uint32_t uart_tx_ticks_per_char(void);
+
+//=========================== public ==========================================
+
+/* Queues LEN bytes for the UART, all or none of them, so that a record
+ * written from an interrupt can't land in the middle of another one. Starts
+ * the pump if it is idle. Safe to call from interrupt context, see
+ * UART_TX_BLOCK_WHEN_FULL for what happens when there isn't enough room.
+ * Returns false if the bytes were dropped.
+ */
+bool uart_tx_write(const uint8_t* buf, uint16_t len) {
+    bool in_isr;
+    bool queued;
+    uint16_t i;
+
+    // the ISR wrappers keep interrupts masked while they run
+    in_isr = (ICSR & ICSR_VECTACTIVE) != 0;
+
+    // nothing would run the pump
+    if (!(RFTIMER_REG__CONTROL & RFTIMER_REG__CONTROL_ENABLE)) {
+        uart_tx_direct(buf, len);
+        return true;
+    }
+
+    if (!in_isr) {
+        HAL_DISABLE_INTERRUPTS();
+#if UART_TX_BLOCK_WHEN_FULL
+        while (len < UART_TX_BUFFER_SIZE && uart_tx_room() < len) {
+            HAL_ENABLE_INTERRUPTS();
+            HAL_IDLE();
+            HAL_DISABLE_INTERRUPTS();
+        }
+#endif
+    }
+
+    queued = uart_tx_room() >= len;
+    if (!queued) {
+        uart_vars.tx_dropped += len;
+    } else {
+        for (i = 0; i < len; i++) {
+            uart_vars.tx_buffer[uart_vars.tx_head] = buf[i];
+            uart_vars.tx_head = (uart_vars.tx_head + 1) & UART_TX_BUFFER_MASK;
+        }
+
+        if (len > 0 && !uart_vars.tx_pumping) {
+            // the last character went out at least a character time ago
+            uart_vars.tx_pumping   = true;
+            uart_vars.tx_next_tick = rftimer_readCounter();
+            rftimer_set_callback(uart_tx_pump, UART_RFTIMER_COMPAREID);
+            uart_tx_pump();
+        }
+    }
+
+    if (!in_isr) {
+        HAL_ENABLE_INTERRUPTS();
+    }
+    return queued;
+}
+
+// Queues a single character, returns CH or EOF if it was dropped
+int uart_tx_putc(int ch) {
+    uint8_t c;
+
+    c = (uint8_t) ch;
+    return uart_tx_write(&c, 1) ? ch : EOF;
+}
+
+/* Returns once everything queued has been written to the UART and the last
+ * character has had time to go out, e.g. before a soft reset. From interrupt
+ * context the pump can't run, so the buffer is written out directly.
+ */
+void uart_tx_flush(void) {
+    uint32_t start;
+
+    if (ICSR & ICSR_VECTACTIVE) {
+        RFTIMER_REG__COMPARE_CONTROL(UART_RFTIMER_COMPAREID) = 0x0;
+        while (uart_vars.tx_tail != uart_vars.tx_head) {
+            UART_REG__TX_DATA = uart_vars.tx_buffer[uart_vars.tx_tail];
+            uart_vars.tx_tail = (uart_vars.tx_tail + 1) & UART_TX_BUFFER_MASK;
+        }
+        uart_vars.tx_pumping = false;
+        
+        start = rftimer_readCounter();
+        while (rftimer_readCounter() - start < uart_tx_ticks_per_char());
+        return;
+    }
+
+    // the pump stops a character time after writing the last one
+    while (uart_vars.tx_pumping) {
+        HAL_IDLE();
+    }
+}
+
+/* Switches the UART between 19200 and 76800 baud, for bulk dumps. There is
+ * no baud rate register, the UART's divider is fixed, so this runs HCLK and
+ * with it the CPU 4 times faster: delay loops counted in CPU cycles get
+ * shorter, the RF timer isn't affected. Flushes what was queued at the old
+ * rate first. The receiver has to switch too, its CRC check drops what it
+ * reads at the wrong baud. The raw chips dump in radio.c uses it.
+ */
+void uart_set_fast_baud(bool fast) {
+    uart_tx_flush();
+
+    if (fast) {
+        set_asc_bit(ASC_HCLK_DIV_PASSTHROUGH);
+    } else {
+        clear_asc_bit(ASC_HCLK_DIV_PASSTHROUGH);
+    }
+    analog_scan_chain_write();
+    analog_scan_chain_load();
+    uart_vars.fast_baud = fast;
+}
+
+// Calls CB with each received byte, from interrupt context
+void uart_set_rx_callback(uart_rx_cbt cb) {
+    uart_vars.rx_cb = cb;
+    ISER = 0x1;
+}
+
+// Bytes dropped because the buffer was full
+uint32_t uart_tx_dropped(void) {
+    return uart_vars.tx_dropped;
+}
+
+//=========================== private =========================================
+
+// One slot stays empty to tell a full buffer from an empty one
+uint16_t uart_tx_room(void) {
+    return (uart_vars.tx_tail - uart_vars.tx_head - 1) & UART_TX_BUFFER_MASK;
+}
+
+// Writes what is left in the buffer then BUF, each write waiting for the UART
+void uart_tx_direct(const uint8_t* buf, uint16_t len) {
+    uint16_t i;
+
+    while (uart_vars.tx_tail != uart_vars.tx_head) {
+        UART_REG__TX_DATA = uart_vars.tx_buffer[uart_vars.tx_tail];
+        uart_vars.tx_tail = (uart_vars.tx_tail + 1) & UART_TX_BUFFER_MASK;
+    }
+    for (i = 0; i < len; i++) {
+        UART_REG__TX_DATA = buf[i];
+    }
+}
+
+// Writes the next character, called from the RF timer compare interrupt
+void uart_tx_pump(void) {
+    if (uart_vars.tx_tail == uart_vars.tx_head) {
+        RFTIMER_REG__COMPARE_CONTROL(UART_RFTIMER_COMPAREID) = 0x0;
+        uart_vars.tx_pumping = false;
+        return;
+    }
+
+    UART_REG__TX_DATA = uart_vars.tx_buffer[uart_vars.tx_tail];
+    uart_vars.tx_tail = (uart_vars.tx_tail + 1) & UART_TX_BUFFER_MASK;
+
+    // keep to a fixed cadence rather than drifting by the interrupt latency,
+    // unless we are so late that the compare would only match after a wrap
+    uart_vars.tx_next_tick += uart_tx_ticks_per_char();
+    if ((int32_t)(uart_vars.tx_next_tick - rftimer_readCounter()) <= 0) {
+        uart_vars.tx_next_tick = rftimer_readCounter() + uart_tx_ticks_per_char();
+    }
+    rftimer_setCompareIn(uart_vars.tx_next_tick, UART_RFTIMER_COMPAREID);
+}
+
+uint32_t uart_tx_ticks_per_char(void) {
+    return uart_vars.fast_baud ? UART_TICKS_PER_CHAR_FAST : UART_TICKS_PER_CHAR;
+}
+
+//=========================== interrupt =======================================
 
 void uart_rx_isr(){
-    printf("uart rx interrupt triggered\r\n");
-}
\ No newline at end of file
+    uint8_t byte;
+    
+    byte = (uint8_t) UART_REG__RX_DATA;
+    
+    if (uart_vars.rx_cb != NULL) {
+        uart_vars.rx_cb(byte);
+    } else {
+        printf("uart rx interrupt triggered\r\n");
+    }
+}
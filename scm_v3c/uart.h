@@ -1,12 +1,33 @@
 #ifndef __UART_H
 #define __UART_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 //=========================== define ==========================================
 
+// power of 2, so the indexes can wrap with a mask
+#define UART_TX_BUFFER_SIZE         1024
+
+// When the buffer is full, wait for room from the main loop (1) or drop the
+// new bytes (0). Interrupt context always drops, the pump can't run there.
+#define UART_TX_BLOCK_WHEN_FULL     1
+
 //=========================== typedef =========================================
 
+typedef void (*uart_rx_cbt)(uint8_t byte);
+
 //=========================== variables =======================================
 
 //=========================== prototypes ======================================
 
-#endif
\ No newline at end of file
+bool     uart_tx_write(const uint8_t* buf, uint16_t len);
+int      uart_tx_putc(int ch);
+void     uart_tx_flush(void);
+void     uart_set_fast_baud(bool fast);
+uint32_t uart_tx_dropped(void);
+void     uart_set_rx_callback(uart_rx_cbt cb);
+
+void     uart_rx_isr(void);
+
+#endif
@@ -0,0 +1,190 @@
+/**
+\brief GPIO waveforms played from RF timer compare interrupts.
+
+A waveform is a table of steps, each setting, clearing or toggling a mask of
+GPIO outputs and then waiting a number of RF timer ticks. A step can be
+repeated, and a loop step plays a range of steps again, so long periodic
+drive patterns such as the SARA phase sequence in zappy2.c fit in a few
+entries.
+
+The edges come from the RF timer compare interrupt, so the CPU can sleep
+between them and the timing does not depend on HCLK. Each deadline is the
+previous one plus the step's ticks, so the edges stay on a grid instead of
+drifting by the interrupt latency. An edge that is already late is applied
+right away instead of being dropped.
+*/
+
+#include "memory_map.h"
+#include "rftimer.h"
+#include "waveform.h"
+
+//=========================== defines =========================================
+
+#define WAVEFORM_RFTIMER_COMPAREID      5
+
+// a compare closer than this to the counter might be missed
+#define WAVEFORM_MIN_ADVANCE_TICKS      5
+
+//=========================== variables =======================================
+
+typedef struct {
+    const waveform_t*   waveform;
+    uint8_t             index;          // step being played
+    uint16_t            repeat_left;    // times the step still has to be applied
+    uint16_t            loop_left;      // times the loop still has to be played
+    uint32_t            next_tick;
+    volatile bool       busy;
+} waveform_vars_t;
+
+waveform_vars_t waveform_vars;
+
+//=========================== prototypes ======================================
+
+void waveform_run(void);
+
+//=========================== public ==========================================
+
+void waveform_init(waveform_t* waveform) {
+    waveform->num_steps = 0;
+}
+
+/* Appends a step applying OP to the GPIO outputs in MASK REPEAT times, TICKS
+ * RF timer ticks apart. Returns false if the table is full or REPEAT is 0.
+ */
+bool waveform_add(waveform_t* waveform, uint8_t op, uint16_t mask, uint16_t repeat, uint32_t ticks) {
+    waveform_step_t* step;
+
+    if (waveform->num_steps >= WAVEFORM_MAX_STEPS || op > WAVEFORM_TOGGLE || repeat == 0) {
+        return false;
+    }
+
+    step = &waveform->steps[waveform->num_steps++];
+    step->op     = op;
+    step->mask   = mask;
+    step->repeat = repeat;
+    step->ticks  = ticks;
+    return true;
+}
+
+/* Appends a loop, so the steps from FIRST_STEP up to here are played COUNT
+ * times in all. Loops can't be nested. Returns false if the table is full,
+ * COUNT is 0 or the steps already hold a loop.
+ */
+bool waveform_add_loop(waveform_t* waveform, uint8_t first_step, uint16_t count) {
+    waveform_step_t* step;
+    uint8_t          i;
+
+    if (waveform->num_steps >= WAVEFORM_MAX_STEPS || first_step >= waveform->num_steps || count == 0) {
+        return false;
+    }
+    for (i = first_step; i < waveform->num_steps; i++) {
+        if (waveform->steps[i].op == WAVEFORM_LOOP) {
+            return false;
+        }
+    }
+
+    step = &waveform->steps[waveform->num_steps++];
+    step->op     = WAVEFORM_LOOP;
+    step->mask   = first_step;
+    step->repeat = count;
+    step->ticks  = 0;
+    return true;
+}
+
+/* Starts playing WAVEFORM, the first edges are applied before returning. The
+ * table must stay valid until the waveform is over. Returns false if another
+ * one is still playing or WAVEFORM is empty.
+ */
+bool waveform_play(const waveform_t* waveform) {
+    if (waveform_vars.busy || waveform->num_steps == 0) {
+        return false;
+    }
+
+    waveform_vars.waveform    = waveform;
+    waveform_vars.index       = 0;
+    waveform_vars.repeat_left = 0;
+    waveform_vars.loop_left   = 0;
+    waveform_vars.busy        = true;
+
+    rftimer_set_callback(waveform_run, WAVEFORM_RFTIMER_COMPAREID);
+    rftimer_set_repeat(false, WAVEFORM_RFTIMER_COMPAREID);
+
+    waveform_vars.next_tick = rftimer_readCounter();
+    waveform_run();
+    return true;
+}
+
+bool waveform_busy(void) {
+    return waveform_vars.busy;
+}
+
+// Sleeps until the waveform is over, from the main loop only
+void waveform_wait(void) {
+    // interrupts stay masked between the check and the sleep so the last
+    // compare can't slip in between, a pending interrupt still wakes up WFI
+    HAL_DISABLE_INTERRUPTS();
+    while (waveform_vars.busy) {
+        HAL_WAIT_FOR_INTERRUPT();
+        HAL_ENABLE_INTERRUPTS();
+        HAL_DISABLE_INTERRUPTS();
+    }
+    HAL_ENABLE_INTERRUPTS();
+}
+
+// Stops the waveform, the GPIO outputs keep their current state
+void waveform_stop(void) {
+    waveform_vars.busy = false;
+    // only this compare, rftimer_disable_interrupts() would mask all of them
+    RFTIMER_REG__COMPARE_CONTROL(WAVEFORM_RFTIMER_COMPAREID) = 0x0;
+}
+
+//=========================== interrupt =======================================
+
+// Applies the steps that are due and schedules the compare for the next one
+void waveform_run(void) {
+    const waveform_step_t* step;
+
+    while (waveform_vars.busy) {
+        if (waveform_vars.index >= waveform_vars.waveform->num_steps) {
+            waveform_stop();
+            return;
+        }
+        step = &waveform_vars.waveform->steps[waveform_vars.index];
+
+        if (step->op == WAVEFORM_LOOP) {
+            if (waveform_vars.loop_left == 0) {
+                waveform_vars.loop_left = step->repeat;
+            }
+            waveform_vars.loop_left--;
+            waveform_vars.index = (waveform_vars.loop_left > 0) ? step->mask : waveform_vars.index + 1;
+            continue;
+        }
+
+        if (waveform_vars.repeat_left == 0) {
+            waveform_vars.repeat_left = step->repeat;
+        }
+        switch (step->op) {
+            case WAVEFORM_SET:
+                GPIO_REG__OUTPUT |= step->mask;
+                break;
+            case WAVEFORM_CLEAR:
+                GPIO_REG__OUTPUT &= ~step->mask;
+                break;
+            default:
+                GPIO_REG__OUTPUT ^= step->mask;
+                break;
+        }
+        waveform_vars.repeat_left--;
+        if (waveform_vars.repeat_left == 0) {
+            waveform_vars.index++;
+        }
+
+        if (step->ticks != 0) {
+            waveform_vars.next_tick += step->ticks;
+            if ((int32_t) (waveform_vars.next_tick - rftimer_readCounter()) >= WAVEFORM_MIN_ADVANCE_TICKS) {
+                rftimer_setCompareIn(waveform_vars.next_tick, WAVEFORM_RFTIMER_COMPAREID);
+                return;
+            }
+        }
+    }
+}
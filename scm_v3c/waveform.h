@@ -0,0 +1,45 @@
+#ifndef __WAVEFORM_H
+#define __WAVEFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== define ==========================================
+
+#define WAVEFORM_MAX_STEPS      24
+
+// what a step does to GPIO_REG__OUTPUT
+enum {
+    WAVEFORM_SET = 0,           // sets the bits in mask
+    WAVEFORM_CLEAR,             // clears the bits in mask
+    WAVEFORM_TOGGLE,            // toggles the bits in mask
+    WAVEFORM_LOOP               // plays the steps from index mask again, see waveform_add_loop()
+};
+
+//=========================== typedef =========================================
+
+typedef struct {
+    uint8_t     op;
+    uint16_t    mask;
+    uint16_t    repeat;         // times the step is applied, or times the loop is played
+    uint32_t    ticks;          // RF timer ticks after each time, 0 goes on right away
+} waveform_step_t;
+
+typedef struct {
+    waveform_step_t steps[WAVEFORM_MAX_STEPS];
+    uint8_t         num_steps;
+} waveform_t;
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void waveform_init(waveform_t* waveform);
+bool waveform_add(waveform_t* waveform, uint8_t op, uint16_t mask, uint16_t repeat, uint32_t ticks);
+bool waveform_add_loop(waveform_t* waveform, uint8_t first_step, uint16_t count);
+bool waveform_play(const waveform_t* waveform);
+bool waveform_busy(void);
+void waveform_wait(void);
+void waveform_stop(void);
+
+#endif
@@ -1,193 +1,78 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include "Memory_Map.h"
+#include "memory_map.h"
 //#include "scm3_hardware_interface.h"
 //#include "scm3c_hardware_interface.h"
 #include "scm3c_hw_interface.h"
-void sara_start(unsigned int toggles,unsigned int periodCounts)
-{	
-	unsigned int i=1;
-	unsigned int t;
-	unsigned int x=1;
-	
+#include "zappy2.h"
 
-	i=1;
-	x=1;
-	//GPIO_REG__OUTPUT = 0x0010;//starts the first toggle
-	GPIO_REG__OUTPUT=GPIO_REG__OUTPUT | 0x0010;
-	GPIO_REG__OUTPUT=GPIO_REG__OUTPUT & 0xFFDF;
-	//I consider it a toggle when any of the two signals generate a one
+#define SARA_CLOCK	0x0040	// GPIO 6
 
-	while(x<toggles)  { //LOOP
-		if(i<16)
-		{
-				GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-				for(t=0;t<periodCounts;t++);
-		}
-		else
-		{		
-				if ((GPIO_REG__OUTPUT | 0xFFEF)==0xFFFF)//if GPIO4 is high toggle GPIO5
-				{
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFF9F); // toggles GPIO6 and GPIO5
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFAF); //toggles GPIO6 & 4
-						for(t=0;t<periodCounts;t++);
-				}
-				else
-				{
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFAF); // toggles GPIO6 and GPIO5
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFF9F); //toggles GPIO6 & 4
-						for(t=0;t<periodCounts;t++);
-				}
-				
-				i=0;
-				x++;
-		}
-		i=i+1;
+// played from the RF timer, so it has to outlive the sara_* calls
+waveform_t sara_waveform;
 
-	}	
-	
-	while(i<11)  { 
-		if(i<11)
-		{
-				GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-				for(t=0;t<periodCounts;t++);
-		}
-		i=i+1;
-	}	
-	//I'm going to set GPIO 4, and 5 stay high.
-	GPIO_REG__OUTPUT = GPIO_REG__OUTPUT | 0x0030; 
-	i=0;
-	while(i<12)  { 
-	if(i<12)
-	{
-			GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-			for(t=0;t<periodCounts;t++);
-	}
-	i=i+1;
-	}	
-}
+/* Compiles the SARA drive pattern into WAVEFORM, one GPIO edge every PERIODTICKS RF timer ticks.
+ * PIN_A starts high and PIN_B low. Each of the TOGGLES-1 cycles is 15 clock edges followed by
+ * the phase swap, clock with B, 3 clocks, clock with A, where every other cycle swaps A and B
+ * back in the other order. Then 10 more clocks, A and B both high and 12 clocks to latch.
+ */
+void sara_compile(waveform_t* waveform, unsigned int toggles, unsigned int pin_a, unsigned int pin_b, unsigned int periodTicks)
+{
+	unsigned int cycles = (toggles > 1) ? toggles - 1 : 0;
 
-void sara_start2(unsigned int toggles,unsigned int periodCounts)
-{	
-	unsigned int i=1;
-	unsigned int t;
-	unsigned int x=1;
-	
+	waveform_init(waveform);
+	waveform_add(waveform, WAVEFORM_SET, pin_a, 1, 0);
+	waveform_add(waveform, WAVEFORM_CLEAR, pin_b, 1, 0);
 
-	i=1;
-	x=1;
-	GPIO_REG__OUTPUT=GPIO_REG__OUTPUT | 0x0100;
-	GPIO_REG__OUTPUT=GPIO_REG__OUTPUT & 0xFDFF;
-	//GPIO_REG__OUTPUT = 0x0100;//starts the first toggle
-	//I consider it a toggle when any of the two signals generate a one
+	// two cycles bring A and B back where they started, loop over pairs of them
+	if (cycles >= 2) {
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK, 15, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK | pin_b, 1, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK, 3, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK | pin_a, 1, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK, 15, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK | pin_a, 1, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK, 3, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK | pin_b, 1, periodTicks);
+		waveform_add_loop(waveform, 2, cycles / 2);
+	}
+	if (cycles & 1) {
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK, 15, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK | pin_b, 1, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK, 3, periodTicks);
+		waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK | pin_a, 1, periodTicks);
+	}
 
-	while(x<toggles)  { //LOOP
-		if(i<16)
-		{
-				GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-				for(t=0;t<periodCounts;t++);
-		}
-		else
-		{		
-				if ((GPIO_REG__OUTPUT | 0xFDFF)==0xFFFF)//if GPIO9 is high toggle GPIO8
-				{
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFEBF); // toggles GPIO6 and GPIO8
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFDBF); //toggles GPIO6 & 9
-						for(t=0;t<periodCounts;t++);
-				}
-				else
-				{
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFDBF); // toggles GPIO6 and GPIO9
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-						i++;
-						for(t=0;t<periodCounts;t++);
-						GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFEBF); //toggles GPIO6 & 8
-						for(t=0;t<periodCounts;t++);
-				}
-				
-				i=0;
-				x++;
-		}
-		i=i+1;
+	waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK, 10, periodTicks);
+	//I'm going to set A, and B stay high.
+	waveform_add(waveform, WAVEFORM_SET, pin_a | pin_b, 1, 0);
+	waveform_add(waveform, WAVEFORM_TOGGLE, SARA_CLOCK, 12, periodTicks);
+}
 
-	}	
-	
-	while(i<11)  { 
-		if(i<11)
-		{
-				GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-				for(t=0;t<periodCounts;t++);
-		}
-		i=i+1;
-	}	
-	//I'm going to set GPIO 8, and 9 stay high.
-	GPIO_REG__OUTPUT = GPIO_REG__OUTPUT | 0x0300; 
-	i=0;
-	while(i<12)  { 
-	if(i<12)
-	{
-			GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-			for(t=0;t<periodCounts;t++);
-	}
-	i=i+1;
-	}	
+// Drives GPIO 4/5 with clock on GPIO 6, PERIODTICKS RF timer ticks per edge. Sleeps until done.
+void sara_start(unsigned int toggles,unsigned int periodTicks)
+{
+	sara_compile(&sara_waveform, toggles, 0x0010, 0x0020, periodTicks);
+	waveform_play(&sara_waveform);
+	waveform_wait();
 }
 
+// Same as sara_start() on GPIO 8/9
+void sara_start2(unsigned int toggles,unsigned int periodTicks)
+{
+	sara_compile(&sara_waveform, toggles, 0x0100, 0x0200, periodTicks);
+	waveform_play(&sara_waveform);
+	waveform_wait();
+}
 
-void sara_release(unsigned int periodCounts)
+// Clears all GPIO outputs then gives 12 clock edges on GPIO 6
+void sara_release(unsigned int periodTicks)
 {
-	int i, t;
-	GPIO_REG__OUTPUT = 0x0000; 
-	i=0;
-	while(i<12)  { 
-	if(i<12)
-	{
-			GPIO_REG__OUTPUT = ~(GPIO_REG__OUTPUT ^ 0xFFBF); //toggles only clock GPIO 6
-			for(t=0;t<periodCounts;t++);
-	}
-	i=i+1;
-	}	
+	waveform_init(&sara_waveform);
+	waveform_add(&sara_waveform, WAVEFORM_CLEAR, 0xFFFF, 1, 0);
+	waveform_add(&sara_waveform, WAVEFORM_TOGGLE, SARA_CLOCK, 12, periodTicks);
+	waveform_play(&sara_waveform);
+	waveform_wait();
 }
 	
 void testZappy2(unsigned int periodCounts)
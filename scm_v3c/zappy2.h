@@ -1,6 +1,10 @@
-void sara_start(unsigned int toggles, unsigned int periodCounts);
-void sara_start2(unsigned int toggles,unsigned int periodCounts);
-void sara_release(unsigned int periodCounts);
+#include "waveform.h"
+
+// periods are in RF timer ticks per GPIO edge
+void sara_compile(waveform_t* waveform, unsigned int toggles, unsigned int pin_a, unsigned int pin_b, unsigned int periodTicks);
+void sara_start(unsigned int toggles, unsigned int periodTicks);
+void sara_start2(unsigned int toggles,unsigned int periodTicks);
+void sara_release(unsigned int periodTicks);
 void testZappy2(unsigned int periodCounts);
 void GPIO9_interrupt_enable(void);
 void GPIO9_interrupt_disable(void);
@@ -173,6 +173,10 @@ void loop() {
       insert_crc();
     }
 
+    else if (inputString == "insertblockcrc\n") {
+      insert_block_crc();
+    }
+
     else if (inputString == "transfersram4b5b\n") {
       transfer_sram_4b5b();
     }
@@ -1567,12 +1571,17 @@ unsigned reverse(unsigned x) {
 
 // Same C function used for calculating CRC on SCM
 unsigned int crc32c(unsigned int length) {
-  int i, j;
-  unsigned int byte, crc;
+  return crc32c_block(0, length);
+}
 
-  i = 0;
+// CRC over length bytes of ram[] starting at start
+unsigned int crc32c_block(unsigned int start, unsigned int length) {
+  int j;
+  unsigned int i, byte, crc;
+
+  i = start;
   crc = 0xFFFFFFFF;
-  while (i < length) {
+  while (i < start + length) {
     byte = ram[i];            // Get next byte.
     byte = reverse(byte);         // 32-bit reversal.
     for (j = 0; j <= 7; j++) {    // Do eight times.
@@ -1611,6 +1620,48 @@ void insert_crc() {
   //Serial.println("Calculated CRC = " + String(calculated_crc));
 }
 
+// Block CRC table layout, must match scm3c_hw_interface.h on SCM
+#define BLOCK_SIZE            1024
+#define MAX_BLOCKS            64
+#define BLOCK_CRC_MAGIC_ADDR  0xFEF0
+#define BLOCK_CRC_TABLE_ADDR  0xFEF8
+
+// The bootloader script writes the magic "BCRC" and number of blocks at 0xFEF0
+// This function calculates the CRC over each block of the code and stores
+// the table from 0xFEF8 so SCM can tell which blocks were corrupted
+// Call this before insert_crc()
+void insert_block_crc() {
+
+  unsigned int code_length, num_blocks, block, start, length, calculated_crc, addr;
+
+  code_length = 256 * ram[65529] + ram[65528];
+  num_blocks = ram[BLOCK_CRC_MAGIC_ADDR + 4];
+
+  // Skip if the header is missing or the code overlaps the table
+  if (ram[BLOCK_CRC_MAGIC_ADDR] != 'B' || ram[BLOCK_CRC_MAGIC_ADDR + 1] != 'C' ||
+      ram[BLOCK_CRC_MAGIC_ADDR + 2] != 'R' || ram[BLOCK_CRC_MAGIC_ADDR + 3] != 'C' ||
+      num_blocks > MAX_BLOCKS || code_length > BLOCK_CRC_MAGIC_ADDR) {
+    return;
+  }
+
+  for (block = 0; block < num_blocks; block++) {
+    start = block * BLOCK_SIZE;
+    length = code_length - start;
+    if (length > BLOCK_SIZE) {
+      length = BLOCK_SIZE;
+    }
+
+    calculated_crc = crc32c_block(start, length);
+
+    // Store CRC in binary, little endian like the code length
+    addr = BLOCK_CRC_TABLE_ADDR + 4 * block;
+    ram[addr + 3] = (calculated_crc & 0xFF000000) >> 24;
+    ram[addr + 2] = (calculated_crc & 0x00FF0000) >> 16;
+    ram[addr + 1] = (calculated_crc & 0x0000FF00) >> 8;
+    ram[addr] =  calculated_crc & 0x000000FF;
+  }
+}
+
 
 /*
   SerialEvent occurs whenever a new data comes in the hardware serial RX. This